@@ -64,6 +64,7 @@ struct arm_pmu {
 	void			(*free_irq)(struct arm_pmu *);
 	int			(*map_event)(struct perf_event *event);
 	int			num_events;
+	bool			user_access;	/* PMUSERENR_EL0 lets EL0 read */
 	atomic_t		active_events;
 	struct mutex		reserve_mutex;
 	u64			max_period;
@@ -72,7 +73,7 @@ struct arm_pmu {
 	struct notifier_block	hotplug_nb;
 	struct notifier_block	cpu_pm_nb;
 	int			(*check_event)(
-					 struct arm_pmu *armpmu,
+					 struct pmu_hw_events *hw_events,
 					 struct hw_perf_event *hwc);
 };
 
@@ -291,12 +291,15 @@ armpmu_add(struct perf_event *event, int flags)
 
 	perf_pmu_disable(event->pmu);
 
-	if (armpmu->check_event) {
-		if (armpmu->check_event(armpmu, hwc)) {
-			event->state = PERF_EVENT_STATE_OFF;
-			hwc->idx = -1;
-			goto out;
-		}
+	/*
+	 * An event that cannot share the PMU with the ones already on it
+	 * is treated like a full PMU: the core leaves it inactive and the
+	 * rotation timer gets it counted in a later time slice.
+	 */
+	if (armpmu->check_event && armpmu->check_event(hw_events, hwc)) {
+		hwc->idx = -1;
+		err = -EAGAIN;
+		goto out;
 	}
 
 	/* If we don't have a space for the counter then finish early. */
@@ -333,6 +336,7 @@ validate_event(struct pmu *pmu, struct pmu_hw_events *hw_events,
 	struct arm_pmu *armpmu;
 	struct hw_perf_event fake_event = event->hw;
 	struct pmu *leader_pmu = event->group_leader->pmu;
+	int idx;
 
 	if (is_software_event(event))
 		return 1;
@@ -352,7 +356,15 @@ validate_event(struct pmu *pmu, struct pmu_hw_events *hw_events,
 		return 1;
 
 	armpmu = to_arm_pmu(event->pmu);
-	return armpmu->get_event_idx(hw_events, &fake_event) >= 0;
+	if (armpmu->check_event && armpmu->check_event(hw_events, &fake_event))
+		return 0;
+
+	idx = armpmu->get_event_idx(hw_events, &fake_event);
+	if (idx < 0)
+		return 0;
+
+	hw_events->events[idx] = event;
+	return 1;
 }
 
 static int
@@ -360,14 +372,18 @@ validate_group(struct perf_event *event)
 {
 	struct perf_event *sibling, *leader = event->group_leader;
 	struct pmu_hw_events fake_pmu;
+	struct perf_event *fake_events[ARMPMU_MAX_HWEVENTS];
 	DECLARE_BITMAP(fake_used_mask, ARMPMU_MAX_HWEVENTS);
 
 	/*
-	 * Initialise the fake PMU. We only need to populate the
-	 * used_mask for the purposes of validation.
+	 * Initialise the fake PMU. The used_mask is enough to count
+	 * counters, the events are needed by check_event() to reject
+	 * groups that could never be scheduled as a whole.
 	 */
 	memset(fake_used_mask, 0, sizeof(fake_used_mask));
+	memset(fake_events, 0, sizeof(fake_events));
 	fake_pmu.used_mask = fake_used_mask;
+	fake_pmu.events = fake_events;
 
 	if (!validate_event(event->pmu, &fake_pmu, leader))
 		return -EINVAL;
@@ -554,6 +570,25 @@ static void armpmu_disable(struct pmu *pmu)
 	armpmu->stop();
 }
 
+/*
+ * With user access enabled, self-monitoring tasks can read the counter
+ * straight from EL0: index - 1 is the PMEVCNTR<n> to read and 32 stands
+ * for PMCCNTR. The user page offset makes up the rest of the count.
+ */
+static int armpmu_event_idx(struct perf_event *event)
+{
+	if (!to_arm_pmu(event->pmu)->user_access || event->hw.idx < 0)
+		return 0;
+
+	return event->hw.idx ? event->hw.idx : ARMPMU_MAX_HWEVENTS;
+}
+
+void arch_perf_update_userpage(struct perf_event_mmap_page *userpg, u64 now)
+{
+	userpg->cap_user_rdpmc = cpu_pmu && cpu_pmu->user_access;
+	userpg->pmc_width = 32;
+}
+
 static void __init armpmu_init(struct arm_pmu *armpmu)
 {
 	atomic_set(&armpmu->active_events, 0);
@@ -568,6 +603,7 @@ static void __init armpmu_init(struct arm_pmu *armpmu)
 		.start		= armpmu_start,
 		.stop		= armpmu_stop,
 		.read		= armpmu_read,
+		.event_idx	= armpmu_event_idx,
 	};
 }
 
@@ -1248,14 +1284,14 @@ static void armv8pmu_init_usermode(void)
 {
 	/* Enable access from userspace. */
 	asm volatile("msr pmuserenr_el0, %0" :: "r" (0xF));
-
+	cpu_pmu->user_access = true;
 }
 #else
 static inline void armv8pmu_init_usermode(void)
 {
 	/* Disable access from userspace. */
 	asm volatile("msr pmuserenr_el0, %0" :: "r" (0));
-
+	cpu_pmu->user_access = false;
 }
 #endif
 
@@ -20,19 +20,41 @@
 #include <linux/sched.h>
 #include <linux/moduleparam.h>
 #include <linux/slab.h>
+#include <linux/ctype.h>
 #include <linux/input.h>
 #include <linux/time.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/uaccess.h>
+#include <linux/cpu_boost.h>
+
+/*
+ * A boost curve is a list of frequency steps, each held for its duration
+ * after the previous one ends. Curves normally decay, e.g. max for 40ms,
+ * then a mid frequency for another 80ms.
+ */
+#define MAX_BOOST_STEPS 4
+
+struct boost_step {
+	unsigned int freq;
+	unsigned int ms;
+};
+
+struct boost_curve {
+	int nr_steps;
+	struct boost_step step[MAX_BOOST_STEPS];
+};
 
 struct cpu_sync {
 	int cpu;
 	unsigned int input_boost_min;
 	unsigned int input_boost_freq;
+	struct boost_curve curve[CPU_BOOST_NR_PROFILES];
 };
 
 static DEFINE_PER_CPU(struct cpu_sync, sync_info);
 static struct workqueue_struct *cpu_boost_wq;
 
-static struct work_struct input_boost_work;
 static bool input_boost_enabled;
 
 static unsigned int input_boost_ms = 40;
@@ -43,16 +65,54 @@ module_param(sched_boost_on_input, bool, 0644);
 
 static bool sched_boost_active;
 
-static struct delayed_work input_boost_rem;
-static u64 last_input_time;
+/*
+ * Start time of each profile's curve in usecs, 0 when not running, and of
+ * its last trigger. Set from input event and ioctl context. The curves are
+ * evaluated by boost_work, which is the only place policy updates are
+ * triggered from. boost_lock protects these and the per-CPU curves.
+ */
+static u64 profile_start[CPU_BOOST_NR_PROFILES];
+static u64 last_trigger_time[CPU_BOOST_NR_PROFILES];
 #define MIN_INPUT_INTERVAL (150 * USEC_PER_MSEC)
+static DEFINE_SPINLOCK(boost_lock);
+static struct delayed_work boost_work;
+
+static const int profile_ids[CPU_BOOST_NR_PROFILES] = {
+	CPU_BOOST_TAP, CPU_BOOST_FLING, CPU_BOOST_LAUNCH,
+};
+
+/* touch movement events between down and up that make a fling */
+#define FLING_MIN_MOVES 8
+
+struct cpuboost_handle {
+	struct input_handle handle;
+	unsigned int moves;
+	bool touching;
+};
+
+/* Input events are only classified if some CPU has a boost configured */
+static void update_input_boost_enabled(void)
+{
+	bool enabled = false;
+	struct cpu_sync *s;
+	int cpu, id;
+
+	for_each_possible_cpu(cpu) {
+		s = &per_cpu(sync_info, cpu);
+		if (s->input_boost_freq)
+			enabled = true;
+		for (id = 0; id < CPU_BOOST_NR_PROFILES; id++)
+			if (s->curve[id].nr_steps)
+				enabled = true;
+	}
+	input_boost_enabled = enabled;
+}
 
 static int set_input_boost_freq(const char *buf, const struct kernel_param *kp)
 {
 	int i, ntokens = 0;
 	unsigned int val, cpu;
 	const char *cp = buf;
-	bool enabled = false;
 
 	while ((cp = strpbrk(cp + 1, " :")))
 		ntokens++;
@@ -83,13 +143,7 @@ static int set_input_boost_freq(const char *buf, const struct kernel_param *kp)
 	}
 
 check_enable:
-	for_each_possible_cpu(i) {
-		if (per_cpu(sync_info, i).input_boost_freq) {
-			enabled = true;
-			break;
-		}
-	}
-	input_boost_enabled = enabled;
+	update_input_boost_enabled();
 
 	return 0;
 }
@@ -114,6 +168,121 @@ static const struct kernel_param_ops param_ops_input_boost_freq = {
 };
 module_param_cb(input_boost_freq, &param_ops_input_boost_freq, NULL, 0644);
 
+static int parse_boost_curve(const char *cp, struct boost_curve *curve)
+{
+	struct boost_curve c = { 0 };
+	unsigned int freq, ms;
+	int n;
+
+	/* "0" clears the curve */
+	if (sscanf(cp, "%u%n", &freq, &n) == 1 && !freq &&
+	    (!cp[n] || isspace(cp[n]))) {
+		*curve = c;
+		return 0;
+	}
+
+	while (sscanf(cp, "%u@%u%n", &freq, &ms, &n) == 2) {
+		if (c.nr_steps == MAX_BOOST_STEPS || !ms)
+			return -EINVAL;
+		c.step[c.nr_steps].freq = freq;
+		c.step[c.nr_steps].ms = ms;
+		c.nr_steps++;
+		cp += n;
+		if (*cp != ',')
+			break;
+		cp++;
+	}
+
+	if (!c.nr_steps || (*cp && !isspace(*cp)))
+		return -EINVAL;
+
+	*curve = c;
+	return 0;
+}
+
+/*
+ * Profile curves: "freq@ms[,freq@ms...]" for all CPUs, or space separated
+ * "cpu:freq@ms[,freq@ms...]" entries, like input_boost_freq.
+ */
+static int set_boost_profile(const char *buf, const struct kernel_param *kp)
+{
+	int id = *(const int *)kp->arg;
+	struct boost_curve curve;
+	const char *cp = buf;
+	unsigned long flags;
+	unsigned int cpu;
+	int i, n, ret;
+
+	if (!strchr(buf, ':')) {
+		ret = parse_boost_curve(buf, &curve);
+		if (ret)
+			return ret;
+		spin_lock_irqsave(&boost_lock, flags);
+		for_each_possible_cpu(i)
+			per_cpu(sync_info, i).curve[id] = curve;
+		spin_unlock_irqrestore(&boost_lock, flags);
+		goto check_enable;
+	}
+
+	while (*cp && !isspace(*cp)) {
+		if (sscanf(cp, "%u:%n", &cpu, &n) != 1 || !n)
+			return -EINVAL;
+		if (cpu >= num_possible_cpus())
+			return -EINVAL;
+		ret = parse_boost_curve(cp + n, &curve);
+		if (ret)
+			return ret;
+
+		spin_lock_irqsave(&boost_lock, flags);
+		per_cpu(sync_info, cpu).curve[id] = curve;
+		spin_unlock_irqrestore(&boost_lock, flags);
+		cp = strchr(cp, ' ');
+		if (!cp)
+			break;
+		cp = skip_spaces(cp);
+	}
+
+check_enable:
+	update_input_boost_enabled();
+
+	return 0;
+}
+
+static int get_boost_profile(char *buf, const struct kernel_param *kp)
+{
+	int id = *(const int *)kp->arg;
+	int cnt = 0, cpu, i;
+	struct boost_curve *c;
+	unsigned long flags;
+
+	spin_lock_irqsave(&boost_lock, flags);
+	for_each_possible_cpu(cpu) {
+		c = &per_cpu(sync_info, cpu).curve[id];
+		cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, "%d:", cpu);
+		if (!c->nr_steps)
+			cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, "0");
+		for (i = 0; i < c->nr_steps; i++)
+			cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, "%s%u@%u",
+					i ? "," : "", c->step[i].freq,
+					c->step[i].ms);
+		cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, " ");
+	}
+	spin_unlock_irqrestore(&boost_lock, flags);
+	cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, "\n");
+	return cnt;
+}
+
+static const struct kernel_param_ops param_ops_boost_profile = {
+	.set = set_boost_profile,
+	.get = get_boost_profile,
+};
+module_param_cb(tap_boost, &param_ops_boost_profile,
+		&profile_ids[CPU_BOOST_TAP], 0644);
+module_param_cb(fling_boost, &param_ops_boost_profile,
+		&profile_ids[CPU_BOOST_FLING], 0644);
+module_param_cb(launch_boost, &param_ops_boost_profile,
+		&profile_ids[CPU_BOOST_LAUNCH], 0644);
+
 /*
  * The CPUFREQ_ADJUST notifier is used to override the current policy min to
  * make sure policy min >= boost_min. The cpufreq framework then does the job
@@ -156,104 +325,217 @@ static struct notifier_block boost_adjust_nb = {
 	.notifier_call = boost_adjust_notify,
 };
 
-static void update_policy_online(void)
+static void update_policy_online(const struct cpumask *changed)
 {
-	unsigned int i;
+	struct cpufreq_policy *policy;
+	cpumask_t done;
+	unsigned int i, pcpu;
+
+	cpumask_clear(&done);
 
-	/* Re-evaluate policy to trigger adjust notifier for online CPUs */
+	/*
+	 * Re-evaluate policy to trigger adjust notifier, once per policy
+	 * with a CPU whose boost changed.
+	 */
 	get_online_cpus();
-	for_each_online_cpu(i) {
-		pr_debug("Updating policy for CPU%d\n", i);
-		cpufreq_update_policy(i);
+	for_each_cpu_and(i, changed, cpu_online_mask) {
+		if (cpumask_test_cpu(i, &done))
+			continue;
+		policy = cpufreq_cpu_get(i);
+		if (!policy)
+			continue;
+		cpumask_or(&done, &done, policy->cpus);
+		pcpu = policy->cpu;
+		cpufreq_cpu_put(policy);
+
+		pr_debug("Updating policy for CPU%d\n", pcpu);
+		cpufreq_update_policy(pcpu);
 	}
 	put_online_cpus();
 }
 
-static void do_input_boost_rem(struct work_struct *work)
+/*
+ * Frequency of @id's curve on @s, @elapsed ms after it was started, or 0
+ * if it has run out. *left is set to the time until the next step.
+ */
+static unsigned int boost_curve_freq(struct cpu_sync *s, int id,
+				     unsigned int elapsed, unsigned int *left)
 {
-	unsigned int i, ret;
-	struct cpu_sync *i_sync_info;
-
-	/* Reset the input_boost_min for all CPUs in the system */
-	pr_debug("Resetting input boost min for all CPUs\n");
-	for_each_possible_cpu(i) {
-		i_sync_info = &per_cpu(sync_info, i);
-		i_sync_info->input_boost_min = 0;
+	struct boost_curve *c = &s->curve[id];
+	struct boost_step legacy;
+	unsigned int end = 0;
+	int i, nr_steps = c->nr_steps;
+	struct boost_step *step = c->step;
+
+	/* taps fall back to input_boost_freq for input_boost_ms */
+	if (!nr_steps && id == CPU_BOOST_TAP && s->input_boost_freq) {
+		legacy.freq = s->input_boost_freq;
+		legacy.ms = input_boost_ms;
+		step = &legacy;
+		nr_steps = 1;
 	}
 
-	/* Update policies for all online CPUs */
-	update_policy_online();
-
-	if (sched_boost_active) {
-		ret = sched_set_boost(0);
-		if (ret)
-			pr_err("cpu-boost: HMP boost disable failed\n");
-		sched_boost_active = false;
+	for (i = 0; i < nr_steps; i++) {
+		end += step[i].ms;
+		if (elapsed < end) {
+			*left = end - elapsed;
+			return step[i].freq;
+		}
 	}
+
+	return 0;
 }
 
-static void do_input_boost(struct work_struct *work)
+static void do_boost_update(struct work_struct *work)
 {
-	unsigned int i, ret;
-	struct cpu_sync *i_sync_info;
+	unsigned int next = UINT_MAX, left, freq, min;
+	bool running[CPU_BOOST_NR_PROFILES] = { false };
+	bool active = false;
+	struct cpu_sync *s;
+	unsigned long flags;
+	cpumask_t changed;
+	u64 now;
+	int cpu, id, ret;
 
-	cancel_delayed_work_sync(&input_boost_rem);
-	if (sched_boost_active) {
-		sched_set_boost(0);
-		sched_boost_active = false;
-	}
+	cpumask_clear(&changed);
 
-	/* Set the input_boost_min for all CPUs in the system */
-	pr_debug("Setting input boost min for all CPUs\n");
-	for_each_possible_cpu(i) {
-		i_sync_info = &per_cpu(sync_info, i);
-		i_sync_info->input_boost_min = i_sync_info->input_boost_freq;
+	spin_lock_irqsave(&boost_lock, flags);
+	now = ktime_to_us(ktime_get());
+
+	for_each_possible_cpu(cpu) {
+		s = &per_cpu(sync_info, cpu);
+		min = 0;
+		for (id = 0; id < CPU_BOOST_NR_PROFILES; id++) {
+			if (!profile_start[id])
+				continue;
+			freq = boost_curve_freq(s, id,
+				div_u64(now - profile_start[id], USEC_PER_MSEC),
+					&left);
+			if (!freq)
+				continue;
+			running[id] = true;
+			min = max(min, freq);
+			next = min(next, left);
+		}
+
+		/* repeated events within a step don't touch the policy */
+		if (min != s->input_boost_min) {
+			s->input_boost_min = min;
+			cpumask_set_cpu(cpu, &changed);
+		}
+		if (min)
+			active = true;
 	}
 
-	/* Update policies for all online CPUs */
-	update_policy_online();
+	/* retire finished curves */
+	for (id = 0; id < CPU_BOOST_NR_PROFILES; id++)
+		if (!running[id])
+			profile_start[id] = 0;
+	spin_unlock_irqrestore(&boost_lock, flags);
+
+	if (!cpumask_empty(&changed)) {
+		pr_debug("Boost changed for CPUs %*pbl\n",
+			 cpumask_pr_args(&changed));
+		update_policy_online(&changed);
+	}
 
 	/* Enable scheduler boost to migrate tasks to big cluster */
-	if (sched_boost_on_input) {
+	if (active && sched_boost_on_input && !sched_boost_active) {
 		ret = sched_set_boost(1);
 		if (ret)
 			pr_err("cpu-boost: HMP boost enable failed\n");
 		else
 			sched_boost_active = true;
+	} else if (!active && sched_boost_active) {
+		ret = sched_set_boost(0);
+		if (ret)
+			pr_err("cpu-boost: HMP boost disable failed\n");
+		sched_boost_active = false;
 	}
 
-	queue_delayed_work(cpu_boost_wq, &input_boost_rem,
-					msecs_to_jiffies(input_boost_ms));
+	if (active)
+		queue_delayed_work(cpu_boost_wq, &boost_work,
+				   msecs_to_jiffies(next) ?: 1);
 }
 
-static void cpuboost_input_event(struct input_handle *handle,
-		unsigned int type, unsigned int code, int value)
+/*
+ * Start or restart a profile's curve; callable from atomic context.
+ * Triggers closer than MIN_INPUT_INTERVAL to the last one are dropped.
+ */
+static void cpuboost_trigger(int id)
 {
+	unsigned long flags;
 	u64 now;
 
-	if (!input_boost_enabled)
-		return;
-
+	spin_lock_irqsave(&boost_lock, flags);
 	now = ktime_to_us(ktime_get());
-	if (now - last_input_time < MIN_INPUT_INTERVAL)
+	if (now - last_trigger_time[id] < MIN_INPUT_INTERVAL) {
+		spin_unlock_irqrestore(&boost_lock, flags);
 		return;
+	}
+	last_trigger_time[id] = now;
+	profile_start[id] = now;
+	spin_unlock_irqrestore(&boost_lock, flags);
 
-	if (work_pending(&input_boost_work))
+	mod_delayed_work(cpu_boost_wq, &boost_work, 0);
+}
+
+static void cpuboost_input_event(struct input_handle *handle,
+		unsigned int type, unsigned int code, int value)
+{
+	struct cpuboost_handle *h =
+		container_of(handle, struct cpuboost_handle, handle);
+	bool down = false, up = false;
+
+	if (!input_boost_enabled)
 		return;
 
-	queue_work(cpu_boost_wq, &input_boost_work);
-	last_input_time = ktime_to_us(ktime_get());
+	switch (type) {
+	case EV_KEY:
+		if (code == BTN_TOUCH) {
+			down = value && !h->touching;
+			up = !value && h->touching;
+		} else if (value == 1) {
+			cpuboost_trigger(CPU_BOOST_TAP);
+		}
+		break;
+	case EV_ABS:
+		if (code == ABS_MT_TRACKING_ID) {
+			down = value >= 0 && !h->touching;
+			up = value < 0 && h->touching;
+		} else if (h->touching) {
+			/*
+			 * Keep a long drag boosted: each movement restarts the
+			 * tap curve, at most once per MIN_INPUT_INTERVAL.
+			 */
+			h->moves++;
+			cpuboost_trigger(CPU_BOOST_TAP);
+		}
+		break;
+	}
+
+	if (down) {
+		h->touching = true;
+		h->moves = 0;
+		cpuboost_trigger(CPU_BOOST_TAP);
+	} else if (up) {
+		h->touching = false;
+		if (h->moves >= FLING_MIN_MOVES)
+			cpuboost_trigger(CPU_BOOST_FLING);
+	}
 }
 
 static int cpuboost_input_connect(struct input_handler *handler,
 		struct input_dev *dev, const struct input_device_id *id)
 {
+	struct cpuboost_handle *h;
 	struct input_handle *handle;
 	int error;
 
-	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
-	if (!handle)
+	h = kzalloc(sizeof(*h), GFP_KERNEL);
+	if (!h)
 		return -ENOMEM;
+	handle = &h->handle;
 
 	handle->dev = dev;
 	handle->handler = handler;
@@ -271,7 +553,7 @@ static int cpuboost_input_connect(struct input_handler *handler,
 err1:
 	input_unregister_handle(handle);
 err2:
-	kfree(handle);
+	kfree(h);
 	return error;
 }
 
@@ -279,7 +561,7 @@ static void cpuboost_input_disconnect(struct input_handle *handle)
 {
 	input_close_device(handle);
 	input_unregister_handle(handle);
-	kfree(handle);
+	kfree(container_of(handle, struct cpuboost_handle, handle));
 }
 
 static const struct input_device_id cpuboost_ids[] = {
@@ -316,6 +598,37 @@ static struct input_handler cpuboost_input_handler = {
 	.id_table       = cpuboost_ids,
 };
 
+/* Boost hints from userspace, e.g. on app launch */
+static long cpuboost_ioctl(struct file *file, unsigned int cmd,
+			   unsigned long arg)
+{
+	u32 id;
+
+	switch (cmd) {
+	case CPU_BOOST_IOC_HINT:
+		if (get_user(id, (u32 __user *)arg))
+			return -EFAULT;
+		if (id >= CPU_BOOST_NR_PROFILES)
+			return -EINVAL;
+		cpuboost_trigger(id);
+		return 0;
+	default:
+		return -ENOTTY;
+	}
+}
+
+static const struct file_operations cpuboost_fops = {
+	.owner		= THIS_MODULE,
+	.unlocked_ioctl	= cpuboost_ioctl,
+	.compat_ioctl	= cpuboost_ioctl,
+};
+
+static struct miscdevice cpuboost_misc = {
+	.minor	= MISC_DYNAMIC_MINOR,
+	.name	= "cpu_boost",
+	.fops	= &cpuboost_fops,
+};
+
 static int cpu_boost_init(void)
 {
 	int cpu, ret;
@@ -325,8 +638,7 @@ static int cpu_boost_init(void)
 	if (!cpu_boost_wq)
 		return -EFAULT;
 
-	INIT_WORK(&input_boost_work, do_input_boost);
-	INIT_DELAYED_WORK(&input_boost_rem, do_input_boost_rem);
+	INIT_DELAYED_WORK(&boost_work, do_boost_update);
 
 	for_each_possible_cpu(cpu) {
 		s = &per_cpu(sync_info, cpu);
@@ -334,6 +646,12 @@ static int cpu_boost_init(void)
 	}
 	cpufreq_register_notifier(&boost_adjust_nb, CPUFREQ_POLICY_NOTIFIER);
 	ret = input_register_handler(&cpuboost_input_handler);
+	if (ret)
+		return ret;
+
+	ret = misc_register(&cpuboost_misc);
+	if (ret)
+		pr_err("Failed to register hint device %d\n", ret);
 
 	return ret;
 }
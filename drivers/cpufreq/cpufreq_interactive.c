@@ -28,9 +28,12 @@
 #include <linux/time.h>
 #include <linux/timer.h>
 #include <linux/hrtimer.h>
+#include <linux/irq_work.h>
 #include <linux/workqueue.h>
 #include <linux/kthread.h>
 #include <linux/slab.h>
+#include <soc/qcom/msm_performance.h>
+#include <trace/events/sched.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/cpufreq_interactive.h>
@@ -39,6 +42,7 @@ struct cpufreq_interactive_policyinfo {
 	struct timer_list policy_timer;
 	struct timer_list policy_slack_timer;
 	struct hrtimer notif_timer;
+	struct irq_work notif_work;
 	spinlock_t load_lock; /* protects load tracking stat */
 	u64 last_evaluated_jiffy;
 	struct cpufreq_policy *policy;
@@ -55,6 +59,8 @@ struct cpufreq_interactive_policyinfo {
 	bool reject_notification;
 	bool notif_pending;
 	unsigned long notif_cpu;
+	unsigned int ramp_freq; /* requested by a migrating/waking task */
+	unsigned int ramp_check_freq; /* pre-raised to, awaiting verdict */
 	int governor_enabled;
 	struct cpufreq_interactive_tunables *cached_tunables;
 	struct sched_load *sl;
@@ -160,14 +166,39 @@ struct cpufreq_interactive_tunables {
 
 	/* Whether to enable prediction or not */
 	bool enable_prediction;
+
+	/*
+	 * Re-evaluate right away on scheduler load notifications instead of
+	 * after notif_timer.
+	 */
+	bool fast_switch;
+
+	/*
+	 * Pre-raise the frequency of the policy a task migrates to or wakes
+	 * up on according to the task's demand, instead of waiting for the
+	 * load to show up in the next window. A ramp is counted as a hit if
+	 * the next regular evaluation picks at least about the same speed.
+	 */
+	bool task_ramp;
+	atomic_t task_ramp_hits;
+	atomic_t task_ramp_misses;
 };
 
 /* For cases where we have single governor instance for system */
 static struct cpufreq_interactive_tunables *common_tunables;
 static struct cpufreq_interactive_tunables *cached_common_tunables;
 
+/* msm_performance reports an IO bound workload */
+static bool perf_iobusy;
+
 static struct attribute_group *get_sysfs_attr(void);
 
+/* iowait counts as busy when the tunable says so or the workload is IO bound */
+static inline bool io_busy(struct cpufreq_interactive_tunables *tunables)
+{
+	return tunables->io_is_busy || READ_ONCE(perf_iobusy);
+}
+
 /* Round to starting jiffy of next evaluation window */
 static u64 round_to_nw_start(u64 jif,
 			     struct cpufreq_interactive_tunables *tunables)
@@ -210,7 +241,7 @@ static void cpufreq_interactive_timer_resched(unsigned long cpu,
 			pcpu = &per_cpu(cpuinfo, i);
 			pcpu->time_in_idle = get_cpu_idle_time(i,
 						&pcpu->time_in_idle_timestamp,
-						tunables->io_is_busy);
+						io_busy(tunables));
 			pcpu->cputime_speedadj = 0;
 			pcpu->cputime_speedadj_timestamp =
 						pcpu->time_in_idle_timestamp;
@@ -258,7 +289,7 @@ static void cpufreq_interactive_timer_start(
 		pcpu = &per_cpu(cpuinfo, i);
 		pcpu->time_in_idle =
 			get_cpu_idle_time(i, &pcpu->time_in_idle_timestamp,
-					  tunables->io_is_busy);
+					  io_busy(tunables));
 		pcpu->cputime_speedadj = 0;
 		pcpu->cputime_speedadj_timestamp = pcpu->time_in_idle_timestamp;
 	}
@@ -423,7 +454,7 @@ static u64 update_load(int cpu)
 	u64 delta_time;
 	u64 active_time;
 
-	now_idle = get_cpu_idle_time(cpu, &now, tunables->io_is_busy);
+	now_idle = get_cpu_idle_time(cpu, &now, io_busy(tunables));
 	delta_idle = (now_idle - pcpu->time_in_idle);
 	delta_time = (now - pcpu->time_in_idle_timestamp);
 
@@ -453,6 +484,7 @@ static unsigned int sl_busy_to_laf(struct cpufreq_interactive_policyinfo *ppol,
 
 #define NEW_TASK_RATIO 75
 #define PRED_TOLERANCE_PCT 10
+#define TASK_RAMP_MIN_LOAD 20
 static void cpufreq_interactive_timer(unsigned long data)
 {
 	s64 now;
@@ -477,6 +509,8 @@ static void cpufreq_interactive_timer(unsigned long data)
 	int prev_l, pred_l = 0;
 	struct cpufreq_govinfo govinfo;
 	bool skip_hispeed_logic, skip_min_sample_time;
+	bool notif, ramped = false;
+	unsigned int ramp_freq;
 	bool jump_to_max_no_ts = false;
 	bool jump_to_max = false;
 	bool start_hyst = true;
@@ -491,10 +525,12 @@ static void cpufreq_interactive_timer(unsigned long data)
 	spin_lock_irqsave(&ppol->target_freq_lock, flags);
 	spin_lock(&ppol->load_lock);
 
-	skip_hispeed_logic =
-		tunables->ignore_hispeed_on_notif && ppol->notif_pending;
-	skip_min_sample_time = tunables->fast_ramp_down && ppol->notif_pending;
+	notif = ppol->notif_pending;
+	skip_hispeed_logic = tunables->ignore_hispeed_on_notif && notif;
+	skip_min_sample_time = tunables->fast_ramp_down && notif;
 	ppol->notif_pending = false;
+	ramp_freq = ppol->ramp_freq;
+	ppol->ramp_freq = 0;
 	now = ktime_to_us(ktime_get());
 	ppol->last_evaluated_jiffy = get_jiffies_64();
 
@@ -560,6 +596,22 @@ static void cpufreq_interactive_timer(unsigned long data)
 	pred_chfreq = choose_freq(ppol, pred_laf);
 	chosen_freq = max(prev_chfreq, pred_chfreq);
 
+	/* judge the last task ramp by what the load turned out to be */
+	if (ppol->ramp_check_freq && !notif) {
+		if (chosen_freq * 100 >= ppol->ramp_check_freq *
+					 (100 - PRED_TOLERANCE_PCT))
+			atomic_inc(&tunables->task_ramp_hits);
+		else
+			atomic_inc(&tunables->task_ramp_misses);
+		ppol->ramp_check_freq = 0;
+	}
+
+	if (ramp_freq > chosen_freq) {
+		chosen_freq = ramp_freq;
+		skip_hispeed_logic = true;
+		ramped = true;
+	}
+
 	if (prev_chfreq < ppol->policy->max && pred_chfreq >= ppol->policy->max)
 		if (!jump_to_max)
 			jump_to_max_no_ts = true;
@@ -666,6 +718,8 @@ static void cpufreq_interactive_timer(unsigned long data)
 	trace_cpufreq_interactive_target(max_cpu, pol_load, ppol->target_freq,
 					 ppol->policy->cur, new_freq);
 
+	if (ramped && new_freq > ppol->target_freq)
+		ppol->ramp_check_freq = new_freq;
 	ppol->target_freq = new_freq;
 	spin_unlock_irqrestore(&ppol->target_freq_lock, flags);
 	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
@@ -790,13 +844,38 @@ static void cpufreq_interactive_boost(struct cpufreq_interactive_tunables *tunab
 		wake_up_process_no_notif(speedchange_task);
 }
 
+/*
+ * Have ppol re-evaluated soon, at no lower than ramp_freq. We may be called
+ * with scheduler locks held, so the evaluation, which reads back the
+ * scheduler's load, has to run from another context. An irq_work gets
+ * there without the notif_timer delay.
+ */
+static void cpufreq_interactive_kick(
+			struct cpufreq_interactive_policyinfo *ppol,
+			struct cpufreq_interactive_tunables *tunables,
+			unsigned long cpu, unsigned int ramp_freq)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ppol->target_freq_lock, flags);
+	ppol->notif_pending = true;
+	ppol->notif_cpu = cpu;
+	ppol->ramp_freq = max(ppol->ramp_freq, ramp_freq);
+	spin_unlock_irqrestore(&ppol->target_freq_lock, flags);
+
+	if (tunables->fast_switch)
+		irq_work_queue(&ppol->notif_work);
+	else if (!hrtimer_is_queued(&ppol->notif_timer))
+		__hrtimer_start_range_ns(&ppol->notif_timer, ms_to_ktime(1),
+					0, HRTIMER_MODE_REL, 0);
+}
+
 static int load_change_callback(struct notifier_block *nb, unsigned long val,
 				void *data)
 {
 	unsigned long cpu = (unsigned long) data;
 	struct cpufreq_interactive_policyinfo *ppol = per_cpu(polinfo, cpu);
 	struct cpufreq_interactive_tunables *tunables;
-	unsigned long flags;
 
 	if (!ppol || ppol->reject_notification)
 		return 0;
@@ -810,30 +889,86 @@ static int load_change_callback(struct notifier_block *nb, unsigned long val,
 	if (!tunables->use_sched_load || !tunables->use_migration_notif)
 		goto exit;
 
-	spin_lock_irqsave(&ppol->target_freq_lock, flags);
-	ppol->notif_pending = true;
-	ppol->notif_cpu = cpu;
-	spin_unlock_irqrestore(&ppol->target_freq_lock, flags);
+	cpufreq_interactive_kick(ppol, tunables, cpu, 0);
+exit:
+	up_read(&ppol->enable_sem);
+	return 0;
+}
 
-	if (!hrtimer_is_queued(&ppol->notif_timer))
-		__hrtimer_start_range_ns(&ppol->notif_timer, ms_to_ktime(1),
-					0, HRTIMER_MODE_REL, 0);
+/*
+ * Turn a task's demand, in percent of a window at the policy's max speed,
+ * into a frequency for the policy @cpu belongs to and have the policy
+ * re-evaluated if that is above its current target.
+ */
+static void cpufreq_interactive_task_ramp(unsigned long cpu,
+					  unsigned int load)
+{
+	struct cpufreq_interactive_policyinfo *ppol = per_cpu(polinfo, cpu);
+	struct cpufreq_interactive_tunables *tunables;
+	unsigned int freq;
+
+	if (load < TASK_RAMP_MIN_LOAD || !ppol || ppol->reject_notification)
+		return;
+
+	if (!down_read_trylock(&ppol->enable_sem))
+		return;
+	if (!ppol->governor_enabled)
+		goto exit;
+
+	tunables = ppol->policy->governor_data;
+	if (!tunables->task_ramp)
+		goto exit;
+
+	freq = choose_freq(ppol, min(load, 100U) *
+			   ppol->policy->cpuinfo.max_freq);
+	if (freq > ppol->target_freq)
+		cpufreq_interactive_kick(ppol, tunables, cpu, freq);
 exit:
 	up_read(&ppol->enable_sem);
+}
+
+static int migration_notify(struct notifier_block *nb, unsigned long val,
+			    void *data)
+{
+	struct migration_notify_data *mnd = data;
+
+	if (mnd->load > 0)
+		cpufreq_interactive_task_ramp(mnd->dest_cpu, mnd->load);
 	return 0;
 }
 
-static enum hrtimer_restart cpufreq_interactive_hrtimer(struct hrtimer *timer)
+static struct notifier_block migration_notifier_block = {
+	.notifier_call = migration_notify,
+};
+
+#ifdef CONFIG_SCHED_HMP
+/*
+ * There is no notifier for wakeups, so catch heavy tasks waking up from
+ * the sched_wakeup tracepoint. task_cpu() is the CPU the task was placed
+ * on by then. The policy and its tunables are only looked at under
+ * enable_sem, by cpufreq_interactive_task_ramp().
+ */
+static void cpufreq_interactive_wakeup(void *ignore, struct task_struct *p,
+				       int success)
+{
+	if (!success)
+		return;
+
+	cpufreq_interactive_task_ramp(task_cpu(p),
+			div_u64((u64)p->ravg.demand * 100, sched_ravg_window));
+}
+#endif
+
+static void cpufreq_interactive_notif_eval(
+			struct cpufreq_interactive_policyinfo *ppol)
 {
-	struct cpufreq_interactive_policyinfo *ppol = container_of(timer,
-			struct cpufreq_interactive_policyinfo, notif_timer);
 	int cpu;
 
 	if (!down_read_trylock(&ppol->enable_sem))
-		return 0;
+		return;
 	if (!ppol->governor_enabled) {
 		up_read(&ppol->enable_sem);
-		return 0;
+		return;
 	}
 	cpu = ppol->notif_cpu;
 	trace_cpufreq_interactive_load_change(cpu);
@@ -842,9 +977,25 @@ static enum hrtimer_restart cpufreq_interactive_hrtimer(struct hrtimer *timer)
 	cpufreq_interactive_timer(cpu);
 
 	up_read(&ppol->enable_sem);
+}
+
+static enum hrtimer_restart cpufreq_interactive_hrtimer(struct hrtimer *timer)
+{
+	struct cpufreq_interactive_policyinfo *ppol = container_of(timer,
+			struct cpufreq_interactive_policyinfo, notif_timer);
+
+	cpufreq_interactive_notif_eval(ppol);
 	return HRTIMER_NORESTART;
 }
 
+static void cpufreq_interactive_irq_work(struct irq_work *work)
+{
+	struct cpufreq_interactive_policyinfo *ppol = container_of(work,
+			struct cpufreq_interactive_policyinfo, notif_work);
+
+	cpufreq_interactive_notif_eval(ppol);
+}
+
 static struct notifier_block load_notifier_block = {
 	.notifier_call = load_change_callback,
 };
@@ -886,6 +1037,39 @@ static struct notifier_block cpufreq_notifier_block = {
 	.notifier_call = cpufreq_interactive_notifier,
 };
 
+/*
+ * An IO bound workload counts iowait as busy time, like io_is_busy. The
+ * load windows are restarted on a change so none is measured half each
+ * way. Loads taken from the scheduler keep following io_is_busy only.
+ */
+static int cpufreq_interactive_mode_notifier(struct notifier_block *nb,
+					     unsigned long mode, void *data)
+{
+	struct msm_perf_mode_change *change = data;
+	struct cpufreq_interactive_policyinfo *ppol;
+	int cpu;
+
+	if (perf_iobusy == !!change->iobusy)
+		return NOTIFY_OK;
+	WRITE_ONCE(perf_iobusy, !!change->iobusy);
+
+	for_each_possible_cpu(cpu) {
+		ppol = per_cpu(polinfo, cpu);
+		if (!ppol)
+			continue;
+
+		down_read(&ppol->enable_sem);
+		if (ppol->governor_enabled && ppol->policy->cpu == cpu)
+			cpufreq_interactive_timer_resched(cpu, false);
+		up_read(&ppol->enable_sem);
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block mode_notifier_block = {
+	.notifier_call = cpufreq_interactive_mode_notifier,
+};
+
 static unsigned int *get_tokenized_data(const char *buf, int *num_tokens)
 {
 	const char *cp;
@@ -1058,6 +1242,22 @@ show_store_one(align_windows);
 show_store_one(ignore_hispeed_on_notif);
 show_store_one(fast_ramp_down);
 show_store_one(enable_prediction);
+show_store_one(fast_switch);
+show_store_one(task_ramp);
+
+static ssize_t show_task_ramp_hits(
+		struct cpufreq_interactive_tunables *tunables, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n",
+			atomic_read(&tunables->task_ramp_hits));
+}
+
+static ssize_t show_task_ramp_misses(
+		struct cpufreq_interactive_tunables *tunables, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n",
+			atomic_read(&tunables->task_ramp_misses));
+}
 
 static ssize_t show_go_hispeed_load(struct cpufreq_interactive_tunables
 		*tunables, char *buf)
@@ -1453,6 +1653,10 @@ show_store_gov_pol_sys(align_windows);
 show_store_gov_pol_sys(ignore_hispeed_on_notif);
 show_store_gov_pol_sys(fast_ramp_down);
 show_store_gov_pol_sys(enable_prediction);
+show_store_gov_pol_sys(fast_switch);
+show_store_gov_pol_sys(task_ramp);
+show_gov_pol_sys(task_ramp_hits);
+show_gov_pol_sys(task_ramp_misses);
 
 #define gov_sys_attr_rw(_name)						\
 static struct global_attr _name##_gov_sys =				\
@@ -1483,6 +1687,17 @@ gov_sys_pol_attr_rw(align_windows);
 gov_sys_pol_attr_rw(ignore_hispeed_on_notif);
 gov_sys_pol_attr_rw(fast_ramp_down);
 gov_sys_pol_attr_rw(enable_prediction);
+gov_sys_pol_attr_rw(fast_switch);
+gov_sys_pol_attr_rw(task_ramp);
+
+#define gov_sys_pol_attr_ro(_name)					\
+static struct global_attr _name##_gov_sys =				\
+__ATTR(_name, 0444, show_##_name##_gov_sys, NULL);			\
+static struct freq_attr _name##_gov_pol =				\
+__ATTR(_name, 0444, show_##_name##_gov_pol, NULL)
+
+gov_sys_pol_attr_ro(task_ramp_hits);
+gov_sys_pol_attr_ro(task_ramp_misses);
 
 static struct global_attr boostpulse_gov_sys =
 	__ATTR(boostpulse, 0200, NULL, store_boostpulse_gov_sys);
@@ -1510,6 +1725,10 @@ static struct attribute *interactive_attributes_gov_sys[] = {
 	&ignore_hispeed_on_notif_gov_sys.attr,
 	&fast_ramp_down_gov_sys.attr,
 	&enable_prediction_gov_sys.attr,
+	&fast_switch_gov_sys.attr,
+	&task_ramp_gov_sys.attr,
+	&task_ramp_hits_gov_sys.attr,
+	&task_ramp_misses_gov_sys.attr,
 	NULL,
 };
 
@@ -1538,6 +1757,10 @@ static struct attribute *interactive_attributes_gov_pol[] = {
 	&ignore_hispeed_on_notif_gov_pol.attr,
 	&fast_ramp_down_gov_pol.attr,
 	&enable_prediction_gov_pol.attr,
+	&fast_switch_gov_pol.attr,
+	&task_ramp_gov_pol.attr,
+	&task_ramp_hits_gov_pol.attr,
+	&task_ramp_misses_gov_pol.attr,
 	NULL,
 };
 
@@ -1614,6 +1837,7 @@ static struct cpufreq_interactive_policyinfo *get_policyinfo(
 	ppol->policy_slack_timer.function = cpufreq_interactive_nop_timer;
 	hrtimer_init(&ppol->notif_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 	ppol->notif_timer.function = cpufreq_interactive_hrtimer;
+	init_irq_work(&ppol->notif_work, cpufreq_interactive_irq_work);
 	spin_lock_init(&ppol->load_lock);
 	spin_lock_init(&ppol->target_freq_lock);
 	init_rwsem(&ppol->enable_sem);
@@ -1707,9 +1931,16 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			return rc;
 		}
 
-		if (!policy->governor->initialized)
+		if (!policy->governor->initialized) {
 			cpufreq_register_notifier(&cpufreq_notifier_block,
 					CPUFREQ_TRANSITION_NOTIFIER);
+			atomic_notifier_chain_register(&migration_notifier_head,
+					&migration_notifier_block);
+#ifdef CONFIG_SCHED_HMP
+			register_trace_sched_wakeup(cpufreq_interactive_wakeup,
+						    NULL);
+#endif
+		}
 
 		if (tunables->use_sched_load)
 			cpufreq_interactive_enable_sched_input(tunables);
@@ -1730,9 +1961,18 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			       policy->related_cpus);
 		sched_update_freq_max_load(cpu_possible_mask);
 		if (!--tunables->usage_count) {
-			if (policy->governor->initialized == 1)
+			if (policy->governor->initialized == 1) {
 				cpufreq_unregister_notifier(&cpufreq_notifier_block,
 						CPUFREQ_TRANSITION_NOTIFIER);
+				atomic_notifier_chain_unregister(
+						&migration_notifier_head,
+						&migration_notifier_block);
+#ifdef CONFIG_SCHED_HMP
+				unregister_trace_sched_wakeup(
+						cpufreq_interactive_wakeup, NULL);
+				tracepoint_synchronize_unregister();
+#endif
+			}
 
 			sysfs_remove_group(get_governor_parent_kobj(policy),
 					get_sysfs_attr());
@@ -1792,6 +2032,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		ppol->target_freq = 0;
 		del_timer_sync(&ppol->policy_timer);
 		del_timer_sync(&ppol->policy_slack_timer);
+		irq_work_sync(&ppol->notif_work);
 		up_write(&ppol->enable_sem);
 		ppol->reject_notification = false;
 
@@ -1852,8 +2093,11 @@ static int __init cpufreq_interactive_init(void)
 	if (ret) {
 		kthread_stop(speedchange_task);
 		put_task_struct(speedchange_task);
+		return ret;
 	}
-	return ret;
+
+	msm_perf_register_mode_notifier(&mode_notifier_block);
+	return 0;
 }
 
 #ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_INTERACTIVE
@@ -1866,6 +2110,7 @@ static void __exit cpufreq_interactive_exit(void)
 {
 	int cpu;
 
+	msm_perf_unregister_mode_notifier(&mode_notifier_block);
 	cpufreq_unregister_governor(&cpufreq_gov_interactive);
 	kthread_stop(speedchange_task);
 	put_task_struct(speedchange_task);
@@ -40,11 +40,12 @@ static DEFINE_SPINLOCK(uid_lock); /* uid_hash_table */
 struct uid_entry {
 	uid_t uid;
 	unsigned int max_states;
+	bool replaced;
 	struct hlist_node hash;
 	struct rcu_head rcu;
 	atomic64_t *concurrent_active_time;
 	atomic64_t *concurrent_policy_time;
-	u64 time_in_state[0];
+	atomic64_t time_in_state[0];
 };
 
 struct cpufreq_stats {
@@ -79,6 +80,21 @@ struct all_freq_table {
 	unsigned int table_size;
 };
 
+#define FREQ_SPLIT_MAX	4
+
+/*
+ * Frequencies a cpu left since its last tick and the time it spent at
+ * each, so that a tick spanning frequency changes can be split between
+ * them. Written by the transition notifier, which may run on another cpu.
+ */
+struct freq_split {
+	raw_spinlock_t lock;
+	u64 last_update;
+	int nr;
+	int all_freq_i[FREQ_SPLIT_MAX];
+	u64 time[FREQ_SPLIT_MAX];
+};
+
 static struct all_freq_table *all_freq_table;
 static bool cpufreq_all_freq_init;
 static struct proc_dir_entry *uid_cpupower;
@@ -109,6 +125,7 @@ static char uid_cpupower_enable;
 static DEFINE_PER_CPU(struct all_cpufreq_stats *, all_cpufreq_stats);
 static DEFINE_PER_CPU(struct cpufreq_stats *, cpufreq_stats_table);
 static DEFINE_PER_CPU(struct cpufreq_power_stats *, cpufreq_power_stats);
+static DEFINE_PER_CPU(struct freq_split, freq_split);
 
 struct cpufreq_stats_attribute {
 	struct attribute attr;
@@ -139,6 +156,38 @@ static struct uid_entry *find_uid_entry(uid_t uid)
 	return NULL;
 }
 
+/* Caller must hold uid lock */
+static void uid_entry_move_times(struct uid_entry *from, struct uid_entry *to)
+{
+	unsigned int i, max_states = min(from->max_states, to->max_states);
+
+	for (i = 0; i < max_states; ++i)
+		atomic64_add(atomic64_xchg(&from->time_in_state[i], 0),
+			     &to->time_in_state[i]);
+}
+
+/*
+ * Adds @time to an entry found under RCU. If the entry has been replaced
+ * by a larger one meanwhile, the time may have missed the move, so what
+ * is left in the old entry is moved again under uid_lock.
+ */
+static void uid_entry_add_time(struct uid_entry *uid_entry, int i, u64 time)
+{
+	struct uid_entry *cur;
+	unsigned long flags;
+
+	atomic64_add(time, &uid_entry->time_in_state[i]);
+	smp_mb__after_atomic();
+	if (likely(!READ_ONCE(uid_entry->replaced)))
+		return;
+
+	spin_lock_irqsave(&uid_lock, flags);
+	cur = find_uid_entry(uid_entry->uid);
+	if (cur && cur != uid_entry)
+		uid_entry_move_times(uid_entry, cur);
+	spin_unlock_irqrestore(&uid_lock, flags);
+}
+
 /* Caller must hold uid lock */
 static struct uid_entry *find_or_register_uid(uid_t uid)
 {
@@ -153,19 +202,21 @@ static struct uid_entry *find_or_register_uid(uid_t uid)
 		if (uid_entry->max_states == max_state)
 			return uid_entry;
 		/* uid_entry->time_in_state is too small to track all freqs, so
-		 * expand it.
+		 * replace it. Times are moved rather than copied, so that time
+		 * added locklessly after the move is not lost.
 		 */
-		temp = __krealloc(uid_entry, alloc_size, GFP_ATOMIC);
+		temp = kzalloc(alloc_size, GFP_ATOMIC);
 		if (!temp)
 			return uid_entry;
+		temp->uid = uid;
 		temp->max_states = max_state;
-		memset(temp->time_in_state + uid_entry->max_states, 0,
-		       (max_state - uid_entry->max_states) *
-		       sizeof(uid_entry->time_in_state[0]));
-		if (temp != uid_entry) {
-			hlist_replace_rcu(&uid_entry->hash, &temp->hash);
-			kfree_rcu(uid_entry, rcu);
-		}
+		temp->concurrent_active_time = uid_entry->concurrent_active_time;
+		temp->concurrent_policy_time = uid_entry->concurrent_policy_time;
+		WRITE_ONCE(uid_entry->replaced, true);
+		smp_mb();
+		uid_entry_move_times(uid_entry, temp);
+		hlist_replace_rcu(&uid_entry->hash, &temp->hash);
+		kfree_rcu(uid_entry, rcu);
 		return temp;
 	}
 
@@ -211,7 +262,8 @@ static int single_uid_time_in_state_show(struct seq_file *m, void  *ptr)
 	}
 
 	for (i = 0; i < uid_entry->max_states; ++i) {
-		time = cputime_to_clock_t(uid_entry->time_in_state[i]);
+		time = nsec_to_clock_t(
+			atomic64_read(&uid_entry->time_in_state[i]));
 		seq_write(m, &time, sizeof(time));
 	}
 
@@ -265,8 +317,8 @@ static int uid_time_in_state_seq_show(struct seq_file *m, void *v)
 			seq_printf(m, "%d:", uid_entry->uid);
 
 		for (i = 0; i < uid_entry->max_states; ++i) {
-			seq_printf(m, " %lu", (unsigned long)cputime_to_clock_t(
-					   uid_entry->time_in_state[i]));
+			seq_printf(m, " %lu", (unsigned long)nsec_to_clock_t(
+				atomic64_read(&uid_entry->time_in_state[i])));
 		}
 		if (uid_entry->max_states)
 			seq_putc(m, '\n');
@@ -298,15 +350,18 @@ static int time_in_state_seq_show(struct seq_file *m, void *v)
 
 	rcu_read_lock();
 
+	/* one record per uid, padded to all frequencies */
 	hlist_for_each_entry_rcu(uid_entry, (struct hlist_head *)v, hash) {
-		if (uid_entry->max_states) {
-			uid = (u32) uid_entry->uid;
-			seq_write(m, &uid, sizeof(uid));
-		}
+		if (!uid_entry->max_states)
+			continue;
 
-		for (i = 0; i < uid_entry->max_states; ++i) {
-			time = (u32)
-				cputime_to_clock_t(uid_entry->time_in_state[i]);
+		uid = (u32) uid_entry->uid;
+		seq_write(m, &uid, sizeof(uid));
+
+		for (i = 0; i < cpufreq_max_states; ++i) {
+			time = i < uid_entry->max_states ? (u32)
+				nsec_to_clock_t(atomic64_read(
+					&uid_entry->time_in_state[i])) : 0;
 			seq_write(m, &time, sizeof(time));
 		}
 	}
@@ -365,7 +420,7 @@ static int concurrent_policy_time_seq_show(struct seq_file *m, void *v)
 	struct uid_entry *uid_entry;
 	struct cpufreq_policy *policy;
 	struct cpufreq_policy *last_policy = NULL;
-	u32 buf[num_possible_cpus()];
+	u32 *buf;
 	u32 uid, time;
 	int i, cnt = 0, num_possible_cpus = num_possible_cpus();
 
@@ -373,6 +428,11 @@ static int concurrent_policy_time_seq_show(struct seq_file *m, void *v)
 		return 0;
 
 	if (v == uid_hash_table) {
+		buf = kmalloc_array(num_possible_cpus + 1, sizeof(*buf),
+				    GFP_KERNEL);
+		if (!buf)
+			return -ENOMEM;
+
 		for_each_possible_cpu(i) {
 			policy = cpufreq_cpu_get(i);
 			if (!policy)
@@ -393,6 +453,7 @@ static int concurrent_policy_time_seq_show(struct seq_file *m, void *v)
 
 		buf[0] = (u32) cnt;
 		seq_write(m, buf, (cnt + 1) * sizeof(*buf));
+		kfree(buf);
 	}
 	rcu_read_lock();
 
@@ -522,7 +583,7 @@ int proc_time_in_state_show(struct seq_file *m, struct pid_namespace *ns,
 			    struct pid *pid, struct task_struct *p)
 {
 	int i;
-	cputime_t cputime;
+	u64 time;
 	unsigned long flags;
 
 	if (!all_freq_table || !cpufreq_all_freq_init || !p->time_in_state)
@@ -530,14 +591,14 @@ int proc_time_in_state_show(struct seq_file *m, struct pid_namespace *ns,
 
 	spin_lock(&cpufreq_stats_lock);
 	for (i = 0; i < p->max_states; ++i) {
-		cputime = 0;
+		time = 0;
 		spin_lock_irqsave(&task_time_in_state_lock, flags);
 		if (p->time_in_state)
-			cputime = atomic_read(&p->time_in_state[i]);
+			time = atomic64_read(&p->time_in_state[i]);
 		spin_unlock_irqrestore(&task_time_in_state_lock, flags);
 
 		seq_printf(m, "%d %lu\n", all_freq_table->freq_table[i],
-			(unsigned long)cputime_to_clock_t(cputime));
+			(unsigned long)nsec_to_clock_t(time));
 	}
 	spin_unlock(&cpufreq_stats_lock);
 
@@ -648,6 +709,78 @@ static int get_index_all_cpufreq_stat(struct all_cpufreq_stats *all_stat,
 	return -1;
 }
 
+/* Called when @cpu changes frequency away from @all_freq_i */
+static void freq_split_note(unsigned int cpu, int all_freq_i)
+{
+	struct freq_split *fs = &per_cpu(freq_split, cpu);
+	unsigned long flags;
+	s64 delta;
+	u64 now;
+	int i;
+
+	raw_spin_lock_irqsave(&fs->lock, flags);
+	now = local_clock();
+	/* only the tick in progress is split */
+	delta = min_t(s64, now - fs->last_update, TICK_NSEC);
+	fs->last_update = now;
+	if (delta <= 0 || all_freq_i < 0)
+		goto out;
+
+	for (i = 0; i < fs->nr; i++)
+		if (fs->all_freq_i[i] == all_freq_i)
+			break;
+	if (i == fs->nr) {
+		if (fs->nr == FREQ_SPLIT_MAX)
+			goto out;
+		fs->all_freq_i[i] = all_freq_i;
+		fs->time[i] = 0;
+		fs->nr++;
+	}
+	fs->time[i] += delta;
+out:
+	raw_spin_unlock_irqrestore(&fs->lock, flags);
+}
+
+/* Takes the splits noted on @cpu since its last tick */
+static int freq_split_take(unsigned int cpu, int *all_freq_i, u64 *time)
+{
+	struct freq_split *fs = &per_cpu(freq_split, cpu);
+	unsigned long flags;
+	int nr;
+
+	raw_spin_lock_irqsave(&fs->lock, flags);
+	fs->last_update = local_clock();
+	nr = fs->nr;
+	memcpy(all_freq_i, fs->all_freq_i, nr * sizeof(*all_freq_i));
+	memcpy(time, fs->time, nr * sizeof(*time));
+	fs->nr = 0;
+	raw_spin_unlock_irqrestore(&fs->lock, flags);
+
+	return nr;
+}
+
+/* Caller must hold rcu_read_lock() */
+static void time_in_state_charge(struct task_struct *task,
+				 struct uid_entry *uid_entry, int all_freq_i,
+				 u64 time)
+{
+	unsigned long flags;
+
+	if (all_freq_i < 0 || !time)
+		return;
+
+	if (!(task->flags & PF_EXITING) &&
+	    all_freq_i < READ_ONCE(task->max_states)) {
+		spin_lock_irqsave(&task_time_in_state_lock, flags);
+		if (task->time_in_state)
+			atomic64_add(time, &task->time_in_state[all_freq_i]);
+		spin_unlock_irqrestore(&task_time_in_state_lock, flags);
+	}
+
+	if (uid_entry && all_freq_i < uid_entry->max_states)
+		uid_entry_add_time(uid_entry, all_freq_i, time);
+}
+
 /* Called without cpufreq_stats_lock held */
 void acct_update_power(struct task_struct *task, cputime_t cputime) {
 	struct cpufreq_power_stats *powerstats;
@@ -656,7 +789,11 @@ void acct_update_power(struct task_struct *task, cputime_t cputime) {
 	struct uid_entry *uid_entry;
 	unsigned int cpu_num, curr;
 	int cpu_freq_i;
-	int all_freq_i;
+	int all_freq_i, max_i;
+	int split_i[FREQ_SPLIT_MAX];
+	u64 split_time[FREQ_SPLIT_MAX];
+	u64 time, t;
+	int i, nr_split;
 	unsigned int active_cpu_cnt = 0;
 	unsigned int policy_cpu_cnt = 0;
 	unsigned int policy_first_cpu;
@@ -674,32 +811,39 @@ void acct_update_power(struct task_struct *task, cputime_t cputime) {
 		return;
 
 	all_freq_i = atomic_read(&stats->all_freq_i);
+	nr_split = freq_split_take(cpu_num, split_i, split_time);
+	max_i = all_freq_i;
+	for (i = 0; i < nr_split; i++)
+		max_i = max(max_i, split_i[i]);
 
-	/* This function is called from a different context
-	 * Interruptions in between reads/assignements are ok
+	/*
+	 * uid_lock is only taken to register a uid or to grow its table
+	 * after a new policy added frequencies.
 	 */
-	if (all_freq_table && cpufreq_all_freq_init &&
-		!(task->flags & PF_EXITING) &&
-		all_freq_i != -1 && all_freq_i < READ_ONCE(task->max_states)) {
+	rcu_read_lock();
+	uid_entry = find_uid_entry_rcu(uid);
+	if (!uid_entry || max_i >= (int)uid_entry->max_states) {
+		spin_lock_irqsave(&uid_lock, flags);
+		uid_entry = find_or_register_uid(uid);
+		spin_unlock_irqrestore(&uid_lock, flags);
+	}
 
-		spin_lock_irqsave(&task_time_in_state_lock, flags);
-		if (task->time_in_state) {
-			atomic64_add(cputime,
-				&task->time_in_state[all_freq_i]);
+	/*
+	 * The tick goes to the frequencies this cpu ran at since the last
+	 * one, the time noted at each change first and the rest to the
+	 * current frequency.
+	 */
+	if (all_freq_table && cpufreq_all_freq_init) {
+		time = cputime_to_nsecs(cputime);
+		for (i = 0; i < nr_split; i++) {
+			t = min(split_time[i], time);
+			time_in_state_charge(task, uid_entry, split_i[i], t);
+			time -= t;
 		}
-		spin_unlock_irqrestore(&task_time_in_state_lock, flags);
+		time_in_state_charge(task, uid_entry, all_freq_i, time);
 	}
 
-	spin_lock_irqsave(&uid_lock, flags);
-	uid_entry = find_or_register_uid(uid);
-	if (uid_entry && all_freq_i < uid_entry->max_states)
-		uid_entry->time_in_state[all_freq_i] += cputime;
-	spin_unlock_irqrestore(&uid_lock, flags);
-
 	if (uid_cpupower_enable) {
-		rcu_read_lock();
-		uid_entry = find_uid_entry_rcu(uid);
-
 		for_each_possible_cpu(cpu)
 			if (!idle_cpu(cpu))
 				++active_cpu_cnt;
@@ -739,8 +883,8 @@ void acct_update_power(struct task_struct *task, cputime_t cputime) {
 			}
 			cpufreq_cpu_put(policy);
 		}
-		rcu_read_unlock();
 	}
+	rcu_read_unlock();
 
 	powerstats = per_cpu(cpufreq_power_stats, cpu_num);
 	if (!powerstats)
@@ -900,6 +1044,17 @@ static int freq_table_get_index(struct cpufreq_stats *stat, unsigned int freq)
 	return -1;
 }
 
+static int all_freq_table_get_index(unsigned int freq)
+{
+	int i;
+
+	for (i = 0; i < all_freq_table->table_size; ++i) {
+		if (all_freq_table->freq_table[i] == freq)
+			return i;
+	}
+	return -1;
+}
+
 static void __cpufreq_stats_free_table(struct cpufreq_policy *policy)
 {
 	struct cpufreq_stats *stat = per_cpu(cpufreq_stats_table, policy->cpu);
@@ -1015,6 +1170,7 @@ static int __cpufreq_stats_create_table(struct cpufreq_policy *policy,
 	spin_lock(&cpufreq_stats_lock);
 	stat->last_time = get_jiffies_64();
 	atomic_set(&stat->cpu_freq_i, freq_table_get_index(stat, policy->cur));
+	atomic_set(&stat->all_freq_i, all_freq_table_get_index(policy->cur));
 	spin_unlock(&cpufreq_stats_lock);
 	return 0;
 error_alloc:
@@ -1278,7 +1434,6 @@ static int cpufreq_stat_notifier_policy(struct notifier_block *nb,
 static int cpufreq_stat_notifier_trans(struct notifier_block *nb,
 		unsigned long val, void *data)
 {
-	int i;
 	struct cpufreq_freqs *freq = data;
 	struct cpufreq_stats *stat;
 	int cpu_freq_old_i, cpu_freq_new_i;
@@ -1287,6 +1442,10 @@ static int cpufreq_stat_notifier_trans(struct notifier_block *nb,
 	if (val != CPUFREQ_POSTCHANGE)
 		return 0;
 
+	/* called for every cpu of the policy, stat only exists for one */
+	if (all_freq_table && cpufreq_all_freq_init)
+		freq_split_note(freq->cpu, all_freq_table_get_index(freq->old));
+
 	stat = per_cpu(cpufreq_stats_table, freq->cpu);
 	if (!stat)
 		return 0;
@@ -1295,14 +1454,7 @@ static int cpufreq_stat_notifier_trans(struct notifier_block *nb,
 	cpu_freq_new_i = freq_table_get_index(stat, freq->new);
 
 	all_freq_old_i = atomic_read(&stat->all_freq_i);
-	for (i = 0; i < all_freq_table->table_size; ++i) {
-		if (all_freq_table->freq_table[i] == freq->new)
-			break;
-	}
-	if (i != all_freq_table->table_size)
-		all_freq_new_i = i;
-	else
-		all_freq_new_i = -1;
+	all_freq_new_i = all_freq_table_get_index(freq->new);
 
 	/* We can't do stat->time_in_state[-1]= .. */
 	if (cpu_freq_old_i == -1 || cpu_freq_new_i == -1)
@@ -1483,6 +1635,8 @@ static int __init cpufreq_stats_init(void)
 	unsigned int cpu;
 
 	spin_lock_init(&cpufreq_stats_lock);
+	for_each_possible_cpu(cpu)
+		raw_spin_lock_init(&per_cpu(freq_split, cpu).lock);
 	ret = cpufreq_register_notifier(&notifier_policy_block,
 				CPUFREQ_POLICY_NOTIFIER);
 	if (ret)
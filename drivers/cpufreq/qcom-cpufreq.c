@@ -27,6 +27,9 @@
 #include <linux/err.h>
 #include <linux/platform_device.h>
 #include <linux/of.h>
+#include <linux/slab.h>
+#include <linux/cpu_cooling.h>
+#include <linux/thermal.h>
 #include <trace/events/power.h>
 
 static DEFINE_MUTEX(l2bw_lock);
@@ -43,6 +46,13 @@ struct cpufreq_suspend_t {
 
 static DEFINE_PER_CPU(struct cpufreq_suspend_t, suspend_data);
 
+/*
+ * Leakage model of one cluster, from the CPU DT node, per online CPU of
+ * the cluster. See struct thermal_static_power.
+ */
+static DEFINE_PER_CPU(struct thermal_static_power *, static_power);
+static DEFINE_PER_CPU(struct thermal_cooling_device *, cpu_cdev);
+
 static int set_cpu_freq(struct cpufreq_policy *policy, unsigned int new_freq,
 			unsigned int index)
 {
@@ -299,6 +309,89 @@ static struct notifier_block msm_cpufreq_pm_notifier = {
 	.notifier_call = msm_cpufreq_pm_event,
 };
 
+static int msm_cpu_static_power(cpumask_t *cpumask, int interval,
+				unsigned long voltage, u32 *power)
+{
+	struct thermal_static_power *sp = per_cpu(static_power,
+						  cpumask_first(cpumask));
+	cpumask_t online;
+
+	cpumask_and(&online, cpumask, cpu_online_mask);
+	if (!sp || cpumask_empty(&online)) {
+		*power = 0;
+		return 0;
+	}
+
+	*power = thermal_static_power(sp, voltage) * cpumask_weight(&online);
+
+	return 0;
+}
+
+static struct thermal_static_power *cpu_static_power_parse(
+						struct device_node *np)
+{
+	struct thermal_static_power *sp;
+
+	sp = kzalloc(sizeof(*sp), GFP_KERNEL);
+	if (!sp)
+		return NULL;
+
+	if (of_thermal_static_power_init(np, sp)) {
+		kfree(sp);
+		return NULL;
+	}
+
+	return sp;
+}
+
+/*
+ * Register one cpufreq cooling device per cluster whose CPU node is a
+ * cooling device in DT. With a dynamic-power-coefficient the device
+ * implements the power actor interface, so that power_allocator can
+ * split a zone's budget between the clusters and the GPU.
+ */
+static void msm_cpufreq_register_cooling(struct cpufreq_policy *policy)
+{
+	struct device_node *np = of_get_cpu_node(policy->cpu, NULL);
+	struct thermal_cooling_device *cdev;
+	struct thermal_static_power *sp = NULL;
+	u32 capacitance = 0;
+	int cpu;
+
+	if (!np)
+		return;
+
+	if (per_cpu(cpu_cdev, policy->cpu) ||
+	    !of_find_property(np, "#cooling-cells", NULL))
+		goto out;
+
+	of_property_read_u32(np, "dynamic-power-coefficient", &capacitance);
+	if (capacitance) {
+		sp = cpu_static_power_parse(np);
+		for_each_cpu(cpu, policy->related_cpus)
+			per_cpu(static_power, cpu) = sp;
+		cdev = of_cpufreq_power_cooling_register(np,
+				policy->related_cpus, capacitance,
+				sp ? msm_cpu_static_power : NULL);
+	} else {
+		cdev = of_cpufreq_cooling_register(np, policy->related_cpus);
+	}
+
+	if (IS_ERR(cdev)) {
+		pr_err("cpufreq: no cooling device for CPU%d: %ld\n",
+		       policy->cpu, PTR_ERR(cdev));
+		for_each_cpu(cpu, policy->related_cpus)
+			per_cpu(static_power, cpu) = NULL;
+		kfree(sp);
+		goto out;
+	}
+
+	for_each_cpu(cpu, policy->related_cpus)
+		per_cpu(cpu_cdev, cpu) = cdev;
+out:
+	of_node_put(np);
+}
+
 static struct freq_attr *msm_freq_attr[] = {
 	&cpufreq_freq_attr_scaling_available_freqs,
 	NULL,
@@ -499,3 +592,23 @@ static int __init msm_cpufreq_early_register(void)
 	return register_hotcpu_notifier(&msm_cpufreq_cpu_notifier);
 }
 core_initcall(msm_cpufreq_early_register);
+
+/* The thermal core is not up yet when the policies are created */
+static int __init msm_cpufreq_cooling_init(void)
+{
+	struct cpufreq_policy *policy;
+	int cpu;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		policy = cpufreq_cpu_get(cpu);
+		if (!policy)
+			continue;
+		msm_cpufreq_register_cooling(policy);
+		cpufreq_cpu_put(policy);
+	}
+	put_online_cpus();
+
+	return 0;
+}
+late_initcall(msm_cpufreq_cooling_init);
@@ -802,6 +802,9 @@ static int parse_cpu_levels(struct device_node *node, struct lpm_cluster *c)
 					c->cpu->levels[i].pwr.residencies[j]);
 		}
 	}
+	for (i = 1; i < c->cpu->nlevels; i++)
+		c->cpu->levels[i].pwr.min_residency =
+			c->cpu->levels[0].pwr.residencies[i];
 
 	return 0;
 failed:
@@ -922,6 +925,9 @@ struct lpm_cluster *parse_cluster(struct device_node *node,
 				&c->levels[i].pwr, &c->levels[j].pwr);
 		}
 	}
+	for (i = 1; i < c->nlevels; i++)
+		c->levels[i].pwr.min_residency =
+			c->levels[0].pwr.residencies[i];
 	set_optimum_cluster_residency(c, true);
 	return c;
 
@@ -81,8 +81,27 @@ struct lpm_debug {
 	uint32_t arg4;
 };
 
+#define MAXSAMPLES	8
+#define MAX_OUTLIERS	2
+
+/*
+ * Recent idle periods of a cpu, to predict wakeups that are not known
+ * in advance, such as device interrupts. pred_end_us is when the cpu is
+ * expected to wake up next, or 0 if nothing was predicted.
+ */
+struct lpm_history {
+	uint32_t resi[MAXSAMPLES];
+	int mode[MAXSAMPLES];
+	int nsamp;
+	uint32_t hptr;
+	bool hinvalid;
+	int64_t pred_end_us;
+};
+
 struct lpm_cluster *lpm_root_node;
 
+static DEFINE_PER_CPU(struct lpm_history, hist);
+static DEFINE_PER_CPU(struct hrtimer, histtimer);
 static DEFINE_PER_CPU(struct lpm_cluster*, cpu_cluster);
 static bool suspend_in_progress;
 static struct hrtimer lpm_hrtimer;
@@ -126,6 +145,25 @@ static bool sleep_disabled;
 module_param_named(sleep_disabled,
 	sleep_disabled, bool, S_IRUGO | S_IWUSR | S_IWGRP);
 
+static bool lpm_prediction = true;
+module_param_named(lpm_prediction,
+	lpm_prediction, bool, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* Max deviation in us of idle periods to use their mean as prediction */
+static unsigned int ref_stddev = 100;
+module_param_named(ref_stddev,
+	ref_stddev, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* Premature exits of a level in the history that restrict it */
+static unsigned int ref_premature_cnt = 2;
+module_param_named(ref_premature_cnt,
+	ref_premature_cnt, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* Slack in us given to a prediction before re-evaluating the level */
+static unsigned int tmr_add = 100;
+module_param_named(tmr_add,
+	tmr_add, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
 void msm_cpuidle_set_sleep_disable(bool disable)
 {
        sleep_disabled = disable;
@@ -454,6 +492,148 @@ static int set_device_mode(struct lpm_cluster *cluster, int ndevice,
 		return -EINVAL;
 }
 
+static enum hrtimer_restart histtimer_fn(struct hrtimer *h)
+{
+	struct lpm_history *history = this_cpu_ptr(&hist);
+
+	history->hinvalid = true;
+	return HRTIMER_NORESTART;
+}
+
+static void histtimer_start(uint32_t time_us)
+{
+	ktime_t hist_ktime = ns_to_ktime((u64)time_us * NSEC_PER_USEC);
+
+	hrtimer_start(this_cpu_ptr(&histtimer), hist_ktime,
+			HRTIMER_MODE_REL_PINNED);
+}
+
+static void histtimer_cancel(void)
+{
+	struct hrtimer *cpu_histtimer = this_cpu_ptr(&histtimer);
+
+	if (!hrtimer_active(cpu_histtimer))
+		return;
+
+	/*
+	 * Interrupts are still disabled, so a timer that woke us up has
+	 * not run yet. Its expiry alone says the prediction was too short.
+	 */
+	if (ktime_to_us(hrtimer_get_remaining(cpu_histtimer)) <= 0)
+		this_cpu_ptr(&hist)->hinvalid = true;
+
+	hrtimer_try_to_cancel(cpu_histtimer);
+}
+
+static void update_history(struct cpuidle_device *dev, int idx)
+{
+	struct lpm_history *history = &per_cpu(hist, dev->cpu);
+
+	if (!lpm_prediction)
+		return;
+
+	history->pred_end_us = 0;
+
+	/* The cpu slept past the prediction, start over */
+	if (history->hinvalid) {
+		memset(history, 0, sizeof(*history));
+		return;
+	}
+
+	history->resi[history->hptr] = dev->last_residency;
+	history->mode[history->hptr] = idx;
+
+	if (++history->hptr >= MAXSAMPLES)
+		history->hptr = 0;
+	if (history->nsamp < MAXSAMPLES)
+		history->nsamp++;
+}
+
+/*
+ * Predict the length of the coming idle period from the last MAXSAMPLES
+ * ones. If they are close together, their mean is returned. If they are
+ * not, but a level keeps being left before its break even time, the
+ * level is returned in @idx_restrict, with the mean time spent in it in
+ * @idx_restrict_time. Returns 0 when nothing is predicted.
+ */
+static uint32_t lpm_cpuidle_predict(struct cpuidle_device *dev,
+		struct lpm_cpu *cpu, int *idx_restrict,
+		uint32_t *idx_restrict_time)
+{
+	struct lpm_history *history = &per_cpu(hist, dev->cpu);
+	uint32_t thresh = ~0U;
+	uint64_t avg, var, max_resi;
+	int64_t diff;
+	int i, j, nr;
+
+	if (!lpm_prediction || history->nsamp < MAXSAMPLES)
+		return 0;
+
+	/*
+	 * Drop the longest samples one at a time while the rest are spread
+	 * too far. These are usually wakeups by unrelated timers, which the
+	 * timer bound covers anyway.
+	 */
+	do {
+		avg = var = max_resi = 0;
+		nr = 0;
+		for (i = 0; i < MAXSAMPLES; i++) {
+			if (history->resi[i] > thresh)
+				continue;
+			avg += history->resi[i];
+			if (history->resi[i] > max_resi)
+				max_resi = history->resi[i];
+			nr++;
+		}
+		do_div(avg, nr);
+
+		for (i = 0; i < MAXSAMPLES; i++) {
+			if (history->resi[i] > thresh)
+				continue;
+			diff = (int64_t)history->resi[i] - (int64_t)avg;
+			var += diff * diff;
+		}
+		do_div(var, nr);
+
+		if (int_sqrt(var) <= ref_stddev)
+			return (uint32_t)avg;
+
+		thresh = max_resi - 1;
+	} while (nr > MAXSAMPLES - MAX_OUTLIERS);
+
+	for (j = 1; j < cpu->nlevels; j++) {
+		uint32_t failed = 0;
+		uint64_t total = 0;
+
+		for (i = 0; i < MAXSAMPLES; i++) {
+			if (history->mode[i] == j && history->resi[i] <
+					cpu->levels[j].pwr.min_residency) {
+				failed++;
+				total += history->resi[i];
+			}
+		}
+
+		if (failed && failed >= ref_premature_cnt) {
+			do_div(total, failed);
+			*idx_restrict = j;
+			*idx_restrict_time = total;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static enum lpm_stats_residency lpm_residency_outcome(uint64_t us,
+		uint32_t min_us, uint32_t max_us)
+{
+	if (us < min_us)
+		return LPM_STATS_RES_TOO_SHORT;
+	if (max_us != ~0U && us > max_us)
+		return LPM_STATS_RES_TOO_LONG;
+	return LPM_STATS_RES_HIT;
+}
+
 static int cpu_power_select(struct cpuidle_device *dev,
 		struct lpm_cpu *cpu)
 {
@@ -466,6 +646,9 @@ static int cpu_power_select(struct cpuidle_device *dev,
 	int i;
 	uint32_t lvl_latency_us = 0;
 	uint32_t *residency = get_per_cpu_max_residency(dev->cpu);
+	uint32_t pred_us = 0;
+	uint32_t idx_restrict_time = 0;
+	int idx_restrict;
 
 	if (!cpu)
 		return -EINVAL;
@@ -475,6 +658,10 @@ static int cpu_power_select(struct cpuidle_device *dev,
 
 	next_event_us = (uint32_t)(ktime_to_us(get_next_event_time(dev->cpu)));
 
+	idx_restrict = cpu->nlevels;
+	pred_us = lpm_cpuidle_predict(dev, cpu, &idx_restrict,
+					&idx_restrict_time);
+
 	for (i = 0; i < cpu->nlevels; i++) {
 		struct lpm_cpu_level *level = &cpu->levels[i];
 		struct power_params *pwr_params = &level->pwr;
@@ -487,6 +674,9 @@ static int cpu_power_select(struct cpuidle_device *dev,
 		if (!allow)
 			continue;
 
+		if (i >= idx_restrict)
+			break;
+
 		lvl_latency_us = pwr_params->latency_us;
 
 		if (latency_us < lvl_latency_us)
@@ -510,6 +700,9 @@ static int cpu_power_select(struct cpuidle_device *dev,
 		else
 			modified_time_us = 0;
 
+		if (pred_us && pred_us < next_wakeup_us)
+			next_wakeup_us = pred_us;
+
 		if (next_wakeup_us <= residency[i])
 			break;
 	}
@@ -517,7 +710,31 @@ static int cpu_power_select(struct cpuidle_device *dev,
 	if (modified_time_us)
 		msm_pm_set_timer(modified_time_us);
 
-	trace_cpu_power_select(best_level, sleep_us, latency_us, next_event_us);
+	/*
+	 * A shallower level was picked on a prediction. Wake up a little
+	 * after the predicted time to re-evaluate, so a wrong prediction
+	 * doesn't keep the cpu in that level until the next timer.
+	 */
+	if ((pred_us || idx_restrict < cpu->nlevels) && best_level >= 0 &&
+			best_level < cpu->nlevels - 1) {
+		uint32_t pred_time = pred_us ? pred_us : idx_restrict_time;
+		uint32_t htime = pred_time + tmr_add;
+		struct lpm_history *history = &per_cpu(hist, dev->cpu);
+
+		if (htime > residency[best_level])
+			htime = residency[best_level];
+
+		if (sleep_us > htime &&
+				(sleep_us - htime) > residency[best_level])
+			histtimer_start(htime);
+
+		if (pred_time < sleep_us)
+			history->pred_end_us =
+				ktime_to_us(ktime_get()) + pred_time;
+	}
+
+	trace_cpu_power_select(best_level, sleep_us, latency_us, next_event_us,
+				pred_us);
 
 	return best_level;
 }
@@ -564,6 +781,33 @@ static uint64_t get_cluster_sleep_time(struct lpm_cluster *cluster,
 		return 0;
 }
 
+/*
+ * Time until the first predicted wakeup of the cpus in the cluster. Cpus
+ * that are past their predicted wakeup are in a longer idle period than
+ * predicted and are left out.
+ */
+static uint32_t cluster_predicted_sleep(struct lpm_cluster *cluster)
+{
+	int64_t now = ktime_to_us(ktime_get());
+	int64_t pred_end = 0;
+	int cpu;
+
+	if (!lpm_prediction)
+		return ~0U;
+
+	for_each_cpu_and(cpu, &cluster->num_children_in_sync,
+			cpu_online_mask) {
+		int64_t end = per_cpu(hist, cpu).pred_end_us;
+
+		if (end <= now)
+			continue;
+		if (!pred_end || end < pred_end)
+			pred_end = end;
+	}
+
+	return pred_end ? (uint32_t)(pred_end - now) : ~0U;
+}
+
 static int cluster_select(struct lpm_cluster *cluster, bool from_idle)
 {
 	int best_level = -1;
@@ -576,6 +820,8 @@ static int cluster_select(struct lpm_cluster *cluster, bool from_idle)
 		return -EINVAL;
 
 	sleep_us = (uint32_t)get_cluster_sleep_time(cluster, NULL, from_idle);
+	if (from_idle)
+		sleep_us = min(sleep_us, cluster_predicted_sleep(cluster));
 
 	if (cpumask_and(&mask, cpu_online_mask, &cluster->child_cpus))
 		latency_us = pm_qos_request_for_cpumask(PM_QOS_CPU_DMA_LATENCY,
@@ -802,9 +1048,20 @@ static void cluster_unprepare(struct lpm_cluster *cluster,
 	if (!first_cpu || cluster->last_level == cluster->default_level)
 		goto unlock_return;
 
-	if (cluster->stats->sleep_time)
+	if (cluster->stats->sleep_time) {
+		uint64_t us;
+		struct power_params *pwr =
+			&cluster->levels[cluster->last_level].pwr;
+
 		cluster->stats->sleep_time = end_time -
 			cluster->stats->sleep_time;
+
+		us = cluster->stats->sleep_time;
+		do_div(us, NSEC_PER_USEC);
+		lpm_stats_cluster_residency(cluster->stats, cluster->last_level,
+			lpm_residency_outcome(us, pwr->min_residency,
+						pwr->max_residency));
+	}
 	lpm_stats_cluster_exit(cluster->stats, cluster->last_level, true);
 
 	level = &cluster->levels[cluster->last_level];
@@ -1092,7 +1349,16 @@ exit:
 	sched_set_cpu_cstate(smp_processor_id(), 0, 0, 0);
 	trace_cpu_idle_exit(idx, success);
 	end_time = ktime_to_ns(ktime_get()) - start_time;
-	dev->last_residency = do_div(end_time, 1000);
+	do_div(end_time, 1000);
+	dev->last_residency = end_time;
+
+	if (success)
+		lpm_stats_cpu_residency(idx, lpm_residency_outcome(end_time,
+			pwr_params->min_residency,
+			get_per_cpu_max_residency(dev->cpu)[idx]));
+
+	histtimer_cancel();
+	update_history(dev, idx);
 	local_irq_enable();
 
 	return idx;
@@ -1372,6 +1638,7 @@ static int lpm_probe(struct platform_device *pdev)
 {
 	int ret;
 	int size;
+	unsigned int cpu;
 	struct kobject *module_kobj = NULL;
 
 	get_online_cpus();
@@ -1397,6 +1664,11 @@ static int lpm_probe(struct platform_device *pdev)
 	put_cpu();
 	suspend_set_ops(&lpm_suspend_ops);
 	hrtimer_init(&lpm_hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	for_each_possible_cpu(cpu) {
+		hrtimer_init(&per_cpu(histtimer, cpu), CLOCK_MONOTONIC,
+				HRTIMER_MODE_REL);
+		per_cpu(histtimer, cpu).function = histtimer_fn;
+	}
 	lpm_clk_init(pdev);
 
 	ret = remote_spin_lock_init(&scm_handoff_lock, SCM_HANDOFF_LOCK_ID);
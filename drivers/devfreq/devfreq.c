@@ -204,7 +204,8 @@ int update_devfreq(struct devfreq *devfreq)
 	 * Adjust the freuqency with user freq and QoS.
 	 *
 	 * List from the highest proiority
-	 * max_freq (probably called by thermal when it's too hot)
+	 * thermal_max_freq (set by a cooling device when it's too hot)
+	 * max_freq
 	 * min_freq
 	 */
 
@@ -216,6 +217,10 @@ int update_devfreq(struct devfreq *devfreq)
 		freq = devfreq->max_freq;
 		flags |= DEVFREQ_FLAG_LEAST_UPPER_BOUND; /* Use LUB */
 	}
+	if (devfreq->thermal_max_freq && freq > devfreq->thermal_max_freq) {
+		freq = devfreq->thermal_max_freq;
+		flags |= DEVFREQ_FLAG_LEAST_UPPER_BOUND; /* Use LUB */
+	}
 
 	err = devfreq->profile->target(devfreq->dev.parent, &freq, flags);
 	if (err)
@@ -37,6 +37,36 @@ TRACE_EVENT(devfreq_msg,
 	)
 );
 
+TRACE_EVENT(mem_arb_update,
+	TP_PROTO(const char *name, unsigned long bw, unsigned long lat,
+		 unsigned long gpu, unsigned long target, unsigned long ib,
+		 unsigned long ab),
+	TP_ARGS(name, bw, lat, gpu, target, ib, ab),
+	TP_STRUCT__entry(
+		__string(name, name)
+		__field(unsigned long, bw)
+		__field(unsigned long, lat)
+		__field(unsigned long, gpu)
+		__field(unsigned long, target)
+		__field(unsigned long, ib)
+		__field(unsigned long, ab)
+	),
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->bw = bw;
+		__entry->lat = lat;
+		__entry->gpu = gpu;
+		__entry->target = target;
+		__entry->ib = ib;
+		__entry->ab = ab;
+	),
+	TP_printk(
+		"dev=%s bw=%lu lat=%lu gpu=%lu target=%lu ib=%lu ab=%lu",
+		__get_str(name), __entry->bw, __entry->lat, __entry->gpu,
+		__entry->target, __entry->ib, __entry->ab
+	)
+);
+
 #endif /* _DEVFREQ_TRACE_H */
 
 /* This part must be outside protection */
@@ -32,6 +32,7 @@
 #include <trace/events/power.h>
 #include "governor.h"
 #include "governor_bw_hwmon.h"
+#include "governor_mem_arb.h"
 
 #define NUM_MBPS_ZONES		10
 struct hwmon_node {
@@ -80,6 +81,7 @@ struct hwmon_node {
 	struct bw_hwmon *hw;
 	struct devfreq_governor *gov;
 	struct attribute_group *attr_grp;
+	struct device_node *arb;
 };
 
 #define UP_WAKE 1
@@ -574,6 +576,8 @@ static int gov_start(struct devfreq *df)
 	if (ret)
 		goto err_sysfs;
 
+	node->arb = of_parse_phandle(dev->of_node, "qcom,mem-arb", 0);
+
 	return 0;
 
 err_sysfs:
@@ -593,6 +597,8 @@ static void gov_stop(struct devfreq *df)
 
 	sysfs_remove_group(&df->dev.kobj, node->attr_grp);
 	stop_monitor(df, true);
+	of_node_put(node->arb);
+	node->arb = NULL;
 	df->data = node->orig_data;
 	node->orig_data = NULL;
 	hw->df = NULL;
@@ -670,6 +676,13 @@ static int devfreq_bw_hwmon_get_freq(struct devfreq *df,
 
 	get_bw_and_set_irq(node, freq, node->dev_ab);
 
+	/* The arbiter votes for us, drop our own vote */
+	if (node->arb && node->dev_ab &&
+	    !mem_arb_vote(node->arb, MEM_ARB_BW, *freq, *node->dev_ab)) {
+		*freq = 0;
+		*node->dev_ab = 0;
+	}
+
 	return 0;
 }
 
@@ -14,6 +14,7 @@
 #include <linux/devfreq.h>
 #include <linux/module.h>
 #include "governor.h"
+#include "governor_mem_arb.h"
 
 unsigned long (*extern_get_bw)(void) = NULL;
 unsigned long *dev_ab;
@@ -65,6 +66,8 @@ int devfreq_vbif_update_bw(unsigned long ib, unsigned long ab)
 		mutex_unlock(&df->lock);
 	}
 	mutex_unlock(&df_lock);
+
+	mem_arb_gpu_vote(ib, ab);
 	return ret;
 }
 
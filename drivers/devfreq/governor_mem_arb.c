@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt) "mem-arb: " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/ktime.h>
+#include <linux/time.h>
+#include <linux/err.h>
+#include <linux/errno.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/of.h>
+#include <linux/devfreq.h>
+#include "governor.h"
+#include "governor_mem_arb.h"
+#include "devfreq_trace.h"
+
+/*
+ * Arbitrating governor for a memory bandwidth device. The bw_hwmon and
+ * mem_latency governors of devices pointing here with "qcom,mem-arb"
+ * post their votes instead of voting for their own bus clients, and the
+ * GPU's bus votes are followed as well. Once per polling window this
+ * governor turns the latest votes into a single IB/AB request:
+ *
+ *  - IB is the largest of the measured bandwidth and latency votes
+ *  - AB is the measured bandwidth, or a share of the latency vote if that
+ *    is larger, instead of the sum of both clients' AB votes
+ *  - decreases smaller than down_hyst_pct are held, as are decreases
+ *    the GPU's IB vote already covers, since changing them has no effect
+ *    on the memory frequency but still costs a bus request
+ *
+ * Votes older than vote_expiry_ms are dropped. Votes above the current
+ * request are applied right away rather than at the end of the window.
+ */
+struct arb_node {
+	unsigned int down_hyst_pct;
+	unsigned int vote_expiry_ms;
+	unsigned int lat_ab_percent;
+	unsigned int nr_updates;
+	unsigned int nr_held;
+
+	unsigned long vote[MEM_ARB_NR_SIGNALS];
+	unsigned long ab[MEM_ARB_NR_SIGNALS];
+	ktime_t ts[MEM_ARB_NR_SIGNALS];
+	unsigned long cur_ib;
+	unsigned long cur_ab;
+	unsigned long *dev_ab;
+	bool mon_started;
+
+	struct work_struct update_work;
+	struct list_head list;
+	struct devfreq *df;
+};
+
+/* Protects arb_list and the votes of all arbiters */
+static DEFINE_SPINLOCK(arb_lock);
+static LIST_HEAD(arb_list);
+
+#define show_attr(name) \
+static ssize_t show_##name(struct device *dev,				\
+			struct device_attribute *attr, char *buf)	\
+{									\
+	struct devfreq *df = to_devfreq(dev);				\
+	struct arb_node *hw = df->data;					\
+	return snprintf(buf, PAGE_SIZE, "%u\n", hw->name);		\
+}
+
+#define store_attr(name, _min, _max) \
+static ssize_t store_##name(struct device *dev,				\
+			struct device_attribute *attr, const char *buf,	\
+			size_t count)					\
+{									\
+	struct devfreq *df = to_devfreq(dev);				\
+	struct arb_node *hw = df->data;					\
+	int ret;							\
+	unsigned int val;						\
+	ret = kstrtouint(buf, 10, &val);				\
+	if (ret)							\
+		return ret;						\
+	val = max(val, _min);						\
+	val = min(val, _max);						\
+	hw->name = val;							\
+	return count;							\
+}
+
+#define gov_attr(__attr, min, max)	\
+show_attr(__attr)			\
+store_attr(__attr, min, max)		\
+static DEVICE_ATTR(__attr, 0644, show_##__attr, store_##__attr)
+
+#define gov_ro_attr(__attr)		\
+show_attr(__attr)			\
+static DEVICE_ATTR(__attr, 0444, show_##__attr, NULL)
+
+static struct arb_node *find_arb_node(struct device_node *of_node)
+{
+	struct arb_node *node;
+
+	list_for_each_entry(node, &arb_list, list)
+		if (node->df->dev.parent->of_node == of_node)
+			return node;
+
+	return NULL;
+}
+
+static void arb_update(struct arb_node *node, enum mem_arb_signal sig,
+		       unsigned long ib_mbps, unsigned long ab_mbps)
+{
+	node->vote[sig] = ib_mbps;
+	node->ab[sig] = ab_mbps;
+	node->ts[sig] = ktime_get();
+
+	if (sig != MEM_ARB_GPU && node->mon_started &&
+	    (ib_mbps > node->cur_ib || ab_mbps > node->cur_ab))
+		queue_work(system_highpri_wq, &node->update_work);
+}
+
+int mem_arb_vote(struct device_node *arb, enum mem_arb_signal sig,
+		 unsigned long ib_mbps, unsigned long ab_mbps)
+{
+	struct arb_node *node;
+	unsigned long flags;
+	int ret = -ENODEV;
+
+	if (!arb || sig >= MEM_ARB_NR_SIGNALS)
+		return -EINVAL;
+
+	spin_lock_irqsave(&arb_lock, flags);
+	node = find_arb_node(arb);
+	if (node && node->mon_started) {
+		arb_update(node, sig, ib_mbps, ab_mbps);
+		ret = 0;
+	}
+	spin_unlock_irqrestore(&arb_lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL(mem_arb_vote);
+
+void mem_arb_gpu_vote(unsigned long ib_mbps, unsigned long ab_mbps)
+{
+	struct arb_node *node;
+	unsigned long flags;
+
+	spin_lock_irqsave(&arb_lock, flags);
+	list_for_each_entry(node, &arb_list, list)
+		arb_update(node, MEM_ARB_GPU, ib_mbps, ab_mbps);
+	spin_unlock_irqrestore(&arb_lock, flags);
+}
+EXPORT_SYMBOL(mem_arb_gpu_vote);
+
+static void arb_update_work(struct work_struct *work)
+{
+	struct arb_node *node = container_of(work, struct arb_node,
+					     update_work);
+	struct devfreq *df = node->df;
+	int ret;
+
+	mutex_lock(&df->lock);
+	ret = update_devfreq(df);
+	if (ret)
+		dev_err(df->dev.parent, "Unable to update freq on vote!\n");
+	mutex_unlock(&df->lock);
+}
+
+/* Hold decreases within the hysteresis band */
+static bool arb_hold(struct arb_node *node, unsigned long new,
+		     unsigned long cur)
+{
+	return new < cur &&
+		new * 100 >= cur * (100 - node->down_hyst_pct);
+}
+
+static int devfreq_mem_arb_get_freq(struct devfreq *df,
+					unsigned long *freq,
+					u32 *flag)
+{
+	struct arb_node *node = df->data;
+	unsigned long vote[MEM_ARB_NR_SIGNALS];
+	unsigned long ib, ab, target, flags;
+	ktime_t now = ktime_get();
+	int i;
+
+	spin_lock_irqsave(&arb_lock, flags);
+	for (i = 0; i < MEM_ARB_NR_SIGNALS; i++) {
+		if (ktime_to_ms(ktime_sub(now, node->ts[i])) >
+						node->vote_expiry_ms) {
+			node->vote[i] = 0;
+			node->ab[i] = 0;
+		}
+		vote[i] = node->vote[i];
+	}
+	ab = node->ab[MEM_ARB_BW];
+	spin_unlock_irqrestore(&arb_lock, flags);
+
+	target = max(vote[MEM_ARB_BW], vote[MEM_ARB_LAT]);
+	/* Latency votes come with no measured traffic of their own */
+	ab = max(ab, vote[MEM_ARB_LAT] * node->lat_ab_percent / 100);
+
+	ib = target;
+	if (arb_hold(node, ib, node->cur_ib) ||
+	    (ib < node->cur_ib && node->cur_ib <= vote[MEM_ARB_GPU]))
+		ib = node->cur_ib;
+	if (arb_hold(node, ab, node->cur_ab))
+		ab = node->cur_ab;
+
+	if (ib != target)
+		node->nr_held++;
+	if (ib != node->cur_ib || ab != node->cur_ab)
+		node->nr_updates++;
+
+	trace_mem_arb_update(dev_name(df->dev.parent), vote[MEM_ARB_BW],
+			     vote[MEM_ARB_LAT], vote[MEM_ARB_GPU], target,
+			     ib, ab);
+
+	node->cur_ib = ib;
+	node->cur_ab = ab;
+	*freq = ib;
+	if (node->dev_ab)
+		*node->dev_ab = ab;
+
+	return 0;
+}
+
+gov_attr(down_hyst_pct, 0U, 50U);
+gov_attr(vote_expiry_ms, 10U, 5000U);
+gov_attr(lat_ab_percent, 0U, 100U);
+gov_ro_attr(nr_updates);
+gov_ro_attr(nr_held);
+
+static struct attribute *dev_attr[] = {
+	&dev_attr_down_hyst_pct.attr,
+	&dev_attr_vote_expiry_ms.attr,
+	&dev_attr_lat_ab_percent.attr,
+	&dev_attr_nr_updates.attr,
+	&dev_attr_nr_held.attr,
+	NULL,
+};
+
+static struct attribute_group dev_attr_group = {
+	.name = "mem_arb",
+	.attrs = dev_attr,
+};
+
+static int gov_start(struct devfreq *df)
+{
+	struct device *dev = df->dev.parent;
+	struct devfreq_dev_status stat;
+	struct arb_node *node;
+	unsigned long flags;
+	int ret = 0;
+
+	node = kzalloc(sizeof(*node), GFP_KERNEL);
+	if (!node)
+		return -ENOMEM;
+
+	node->down_hyst_pct = 10;
+	node->vote_expiry_ms = 200;
+	node->lat_ab_percent = 20;
+	node->df = df;
+	INIT_WORK(&node->update_work, arb_update_work);
+
+	stat.private_data = NULL;
+	if (df->profile->get_dev_status)
+		ret = df->profile->get_dev_status(dev, &stat);
+	if (ret || !stat.private_data)
+		dev_warn(dev, "Device doesn't take AB votes!\n");
+	else
+		node->dev_ab = stat.private_data;
+
+	df->data = node;
+
+	ret = sysfs_create_group(&df->dev.kobj, &dev_attr_group);
+	if (ret) {
+		df->data = NULL;
+		kfree(node);
+		return ret;
+	}
+
+	spin_lock_irqsave(&arb_lock, flags);
+	list_add_tail(&node->list, &arb_list);
+	node->mon_started = true;
+	spin_unlock_irqrestore(&arb_lock, flags);
+
+	devfreq_monitor_start(df);
+
+	return 0;
+}
+
+static void gov_stop(struct devfreq *df)
+{
+	struct arb_node *node = df->data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&arb_lock, flags);
+	node->mon_started = false;
+	list_del(&node->list);
+	spin_unlock_irqrestore(&arb_lock, flags);
+
+	cancel_work_sync(&node->update_work);
+	devfreq_monitor_stop(df);
+	sysfs_remove_group(&df->dev.kobj, &dev_attr_group);
+
+	if (node->dev_ab)
+		*node->dev_ab = 0;
+	df->data = NULL;
+	kfree(node);
+}
+
+static void gov_suspend(struct devfreq *df)
+{
+	struct arb_node *node = df->data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&arb_lock, flags);
+	node->mon_started = false;
+	spin_unlock_irqrestore(&arb_lock, flags);
+
+	cancel_work_sync(&node->update_work);
+	devfreq_monitor_suspend(df);
+}
+
+static void gov_resume(struct devfreq *df)
+{
+	struct arb_node *node = df->data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&arb_lock, flags);
+	node->mon_started = true;
+	spin_unlock_irqrestore(&arb_lock, flags);
+
+	devfreq_monitor_resume(df);
+}
+
+#define MIN_MS	10U
+#define MAX_MS	500U
+static int devfreq_mem_arb_ev_handler(struct devfreq *df,
+					unsigned int event, void *data)
+{
+	int ret;
+	unsigned int sample_ms;
+
+	switch (event) {
+	case DEVFREQ_GOV_START:
+		sample_ms = df->profile->polling_ms;
+		sample_ms = max(MIN_MS, sample_ms);
+		sample_ms = min(MAX_MS, sample_ms);
+		df->profile->polling_ms = sample_ms;
+
+		ret = gov_start(df);
+		if (ret)
+			return ret;
+
+		dev_dbg(df->dev.parent,
+			"Enabled memory arbitration governor\n");
+		break;
+
+	case DEVFREQ_GOV_STOP:
+		gov_stop(df);
+		dev_dbg(df->dev.parent,
+			"Disabled memory arbitration governor\n");
+		break;
+
+	case DEVFREQ_GOV_INTERVAL:
+		sample_ms = *(unsigned int *)data;
+		sample_ms = max(MIN_MS, sample_ms);
+		sample_ms = min(MAX_MS, sample_ms);
+		devfreq_interval_update(df, &sample_ms);
+		break;
+
+	case DEVFREQ_GOV_SUSPEND:
+		gov_suspend(df);
+		break;
+
+	case DEVFREQ_GOV_RESUME:
+		gov_resume(df);
+		break;
+	}
+
+	return 0;
+}
+
+static struct devfreq_governor devfreq_gov_mem_arb = {
+	.name = "mem_arb",
+	.get_target_freq = devfreq_mem_arb_get_freq,
+	.event_handler = devfreq_mem_arb_ev_handler,
+};
+
+static int __init devfreq_mem_arb_init(void)
+{
+	return devfreq_add_governor(&devfreq_gov_mem_arb);
+}
+subsys_initcall(devfreq_mem_arb_init);
+
+MODULE_DESCRIPTION("Arbitrating DDR bandwidth voting governor");
+MODULE_LICENSE("GPL v2");
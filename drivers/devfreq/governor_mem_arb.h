@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _GOVERNOR_MEM_ARB_H
+#define _GOVERNOR_MEM_ARB_H
+
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/of.h>
+
+/**
+ * enum mem_arb_signal - Inputs of the memory bandwidth arbiter
+ * @MEM_ARB_BW:		Measured bandwidth, from the bw_hwmon governor
+ * @MEM_ARB_LAT:	Memory latency bound CPUs, from the mem_latency
+ *			governor
+ * @MEM_ARB_GPU:	GPU bus vote. The GPU votes for its own port, so
+ *			this is only used to hold votes it already covers.
+ */
+enum mem_arb_signal {
+	MEM_ARB_BW,
+	MEM_ARB_LAT,
+	MEM_ARB_GPU,
+	MEM_ARB_NR_SIGNALS,
+};
+
+/*
+ * Governors of devices with a "qcom,mem-arb" phandle hand their votes,
+ * in the MBps units of the arbitrated device, to the mem_arb governor of
+ * the device the phandle points to instead of voting themselves. A
+ * non-zero return means there is no running arbiter and the caller
+ * should vote as usual.
+ */
+#ifdef CONFIG_DEVFREQ_GOV_MEM_ARB
+int mem_arb_vote(struct device_node *arb, enum mem_arb_signal sig,
+		 unsigned long ib_mbps, unsigned long ab_mbps);
+void mem_arb_gpu_vote(unsigned long ib_mbps, unsigned long ab_mbps);
+#else
+static inline int mem_arb_vote(struct device_node *arb,
+			       enum mem_arb_signal sig,
+			       unsigned long ib_mbps, unsigned long ab_mbps)
+{
+	return -ENODEV;
+}
+static inline void mem_arb_gpu_vote(unsigned long ib_mbps,
+				    unsigned long ab_mbps)
+{
+}
+#endif
+
+#endif /* _GOVERNOR_MEM_ARB_H */
@@ -30,6 +30,7 @@
 #include <linux/devfreq.h>
 #include "governor.h"
 #include "governor_memlat.h"
+#include "governor_mem_arb.h"
 
 #include <trace/events/power.h>
 
@@ -43,6 +44,7 @@ struct memlat_node {
 	struct memlat_hwmon *hw;
 	struct devfreq_governor *gov;
 	struct attribute_group *attr_grp;
+	struct device_node *arb;
 };
 
 static LIST_HEAD(memlat_list);
@@ -197,6 +199,8 @@ static int gov_start(struct devfreq *df)
 	if (ret)
 		goto err_sysfs;
 
+	node->arb = of_parse_phandle(dev->of_node, "qcom,mem-arb", 0);
+
 	return 0;
 
 err_sysfs:
@@ -215,6 +219,8 @@ static void gov_stop(struct devfreq *df)
 
 	sysfs_remove_group(&df->dev.kobj, node->attr_grp);
 	stop_monitor(df);
+	of_node_put(node->arb);
+	node->arb = NULL;
 	df->data = node->orig_data;
 	node->orig_data = NULL;
 	hw->df = NULL;
@@ -230,6 +236,10 @@ static int devfreq_memlat_get_freq(struct devfreq *df,
 	mhz = compute_dev_vote(df);
 	*freq = mhz ? (mhz * node->mult_factor) : 0;
 
+	/* The arbiter votes for us, drop our own vote */
+	if (node->arb && !mem_arb_vote(node->arb, MEM_ARB_LAT, *freq, 0))
+		*freq = 0;
+
 	return 0;
 }
 
@@ -356,6 +356,8 @@ static int tz_get_target_freq(struct devfreq *devfreq, unsigned long *freq,
 	}
 
 	*freq = stats.current_frequency;
+	devfreq->last_status = stats;
+	devfreq->last_status.private_data = NULL;
 	priv->bin.total_time += stats.total_time;
 	priv->bin.busy_time += stats.busy_time;
 
@@ -660,6 +660,18 @@ int kgsl_pwrscale_init(struct device *dev, const char *governor)
 
 	pwrscale->devfreqptr = devfreq;
 
+	/* Power actor for the thermal framework, if described in DT */
+	if (of_find_property(device->pdev->dev.of_node, "#cooling-cells",
+			NULL)) {
+		pwrscale->cooling_dev = of_devfreq_cooling_register(
+				device->pdev->dev.of_node, devfreq);
+		if (IS_ERR(pwrscale->cooling_dev)) {
+			KGSL_PWR_ERR(device, "no GPU cooling device: %ld\n",
+				PTR_ERR(pwrscale->cooling_dev));
+			pwrscale->cooling_dev = NULL;
+		}
+	}
+
 	pwrscale->gpu_profile.bus_devfreq = NULL;
 	if (data->bus.num) {
 		pwrscale->bus_profile.profile.max_state
@@ -722,6 +734,8 @@ void kgsl_pwrscale_close(struct kgsl_device *device)
 		return;
 	flush_workqueue(pwrscale->devfreq_wq);
 	destroy_workqueue(pwrscale->devfreq_wq);
+	devfreq_cooling_unregister(pwrscale->cooling_dev);
+	pwrscale->cooling_dev = NULL;
 	devfreq_remove_device(device->pwrscale.devfreqptr);
 	device->pwrscale.devfreqptr = NULL;
 	srcu_cleanup_notifier_head(&device->pwrscale.nh);
@@ -15,6 +15,7 @@
 #define __KGSL_PWRSCALE_H
 
 #include <linux/devfreq.h>
+#include <linux/devfreq_cooling.h>
 #include <linux/msm_adreno_devfreq.h>
 #include "kgsl_pwrctrl.h"
 
@@ -72,6 +73,7 @@ struct kgsl_pwr_history {
  * @next_governor_call - Timestamp after which the governor may be notified of
  * a new sample
  * @history - History of power events with timestamps and durations
+ * @cooling_dev - Thermal cooling device capping the GPU devfreq device
  */
 struct kgsl_pwrscale {
 	struct devfreq *devfreqptr;
@@ -91,6 +93,7 @@ struct kgsl_pwrscale {
 	struct work_struct devfreq_notify_ws;
 	ktime_t next_governor_call;
 	struct kgsl_pwr_history history[KGSL_PWREVENT_MAX];
+	struct thermal_cooling_device *cooling_dev;
 };
 
 int kgsl_pwrscale_init(struct device *dev, const char *governor);
@@ -61,6 +61,10 @@ static bool support_p2p_device = true;
 module_param(support_p2p_device, bool, 0444);
 MODULE_PARM_DESC(support_p2p_device, "Support P2P-Device interface type");
 
+static bool txqs;
+module_param(txqs, bool, 0444);
+MODULE_PARM_DESC(txqs, "Use intermediate TX queues with airtime fairness");
+
 /**
  * enum hwsim_regtest - the type of regulatory tests we offer
  *
@@ -1170,6 +1174,95 @@ static void mac80211_hwsim_tx(struct ieee80211_hw *hw,
 	ieee80211_tx_status_irqsafe(hw, skb);
 }
 
+/* frames pulled from one TXQ per scheduling round */
+#define HWSIM_TXQ_BURST		8
+
+/* rough airtime of a frame in usecs, from its first rate */
+static u32 mac80211_hwsim_tx_airtime(struct ieee80211_hw *hw,
+				     struct sk_buff *skb)
+{
+	struct ieee80211_tx_info *txi = IEEE80211_SKB_CB(skb);
+	struct ieee80211_tx_rate *r = &txi->control.rates[0];
+	struct rate_info ri = {};
+	u32 bitrate = 0;
+
+	if (r->idx < 0)
+		return 0;
+
+	if (r->flags & (IEEE80211_TX_RC_MCS | IEEE80211_TX_RC_VHT_MCS)) {
+		if (r->flags & IEEE80211_TX_RC_VHT_MCS) {
+			ri.flags |= RATE_INFO_FLAGS_VHT_MCS;
+			ri.mcs = r->idx & 0xf;
+			ri.nss = (r->idx >> 4) + 1;
+		} else {
+			ri.flags |= RATE_INFO_FLAGS_MCS;
+			ri.mcs = r->idx;
+		}
+		if (r->flags & IEEE80211_TX_RC_40_MHZ_WIDTH)
+			ri.flags |= RATE_INFO_FLAGS_40_MHZ_WIDTH;
+		else if (r->flags & IEEE80211_TX_RC_80_MHZ_WIDTH)
+			ri.flags |= RATE_INFO_FLAGS_80_MHZ_WIDTH;
+		else if (r->flags & IEEE80211_TX_RC_160_MHZ_WIDTH)
+			ri.flags |= RATE_INFO_FLAGS_160_MHZ_WIDTH;
+		if (r->flags & IEEE80211_TX_RC_SHORT_GI)
+			ri.flags |= RATE_INFO_FLAGS_SHORT_GI;
+		bitrate = cfg80211_calculate_bitrate(&ri);
+	} else {
+		bitrate = ieee80211_get_tx_rate(hw, txi)->bitrate;
+	}
+
+	if (!bitrate)
+		bitrate = 10;
+
+	/* bitrate is in 100 kbps; add a fixed preamble/IFS overhead */
+	return 36 + DIV_ROUND_UP(skb->len * 8 * 10, bitrate);
+}
+
+static void mac80211_hwsim_wake_tx_queue(struct ieee80211_hw *hw,
+					 struct ieee80211_txq *txq)
+{
+	struct ieee80211_tx_control control = {};
+	struct sk_buff_head frames;
+	struct ieee80211_txq *cur;
+	struct sk_buff *skb;
+	u8 ac = txq->ac;
+	int n;
+
+	__skb_queue_head_init(&frames);
+
+	/*
+	 * Pull a burst from each queue that is due this round. The frames
+	 * are handed to the medium only after the scheduler lock has been
+	 * dropped, since reporting their airtime takes it again.
+	 */
+	ieee80211_txq_schedule_start(hw, ac);
+	while ((cur = ieee80211_next_txq(hw, ac))) {
+		for (n = 0; n < HWSIM_TXQ_BURST; n++) {
+			skb = ieee80211_tx_dequeue(hw, cur);
+			if (!skb)
+				break;
+			__skb_queue_tail(&frames, skb);
+		}
+		ieee80211_return_txq(hw, cur);
+	}
+	ieee80211_txq_schedule_end(hw, ac);
+
+	while ((skb = __skb_dequeue(&frames))) {
+		struct ieee80211_tx_info *txi = IEEE80211_SKB_CB(skb);
+		struct ieee80211_hdr *hdr = (struct ieee80211_hdr *)skb->data;
+		u8 tid = skb->priority & IEEE80211_QOS_CTL_TID_MASK;
+		u32 airtime;
+
+		control.sta = ieee80211_find_sta(txi->control.vif, hdr->addr1);
+		airtime = mac80211_hwsim_tx_airtime(hw, skb);
+
+		mac80211_hwsim_tx(hw, &control, skb);
+
+		if (control.sta && airtime)
+			ieee80211_sta_register_airtime(control.sta, tid,
+						       airtime, 0);
+	}
+}
 
 static int mac80211_hwsim_start(struct ieee80211_hw *hw)
 {
@@ -1960,6 +2053,7 @@ static const struct ieee80211_ops mac80211_hwsim_ops = {
 	.set_tsf = mac80211_hwsim_set_tsf,
 };
 
+static struct ieee80211_ops mac80211_hwsim_txq_ops;
 static struct ieee80211_ops mac80211_hwsim_mchan_ops;
 
 struct hwsim_new_radio_params {
@@ -2098,6 +2192,8 @@ static int mac80211_hwsim_new_radio(struct genl_info *info,
 
 	if (param->use_chanctx)
 		ops = &mac80211_hwsim_mchan_ops;
+	else if (txqs)
+		ops = &mac80211_hwsim_txq_ops;
 	hw = ieee80211_alloc_hw_nm(sizeof(*data), ops, param->hwname);
 	if (!hw) {
 		printk(KERN_DEBUG "mac80211_hwsim: ieee80211_alloc_hw failed\n");
@@ -2188,6 +2284,8 @@ static int mac80211_hwsim_new_radio(struct genl_info *info,
 		    IEEE80211_HW_CHANCTX_STA_CSA;
 	if (rctbl)
 		hw->flags |= IEEE80211_HW_SUPPORTS_RC_TABLE;
+	if (txqs)
+		hw->flags |= IEEE80211_HW_AIRTIME_FAIRNESS;
 
 	hw->wiphy->flags |= WIPHY_FLAG_SUPPORTS_TDLS |
 			    WIPHY_FLAG_HAS_REMAIN_ON_CHANNEL |
@@ -2822,7 +2920,13 @@ static int __init init_mac80211_hwsim(void)
 	if (channels < 1)
 		return -EINVAL;
 
+	mac80211_hwsim_txq_ops = mac80211_hwsim_ops;
+	mac80211_hwsim_txq_ops.wake_tx_queue = mac80211_hwsim_wake_tx_queue;
+
 	mac80211_hwsim_mchan_ops = mac80211_hwsim_ops;
+	if (txqs)
+		mac80211_hwsim_mchan_ops.wake_tx_queue =
+			mac80211_hwsim_wake_tx_queue;
 	mac80211_hwsim_mchan_ops.hw_scan = mac80211_hwsim_hw_scan;
 	mac80211_hwsim_mchan_ops.cancel_hw_scan = mac80211_hwsim_cancel_hw_scan;
 	mac80211_hwsim_mchan_ops.sw_scan_start = NULL;
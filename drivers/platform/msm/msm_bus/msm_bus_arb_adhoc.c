@@ -35,10 +35,24 @@ struct handle_type {
 	struct msm_bus_client **cl_list;
 };
 
+/*
+ * Route found by getpath() for a src/dest pair. The topology doesn't
+ * change once the fabrics are probed, so later clients of the same pair
+ * just get link nodes allocated along the cached hops.
+ */
+struct path_cache_type {
+	struct list_head link;
+	int src;
+	int dest;
+	int num_hops;
+	struct device **hops;
+};
+
 static struct handle_type handle_list;
 static LIST_HEAD(input_list);
 static LIST_HEAD(apply_list);
 static LIST_HEAD(commit_list);
+static LIST_HEAD(path_cache);
 
 DEFINE_RT_MUTEX(msm_bus_adhoc_lock);
 
@@ -108,8 +122,8 @@ int msm_bus_device_match_adhoc(struct device *dev, void *id)
 	return ret;
 }
 
-static int gen_lnode(struct device *dev,
-			int next_hop, int prev_idx, const char *cl_name)
+static int gen_lnode_dev(struct device *dev, struct device *next_dev,
+			int prev_idx, const char *cl_name)
 {
 	struct link_node *lnode;
 	struct msm_bus_node_device_type *cur_dev = NULL;
@@ -168,14 +182,12 @@ static int gen_lnode(struct device *dev,
 
 	lnode->in_use = 1;
 	lnode->cl_name = cl_name;
-	if (next_hop == cur_dev->node_info->id) {
+	if (!next_dev) {
 		lnode->next = -1;
 		lnode->next_dev = NULL;
 	} else {
 		lnode->next = prev_idx;
-		lnode->next_dev = bus_find_device(&msm_bus_type, NULL,
-					(void *) &next_hop,
-					msm_bus_device_match_adhoc);
+		lnode->next_dev = next_dev;
 	}
 
 	memset(lnode->lnode_ib, 0, sizeof(uint64_t) * NUM_CTX);
@@ -185,6 +197,19 @@ exit_gen_lnode:
 	return lnode_idx;
 }
 
+static int gen_lnode(struct device *dev,
+			int next_hop, int prev_idx, const char *cl_name)
+{
+	struct device *next_dev = NULL;
+
+	if (dev && next_hop != to_msm_bus_node(dev)->node_info->id)
+		next_dev = bus_find_device(&msm_bus_type, NULL,
+					(void *) &next_hop,
+					msm_bus_device_match_adhoc);
+
+	return gen_lnode_dev(dev, next_dev, prev_idx, cl_name);
+}
+
 static int remove_lnode(struct msm_bus_node_device_type *cur_dev,
 				int lnode_idx)
 {
@@ -299,6 +324,73 @@ static void setup_bl_list(struct msm_bus_node_device_type *node,
 	}
 }
 
+static struct path_cache_type *find_path_cache(int src, int dest)
+{
+	struct path_cache_type *path;
+
+	list_for_each_entry(path, &path_cache, link) {
+		if (path->src == src && path->dest == dest)
+			return path;
+	}
+	return NULL;
+}
+
+/* Allocate link nodes along a cached route, from the destination back */
+static int gen_path_from_cache(struct path_cache_type *path,
+				const char *cl_name)
+{
+	struct device *next_dev = NULL;
+	int lnode_hop = -1;
+	int i;
+
+	for (i = path->num_hops - 1; i >= 0; i--) {
+		lnode_hop = gen_lnode_dev(path->hops[i], next_dev, lnode_hop,
+								cl_name);
+		if (lnode_hop < 0)
+			break;
+		next_dev = path->hops[i];
+	}
+
+	return lnode_hop;
+}
+
+static void add_path_cache(struct device *src_dev, int src, int dest,
+				int first_hop)
+{
+	struct path_cache_type *path;
+	struct msm_bus_node_device_type *bus_node;
+	struct device *dev;
+	int idx, i;
+
+	path = kzalloc(sizeof(struct path_cache_type), GFP_KERNEL);
+	if (!path)
+		return;
+
+	for (dev = src_dev, idx = first_hop; dev; path->num_hops++) {
+		bus_node = to_msm_bus_node(dev);
+		dev = bus_node->lnode_list[idx].next_dev;
+		idx = bus_node->lnode_list[idx].next;
+	}
+
+	path->hops = kzalloc(sizeof(struct device *) * path->num_hops,
+								GFP_KERNEL);
+	if (!path->hops) {
+		kfree(path);
+		return;
+	}
+
+	for (dev = src_dev, idx = first_hop, i = 0; dev; i++) {
+		bus_node = to_msm_bus_node(dev);
+		path->hops[i] = dev;
+		dev = bus_node->lnode_list[idx].next_dev;
+		idx = bus_node->lnode_list[idx].next;
+	}
+
+	path->src = src;
+	path->dest = dest;
+	list_add_tail(&path->link, &path_cache);
+}
+
 static int getpath(struct device *src_dev, int dest, const char *cl_name)
 {
 	struct list_head traverse_list;
@@ -307,6 +399,7 @@ static int getpath(struct device *src_dev, int dest, const char *cl_name)
 	struct list_head black_list;
 	struct msm_bus_node_device_type *src_node;
 	struct bus_search_type *search_node;
+	struct path_cache_type *path;
 	int found = 0;
 	int depth_index = 0;
 	int first_hop = -1;
@@ -328,6 +421,15 @@ static int getpath(struct device *src_dev, int dest, const char *cl_name)
 		goto exit_getpath;
 	}
 	src = src_node->node_info->id;
+
+	path = find_path_cache(src, dest);
+	if (path) {
+		msm_bus_dbg_inc_stat(MSM_BUS_DBG_PATH_HIT);
+		first_hop = gen_path_from_cache(path, cl_name);
+		goto exit_getpath;
+	}
+	msm_bus_dbg_inc_stat(MSM_BUS_DBG_PATH_MISS);
+
 	list_add_tail(&src_node->link, &traverse_list);
 
 	while ((!found && !list_empty(&traverse_list))) {
@@ -390,6 +492,8 @@ reset_traversed:
 	copy_remaining_nodes(&edge_list, &traverse_list, &route_list);
 	first_hop = prune_path(&route_list, dest, src, &black_list, found,
 								cl_name);
+	if (first_hop >= 0)
+		add_path_cache(src_dev, src, dest, first_hop);
 
 exit_getpath:
 	return first_hop;
@@ -659,6 +763,13 @@ static void commit_data(void)
 {
 	bool rules_registered = msm_rule_are_rules_registered();
 
+	/* None of the aggregates along the updated paths changed */
+	if (list_empty(&commit_list)) {
+		msm_bus_dbg_inc_stat(MSM_BUS_DBG_COMMIT_SKIPPED);
+		return;
+	}
+	msm_bus_dbg_inc_stat(MSM_BUS_DBG_COMMIT);
+
 	if (rules_registered) {
 		msm_rules_update_path(&input_list, &apply_list);
 		msm_bus_apply_rules(&apply_list, false);
@@ -692,6 +803,20 @@ static void add_node_to_clist(struct msm_bus_node_device_type *node)
 	}
 }
 
+static bool node_bw_changed(struct msm_bus_node_device_type *node,
+				struct nodebw *old_bw)
+{
+	int i;
+
+	for (i = 0; i < NUM_CTX; i++) {
+		if (node->node_bw[i].cur_clk_hz != old_bw[i].cur_clk_hz ||
+			node->node_bw[i].sum_ab != old_bw[i].sum_ab ||
+			node->node_bw[i].max_ib != old_bw[i].max_ib)
+			return true;
+	}
+	return false;
+}
+
 static int update_path(struct device *src_dev, int dest, uint64_t act_req_ib,
 			uint64_t act_req_bw, uint64_t slp_req_ib,
 			uint64_t slp_req_bw, uint64_t cur_ib, uint64_t cur_bw,
@@ -700,6 +825,7 @@ static int update_path(struct device *src_dev, int dest, uint64_t act_req_ib,
 	struct device *next_dev = NULL;
 	struct link_node *lnode = NULL;
 	struct msm_bus_node_device_type *dev_info = NULL;
+	struct nodebw old_bw[NUM_CTX];
 	int curr_idx;
 	int ret = 0;
 	struct rule_update_path_info *rule_node;
@@ -743,10 +869,18 @@ static int update_path(struct device *src_dev, int dest, uint64_t act_req_ib,
 		lnode->lnode_ib[DUAL_CTX] = slp_req_ib;
 		lnode->lnode_ab[DUAL_CTX] = slp_req_bw;
 
+		memcpy(old_bw, dev_info->node_bw, sizeof(old_bw));
 		for (i = 0; i < NUM_CTX; i++)
 			dev_info->node_bw[i].cur_clk_hz =
 					aggregate_bus_req(dev_info, i);
 
+		/*
+		 * Other clients' votes still dominate this node, nothing to
+		 * send to the hardware for it.
+		 */
+		if (!node_bw_changed(dev_info, old_bw))
+			goto next_hop;
+
 		add_node_to_clist(dev_info);
 
 		if (rules_registered) {
@@ -762,6 +896,7 @@ static int update_path(struct device *src_dev, int dest, uint64_t act_req_ib,
 			}
 		}
 
+next_hop:
 		next_dev = lnode->next_dev;
 		curr_idx = lnode->next;
 	}
@@ -1219,9 +1354,11 @@ static int update_request_adhoc(uint32_t cl, unsigned int index)
 		goto exit_update_request;
 	}
 
+	msm_bus_dbg_inc_stat(MSM_BUS_DBG_VOTE);
 	if (client->curr == index) {
 		MSM_BUS_DBG("%s: Not updating client request idx %d unchanged",
 				__func__, index);
+		msm_bus_dbg_inc_stat(MSM_BUS_DBG_VOTE_UNCHANGED);
 		goto exit_update_request;
 	}
 
@@ -1260,24 +1397,29 @@ static int update_bw_adhoc(struct msm_bus_client_handle *cl, u64 ab, u64 ib)
 	bool log_transaction = false;
 	u64 slp_ib, slp_ab;
 
-	rt_mutex_lock(&msm_bus_adhoc_lock);
-
 	if (!cl) {
 		MSM_BUS_ERR("%s: Invalid client handle %p", __func__, cl);
-		ret = -ENXIO;
-		goto exit_update_request;
+		return -ENXIO;
 	}
 
-	if (!strcmp(test_cl, cl->name))
-		log_transaction = true;
-
 	msm_bus_dbg_rec_transaction(cl, ab, ib);
+	msm_bus_dbg_inc_stat(MSM_BUS_DBG_VOTE);
 
+	/*
+	 * The vote of a handle is only changed by its owner, so repeated
+	 * votes can be dropped without serialising on the adhoc lock.
+	 */
 	if ((cl->cur_act_ib == ib) && (cl->cur_act_ab == ab)) {
 		MSM_BUS_DBG("%s:no change in request", cl->name);
-		goto exit_update_request;
+		msm_bus_dbg_inc_stat(MSM_BUS_DBG_VOTE_UNCHANGED);
+		return 0;
 	}
 
+	rt_mutex_lock(&msm_bus_adhoc_lock);
+
+	if (!strcmp(test_cl, cl->name))
+		log_transaction = true;
+
 	if (cl->active_only) {
 		slp_ib = 0;
 		slp_ab = 0;
@@ -1322,11 +1464,13 @@ static int update_bw_context(struct msm_bus_client_handle *cl, u64 act_ab,
 		goto exit_change_context;
 	}
 
+	msm_bus_dbg_inc_stat(MSM_BUS_DBG_VOTE);
 	if ((cl->cur_act_ib == act_ib) &&
 		(cl->cur_act_ab == act_ab) &&
 		(cl->cur_slp_ib == slp_ib) &&
 		(cl->cur_slp_ab == slp_ab)) {
 		MSM_BUS_ERR("No change in vote");
+		msm_bus_dbg_inc_stat(MSM_BUS_DBG_VOTE_UNCHANGED);
 		goto exit_change_context;
 	}
 
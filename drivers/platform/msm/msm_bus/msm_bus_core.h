@@ -50,6 +50,17 @@ enum msm_bus_dbg_op_type {
 	MSM_BUS_DBG_OP = 1,
 };
 
+/* Vote path counters reported in msm-bus-dbg/vote_stats */
+enum msm_bus_dbg_stat {
+	MSM_BUS_DBG_VOTE,
+	MSM_BUS_DBG_VOTE_UNCHANGED,
+	MSM_BUS_DBG_COMMIT,
+	MSM_BUS_DBG_COMMIT_SKIPPED,
+	MSM_BUS_DBG_PATH_HIT,
+	MSM_BUS_DBG_PATH_MISS,
+	MSM_BUS_DBG_NR_STATS,
+};
+
 enum msm_bus_hw_sel {
 	MSM_BUS_RPM = 0,
 	MSM_BUS_NOC,
@@ -331,6 +342,7 @@ int msm_bus_dbg_add_client(const struct msm_bus_client_handle *pdata);
 int msm_bus_dbg_rec_transaction(const struct msm_bus_client_handle *pdata,
 						u64 ab, u64 ib);
 void msm_bus_dbg_remove_client(const struct msm_bus_client_handle *pdata);
+void msm_bus_dbg_inc_stat(enum msm_bus_dbg_stat stat);
 
 #else
 static inline void msm_bus_dbg_client_data(struct msm_bus_scale_pdata *pdata,
@@ -359,6 +371,10 @@ msm_bus_dbg_add_client(const struct msm_bus_client_handle *pdata)
 {
 	return 0;
 }
+
+static inline void msm_bus_dbg_inc_stat(enum msm_bus_dbg_stat stat)
+{
+}
 #endif
 
 #ifdef CONFIG_CORESIGHT
@@ -65,6 +65,7 @@ struct msm_bus_fab_list {
 };
 
 static char *rules_buf;
+static atomic_t vote_stats[MSM_BUS_DBG_NR_STATS];
 
 LIST_HEAD(fabdata_list);
 LIST_HEAD(cl_list);
@@ -673,6 +674,54 @@ static const struct file_operations rules_dbg_fops = {
 	.read		= rules_dbg_read,
 };
 
+/**
+ * The following funtions are used for counting client votes and how
+ * many of them needed a commit to the hardware
+ */
+void msm_bus_dbg_inc_stat(enum msm_bus_dbg_stat stat)
+{
+	if (stat < MSM_BUS_DBG_NR_STATS)
+		atomic_inc(&vote_stats[stat]);
+}
+EXPORT_SYMBOL(msm_bus_dbg_inc_stat);
+
+static ssize_t vote_stats_read(struct file *file, char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	char msg[256];
+	int cnt;
+
+	cnt = scnprintf(msg, sizeof(msg),
+		"votes: %d\nunchanged: %d\ncommits: %d\ncommits_skipped: %d\n"
+		"path_cache_hits: %d\npath_cache_misses: %d\n",
+		atomic_read(&vote_stats[MSM_BUS_DBG_VOTE]),
+		atomic_read(&vote_stats[MSM_BUS_DBG_VOTE_UNCHANGED]),
+		atomic_read(&vote_stats[MSM_BUS_DBG_COMMIT]),
+		atomic_read(&vote_stats[MSM_BUS_DBG_COMMIT_SKIPPED]),
+		atomic_read(&vote_stats[MSM_BUS_DBG_PATH_HIT]),
+		atomic_read(&vote_stats[MSM_BUS_DBG_PATH_MISS]));
+
+	return simple_read_from_buffer(buf, count, ppos, msg, cnt);
+}
+
+/* Any write clears the counters */
+static ssize_t vote_stats_write(struct file *file, const char __user *ubuf,
+	size_t cnt, loff_t *ppos)
+{
+	int i;
+
+	for (i = 0; i < MSM_BUS_DBG_NR_STATS; i++)
+		atomic_set(&vote_stats[i], 0);
+
+	return cnt;
+}
+
+static const struct file_operations vote_stats_fops = {
+	.open		= rules_dbg_open,
+	.read		= vote_stats_read,
+	.write		= vote_stats_write,
+};
+
 static int msm_bus_dbg_record_fabric(const char *fabname, struct dentry *file)
 {
 	struct msm_bus_fab_list *fablist;
@@ -898,6 +947,10 @@ static int __init msm_bus_debugfs_init(void)
 		rules_dbg, &val, &rules_dbg_fops) == NULL)
 		goto err;
 
+	if (debugfs_create_file("vote_stats", S_IRUGO | S_IWUSR,
+		dir, NULL, &vote_stats_fops) == NULL)
+		goto err;
+
 	if (debugfs_create_file("update_request", S_IRUGO | S_IWUSR,
 		shell_client, &val, &shell_client_en_fops) == NULL)
 		goto err;
@@ -45,6 +45,7 @@ struct level_stats {
 	int64_t max_time[CONFIG_MSM_IDLE_STATS_BUCKET_COUNT];
 	int success_count;
 	int failed_count;
+	int res_count[LPM_STATS_RES_TOO_LONG + 1];
 	int64_t total_time;
 	uint64_t enter_time;
 };
@@ -124,6 +125,19 @@ static void level_stats_print(struct seq_file *m, struct level_stats *stats)
 		seq_puts(m, seqs);
 	}
 
+	if (stats->res_count[LPM_STATS_RES_HIT] ||
+			stats->res_count[LPM_STATS_RES_TOO_SHORT] ||
+			stats->res_count[LPM_STATS_RES_TOO_LONG]) {
+		snprintf(seqs, MAX_STR_LEN,
+			"  residency hit: %7d\n"
+			"  too short: %7d\n"
+			"  too long: %7d\n",
+			stats->res_count[LPM_STATS_RES_HIT],
+			stats->res_count[LPM_STATS_RES_TOO_SHORT],
+			stats->res_count[LPM_STATS_RES_TOO_LONG]);
+		seq_puts(m, seqs);
+	}
+
 	bucket_time = stats->first_bucket_time;
 	for (i = 0;
 		i < CONFIG_MSM_IDLE_STATS_BUCKET_COUNT - 1;
@@ -190,6 +204,7 @@ static void level_stats_reset(struct level_stats *stats)
 	memset(stats->max_time, 0, sizeof(stats->max_time));
 	stats->success_count = 0;
 	stats->failed_count = 0;
+	memset(stats->res_count, 0, sizeof(stats->res_count));
 	stats->total_time = 0;
 }
 
@@ -843,6 +858,45 @@ void lpm_stats_cpu_exit(uint32_t index, uint64_t time, bool success)
 }
 EXPORT_SYMBOL(lpm_stats_cpu_exit);
 
+/**
+ * lpm_stats_cpu_residency() - API to communicate how long the cpu stayed
+ * in a level compared to the level's residency range.
+ *
+ * @index:	cpu's lpm level index.
+ * @res:	Whether the time was in range, too short or too long.
+ *
+ * Too short means a shallower level would have used less energy, too long
+ * means a deeper one would have.
+ */
+void lpm_stats_cpu_residency(uint32_t index, enum lpm_stats_residency res)
+{
+	struct lpm_stats *stats = &__get_cpu_var(cpu_stats);
+
+	if (!stats->time_stats || index >= stats->num_levels)
+		return;
+
+	stats->time_stats[index].res_count[res]++;
+}
+EXPORT_SYMBOL(lpm_stats_cpu_residency);
+
+/**
+ * lpm_stats_cluster_residency() - API to communicate how long a cluster
+ * stayed in a level compared to the level's residency range.
+ *
+ * @stats:	Pointer to the cluster's lpm_stats object.
+ * @index:	Index of the cluster lpm level.
+ * @res:	Whether the time was in range, too short or too long.
+ */
+void lpm_stats_cluster_residency(struct lpm_stats *stats, uint32_t index,
+				enum lpm_stats_residency res)
+{
+	if (IS_ERR_OR_NULL(stats) || index >= stats->num_levels)
+		return;
+
+	stats->time_stats[index].res_count[res]++;
+}
+EXPORT_SYMBOL(lpm_stats_cluster_residency);
+
 /**
  * lpm_stats_suspend_enter() - API to communicate system entering suspend.
  *
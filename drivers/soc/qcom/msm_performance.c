@@ -25,11 +25,53 @@
 #include <linux/module.h>
 #include <linux/input.h>
 #include <linux/kthread.h>
+#include <soc/qcom/msm_performance.h>
 
 static unsigned int use_input_evts_with_hi_slvt_detect;
 static struct mutex managed_cpus_lock;
 
 
+/*
+ * Workload classifier. Each load window reported by the governor is
+ * reduced to one sample per cluster, and every signal in the sample goes
+ * through a first order low pass filter whose time constant is the enter
+ * or the exit time, depending on the direction the signal moves in. A
+ * mode is entered once its filtered signal reaches the enter load and
+ * left once it drops below the exit load. Hysteresis is thus set by the
+ * load thresholds and time constants instead of a count of windows, and
+ * windows of irregular length weigh in by how long they lasted.
+ */
+enum wl_signal {
+	WL_SINGLE,	/* highest CPU load */
+	WL_MULTI,	/* average CPU load, with more than one CPU reporting */
+	WL_IO,		/* highest iowait percentage */
+	WL_PEAK,	/* highest CPU load while at a high frequency */
+	WL_NR_SIGNALS,
+};
+
+/* filtered signals are in percent << WL_SHIFT */
+#define WL_SHIFT	10
+/* longest window a single sample may account for */
+#define WL_MAX_DT_US	(10 * USEC_PER_SEC)
+/* exit time constants without windows before the modes are decayed */
+#define WL_IDLE_TAUS	3
+
+struct wl_sample {
+	u64 dt_us;
+	unsigned int max_load;
+	unsigned int avg_load;
+	unsigned int nr_cpus;
+	unsigned int max_iowait;
+	bool hi_freq;
+	bool input;
+};
+
+struct wl_state {
+	unsigned int avg[WL_NR_SIGNALS];
+	unsigned int mode;
+	unsigned int io_busy;
+};
+
 /* Maximum number to clusters that this module will manage*/
 static unsigned int num_clusters;
 struct cluster {
@@ -38,30 +80,11 @@ struct cluster {
 	int max_cpu_request;
 	/* To track CPUs that the module decides to offline */
 	cpumask_var_t offlined_cpus;
-	/* stats for load detection */
-	/* IO */
-	u64 last_io_check_ts;
-	unsigned int iowait_enter_cycle_cnt;
-	unsigned int iowait_exit_cycle_cnt;
-	spinlock_t iowait_lock;
-	unsigned int cur_io_busy;
-	bool io_change;
-	/* CPU */
-	unsigned int mode;
+	/* workload classifier state, IO, CPU and perf cluster peak */
+	struct wl_state wl;
 	bool mode_change;
 	u64 last_mode_check_ts;
-	unsigned int single_enter_cycle_cnt;
-	unsigned int single_exit_cycle_cnt;
-	unsigned int multi_enter_cycle_cnt;
-	unsigned int multi_exit_cycle_cnt;
 	spinlock_t mode_lock;
-	/* Perf Cluster Peak Loads */
-	unsigned int perf_cl_peak;
-	u64 last_perf_cl_check_ts;
-	bool perf_cl_detect_state_change;
-	unsigned int perf_cl_peak_enter_cycle_cnt;
-	unsigned int perf_cl_peak_exit_cycle_cnt;
-	spinlock_t perf_cl_peak_lock;
 	/* Tunables */
 	unsigned int single_enter_load;
 	unsigned int pcpu_multi_enter_load;
@@ -69,17 +92,10 @@ struct cluster {
 	unsigned int single_exit_load;
 	unsigned int pcpu_multi_exit_load;
 	unsigned int perf_cl_peak_exit_load;
-	unsigned int single_enter_cycles;
-	unsigned int single_exit_cycles;
-	unsigned int multi_enter_cycles;
-	unsigned int multi_exit_cycles;
-	unsigned int perf_cl_peak_enter_cycles;
-	unsigned int perf_cl_peak_exit_cycles;
 	unsigned int current_freq;
-	spinlock_t timer_lock;
 	unsigned int timer_rate;
+	/* decays the modes when no load windows are reported */
 	struct timer_list mode_exit_timer;
-	struct timer_list perf_cl_peak_mode_exit_timer;
 };
 
 struct input_events {
@@ -149,11 +165,17 @@ static unsigned int workload_detect;
 
 
 /* IOwait related tunables */
-static unsigned int io_enter_cycles = 4;
-static unsigned int io_exit_cycles = 4;
 static u64 iowait_ceiling_pct = 25;
 static u64 iowait_floor_pct = 8;
-#define LAST_IO_CHECK_TOL	(3 * USEC_PER_MSEC)
+
+/* Classifier time constants, in ms */
+static unsigned int mode_enter_ms = 30;
+static unsigned int mode_exit_ms = 50;
+static unsigned int perf_cl_peak_enter_ms = 800;
+static unsigned int perf_cl_peak_exit_ms = 200;
+static struct wl_state *replay_state;
+
+static BLOCKING_NOTIFIER_HEAD(mode_notifier_head);
 
 static unsigned int aggr_iobusy;
 static unsigned int aggr_mode;
@@ -164,22 +186,16 @@ static struct input_handler *handler;
 
 /* CPU workload detection related */
 #define NO_MODE		(0)
-#define SINGLE		(1)
-#define MULTI		(2)
-#define MIXED		(3)
-#define PERF_CL_PEAK		(4)
+#define SINGLE		MSM_PERF_MODE_SINGLE
+#define MULTI		MSM_PERF_MODE_MULTI
+#define MIXED		(SINGLE | MULTI)
+#define PERF_CL_PEAK	MSM_PERF_MODE_PERF_CL_PEAK
 #define DEF_SINGLE_ENT		90
 #define DEF_PCPU_MULTI_ENT	85
 #define DEF_PERF_CL_PEAK_ENT	80
 #define DEF_SINGLE_EX		60
 #define DEF_PCPU_MULTI_EX	50
 #define DEF_PERF_CL_PEAK_EX		70
-#define DEF_SINGLE_ENTER_CYCLE	4
-#define DEF_SINGLE_EXIT_CYCLE	4
-#define DEF_MULTI_ENTER_CYCLE	4
-#define DEF_MULTI_EXIT_CYCLE	4
-#define DEF_PERF_CL_PEAK_ENTER_CYCLE	100
-#define DEF_PERF_CL_PEAK_EXIT_CYCLE	20
 #define LAST_LD_CHECK_TOL	(2 * USEC_PER_MSEC)
 #define CLUSTER_0_THRESHOLD_FREQ	147000
 #define CLUSTER_1_THRESHOLD_FREQ	190000
@@ -965,311 +981,355 @@ static const struct kernel_param_ops param_ops_perf_cl_peak_exit_load = {
 device_param_cb(perf_cl_peak_exit_load, &param_ops_perf_cl_peak_exit_load,
 		 NULL, 0644);
 
-static int set_perf_cl_peak_enter_cycles(const char *buf,
-				const struct kernel_param *kp)
+static int set_time_const(const char *buf, const struct kernel_param *kp)
 {
-	unsigned int val, i, ntokens = 0;
-	const char *cp = buf;
-	unsigned int bytes_left;
-
-	if (!clusters_inited)
-		return -EINVAL;
-
-	while ((cp = strpbrk(cp + 1, ":")))
-		ntokens++;
+	unsigned int val;
 
-	if (ntokens != (num_clusters - 1))
+	if (sscanf(buf, "%u\n", &val) != 1 || !val)
 		return -EINVAL;
 
-	cp = buf;
-	for (i = 0; i < num_clusters; i++) {
-
-		if (sscanf(cp, "%u\n", &val) != 1)
-			return -EINVAL;
-
-		managed_clusters[i]->perf_cl_peak_enter_cycles = val;
-
-		bytes_left = PAGE_SIZE - (cp - buf);
-		cp = strnchr(cp, bytes_left, ':');
-		cp++;
-	}
+	*(unsigned int *)kp->arg = val;
 
 	return 0;
 }
 
-static int get_perf_cl_peak_enter_cycles(char *buf,
-				const struct kernel_param *kp)
-{
-	int i, cnt = 0;
-
-	if (!clusters_inited)
-		return cnt;
+static const struct kernel_param_ops param_ops_time_const = {
+	.set = set_time_const,
+	.get = param_get_uint,
+};
+device_param_cb(mode_enter_ms, &param_ops_time_const, &mode_enter_ms, 0644);
+device_param_cb(mode_exit_ms, &param_ops_time_const, &mode_exit_ms, 0644);
+device_param_cb(perf_cl_peak_enter_ms, &param_ops_time_const,
+		&perf_cl_peak_enter_ms, 0644);
+device_param_cb(perf_cl_peak_exit_ms, &param_ops_time_const,
+		&perf_cl_peak_exit_ms, 0644);
 
-	for (i = 0; i < num_clusters; i++)
-		cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, "%u:",
-				managed_clusters[i]->perf_cl_peak_enter_cycles);
-	cnt--;
-	cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, " ");
-	return cnt;
-}
+/*
+ * Deprecated: the enter/exit counts of governor windows the classifier
+ * used to take. They set the time constant they correspond to, taking
+ * each window as WL_CYCLE_MS. Per cluster counts are given as a ':'
+ * separated list, of which the largest is used, as the time constants
+ * are shared by all clusters.
+ */
+#define WL_CYCLE_MS	10
 
-static const struct kernel_param_ops param_ops_perf_cl_peak_enter_cycles = {
-	.set = set_perf_cl_peak_enter_cycles,
-	.get = get_perf_cl_peak_enter_cycles,
+struct cycles_alias {
+	unsigned int *ms;
+	bool per_cluster;
 };
-device_param_cb(perf_cl_peak_enter_cycles, &param_ops_perf_cl_peak_enter_cycles,
-		NULL, 0644);
 
-
-static int set_perf_cl_peak_exit_cycles(const char *buf,
-				const struct kernel_param *kp)
+static int set_cycles_alias(const char *buf, const struct kernel_param *kp)
 {
-	unsigned int val, i, ntokens = 0;
+	const struct cycles_alias *alias = kp->arg;
+	unsigned int val, cycles = 0;
 	const char *cp = buf;
-	unsigned int bytes_left;
-
-	if (!clusters_inited)
-		return -EINVAL;
-
-	while ((cp = strpbrk(cp + 1, ":")))
-		ntokens++;
 
-	if (ntokens != (num_clusters - 1))
-		return -EINVAL;
-
-	cp = buf;
-	for (i = 0; i < num_clusters; i++) {
+	pr_warn_once("msm_perf: %s is deprecated, use the *_ms tunables\n",
+		     kp->name);
 
-		if (sscanf(cp, "%u\n", &val) != 1)
+	do {
+		if (sscanf(cp, "%u", &val) != 1)
 			return -EINVAL;
+		cycles = max(cycles, val);
+		cp = strchr(cp, ':');
+	} while (alias->per_cluster && cp && *++cp);
 
-		managed_clusters[i]->perf_cl_peak_exit_cycles = val;
+	if (!cycles || cycles > UINT_MAX / WL_CYCLE_MS)
+		return -EINVAL;
 
-		bytes_left = PAGE_SIZE - (cp - buf);
-		cp = strnchr(cp, bytes_left, ':');
-		cp++;
-	}
+	*alias->ms = cycles * WL_CYCLE_MS;
 
 	return 0;
 }
 
-static int get_perf_cl_peak_exit_cycles(char *buf,
-			const struct kernel_param *kp)
+static int get_cycles_alias(char *buf, const struct kernel_param *kp)
 {
+	const struct cycles_alias *alias = kp->arg;
+	unsigned int val = DIV_ROUND_UP(*alias->ms, WL_CYCLE_MS);
 	int i, cnt = 0;
 
+	if (!alias->per_cluster)
+		return snprintf(buf, PAGE_SIZE, "%u", val);
+
 	if (!clusters_inited)
 		return cnt;
 
 	for (i = 0; i < num_clusters; i++)
-		cnt += snprintf(buf + cnt, PAGE_SIZE - cnt,
-			"%u:", managed_clusters[i]->perf_cl_peak_exit_cycles);
+		cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, "%u:", val);
 	cnt--;
 	cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, " ");
 	return cnt;
 }
 
-static const struct kernel_param_ops param_ops_perf_cl_peak_exit_cycles = {
-	.set = set_perf_cl_peak_exit_cycles,
-	.get = get_perf_cl_peak_exit_cycles,
+static const struct kernel_param_ops param_ops_cycles_alias = {
+	.set = set_cycles_alias,
+	.get = get_cycles_alias,
 };
-device_param_cb(perf_cl_peak_exit_cycles, &param_ops_perf_cl_peak_exit_cycles,
-		 NULL, 0644);
 
+#define cycles_alias_param(_name, _ms, _per_cluster)			\
+static struct cycles_alias _name##_alias = {				\
+	.ms = &_ms,							\
+	.per_cluster = _per_cluster,					\
+};									\
+device_param_cb(_name, &param_ops_cycles_alias, &_name##_alias, 0644)
+
+cycles_alias_param(single_enter_cycles, mode_enter_ms, true);
+cycles_alias_param(single_exit_cycles, mode_exit_ms, true);
+cycles_alias_param(multi_enter_cycles, mode_enter_ms, true);
+cycles_alias_param(multi_exit_cycles, mode_exit_ms, true);
+cycles_alias_param(perf_cl_peak_enter_cycles, perf_cl_peak_enter_ms, true);
+cycles_alias_param(perf_cl_peak_exit_cycles, perf_cl_peak_exit_ms, true);
+cycles_alias_param(io_enter_cycles, mode_enter_ms, false);
+cycles_alias_param(io_exit_cycles, mode_exit_ms, false);
 
-static int set_single_enter_cycles(const char *buf,
-				const struct kernel_param *kp)
+static int set_iowait_floor_pct(const char *buf, const struct kernel_param *kp)
 {
-	unsigned int val, i, ntokens = 0;
-	const char *cp = buf;
-	unsigned int bytes_left;
+	u64 val;
 
-	if (!clusters_inited)
+	if (sscanf(buf, "%llu\n", &val) != 1)
 		return -EINVAL;
-
-	while ((cp = strpbrk(cp + 1, ":")))
-		ntokens++;
-
-	if (ntokens != (num_clusters - 1))
+	if (val > iowait_ceiling_pct)
 		return -EINVAL;
 
-	cp = buf;
-	for (i = 0; i < num_clusters; i++) {
-
-		if (sscanf(cp, "%u\n", &val) != 1)
-			return -EINVAL;
-
-		managed_clusters[i]->single_enter_cycles = val;
-
-		bytes_left = PAGE_SIZE - (cp - buf);
-		cp = strnchr(cp, bytes_left, ':');
-		cp++;
-	}
+	iowait_floor_pct = val;
 
 	return 0;
 }
 
-static int get_single_enter_cycles(char *buf, const struct kernel_param *kp)
+static int get_iowait_floor_pct(char *buf, const struct kernel_param *kp)
 {
-	int i, cnt = 0;
-
-	if (!clusters_inited)
-		return cnt;
-
-	for (i = 0; i < num_clusters; i++)
-		cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, "%u:",
-				managed_clusters[i]->single_enter_cycles);
-	cnt--;
-	cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, " ");
-	return cnt;
+	return snprintf(buf, PAGE_SIZE, "%llu", iowait_floor_pct);
 }
 
-static const struct kernel_param_ops param_ops_single_enter_cycles = {
-	.set = set_single_enter_cycles,
-	.get = get_single_enter_cycles,
+static const struct kernel_param_ops param_ops_iowait_floor_pct = {
+	.set = set_iowait_floor_pct,
+	.get = get_iowait_floor_pct,
 };
-device_param_cb(single_enter_cycles, &param_ops_single_enter_cycles,
-		NULL, 0644);
-
+device_param_cb(iowait_floor_pct, &param_ops_iowait_floor_pct, NULL, 0644);
 
-static int set_single_exit_cycles(const char *buf,
-				const struct kernel_param *kp)
+static int set_iowait_ceiling_pct(const char *buf,
+						const struct kernel_param *kp)
 {
-	unsigned int val, i, ntokens = 0;
-	const char *cp = buf;
-	unsigned int bytes_left;
+	u64 val;
 
-	if (!clusters_inited)
+	if (sscanf(buf, "%llu\n", &val) != 1)
+		return -EINVAL;
+	if (val < iowait_floor_pct)
 		return -EINVAL;
 
-	while ((cp = strpbrk(cp + 1, ":")))
-		ntokens++;
+	iowait_ceiling_pct = val;
 
-	if (ntokens != (num_clusters - 1))
-		return -EINVAL;
+	return 0;
+}
 
-	cp = buf;
-	for (i = 0; i < num_clusters; i++) {
+static int get_iowait_ceiling_pct(char *buf, const struct kernel_param *kp)
+{
+	return snprintf(buf, PAGE_SIZE, "%llu", iowait_ceiling_pct);
+}
 
-		if (sscanf(cp, "%u\n", &val) != 1)
-			return -EINVAL;
+static const struct kernel_param_ops param_ops_iowait_ceiling_pct = {
+	.set = set_iowait_ceiling_pct,
+	.get = get_iowait_ceiling_pct,
+};
+device_param_cb(iowait_ceiling_pct, &param_ops_iowait_ceiling_pct, NULL, 0644);
+
+/* Drop the state of signals whose detection is disabled */
+static void wl_clear(struct wl_state *st, unsigned int detect)
+{
+	if (!(detect & IO_DETECT)) {
+		st->avg[WL_IO] = 0;
+		st->io_busy = 0;
+	}
+	if (!(detect & MODE_DETECT)) {
+		st->avg[WL_SINGLE] = 0;
+		st->avg[WL_MULTI] = 0;
+		st->mode &= ~(SINGLE | MULTI);
+	}
+	if (!(detect & PERF_CL_PEAK_DETECT)) {
+		st->avg[WL_PEAK] = 0;
+		st->mode &= ~PERF_CL_PEAK;
+	}
+}
 
-		managed_clusters[i]->single_exit_cycles = val;
+/* One step of a first order low pass filter towards @val over @dt_us */
+static unsigned int wl_filter(unsigned int avg, unsigned int val, u64 dt_us,
+			      unsigned int rise_ms, unsigned int fall_ms)
+{
+	unsigned int target = val << WL_SHIFT;
+	u64 tau;
 
-		bytes_left = PAGE_SIZE - (cp - buf);
-		cp = strnchr(cp, bytes_left, ':');
-		cp++;
+	if (target > avg) {
+		tau = (u64)rise_ms * USEC_PER_MSEC;
+		return avg + div64_u64((u64)(target - avg) * dt_us,
+				       tau + dt_us);
 	}
 
-	return 0;
+	tau = (u64)fall_ms * USEC_PER_MSEC;
+	return avg - div64_u64((u64)(avg - target) * dt_us, tau + dt_us);
 }
 
-static int get_single_exit_cycles(char *buf, const struct kernel_param *kp)
+static bool wl_level(bool on, unsigned int avg, unsigned int enter,
+		     unsigned int exit)
 {
-	int i, cnt = 0;
+	return avg >= ((on ? exit : enter) << WL_SHIFT);
+}
 
-	if (!clusters_inited)
-		return cnt;
+/*
+ * Feed one sample through the classifier. This only depends on its
+ * arguments, so that recorded samples replay to the same modes.
+ */
+static void wl_classify(const struct cluster *cl, struct wl_state *st,
+			const struct wl_sample *s, unsigned int detect)
+{
+	unsigned int val[WL_NR_SIGNALS];
+	u64 dt = min_t(u64, s->dt_us, WL_MAX_DT_US);
+	bool on;
+	int i;
 
-	for (i = 0; i < num_clusters; i++)
-		cnt += snprintf(buf + cnt, PAGE_SIZE - cnt,
-				"%u:", managed_clusters[i]->single_exit_cycles);
-	cnt--;
-	cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, " ");
-	return cnt;
-}
+	val[WL_SINGLE] = s->max_load;
+	val[WL_MULTI] = s->nr_cpus > 1 ? s->avg_load : 0;
+	val[WL_IO] = s->max_iowait;
+	/* Only the SLVT is watched for peak loads */
+	val[WL_PEAK] = (s->hi_freq && cpumask_first(cl->cpus)) ?
+			s->max_load : 0;
+
+	for (i = 0; i < WL_NR_SIGNALS; i++) {
+		if (i == WL_PEAK)
+			st->avg[i] = wl_filter(st->avg[i], val[i], dt,
+					perf_cl_peak_enter_ms,
+					perf_cl_peak_exit_ms);
+		else
+			st->avg[i] = wl_filter(st->avg[i], val[i], dt,
+					mode_enter_ms, mode_exit_ms);
+	}
+
+	if (wl_level(st->mode & SINGLE, st->avg[WL_SINGLE],
+		     cl->single_enter_load, cl->single_exit_load))
+		st->mode |= SINGLE;
+	else
+		st->mode &= ~SINGLE;
 
-static const struct kernel_param_ops param_ops_single_exit_cycles = {
-	.set = set_single_exit_cycles,
-	.get = get_single_exit_cycles,
-};
-device_param_cb(single_exit_cycles, &param_ops_single_exit_cycles, NULL, 0644);
+	if (wl_level(st->mode & MULTI, st->avg[WL_MULTI],
+		     cl->pcpu_multi_enter_load, cl->pcpu_multi_exit_load))
+		st->mode |= MULTI;
+	else
+		st->mode &= ~MULTI;
 
-static int set_multi_enter_cycles(const char *buf,
-				const struct kernel_param *kp)
+	st->io_busy = wl_level(st->io_busy, st->avg[WL_IO],
+			       iowait_ceiling_pct + 1, iowait_floor_pct);
+
+	/* entering peak mode also takes enough touch input, if enabled */
+	on = st->mode & PERF_CL_PEAK;
+	if (wl_level(on, st->avg[WL_PEAK], cl->perf_cl_peak_enter_load,
+		     cl->perf_cl_peak_exit_load) && (on || s->input))
+		st->mode |= PERF_CL_PEAK;
+	else
+		st->mode &= ~PERF_CL_PEAK;
+
+	wl_clear(st, detect);
+}
+
+static int set_workload_detect(const char *buf, const struct kernel_param *kp)
 {
-	unsigned int val, i, ntokens = 0;
-	const char *cp = buf;
-	unsigned int bytes_left;
+	unsigned int val, i;
+	struct cluster *i_cl;
+	unsigned long flags;
 
 	if (!clusters_inited)
 		return -EINVAL;
 
-	while ((cp = strpbrk(cp + 1, ":")))
-		ntokens++;
-
-	if (ntokens != (num_clusters - 1))
+	if (sscanf(buf, "%u\n", &val) != 1)
 		return -EINVAL;
 
-	cp = buf;
-	for (i = 0; i < num_clusters; i++) {
-
-		if (sscanf(cp, "%u\n", &val) != 1)
-			return -EINVAL;
-
-		managed_clusters[i]->multi_enter_cycles = val;
+	if (val == workload_detect)
+		return 0;
 
-		bytes_left = PAGE_SIZE - (cp - buf);
-		cp = strnchr(cp, bytes_left, ':');
-		cp++;
+	workload_detect = val;
+	for (i = 0; i < num_clusters; i++) {
+		i_cl = managed_clusters[i];
+		spin_lock_irqsave(&i_cl->mode_lock, flags);
+		wl_clear(&i_cl->wl, workload_detect);
+		i_cl->mode_change = true;
+		spin_unlock_irqrestore(&i_cl->mode_lock, flags);
 	}
 
+	wake_up_process(notify_thread);
 	return 0;
 }
 
-static int get_multi_enter_cycles(char *buf, const struct kernel_param *kp)
+static int get_workload_detect(char *buf, const struct kernel_param *kp)
 {
-	int i, cnt = 0;
-
-	if (!clusters_inited)
-		return cnt;
-
-	for (i = 0; i < num_clusters; i++)
-		cnt += snprintf(buf + cnt, PAGE_SIZE - cnt,
-				"%u:", managed_clusters[i]->multi_enter_cycles);
-	cnt--;
-	cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, " ");
-	return cnt;
+	return snprintf(buf, PAGE_SIZE, "%u", workload_detect);
 }
 
-static const struct kernel_param_ops param_ops_multi_enter_cycles = {
-	.set = set_multi_enter_cycles,
-	.get = get_multi_enter_cycles,
+static const struct kernel_param_ops param_ops_workload_detect = {
+	.set = set_workload_detect,
+	.get = get_workload_detect,
 };
-device_param_cb(multi_enter_cycles, &param_ops_multi_enter_cycles, NULL, 0644);
+device_param_cb(workload_detect, &param_ops_workload_detect, NULL, 0644);
 
-static int set_multi_exit_cycles(const char *buf, const struct kernel_param *kp)
+/*
+ * Test mode: samples written here are run through a separate copy of the
+ * classifier with the cluster's tunables. A sample is a cpu_mode_detect
+ * trace line, "... cpu=<cpu> dt_us=<dt_us> max_load=<max_load>
+ * avg_load=<avg_load> nr_cpus=<nr_cpus> iowait=<iowait> hi_freq=<hi_freq>
+ * input=<input> ...", with any prefix before "cpu=" and the recorded mode
+ * ignored, so a recorded trace can be written back unchanged. The same
+ * values may also be given positionally as "<cluster> <dt_us> <max_load>
+ * <avg_load> <nr_cpus> <iowait> <hi_freq> <input>". Reading returns
+ * "<mode>:<io_busy>" for every cluster. "reset" clears the state.
+ */
+static int set_wl_replay(const char *buf, const struct kernel_param *kp)
 {
-	unsigned int val, i, ntokens = 0;
-	const char *cp = buf;
-	unsigned int bytes_left;
+	struct wl_sample s;
+	unsigned int cl, cpu, hi_freq, input;
+	unsigned long long dt_us;
+	const char *tp;
 
 	if (!clusters_inited)
 		return -EINVAL;
 
-	while ((cp = strpbrk(cp + 1, ":")))
-		ntokens++;
+	if (!strncmp(buf, "reset", 5)) {
+		memset(replay_state, 0, num_clusters * sizeof(*replay_state));
+		return 0;
+	}
 
-	if (ntokens != (num_clusters - 1))
-		return -EINVAL;
+	tp = strstr(buf, "cpu=");
+	if (tp) {
+		if (sscanf(tp, "cpu=%u dt_us=%llu max_load=%u avg_load=%u "
+			   "nr_cpus=%u iowait=%u hi_freq=%u input=%u", &cpu,
+			   &dt_us, &s.max_load, &s.avg_load, &s.nr_cpus,
+			   &s.max_iowait, &hi_freq, &input) != 8 ||
+		    cpu >= nr_cpu_ids)
+			return -EINVAL;
 
-	cp = buf;
-	for (i = 0; i < num_clusters; i++) {
+		for (cl = 0; cl < num_clusters; cl++)
+			if (cpumask_test_cpu(cpu, managed_clusters[cl]->cpus))
+				break;
+	} else if (sscanf(buf, "%u %llu %u %u %u %u %u %u", &cl, &dt_us,
+			  &s.max_load, &s.avg_load, &s.nr_cpus,
+			  &s.max_iowait, &hi_freq, &input) != 8) {
+		return -EINVAL;
+	}
 
-		if (sscanf(cp, "%u\n", &val) != 1)
-			return -EINVAL;
+	if (cl >= num_clusters)
+		return -EINVAL;
 
-		managed_clusters[i]->multi_exit_cycles = val;
+	/* the filters take percentages, shifted up by WL_SHIFT */
+	if (s.max_load > 100 || s.avg_load > 100 || s.max_iowait > 100 ||
+	    s.nr_cpus > NR_CPUS)
+		return -EINVAL;
 
-		bytes_left = PAGE_SIZE - (cp - buf);
-		cp = strnchr(cp, bytes_left, ':');
-		cp++;
-	}
+	s.dt_us = dt_us;
+	s.hi_freq = hi_freq;
+	s.input = input;
+	wl_classify(managed_clusters[cl], &replay_state[cl], &s,
+		    IO_DETECT | MODE_DETECT | PERF_CL_PEAK_DETECT);
 
 	return 0;
 }
 
-static int get_multi_exit_cycles(char *buf, const struct kernel_param *kp)
+static int get_wl_replay(char *buf, const struct kernel_param *kp)
 {
 	int i, cnt = 0;
 
@@ -1277,182 +1337,18 @@ static int get_multi_exit_cycles(char *buf, const struct kernel_param *kp)
 		return cnt;
 
 	for (i = 0; i < num_clusters; i++)
-		cnt += snprintf(buf + cnt, PAGE_SIZE - cnt,
-				"%u:", managed_clusters[i]->multi_exit_cycles);
+		cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, "%u:%u ",
+				replay_state[i].mode, replay_state[i].io_busy);
 	cnt--;
-	cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, " ");
+	cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, "\n");
 	return cnt;
 }
 
-static const struct kernel_param_ops param_ops_multi_exit_cycles = {
-	.set = set_multi_exit_cycles,
-	.get = get_multi_exit_cycles,
+static const struct kernel_param_ops param_ops_wl_replay = {
+	.set = set_wl_replay,
+	.get = get_wl_replay,
 };
-device_param_cb(multi_exit_cycles, &param_ops_multi_exit_cycles, NULL, 0644);
-
-static int set_io_enter_cycles(const char *buf, const struct kernel_param *kp)
-{
-	unsigned int val;
-
-	if (sscanf(buf, "%u\n", &val) != 1)
-		return -EINVAL;
-
-	io_enter_cycles = val;
-
-	return 0;
-}
-
-static int get_io_enter_cycles(char *buf, const struct kernel_param *kp)
-{
-	return snprintf(buf, PAGE_SIZE, "%u", io_enter_cycles);
-}
-
-static const struct kernel_param_ops param_ops_io_enter_cycles = {
-	.set = set_io_enter_cycles,
-	.get = get_io_enter_cycles,
-};
-device_param_cb(io_enter_cycles, &param_ops_io_enter_cycles, NULL, 0644);
-
-static int set_io_exit_cycles(const char *buf, const struct kernel_param *kp)
-{
-	unsigned int val;
-
-	if (sscanf(buf, "%u\n", &val) != 1)
-		return -EINVAL;
-
-	io_exit_cycles = val;
-
-	return 0;
-}
-
-static int get_io_exit_cycles(char *buf, const struct kernel_param *kp)
-{
-	return snprintf(buf, PAGE_SIZE, "%u", io_exit_cycles);
-}
-
-static const struct kernel_param_ops param_ops_io_exit_cycles = {
-	.set = set_io_exit_cycles,
-	.get = get_io_exit_cycles,
-};
-device_param_cb(io_exit_cycles, &param_ops_io_exit_cycles, NULL, 0644);
-
-static int set_iowait_floor_pct(const char *buf, const struct kernel_param *kp)
-{
-	u64 val;
-
-	if (sscanf(buf, "%llu\n", &val) != 1)
-		return -EINVAL;
-	if (val > iowait_ceiling_pct)
-		return -EINVAL;
-
-	iowait_floor_pct = val;
-
-	return 0;
-}
-
-static int get_iowait_floor_pct(char *buf, const struct kernel_param *kp)
-{
-	return snprintf(buf, PAGE_SIZE, "%llu", iowait_floor_pct);
-}
-
-static const struct kernel_param_ops param_ops_iowait_floor_pct = {
-	.set = set_iowait_floor_pct,
-	.get = get_iowait_floor_pct,
-};
-device_param_cb(iowait_floor_pct, &param_ops_iowait_floor_pct, NULL, 0644);
-
-static int set_iowait_ceiling_pct(const char *buf,
-						const struct kernel_param *kp)
-{
-	u64 val;
-
-	if (sscanf(buf, "%llu\n", &val) != 1)
-		return -EINVAL;
-	if (val < iowait_floor_pct)
-		return -EINVAL;
-
-	iowait_ceiling_pct = val;
-
-	return 0;
-}
-
-static int get_iowait_ceiling_pct(char *buf, const struct kernel_param *kp)
-{
-	return snprintf(buf, PAGE_SIZE, "%llu", iowait_ceiling_pct);
-}
-
-static const struct kernel_param_ops param_ops_iowait_ceiling_pct = {
-	.set = set_iowait_ceiling_pct,
-	.get = get_iowait_ceiling_pct,
-};
-device_param_cb(iowait_ceiling_pct, &param_ops_iowait_ceiling_pct, NULL, 0644);
-
-static int set_workload_detect(const char *buf, const struct kernel_param *kp)
-{
-	unsigned int val, i;
-	struct cluster *i_cl;
-	unsigned long flags;
-
-	if (!clusters_inited)
-		return -EINVAL;
-
-	if (sscanf(buf, "%u\n", &val) != 1)
-		return -EINVAL;
-
-	if (val == workload_detect)
-		return 0;
-
-	workload_detect = val;
-	if (!(workload_detect & IO_DETECT)) {
-		for (i = 0; i < num_clusters; i++) {
-			i_cl = managed_clusters[i];
-			spin_lock_irqsave(&i_cl->iowait_lock, flags);
-			i_cl->iowait_enter_cycle_cnt = 0;
-			i_cl->iowait_exit_cycle_cnt = 0;
-			i_cl->cur_io_busy = 0;
-			i_cl->io_change = true;
-			spin_unlock_irqrestore(&i_cl->iowait_lock, flags);
-		}
-	}
-	if (!(workload_detect & MODE_DETECT)) {
-		for (i = 0; i < num_clusters; i++) {
-			i_cl = managed_clusters[i];
-			spin_lock_irqsave(&i_cl->mode_lock, flags);
-			i_cl->single_enter_cycle_cnt = 0;
-			i_cl->single_exit_cycle_cnt = 0;
-			i_cl->multi_enter_cycle_cnt = 0;
-			i_cl->multi_exit_cycle_cnt = 0;
-			i_cl->mode = 0;
-			i_cl->mode_change = true;
-			spin_unlock_irqrestore(&i_cl->mode_lock, flags);
-		}
-	}
-
-	if (!(workload_detect & PERF_CL_PEAK_DETECT)) {
-		for (i = 0; i < num_clusters; i++) {
-			i_cl = managed_clusters[i];
-			spin_lock_irqsave(&i_cl->perf_cl_peak_lock, flags);
-			i_cl->perf_cl_peak_enter_cycle_cnt = 0;
-			i_cl->perf_cl_peak_exit_cycle_cnt = 0;
-			i_cl->perf_cl_peak = 0;
-			spin_unlock_irqrestore(&i_cl->perf_cl_peak_lock, flags);
-		}
-	}
-
-	wake_up_process(notify_thread);
-	return 0;
-}
-
-static int get_workload_detect(char *buf, const struct kernel_param *kp)
-{
-	return snprintf(buf, PAGE_SIZE, "%u", workload_detect);
-}
-
-static const struct kernel_param_ops param_ops_workload_detect = {
-	.set = set_workload_detect,
-	.get = get_workload_detect,
-};
-device_param_cb(workload_detect, &param_ops_workload_detect, NULL, 0644);
+device_param_cb(wl_replay, &param_ops_wl_replay, NULL, 0600);
 
 
 static int set_input_evts_with_hi_slvt_detect(const char *buf,
@@ -1592,34 +1488,34 @@ static bool check_notify_status(void)
 	bool any_change = false;
 	unsigned long flags;
 
-
 	for (i = 0; i < num_clusters; i++) {
 		cl = managed_clusters[i];
-		spin_lock_irqsave(&cl->iowait_lock, flags);
-		if (!any_change)
-			any_change = cl->io_change;
-		cl->io_change = false;
-		spin_unlock_irqrestore(&cl->iowait_lock, flags);
-
 		spin_lock_irqsave(&cl->mode_lock, flags);
-		if (!any_change)
-			any_change = cl->mode_change;
+		if (cl->mode_change)
+			any_change = true;
 		cl->mode_change = false;
 		spin_unlock_irqrestore(&cl->mode_lock, flags);
-
-		spin_lock_irqsave(&cl->perf_cl_peak_lock, flags);
-		if (!any_change)
-			any_change = cl->perf_cl_detect_state_change;
-		cl->perf_cl_detect_state_change = false;
-		spin_unlock_irqrestore(&cl->perf_cl_peak_lock, flags);
 	}
 
 	return any_change;
 }
 
+int msm_perf_register_mode_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&mode_notifier_head, nb);
+}
+EXPORT_SYMBOL(msm_perf_register_mode_notifier);
+
+int msm_perf_unregister_mode_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&mode_notifier_head, nb);
+}
+EXPORT_SYMBOL(msm_perf_unregister_mode_notifier);
+
 static int notify_userspace(void *data)
 {
-	unsigned int i, io, cpu_mode, perf_cl_peak_mode;
+	struct msm_perf_mode_change change;
+	unsigned int i, io, mode;
 
 	while (1) {
 		set_current_state(TASK_INTERRUPTIBLE);
@@ -1632,32 +1528,29 @@ static int notify_userspace(void *data)
 		set_current_state(TASK_RUNNING);
 
 		io = 0;
-		cpu_mode = 0;
-		perf_cl_peak_mode = 0;
+		mode = 0;
 		for (i = 0; i < num_clusters; i++) {
-			io |= managed_clusters[i]->cur_io_busy;
-			cpu_mode |= managed_clusters[i]->mode;
-			perf_cl_peak_mode |= managed_clusters[i]->perf_cl_peak;
+			io |= managed_clusters[i]->wl.io_busy;
+			mode |= managed_clusters[i]->wl.mode;
 		}
+		if (io == aggr_iobusy && mode == aggr_mode)
+			continue;
+
 		if (io != aggr_iobusy) {
 			aggr_iobusy = io;
 			sysfs_notify(mode_kobj, NULL, "aggr_iobusy");
-			pr_debug("msm_perf: Notifying IO: %u\n", aggr_iobusy);
 		}
-		if ((aggr_mode & (SINGLE | MULTI)) != cpu_mode) {
-			aggr_mode &= ~(SINGLE | MULTI);
-			aggr_mode |= cpu_mode;
+		if (mode != aggr_mode) {
+			aggr_mode = mode;
 			sysfs_notify(mode_kobj, NULL, "aggr_mode");
-			pr_debug("msm_perf: Notifying CPU mode:%u\n",
-								aggr_mode);
-		}
-		if ((aggr_mode & PERF_CL_PEAK) != perf_cl_peak_mode) {
-			aggr_mode &= ~(PERF_CL_PEAK);
-			aggr_mode |= perf_cl_peak_mode;
-			sysfs_notify(mode_kobj, NULL, "aggr_mode");
-			pr_debug("msm_perf: Notifying Gaming mode:%u\n",
-								aggr_mode);
 		}
+		pr_debug("msm_perf: Notifying mode:%u IO:%u\n", aggr_mode,
+								aggr_iobusy);
+
+		change.mode = aggr_mode;
+		change.iobusy = aggr_iobusy;
+		blocking_notifier_call_chain(&mode_notifier_head, aggr_mode,
+					     &change);
 	}
 
 	return 0;
@@ -1711,141 +1604,6 @@ static int events_notify_userspace(void *data)
 	return 0;
 }
 
-static void check_cluster_iowait(struct cluster *cl, u64 now)
-{
-	struct load_stats *pcpu_st;
-	unsigned int i;
-	unsigned long flags;
-	unsigned int temp_iobusy;
-	u64 max_iowait = 0;
-
-	spin_lock_irqsave(&cl->iowait_lock, flags);
-
-	if (((now - cl->last_io_check_ts)
-		< (cl->timer_rate - LAST_IO_CHECK_TOL)) ||
-		!(workload_detect & IO_DETECT)) {
-		spin_unlock_irqrestore(&cl->iowait_lock, flags);
-		return;
-	}
-
-	temp_iobusy = cl->cur_io_busy;
-	for_each_cpu(i, cl->cpus) {
-		pcpu_st = &per_cpu(cpu_load_stats, i);
-		if ((now - pcpu_st->last_wallclock)
-			> (cl->timer_rate + LAST_UPDATE_TOL))
-			continue;
-		if (max_iowait < pcpu_st->last_iopercent)
-			max_iowait = pcpu_st->last_iopercent;
-	}
-
-	if (!cl->cur_io_busy) {
-		if (max_iowait > iowait_ceiling_pct) {
-			cl->iowait_enter_cycle_cnt++;
-			if (cl->iowait_enter_cycle_cnt >= io_enter_cycles) {
-				cl->cur_io_busy = 1;
-				cl->iowait_enter_cycle_cnt = 0;
-			}
-		} else {
-			cl->iowait_enter_cycle_cnt = 0;
-		}
-	} else {
-		if (max_iowait < iowait_floor_pct) {
-			cl->iowait_exit_cycle_cnt++;
-			if (cl->iowait_exit_cycle_cnt >= io_exit_cycles) {
-				cl->cur_io_busy = 0;
-				cl->iowait_exit_cycle_cnt = 0;
-			}
-		} else {
-			cl->iowait_exit_cycle_cnt = 0;
-		}
-	}
-
-	cl->last_io_check_ts = now;
-	trace_track_iowait(cpumask_first(cl->cpus), cl->iowait_enter_cycle_cnt,
-			cl->iowait_exit_cycle_cnt, cl->cur_io_busy, max_iowait);
-
-	if (temp_iobusy != cl->cur_io_busy) {
-		cl->io_change = true;
-		pr_debug("msm_perf: IO changed to %u\n", cl->cur_io_busy);
-	}
-
-	spin_unlock_irqrestore(&cl->iowait_lock, flags);
-	if (cl->io_change)
-		wake_up_process(notify_thread);
-}
-
-static void disable_timer(struct cluster *cl)
-{
-	unsigned long flags;
-
-	spin_lock_irqsave(&cl->timer_lock, flags);
-
-	if (del_timer(&cl->mode_exit_timer)) {
-		trace_single_cycle_exit_timer_stop(cpumask_first(cl->cpus),
-			cl->single_enter_cycles, cl->single_enter_cycle_cnt,
-			cl->single_exit_cycles, cl->single_exit_cycle_cnt,
-			cl->multi_enter_cycles, cl->multi_enter_cycle_cnt,
-			cl->multi_exit_cycles, cl->multi_exit_cycle_cnt,
-			cl->timer_rate, cl->mode);
-	}
-
-	spin_unlock_irqrestore(&cl->timer_lock, flags);
-}
-
-static void start_timer(struct cluster *cl)
-{
-	unsigned long flags;
-
-	spin_lock_irqsave(&cl->timer_lock, flags);
-	if ((cl->mode & SINGLE) && !timer_pending(&cl->mode_exit_timer)) {
-		/*Set timer for the Cluster since there is none pending*/
-		cl->mode_exit_timer.expires = get_jiffies_64() +
-		usecs_to_jiffies(cl->single_exit_cycles * cl->timer_rate);
-		cl->mode_exit_timer.data = cpumask_first(cl->cpus);
-		add_timer(&cl->mode_exit_timer);
-		trace_single_cycle_exit_timer_start(cpumask_first(cl->cpus),
-			cl->single_enter_cycles, cl->single_enter_cycle_cnt,
-			cl->single_exit_cycles, cl->single_exit_cycle_cnt,
-			cl->multi_enter_cycles, cl->multi_enter_cycle_cnt,
-			cl->multi_exit_cycles, cl->multi_exit_cycle_cnt,
-			cl->timer_rate, cl->mode);
-	}
-	spin_unlock_irqrestore(&cl->timer_lock, flags);
-}
-
-
-static void disable_perf_cl_peak_timer(struct cluster *cl)
-{
-
-	if (del_timer(&cl->perf_cl_peak_mode_exit_timer)) {
-		trace_perf_cl_peak_exit_timer_stop(cpumask_first(cl->cpus),
-			cl->perf_cl_peak_enter_cycles,
-			cl->perf_cl_peak_enter_cycle_cnt,
-			cl->perf_cl_peak_exit_cycles,
-			cl->perf_cl_peak_exit_cycle_cnt,
-			cl->timer_rate, cl->mode);
-	}
-
-}
-
-static void start_perf_cl_peak_timer(struct cluster *cl)
-{
-	if ((cl->mode & PERF_CL_PEAK) &&
-		!timer_pending(&cl->perf_cl_peak_mode_exit_timer)) {
-		/*Set timer for the Cluster since there is none pending*/
-		cl->perf_cl_peak_mode_exit_timer.expires = get_jiffies_64() +
-		usecs_to_jiffies(cl->perf_cl_peak_exit_cycles * cl->timer_rate);
-		cl->perf_cl_peak_mode_exit_timer.data = cpumask_first(cl->cpus);
-		add_timer(&cl->perf_cl_peak_mode_exit_timer);
-		trace_perf_cl_peak_exit_timer_start(cpumask_first(cl->cpus),
-			cl->perf_cl_peak_enter_cycles,
-			cl->perf_cl_peak_enter_cycle_cnt,
-			cl->perf_cl_peak_exit_cycles,
-			cl->perf_cl_peak_exit_cycle_cnt,
-			cl->timer_rate, cl->mode);
-	}
-}
-
 static const struct input_device_id msm_perf_input_ids[] = {
 
 	{
@@ -1962,118 +1720,73 @@ static int register_input_handler(void)
 	return rc;
 }
 
-static void check_perf_cl_peak_load(struct cluster *cl, u64 now)
+static void update_mode_exit_timer(struct cluster *cl)
 {
-	struct load_stats *pcpu_st;
-	unsigned int i, ret_mode, max_load = 0;
-	unsigned int total_load = 0, cpu_cnt = 0;
-	unsigned long flags;
-	bool cpu_of_cluster_zero = true;
-
-	spin_lock_irqsave(&cl->perf_cl_peak_lock, flags);
+	unsigned int ms;
 
-	cpu_of_cluster_zero = cpumask_first(cl->cpus) ? false:true;
-	/*
-	 * If delta of last load to now < than timer_rate - ld check tolerance
-	 * which is 18ms OR if perf_cl_peak detection not set
-	 * OR the first CPU of Cluster is CPU 0 (LVT)
-	 * then return do nothing. We are interested only in SLVT
-	 */
-	if (((now - cl->last_perf_cl_check_ts)
-		< (cl->timer_rate - LAST_LD_CHECK_TOL)) ||
-		!(workload_detect & PERF_CL_PEAK_DETECT) ||
-		cpu_of_cluster_zero) {
-		spin_unlock_irqrestore(&cl->perf_cl_peak_lock, flags);
+	if (!cl->wl.mode && !cl->wl.io_busy)
 		return;
-	}
-	for_each_cpu(i, cl->cpus) {
-		pcpu_st = &per_cpu(cpu_load_stats, i);
-		if ((now - pcpu_st->last_wallclock)
-			> (cl->timer_rate + LAST_UPDATE_TOL))
-			continue;
-		if (pcpu_st->cpu_load > max_load)
-			max_load = pcpu_st->cpu_load;
-		 /*
-		  * Save the frequency for the cpu of the cluster
-		  * This frequency is the most recent/current
-		  * as obtained due to a transition
-		  * notifier callback.
-		  */
-		cl->current_freq = pcpu_st->freq;
-	}
-	ret_mode = cl->perf_cl_peak;
-
-	if (!(cl->perf_cl_peak & PERF_CL_PEAK)) {
-		if (max_load >= cl->perf_cl_peak_enter_load &&
-			freq_greater_than_threshold(cl,
-				cpumask_first(cl->cpus))) {
-			/* Reset the event count  for the first cycle
-			 * of perf_cl_peak we detect
-			 */
-			if (!cl->perf_cl_peak_enter_cycle_cnt)
-				ip_evts->evt_x_cnt = ip_evts->evt_y_cnt = 0;
-			cl->perf_cl_peak_enter_cycle_cnt++;
-			if (cl->perf_cl_peak_enter_cycle_cnt
-				>= cl->perf_cl_peak_enter_cycles) {
-				if (input_events_greater_than_threshold())
-					ret_mode |= PERF_CL_PEAK;
-				cl->perf_cl_peak_enter_cycle_cnt = 0;
-			}
-		} else {
-			cl->perf_cl_peak_enter_cycle_cnt = 0;
-			/* Reset the event count */
-			ip_evts->evt_x_cnt = ip_evts->evt_y_cnt = 0;
-		}
-	} else {
-		if (max_load >= cl->perf_cl_peak_exit_load &&
-			freq_greater_than_threshold(cl,
-				cpumask_first(cl->cpus))) {
-			cl->perf_cl_peak_exit_cycle_cnt = 0;
-			disable_perf_cl_peak_timer(cl);
-		} else {
-			start_perf_cl_peak_timer(cl);
-			cl->perf_cl_peak_exit_cycle_cnt++;
-			if (cl->perf_cl_peak_exit_cycle_cnt
-				>= cl->perf_cl_peak_exit_cycles) {
-				ret_mode &= ~PERF_CL_PEAK;
-				cl->perf_cl_peak_exit_cycle_cnt = 0;
-				disable_perf_cl_peak_timer(cl);
-			}
-		}
-	}
 
-	cl->last_perf_cl_check_ts = now;
-	if (ret_mode != cl->perf_cl_peak) {
-		pr_debug("msm_perf: Mode changed to %u\n", ret_mode);
-		cl->perf_cl_peak = ret_mode;
-		cl->perf_cl_detect_state_change = true;
-	}
+	ms = max(mode_exit_ms, perf_cl_peak_exit_ms) * WL_IDLE_TAUS;
+	mod_timer(&cl->mode_exit_timer, jiffies + msecs_to_jiffies(ms));
+}
+
+/*
+ * Classify a cluster once per load window. Called with the cluster's
+ * mode_lock held; returns true if its modes changed.
+ */
+static bool classify_cluster(struct cluster *cl, struct wl_sample *s, u64 now)
+{
+	unsigned int mode = cl->wl.mode, io_busy = cl->wl.io_busy;
 
-	trace_cpu_mode_detect(cpumask_first(cl->cpus), max_load,
-		cl->single_enter_cycle_cnt, cl->single_exit_cycle_cnt,
-		total_load, cl->multi_enter_cycle_cnt,
-		cl->multi_exit_cycle_cnt, cl->perf_cl_peak_enter_cycle_cnt,
-		cl->perf_cl_peak_exit_cycle_cnt, cl->mode, cpu_cnt);
+	s->dt_us = cl->last_mode_check_ts ? now - cl->last_mode_check_ts :
+					    cl->timer_rate;
+	wl_classify(cl, &cl->wl, s, workload_detect);
+	cl->last_mode_check_ts = now;
 
-	spin_unlock_irqrestore(&cl->perf_cl_peak_lock, flags);
+	/* Count touch input only while peak load is building up */
+	if (!(cl->wl.mode & PERF_CL_PEAK) &&
+	    cl->wl.avg[WL_PEAK] < (cl->perf_cl_peak_enter_load << WL_SHIFT))
+		ip_evts->evt_x_cnt = ip_evts->evt_y_cnt = 0;
 
-	if (cl->perf_cl_detect_state_change)
-		wake_up_process(notify_thread);
+	trace_cpu_mode_detect(cpumask_first(cl->cpus), s->dt_us, s->max_load,
+		s->avg_load, s->nr_cpus, s->max_iowait, s->hi_freq, s->input,
+		cl->wl.mode, cl->wl.io_busy);
+
+	update_mode_exit_timer(cl);
 
+	if (mode == cl->wl.mode && io_busy == cl->wl.io_busy)
+		return false;
+
+	pr_debug("msm_perf: Mode changed to %u IO %u\n", cl->wl.mode,
+							cl->wl.io_busy);
+	cl->mode_change = true;
+	return true;
 }
 
-static void check_cpu_load(struct cluster *cl, u64 now)
+static void check_workload_stats(unsigned int cpu, unsigned int rate, u64 now)
 {
+	struct cluster *cl = NULL;
 	struct load_stats *pcpu_st;
-	unsigned int i, max_load = 0, total_load = 0, ret_mode, cpu_cnt = 0;
-	unsigned int total_load_ceil, total_load_floor;
+	struct wl_sample s = { 0 };
+	unsigned int i, total_load = 0;
 	unsigned long flags;
+	bool changed;
+
+	for (i = 0; i < num_clusters; i++) {
+		if (cpumask_test_cpu(cpu, managed_clusters[i]->cpus)) {
+			cl = managed_clusters[i];
+			break;
+		}
+	}
+	if (cl == NULL)
+		return;
 
 	spin_lock_irqsave(&cl->mode_lock, flags);
 
-	if (((now - cl->last_mode_check_ts)
-		< (cl->timer_rate - LAST_LD_CHECK_TOL)) ||
-		!(workload_detect & MODE_DETECT)) {
+	cl->timer_rate = rate;
+	if ((now - cl->last_mode_check_ts)
+		< (cl->timer_rate - LAST_LD_CHECK_TOL)) {
 		spin_unlock_irqrestore(&cl->mode_lock, flags);
 		return;
 	}
@@ -2083,112 +1796,26 @@ static void check_cpu_load(struct cluster *cl, u64 now)
 		if ((now - pcpu_st->last_wallclock)
 			> (cl->timer_rate + LAST_UPDATE_TOL))
 			continue;
-		if (pcpu_st->cpu_load > max_load)
-			max_load = pcpu_st->cpu_load;
+		s.max_load = max(s.max_load, pcpu_st->cpu_load);
+		s.max_iowait = max(s.max_iowait, pcpu_st->last_iopercent);
 		total_load += pcpu_st->cpu_load;
-		cpu_cnt++;
-	}
-
-	if (cpu_cnt > 1) {
-		total_load_ceil = cl->pcpu_multi_enter_load * cpu_cnt;
-		total_load_floor = cl->pcpu_multi_exit_load * cpu_cnt;
-	} else {
-		total_load_ceil = UINT_MAX;
-		total_load_floor = UINT_MAX;
-	}
-
-	ret_mode = cl->mode;
-	if (!(cl->mode & SINGLE)) {
-		if (max_load >= cl->single_enter_load) {
-			cl->single_enter_cycle_cnt++;
-			if (cl->single_enter_cycle_cnt
-				>= cl->single_enter_cycles) {
-				ret_mode |= SINGLE;
-				cl->single_enter_cycle_cnt = 0;
-			}
-		} else {
-			cl->single_enter_cycle_cnt = 0;
-		}
-	} else {
-		if (max_load < cl->single_exit_load) {
-			start_timer(cl);
-			cl->single_exit_cycle_cnt++;
-			if (cl->single_exit_cycle_cnt
-				>= cl->single_exit_cycles) {
-				ret_mode &= ~SINGLE;
-				cl->single_exit_cycle_cnt = 0;
-				disable_timer(cl);
-			}
-		} else {
-			cl->single_exit_cycle_cnt = 0;
-			disable_timer(cl);
-		}
-	}
-
-	if (!(cl->mode & MULTI)) {
-		if (total_load >= total_load_ceil) {
-			cl->multi_enter_cycle_cnt++;
-			if (cl->multi_enter_cycle_cnt
-				>= cl->multi_enter_cycles) {
-				ret_mode |= MULTI;
-				cl->multi_enter_cycle_cnt = 0;
-			}
-		} else {
-			cl->multi_enter_cycle_cnt = 0;
-		}
-	} else {
-		if (total_load < total_load_floor) {
-			cl->multi_exit_cycle_cnt++;
-			if (cl->multi_exit_cycle_cnt
-				>= cl->multi_exit_cycles) {
-				ret_mode &= ~MULTI;
-				cl->multi_exit_cycle_cnt = 0;
-			}
-		} else {
-			cl->multi_exit_cycle_cnt = 0;
-		}
-	}
-
-	cl->last_mode_check_ts = now;
-
-	if (ret_mode != cl->mode) {
-		cl->mode = ret_mode;
-		cl->mode_change = true;
-		pr_debug("msm_perf: Mode changed to %u\n", ret_mode);
+		s.nr_cpus++;
+		/* most recent frequency, from the transition notifier */
+		cl->current_freq = pcpu_st->freq;
 	}
+	if (s.nr_cpus)
+		s.avg_load = total_load / s.nr_cpus;
+	s.hi_freq = freq_greater_than_threshold(cl, cpumask_first(cl->cpus));
+	s.input = input_events_greater_than_threshold();
 
-	trace_cpu_mode_detect(cpumask_first(cl->cpus), max_load,
-		cl->single_enter_cycle_cnt, cl->single_exit_cycle_cnt,
-		total_load, cl->multi_enter_cycle_cnt,
-		cl->multi_exit_cycle_cnt, cl->perf_cl_peak_enter_cycle_cnt,
-		cl->perf_cl_peak_exit_cycle_cnt, cl->mode, cpu_cnt);
+	changed = classify_cluster(cl, &s, now);
 
 	spin_unlock_irqrestore(&cl->mode_lock, flags);
 
-	if (cl->mode_change)
+	if (changed)
 		wake_up_process(notify_thread);
 }
 
-static void check_workload_stats(unsigned int cpu, unsigned int rate, u64 now)
-{
-	struct cluster *cl = NULL;
-	unsigned int i;
-
-	for (i = 0; i < num_clusters; i++) {
-		if (cpumask_test_cpu(cpu, managed_clusters[i]->cpus)) {
-			cl = managed_clusters[i];
-			break;
-		}
-	}
-	if (cl == NULL)
-		return;
-
-	cl->timer_rate = rate;
-	check_cluster_iowait(cl, now);
-	check_cpu_load(cl, now);
-	check_perf_cl_peak_load(cl, now);
-}
-
 static int perf_govinfo_notify(struct notifier_block *nb, unsigned long val,
 								void *data)
 {
@@ -2256,9 +1883,9 @@ static int perf_cputrans_notify(struct notifier_block *nb, unsigned long val,
 		return NOTIFY_OK;
 
 	if (val == CPUFREQ_POSTCHANGE) {
-		spin_lock_irqsave(&cl->perf_cl_peak_lock, flags);
+		spin_lock_irqsave(&cl->mode_lock, flags);
 		cpu_st->freq = freq->new;
-		spin_unlock_irqrestore(&cl->perf_cl_peak_lock, flags);
+		spin_unlock_irqrestore(&cl->mode_lock, flags);
 	}
 	/*
 	* Avoid deadlock in case governor notifier ran in the context
@@ -2520,72 +2147,26 @@ static struct notifier_block __refdata msm_performance_cpu_notifier = {
 	.notifier_call = msm_performance_cpu_callback,
 };
 
-static void single_mod_exit_timer(unsigned long data)
-{
-	int i;
-	struct cluster *i_cl = NULL;
-	unsigned long flags;
-
-	if (!clusters_inited)
-		return;
-
-	for (i = 0; i < num_clusters; i++) {
-		if (cpumask_test_cpu(data,
-			managed_clusters[i]->cpus)) {
-			i_cl = managed_clusters[i];
-			break;
-		}
-	}
-
-	if (i_cl == NULL)
-		return;
-
-	spin_lock_irqsave(&i_cl->mode_lock, flags);
-	if (i_cl->mode & SINGLE) {
-		/* Disable SINGLE mode and exit since the timer expired */
-		i_cl->mode = i_cl->mode & ~SINGLE;
-		i_cl->single_enter_cycle_cnt = 0;
-		i_cl->single_exit_cycle_cnt = 0;
-		trace_single_mode_timeout(cpumask_first(i_cl->cpus),
-			i_cl->single_enter_cycles, i_cl->single_enter_cycle_cnt,
-			i_cl->single_exit_cycles, i_cl->single_exit_cycle_cnt,
-			i_cl->multi_enter_cycles, i_cl->multi_enter_cycle_cnt,
-			i_cl->multi_exit_cycles, i_cl->multi_exit_cycle_cnt,
-			i_cl->timer_rate, i_cl->mode);
-	}
-	spin_unlock_irqrestore(&i_cl->mode_lock, flags);
-	wake_up_process(notify_thread);
-}
-
-static void perf_cl_peak_mod_exit_timer(unsigned long data)
+/*
+ * No load windows are reported while the cluster's CPUs are idle, so
+ * decay the modes as if the time since the last window had no load.
+ */
+static void mode_exit_timer_fn(unsigned long data)
 {
-	int i;
-	struct cluster *i_cl = NULL;
+	struct cluster *cl = (struct cluster *)data;
+	struct wl_sample s = { 0 };
 	unsigned long flags;
+	bool changed;
 
 	if (!clusters_inited)
 		return;
 
-	for (i = 0; i < num_clusters; i++) {
-		if (cpumask_test_cpu(data,
-			managed_clusters[i]->cpus)) {
-			i_cl = managed_clusters[i];
-			break;
-		}
-	}
-
-	if (i_cl == NULL)
-		return;
+	spin_lock_irqsave(&cl->mode_lock, flags);
+	changed = classify_cluster(cl, &s, ktime_to_us(ktime_get()));
+	spin_unlock_irqrestore(&cl->mode_lock, flags);
 
-	spin_lock_irqsave(&i_cl->perf_cl_peak_lock, flags);
-	if (i_cl->perf_cl_peak & PERF_CL_PEAK) {
-		/* Disable PERF_CL_PEAK mode and exit since the timer expired */
-		i_cl->perf_cl_peak = i_cl->perf_cl_peak & ~PERF_CL_PEAK;
-		i_cl->perf_cl_peak_enter_cycle_cnt = 0;
-		i_cl->perf_cl_peak_exit_cycle_cnt = 0;
-	}
-	spin_unlock_irqrestore(&i_cl->perf_cl_peak_lock, flags);
-	wake_up_process(notify_thread);
+	if (changed)
+		wake_up_process(notify_thread);
 }
 
 static int init_cluster_control(void)
@@ -2624,38 +2205,22 @@ static int init_cluster_control(void)
 		managed_clusters[i]->max_cpu_request = -1;
 		managed_clusters[i]->single_enter_load = DEF_SINGLE_ENT;
 		managed_clusters[i]->single_exit_load = DEF_SINGLE_EX;
-		managed_clusters[i]->single_enter_cycles
-						= DEF_SINGLE_ENTER_CYCLE;
-		managed_clusters[i]->single_exit_cycles
-						= DEF_SINGLE_EXIT_CYCLE;
 		managed_clusters[i]->pcpu_multi_enter_load
 						= DEF_PCPU_MULTI_ENT;
 		managed_clusters[i]->pcpu_multi_exit_load = DEF_PCPU_MULTI_EX;
-		managed_clusters[i]->multi_enter_cycles = DEF_MULTI_ENTER_CYCLE;
-		managed_clusters[i]->multi_exit_cycles = DEF_MULTI_EXIT_CYCLE;
 		managed_clusters[i]->perf_cl_peak_enter_load =
 						DEF_PERF_CL_PEAK_ENT;
 		managed_clusters[i]->perf_cl_peak_exit_load =
 						DEF_PERF_CL_PEAK_EX;
-		managed_clusters[i]->perf_cl_peak_enter_cycles =
-						DEF_PERF_CL_PEAK_ENTER_CYCLE;
-		managed_clusters[i]->perf_cl_peak_exit_cycles =
-						DEF_PERF_CL_PEAK_EXIT_CYCLE;
 
 		/* Initialize trigger threshold */
 		thr.perf_cl_trigger_threshold = CLUSTER_1_THRESHOLD_FREQ;
 		thr.pwr_cl_trigger_threshold = CLUSTER_0_THRESHOLD_FREQ;
 		thr.ip_evt_threshold = INPUT_EVENT_CNT_THRESHOLD;
-		spin_lock_init(&(managed_clusters[i]->iowait_lock));
 		spin_lock_init(&(managed_clusters[i]->mode_lock));
-		spin_lock_init(&(managed_clusters[i]->timer_lock));
-		spin_lock_init(&(managed_clusters[i]->perf_cl_peak_lock));
-		init_timer(&managed_clusters[i]->mode_exit_timer);
-		managed_clusters[i]->mode_exit_timer.function =
-			single_mod_exit_timer;
-		init_timer(&managed_clusters[i]->perf_cl_peak_mode_exit_timer);
-		managed_clusters[i]->perf_cl_peak_mode_exit_timer.function =
-			perf_cl_peak_mod_exit_timer;
+		setup_timer(&managed_clusters[i]->mode_exit_timer,
+			mode_exit_timer_fn,
+			(unsigned long)managed_clusters[i]);
 
 	}
 	ip_evts = kcalloc(1, sizeof(struct input_events), GFP_KERNEL);
@@ -2663,6 +2228,12 @@ static int init_cluster_control(void)
 		ret = -ENOMEM;
 		goto error;
 	}
+	replay_state = kcalloc(num_clusters, sizeof(*replay_state),
+								GFP_KERNEL);
+	if (!replay_state) {
+		ret = -ENOMEM;
+		goto error;
+	}
 
 	INIT_DELAYED_WORK(&evaluate_hotplug_work, check_cluster_status);
 	mutex_init(&managed_cpus_lock);
@@ -206,6 +206,29 @@ static void kryo_clear_resr(struct kryo_evt *evtinfo)
 	kryo_write_pmresr(evtinfo->reg, evtinfo->l_h, val);
 }
 
+/*
+ * Events with the same reg, code and group program the same PMRESR
+ * column and can share it. Returns the first other counter using the
+ * column of @hwc, or -1 if it is free.
+ */
+static int kryo_column_user(struct pmu_hw_events *hw_events,
+			    struct hw_perf_event *hwc, int idx)
+{
+	u32 r_g_mask = KRYO_EVT_REG_MASK | KRYO_EVT_GROUP_MASK;
+	u32 r_g_value = hwc->config_base & r_g_mask;
+	struct hw_perf_event *hwc_i;
+	int i;
+
+	for (i = 1; i < cpu_pmu->num_events; i++) {
+		if (i == idx || hw_events->events[i] == NULL)
+			continue;
+		hwc_i = &hw_events->events[i]->hw;
+		if (r_g_value == (hwc_i->config_base & r_g_mask))
+			return i;
+	}
+	return -1;
+}
+
 static void kryo_pmu_disable_event(struct hw_perf_event *hwc, int idx)
 {
 	unsigned long flags;
@@ -231,7 +254,8 @@ static void kryo_pmu_disable_event(struct hw_perf_event *hwc, int idx)
 			ev_num = get_kryo_evtinfo(val, &evtinfo);
 			if (ev_num == -EINVAL)
 				goto kryo_dis_out;
-			kryo_clear_resr(&evtinfo);
+			if (kryo_column_user(events, hwc, idx) < 0)
+				kryo_clear_resr(&evtinfo);
 		}
 	}
 	/* Disable interrupt for this counter */
@@ -301,6 +325,7 @@ static void kryo_init_usermode(void)
 	asm volatile("mrs %0, pmuserenr_el0" : "=r" (val));
 	val |= PMUSERENR_UEN;
 	asm volatile("msr pmuserenr_el0, %0" : : "r" (val));
+	cpu_pmu->user_access = true;
 }
 #else
 static inline void kryo_init_usermode(void)
@@ -337,13 +362,10 @@ static void kryo_pmu_reset(void *info)
 	armv8pmu_pmcr_write(ARMV8_PMCR_P | ARMV8_PMCR_C);
 }
 
-static int kryo_check_column_exclusion(struct arm_pmu *armpmu,
+static int kryo_check_column_exclusion(struct pmu_hw_events *hw_events,
 				       struct hw_perf_event *hwc)
 {
-	struct pmu_hw_events *hw_events = armpmu->get_hw_events();
 	struct hw_perf_event *hwc_i;
-	u32 r_g_mask = KRYO_EVT_REG_MASK | KRYO_EVT_GROUP_MASK;
-	u32 r_g_value = hwc->config_base & r_g_mask;
 	int i;
 
 	/* Only check for kryo implementation events */
@@ -352,24 +374,23 @@ static int kryo_check_column_exclusion(struct arm_pmu *armpmu,
 		return 0;
 
 	/*
-	 * Tests against all existing events. This function is called per-cpu
-	 * so we are only concerned with events on this CPU. Conflicting
-	 * task events (with cpu == -1) will be detected on the first CPU
-	 * that they run on and when disabled they won't show up on
-	 * other CPUs.
+	 * Tests against the events on this CPU, or against the rest of the
+	 * group when validating one. A conflict only keeps the event off
+	 * the PMU for now, it is retried when the events are rotated.
 	 */
-	for (i = 1; i < armpmu->num_events; i++) {
-		if (hw_events->events[i] == NULL)
-			continue;
-		hwc_i = &hw_events->events[i]->hw;
-		if (r_g_value == (hwc_i->config_base & r_g_mask)) {
-			pr_err("column exclusion violation, events %lx, %lx\n",
-			       hwc_i->config_base & KRYO_EVT_MASK,
-			       hwc->config_base & KRYO_EVT_MASK);
-			return -EPERM;
-		}
-	}
-	return 0;
+	i = kryo_column_user(hw_events, hwc, -1);
+	if (i < 0)
+		return 0;
+
+	hwc_i = &hw_events->events[i]->hw;
+	if ((hwc->config_base & KRYO_EVT_MASK) ==
+	    (hwc_i->config_base & KRYO_EVT_MASK))
+		return 0;
+
+	pr_debug("column exclusion violation, events %lx, %lx\n",
+		 hwc_i->config_base & KRYO_EVT_MASK,
+		 hwc->config_base & KRYO_EVT_MASK);
+	return -EPERM;
 }
 
 /* NRCCG format for perf RAW codes. */
@@ -524,6 +524,32 @@ void l2_cache__pmu_disable(struct pmu *pmu)
 	wmb();
 }
 
+/*
+ * A group whose members need different codes in the same R, G column
+ * can never be scheduled as a whole, reject it up front.
+ */
+static
+int group_violates_column_exclusion(struct perf_event *event)
+{
+	struct perf_event *leader = event->group_leader;
+	struct perf_event *sibling;
+	u32 r_g_mask = EVENT_REG_MASK | EVENT_GROUP_MASK;
+	u32 config = event->attr.config;
+
+	list_for_each_entry(sibling, &leader->sibling_list, group_entry) {
+		if (sibling->pmu != event->pmu)
+			continue;
+		if (sibling->attr.config != config &&
+		    (sibling->attr.config & r_g_mask) == (config & r_g_mask))
+			return 1;
+	}
+
+	if (leader == event || leader->pmu != event->pmu)
+		return 0;
+	return leader->attr.config != config &&
+	       (leader->attr.config & r_g_mask) == (config & r_g_mask);
+}
+
 static
 int l2_cache__event_init(struct perf_event *event)
 {
@@ -540,6 +566,9 @@ int l2_cache__event_init(struct perf_event *event)
 	hwc->idx = -1;
 	hwc->config_base = event->attr.config;
 
+	if (group_violates_column_exclusion(event))
+		return -EINVAL;
+
 	/*
 	 * For counting events use L2_CNT_PERIOD which allows for simplified
 	 * math and proper handling of overflows in the presence of IRQs and
@@ -645,16 +674,39 @@ void l2_cache__event_stop(struct perf_event *event, int flags)
 	}
 }
 
-/* Look for a duplicate event already configured on this cluster */
+/*
+ * Events bound to a CPU count for the whole cluster, unless they are
+ * trace counters. Task events and trace counters filter on the CPU they
+ * run on, so they are attributed to that CPU (or task) only.
+ */
+static inline
+int is_cluster_wide(struct perf_event *event)
+{
+	u32 evt_prefix = (event->hw.config_base & EVENT_PREFIX_MASK) >>
+			 EVENT_PREFIX_SHIFT;
+
+	return event->cpu >= 0 && evt_prefix != L2_TRACECTR_PREFIX;
+}
+
+/*
+ * Look for a duplicate cluster wide event already configured on this
+ * cluster. Per-CPU filtered events need a counter of their own.
+ */
 static
-int config_is_dup(struct hml2_pmu *slice, struct hw_perf_event *hwc)
+int config_is_dup(struct hml2_pmu *slice, struct perf_event *event)
 {
 	int i;
+	struct hw_perf_event *hwc = &event->hw;
 	struct hw_perf_event *hwc_i;
 
+	if (!is_cluster_wide(event))
+		return 0;
+
 	for (i = 0; i < MAX_L2_CTRS; i++) {
 		if (slice->events[i] == NULL)
 			continue;
+		if (!is_cluster_wide(slice->events[i]))
+			continue;
 		hwc_i = &slice->events[i]->hw;
 		if (hwc->config_base == hwc_i->config_base)
 			return 1;
@@ -683,9 +735,9 @@ int event_violates_column_exclusion(struct hml2_pmu *slice,
 		if (hwc->config_base == hwc_i->config_base)
 			continue;
 		if (r_g_value == (hwc_i->config_base & r_g_mask)) {
-			pr_err("column exclusion violation, events %lx, %lx\n",
-			       hwc_i->config_base & L2_EVT_MASK,
-			       hwc->config_base & L2_EVT_MASK);
+			pr_debug("column exclusion violation, events %lx, %lx\n",
+				 hwc_i->config_base & L2_EVT_MASK,
+				 hwc->config_base & L2_EVT_MASK);
 			return 1;
 		}
 	}
@@ -722,14 +774,19 @@ int l2_cache__event_add(struct perf_event *event, int flags)
 	 * OFF, because if the other CPU is subsequently hotplugged, etc,
 	 * we want the opportunity to start collecting on this event.
 	 */
-	if (config_is_dup(slice, hwc)) {
+	if (config_is_dup(slice, event)) {
 		hwc->idx = -1;
 		goto out;
 	}
 
+	/*
+	 * The column may be taken by an event of the other CPU in the
+	 * cluster, which can go away at its next context switch. Leave
+	 * the event inactive so that it is retried on rotation.
+	 */
 	if (event_violates_column_exclusion(slice, hwc)) {
-		event->state = PERF_EVENT_STATE_OFF;
 		hwc->idx = -1;
+		err = -EAGAIN;
 		goto out;
 	}
 
@@ -264,6 +264,7 @@ ol_rx_reorder_flush_frag(
         ol_rx_frames_free(htt_pdev, rx_reorder_array_elem->head);
         rx_reorder_array_elem->head = NULL;
         rx_reorder_array_elem->tail = NULL;
+        ol_rx_reorder_slot_sync(&peer->tids_rx_reorder[tid], seq);
     }
 }
 
@@ -336,6 +337,7 @@ ol_rx_reorder_store_frag(
         ol_rx_defrag(pdev, peer, tid, rx_reorder_array_elem->head);
         rx_reorder_array_elem->head = NULL;
         rx_reorder_array_elem->tail = NULL;
+        ol_rx_reorder_slot_sync(&peer->tids_rx_reorder[tid], seq);
 
         VOS_TRACE(VOS_MODULE_ID_TXRX, VOS_TRACE_LEVEL_ERROR,
             "%s: QSV2020008 not expected behavior, but also handled\n",
@@ -363,6 +365,7 @@ ol_rx_reorder_store_frag(
     ol_rx_fraglist_insert(htt_pdev, peer,
         &rx_reorder_array_elem->head,
         &rx_reorder_array_elem->tail, frag, &all_frag_present);
+    ol_rx_reorder_slot_sync(&peer->tids_rx_reorder[tid], seq);
 
     if (pdev->rx.flags.defrag_timeout_check) {
         ol_rx_defrag_waitlist_remove(peer, tid);
@@ -372,6 +375,7 @@ ol_rx_reorder_store_frag(
         ol_rx_defrag(pdev, peer, tid, rx_reorder_array_elem->head);
         rx_reorder_array_elem->head = NULL;
         rx_reorder_array_elem->tail = NULL;
+        ol_rx_reorder_slot_sync(&peer->tids_rx_reorder[tid], seq);
         peer->tids_rx_reorder[tid].defrag_timeout_ms = 0;
         peer->tids_last_seq[tid] = seq_num;
     } else if (pdev->rx.flags.defrag_timeout_check) {
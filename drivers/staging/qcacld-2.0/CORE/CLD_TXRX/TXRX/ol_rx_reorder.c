@@ -29,6 +29,7 @@
 /* generic utilities */
 #include <adf_nbuf.h>          /* adf_nbuf_t, etc. */
 #include <adf_os_mem.h>        /* adf_os_mem_alloc */
+#include <adf_os_util.h>       /* adf_os_ffs64 */
 
 #include <ieee80211.h>         /* IEEE80211_SEQ_MAX */
 
@@ -84,13 +85,89 @@ static char g_log2ceil[] = {
 
 /*---*/
 
-/* reorder array elements are known to be non-NULL */
-#define OL_RX_REORDER_LIST_APPEND(head_msdu, tail_msdu, rx_reorder_array_elem) \
-    do { \
-        if (tail_msdu) { \
-            adf_nbuf_set_next(tail_msdu, rx_reorder_array_elem->head); \
-        } \
-    } while (0)
+/*
+ * The present-slot bitmap of a TID covers up to 64 reorder array slots.
+ * Slot sets are handled "rotated", i.e. with bit 0 standing for the slot
+ * the walk starts from, so that a circular range of slots is a plain
+ * low-order bit range and the slots come out of adf_os_ffs64 in order.
+ */
+#define OL_RX_REORDER_SLOTS_ALL(win_sz_mask) \
+    (~((u_int64_t) 0) >> (63 - (win_sz_mask)))
+
+static inline u_int64_t
+ol_rx_reorder_slots_rotate(
+    u_int64_t slots,
+    unsigned idx_start,
+    unsigned win_sz_mask)
+{
+    if (idx_start == 0) {
+        return slots;
+    }
+    return ((slots >> idx_start) |
+            (slots << (win_sz_mask + 1 - idx_start))) &
+        OL_RX_REORDER_SLOTS_ALL(win_sz_mask);
+}
+
+/*
+ * Rotated set of the occupied slots in [idx_start, idx_end).
+ * As elsewhere in this file, idx_start == idx_end stands for the whole
+ * reorder array, beginning at idx_start.
+ */
+static inline u_int64_t
+ol_rx_reorder_slots_range(
+    struct ol_rx_reorder_t *rx_reorder,
+    unsigned idx_start,
+    unsigned idx_end)
+{
+    unsigned win_sz_mask = rx_reorder->win_sz_mask;
+    u_int64_t slots;
+
+    slots = ol_rx_reorder_slots_rotate(
+        rx_reorder->present, idx_start, win_sz_mask);
+    if (idx_start != idx_end) {
+        slots &= OL_RX_REORDER_SLOT_BIT((idx_end - idx_start) & win_sz_mask) - 1;
+    }
+    return slots;
+}
+
+/*
+ * Unlink the MPDUs held in [idx_start, idx_end) of the reorder array and
+ * chain them, in sequence order, into a single (non NULL-terminated) list.
+ * Only the occupied slots are visited.
+ */
+static adf_nbuf_t
+ol_rx_reorder_slots_unlink(
+    struct ol_rx_reorder_t *rx_reorder,
+    unsigned idx_start,
+    unsigned idx_end,
+    adf_nbuf_t *tail_msdu)
+{
+    struct ol_rx_reorder_array_elem_t *rx_reorder_array_elem;
+    unsigned win_sz_mask = rx_reorder->win_sz_mask;
+    adf_nbuf_t head_msdu = NULL;
+    u_int64_t slots;
+
+    *tail_msdu = NULL;
+    slots = ol_rx_reorder_slots_range(rx_reorder, idx_start, idx_end);
+    while (slots) {
+        unsigned idx;
+
+        idx = (idx_start + adf_os_ffs64(slots)) & win_sz_mask;
+        slots &= slots - 1;
+
+        rx_reorder_array_elem = &rx_reorder->array[idx];
+        OL_RX_REORDER_MPDU_CNT_DECR(rx_reorder, 1);
+        if (head_msdu) {
+            adf_nbuf_set_next(*tail_msdu, rx_reorder_array_elem->head);
+        } else {
+            head_msdu = rx_reorder_array_elem->head;
+        }
+        *tail_msdu = rx_reorder_array_elem->tail;
+        rx_reorder_array_elem->head = rx_reorder_array_elem->tail = NULL;
+        rx_reorder->present &= ~OL_RX_REORDER_SLOT_BIT(idx);
+    }
+    return head_msdu;
+}
 
 
 /* functions called by txrx components */
@@ -99,6 +176,7 @@ void ol_rx_reorder_init(struct ol_rx_reorder_t *rx_reorder, u_int8_t tid)
 {
     rx_reorder->win_sz = 1;
     rx_reorder->win_sz_mask = 0;
+    rx_reorder->present = 0;
     rx_reorder->array = &rx_reorder->base;
     rx_reorder->base.head = rx_reorder->base.tail = NULL;
     rx_reorder->tid = tid;
@@ -251,15 +329,17 @@ ol_rx_reorder_store(
     adf_nbuf_t head_msdu,
     adf_nbuf_t tail_msdu)
 {
+    struct ol_rx_reorder_t *rx_reorder = &peer->tids_rx_reorder[tid];
     struct ol_rx_reorder_array_elem_t *rx_reorder_array_elem;
 
-    idx &= peer->tids_rx_reorder[tid].win_sz_mask;
-    rx_reorder_array_elem = &peer->tids_rx_reorder[tid].array[idx];
+    idx &= rx_reorder->win_sz_mask;
+    rx_reorder_array_elem = &rx_reorder->array[idx];
     if (rx_reorder_array_elem->head) {
         adf_nbuf_set_next(rx_reorder_array_elem->tail, head_msdu);
     } else {
         rx_reorder_array_elem->head = head_msdu;
-	OL_RX_REORDER_MPDU_CNT_INCR(&peer->tids_rx_reorder[tid], 1);
+        rx_reorder->present |= OL_RX_REORDER_SLOT_BIT(idx);
+	OL_RX_REORDER_MPDU_CNT_INCR(rx_reorder, 1);
     }
     rx_reorder_array_elem->tail = tail_msdu;
 }
@@ -272,42 +352,23 @@ ol_rx_reorder_release(
     unsigned idx_start,
     unsigned idx_end)
 {
-    unsigned idx;
-    unsigned win_sz, win_sz_mask;
-    struct ol_rx_reorder_array_elem_t *rx_reorder_array_elem;
+    unsigned win_sz_mask;
     adf_nbuf_t head_msdu;
     adf_nbuf_t tail_msdu;
 
     OL_RX_REORDER_IDX_START_SELF_SELECT(peer, tid, &idx_start);
     peer->tids_next_rel_idx[tid] = (u_int16_t)idx_end; /* may get reset below */
 
-    win_sz = peer->tids_rx_reorder[tid].win_sz;
     win_sz_mask = peer->tids_rx_reorder[tid].win_sz_mask;
     idx_start &= win_sz_mask;
     idx_end   &= win_sz_mask;
-    rx_reorder_array_elem = &peer->tids_rx_reorder[tid].array[idx_start];
 
-    head_msdu = rx_reorder_array_elem->head;
-    tail_msdu = rx_reorder_array_elem->tail;
-    rx_reorder_array_elem->head = rx_reorder_array_elem->tail = NULL;
-    if (head_msdu) {
-        OL_RX_REORDER_MPDU_CNT_DECR(&peer->tids_rx_reorder[tid], 1);
-    }
-
-    idx = (idx_start + 1);
-    OL_RX_REORDER_IDX_WRAP(idx, win_sz, win_sz_mask);
-    while (idx != idx_end) {
-        rx_reorder_array_elem = &peer->tids_rx_reorder[tid].array[idx];
-        if (rx_reorder_array_elem->head) {
-            OL_RX_REORDER_MPDU_CNT_DECR(&peer->tids_rx_reorder[tid], 1);
-            OL_RX_REORDER_LIST_APPEND(
-                head_msdu, tail_msdu, rx_reorder_array_elem);
-            tail_msdu = rx_reorder_array_elem->tail;
-        }
-        rx_reorder_array_elem->head = rx_reorder_array_elem->tail = NULL;
-        idx++;
-        OL_RX_REORDER_IDX_WRAP(idx, win_sz, win_sz_mask);
-    }
+    /*
+     * All MPDUs in the released range go up the stack as one list,
+     * so the OS shim gets the whole in-order batch in a single call.
+     */
+    head_msdu = ol_rx_reorder_slots_unlink(
+        &peer->tids_rx_reorder[tid], idx_start, idx_end, &tail_msdu);
     if (head_msdu) {
         u_int16_t seq_num;
         htt_pdev_handle htt_pdev = vdev->pdev->htt_pdev;
@@ -351,9 +412,8 @@ ol_rx_reorder_flush(
     struct ol_txrx_pdev_t *pdev;
     unsigned win_sz;
     u_int8_t win_sz_mask;
-    struct ol_rx_reorder_array_elem_t *rx_reorder_array_elem;
-    adf_nbuf_t head_msdu = NULL;
-    adf_nbuf_t tail_msdu = NULL;
+    adf_nbuf_t head_msdu;
+    adf_nbuf_t tail_msdu;
 
     pdev = vdev->pdev;
     win_sz = peer->tids_rx_reorder[tid].win_sz;
@@ -380,26 +440,8 @@ ol_rx_reorder_flush(
     idx_start &= win_sz_mask;
     idx_end   &= win_sz_mask;
 
-    do {
-        rx_reorder_array_elem =
-            &peer->tids_rx_reorder[tid].array[idx_start];
-        idx_start = (idx_start + 1);
-        OL_RX_REORDER_IDX_WRAP(idx_start, win_sz, win_sz_mask);
-
-        if (rx_reorder_array_elem->head) {
-            OL_RX_REORDER_MPDU_CNT_DECR(&peer->tids_rx_reorder[tid], 1);
-            if (head_msdu == NULL) {
-                head_msdu = rx_reorder_array_elem->head;
-                tail_msdu = rx_reorder_array_elem->tail;
-                rx_reorder_array_elem->head = NULL;
-                rx_reorder_array_elem->tail = NULL;
-                continue;
-            }
-            adf_nbuf_set_next(tail_msdu, rx_reorder_array_elem->head);
-            tail_msdu = rx_reorder_array_elem->tail;
-            rx_reorder_array_elem->head = rx_reorder_array_elem->tail = NULL;
-        }
-    } while (idx_start != idx_end);
+    head_msdu = ol_rx_reorder_slots_unlink(
+        &peer->tids_rx_reorder[tid], idx_start, idx_end, &tail_msdu);
 
     ol_rx_defrag_waitlist_remove(peer, tid);
 
@@ -441,36 +483,38 @@ ol_rx_reorder_first_hole(
     unsigned tid,
     unsigned *idx_end)
 {
-    unsigned win_sz, win_sz_mask;
-    unsigned idx_start = 0, tmp_idx = 0;
+    unsigned win_sz_mask;
+    unsigned idx_start = 0;
+    u_int64_t present, slots;
 
-    win_sz = peer->tids_rx_reorder[tid].win_sz;
     win_sz_mask = peer->tids_rx_reorder[tid].win_sz_mask;
 
     OL_RX_REORDER_IDX_START_SELF_SELECT(peer, tid, &idx_start);
-    tmp_idx++;
-    OL_RX_REORDER_IDX_WRAP(tmp_idx, win_sz, win_sz_mask);
-    /* bypass the initial hole */
-    while (tmp_idx != idx_start &&
-           !peer->tids_rx_reorder[tid].array[tmp_idx].head)
-    {
-        tmp_idx++;
-        OL_RX_REORDER_IDX_WRAP(tmp_idx, win_sz, win_sz_mask);
-    }
-    /* bypass the present frames following the initial hole */
-    while (tmp_idx != idx_start &&
-           peer->tids_rx_reorder[tid].array[tmp_idx].head)
-    {
-        tmp_idx++;
-        OL_RX_REORDER_IDX_WRAP(tmp_idx, win_sz, win_sz_mask);
-    }
+    idx_start &= win_sz_mask;
     /*
      * idx_end is exclusive rather than inclusive.
      * In other words, it is the index of the first slot of the second
      * hole, rather than the index of the final present frame following
      * the first hole.
+     * If either search runs off the end of the array, idx_end wraps
+     * around to idx_start.
      */
-    *idx_end = tmp_idx;
+    *idx_end = idx_start;
+
+    present = ol_rx_reorder_slots_rotate(
+        peer->tids_rx_reorder[tid].present, idx_start, win_sz_mask);
+    /* bypass the initial hole */
+    slots = present & ~OL_RX_REORDER_SLOT_BIT(0);
+    if (!slots) {
+        return;
+    }
+    /* bypass the present frames following the initial hole */
+    slots = ~present & OL_RX_REORDER_SLOTS_ALL(win_sz_mask) &
+        ~(OL_RX_REORDER_SLOT_BIT(adf_os_ffs64(slots)) - 1);
+    if (!slots) {
+        return;
+    }
+    *idx_end = (idx_start + adf_os_ffs64(slots)) & win_sz_mask;
 }
 
 #ifdef HL_RX_AGGREGATION_HOLE_DETCTION
@@ -595,6 +639,7 @@ ol_rx_addba_handler(
 
     rx_reorder->win_sz_mask = round_pwr2_win_sz - 1;
     rx_reorder->num_mpdus = 0;
+    rx_reorder->present = 0;
 
     peer->tids_next_rel_idx[tid] = OL_RX_REORDER_IDX_INIT(
         start_seq_num, rx_reorder->win_sz, rx_reorder->win_sz_mask);
@@ -723,6 +768,7 @@ ol_rx_pn_ind_handler(
     adf_nbuf_t tail_msdu = NULL;
     htt_pdev_handle htt_pdev = pdev->htt_pdev;
     u_int16_t seq_num;
+    u_int64_t slots;
     int i=0;
 
     if (tid >= OL_TXRX_NUM_EXT_TIDS) {
@@ -752,9 +798,12 @@ ol_rx_pn_ind_handler(
     win_sz_mask = peer->tids_rx_reorder[tid].win_sz_mask;
     seq_num_start &= win_sz_mask;
     seq_num_end   &= win_sz_mask;
-    seq_num = seq_num_start;
+    slots = ol_rx_reorder_slots_range(
+        &peer->tids_rx_reorder[tid], seq_num_start, seq_num_end);
 
-    do {
+    while (slots) {
+        seq_num = (seq_num_start + adf_os_ffs64(slots)) & win_sz_mask;
+        slots &= slots - 1;
         rx_reorder_array_elem =
             &peer->tids_rx_reorder[tid].array[seq_num];
 
@@ -828,9 +877,10 @@ ol_rx_pn_ind_handler(
             }
             rx_reorder_array_elem->head = NULL;
             rx_reorder_array_elem->tail = NULL;
+            peer->tids_rx_reorder[tid].present &=
+                ~OL_RX_REORDER_SLOT_BIT(seq_num);
         }
-        seq_num = (seq_num + 1) & win_sz_mask;
-    } while (seq_num != seq_num_end);
+    }
 
     if (head_msdu) {
         /* rx_opt_proc takes a NULL-terminated list of msdu netbufs */
@@ -34,6 +34,25 @@
 
 #include <ol_txrx_types.h>   /* ol_rx_reorder_t */
 
+#define OL_RX_REORDER_SLOT_BIT(idx) (((u_int64_t) 1) << (idx))
+
+/**
+ * @brief - resync the present-slot bitmap with one reorder array slot
+ * @details
+ *  Code that fills or drains a reorder array slot without going through
+ *  ol_rx_reorder_store / release / flush (e.g. fragment reassembly) has
+ *  to call this afterwards, so that the bitmap keeps matching the array.
+ */
+static inline void
+ol_rx_reorder_slot_sync(struct ol_rx_reorder_t *rx_reorder, unsigned idx)
+{
+    if (rx_reorder->array[idx].head) {
+        rx_reorder->present |= OL_RX_REORDER_SLOT_BIT(idx);
+    } else {
+        rx_reorder->present &= ~OL_RX_REORDER_SLOT_BIT(idx);
+    }
+}
+
 void
 ol_rx_reorder_store(
     struct ol_txrx_pdev_t *pdev,
@@ -38,17 +38,26 @@
 
 #ifdef QCA_SUPPORT_OL_RX_REORDER_TIMEOUT
 
+/*
+ * All peer-TIDs with rx holes share one timer wheel per pdev.
+ * A peer-TID is queued in the slot whose expiry covers its AC's timeout,
+ * and a single periodic timer expires one slot per tick while the wheel
+ * is non-empty, so adding and removing a timeout are O(1) no matter how
+ * many peer-TIDs are waiting.
+ */
+#define OL_RX_REORDER_TIMEOUT_SLOT_MASK (OL_RX_REORDER_TIMEOUT_WHEEL_SLOTS - 1)
+
+/* the longest per-AC timeout (100 ms) has to fit within one wheel turn */
+A_COMPILE_TIME_ASSERT(ol_rx_reorder_timeout_wheel_span,
+    100 / OL_RX_REORDER_TIMEOUT_TICK_MS < OL_RX_REORDER_TIMEOUT_WHEEL_SLOTS);
+
 void
 ol_rx_reorder_timeout_remove(struct ol_txrx_peer_t *peer, unsigned tid)
 {
-    struct ol_txrx_pdev_t *pdev;
-    struct ol_tx_reorder_cat_timeout_t *rx_reorder_timeout_ac;
+    struct ol_rx_reorder_timeout_wheel_t *wheel;
     struct ol_rx_reorder_timeout_list_elem_t *list_elem;
-    int ac;
 
-    pdev = peer->vdev->pdev;
-    ac = TXRX_TID_TO_WMM_AC(tid);
-    rx_reorder_timeout_ac = &pdev->rx.reorder_timeout.access_cats[ac];
+    wheel = &peer->vdev->pdev->rx.reorder_timeout;
     list_elem = &peer->tids_rx_reorder[tid].timeout;
     if (!list_elem->active) {
         /* this element has already been removed */
@@ -56,55 +65,51 @@ ol_rx_reorder_timeout_remove(struct ol_txrx_peer_t *peer, unsigned tid)
     }
     list_elem->active = 0;
     TAILQ_REMOVE(
-        &rx_reorder_timeout_ac->virtual_timer_list, list_elem,
-        reorder_timeout_list_elem);
-}
-
-static void
-ol_rx_reorder_timeout_start(
-    struct ol_tx_reorder_cat_timeout_t *rx_reorder_timeout_ac,
-    u_int32_t time_now_ms)
-{
-    u_int32_t duration_ms;
-    struct ol_rx_reorder_timeout_list_elem_t *list_elem;
-
-    list_elem = TAILQ_FIRST(&rx_reorder_timeout_ac->virtual_timer_list);
-
-    duration_ms = list_elem->timestamp_ms - time_now_ms;
-    adf_os_timer_start(&rx_reorder_timeout_ac->timer, duration_ms);
+        &wheel->slots[list_elem->slot], list_elem, reorder_timeout_list_elem);
+    wheel->num_elems--;
+    /*
+     * Leave the wheel timer alone even if the wheel is now empty -
+     * it will find nothing to expire and not restart itself.
+     */
 }
 
 static inline void
 ol_rx_reorder_timeout_add(struct ol_txrx_peer_t *peer, u_int8_t tid)
 {
     u_int32_t time_now_ms;
-    struct ol_txrx_pdev_t *pdev;
-    struct ol_tx_reorder_cat_timeout_t *rx_reorder_timeout_ac;
+    u_int32_t ticks;
+    struct ol_rx_reorder_timeout_wheel_t *wheel;
     struct ol_rx_reorder_timeout_list_elem_t *list_elem;
-    int ac;
-    int start;
 
-    pdev = peer->vdev->pdev;
-    ac = TXRX_TID_TO_WMM_AC(tid);
-    rx_reorder_timeout_ac = &pdev->rx.reorder_timeout.access_cats[ac];
+    wheel = &peer->vdev->pdev->rx.reorder_timeout;
     list_elem = &peer->tids_rx_reorder[tid].timeout;
 
     list_elem->active = 1;
     list_elem->peer = peer;
     list_elem->tid = tid;
 
-    /* set the expiration timestamp */
     time_now_ms = adf_os_ticks_to_msecs(adf_os_ticks());
-    list_elem->timestamp_ms = time_now_ms + rx_reorder_timeout_ac->duration_ms;
+    if (wheel->num_elems == 0) {
+        /* the wheel is idle - restart it from the current slot */
+        wheel->cur_slot_ms = time_now_ms;
+        adf_os_timer_mod(&wheel->timer, OL_RX_REORDER_TIMEOUT_TICK_MS);
+    }
 
-    /* add to the queue */
-    start = TAILQ_EMPTY(&rx_reorder_timeout_ac->virtual_timer_list);
-    TAILQ_INSERT_TAIL(
-        &rx_reorder_timeout_ac->virtual_timer_list,
-        list_elem, reorder_timeout_list_elem);
-    if (start) {
-        ol_rx_reorder_timeout_start(rx_reorder_timeout_ac, time_now_ms);
+    /*
+     * Pick a slot that gets expired no sooner than the AC's timeout,
+     * counting from the (possibly slightly stale) current wheel position.
+     */
+    ticks = (time_now_ms - wheel->cur_slot_ms +
+             OL_RX_REORDER_TIMEOUT_TICK_MS - 1) / OL_RX_REORDER_TIMEOUT_TICK_MS;
+    ticks += wheel->duration_ticks[TXRX_TID_TO_WMM_AC(tid)];
+    if (ticks > OL_RX_REORDER_TIMEOUT_SLOT_MASK) {
+        ticks = OL_RX_REORDER_TIMEOUT_SLOT_MASK;
     }
+    list_elem->slot = (wheel->cur_slot + ticks) & OL_RX_REORDER_TIMEOUT_SLOT_MASK;
+
+    TAILQ_INSERT_TAIL(
+        &wheel->slots[list_elem->slot], list_elem, reorder_timeout_list_elem);
+    wheel->num_elems++;
 }
 
 void
@@ -116,7 +121,7 @@ ol_rx_reorder_timeout_update(struct ol_txrx_peer_t *peer, u_int8_t tid)
      * If there are no holes, i.e. no queued frames,
      * then timeout doesn't apply.
      */
-    if (peer->tids_rx_reorder[tid].num_mpdus == 0) return;
+    if (peer->tids_rx_reorder[tid].present == 0) return;
 
     /*
      * If the virtual timer for this peer-TID is already running,
@@ -128,43 +133,20 @@ ol_rx_reorder_timeout_update(struct ol_txrx_peer_t *peer, u_int8_t tid)
 }
 
 static void
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
-ol_rx_reorder_timeout(struct timer_list *t)
-#else
-ol_rx_reorder_timeout(void *arg)
-#endif
+ol_rx_reorder_timeout_expire_slot(
+    struct ol_rx_reorder_timeout_wheel_t *wheel,
+    u_int32_t slot)
 {
-    struct ol_txrx_pdev_t *pdev;
-    struct ol_rx_reorder_timeout_list_elem_t *list_elem, *tmp;
-    u_int32_t time_now_ms;
-    struct ol_tx_reorder_cat_timeout_t *rx_reorder_timeout_ac;
-
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
-    rx_reorder_timeout_ac = from_timer(rx_reorder_timeout_ac, t, timer);
-#else
-    rx_reorder_timeout_ac = (struct ol_tx_reorder_cat_timeout_t *) arg;
-#endif
-    time_now_ms = adf_os_ticks_to_msecs(adf_os_ticks());
+    struct ol_rx_reorder_timeout_list_elem_t *list_elem;
 
-    pdev = rx_reorder_timeout_ac->pdev;
-    adf_os_spin_lock(&pdev->rx.mutex);
-// TODO: conditionally take mutex lock during regular rx
-    TAILQ_FOREACH_SAFE(
-        list_elem, &rx_reorder_timeout_ac->virtual_timer_list,
-        reorder_timeout_list_elem, tmp)
-    {
+    while ((list_elem = TAILQ_FIRST(&wheel->slots[slot]))) {
         unsigned idx_start, idx_end;
         struct ol_txrx_peer_t *peer;
 
-        if (list_elem->timestamp_ms > time_now_ms) {
-            break; /* time has not expired yet for this element */
-        }
-
         list_elem->active = 0;
-        /* remove the expired element from the list */
-        TAILQ_REMOVE(
-            &rx_reorder_timeout_ac->virtual_timer_list, list_elem,
-            reorder_timeout_list_elem);
+        /* remove the expired element from the wheel */
+        TAILQ_REMOVE(&wheel->slots[slot], list_elem, reorder_timeout_list_elem);
+        wheel->num_elems--;
 
         peer = list_elem->peer;
 
@@ -178,9 +160,49 @@ ol_rx_reorder_timeout(void *arg)
             idx_end,
             htt_rx_flush_release);
     }
-    /* restart the timer if unexpired elements are left in the list */
-    if (!TAILQ_EMPTY(&rx_reorder_timeout_ac->virtual_timer_list)) {
-        ol_rx_reorder_timeout_start(rx_reorder_timeout_ac, time_now_ms);
+}
+
+static void
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
+ol_rx_reorder_timeout(struct timer_list *t)
+#else
+ol_rx_reorder_timeout(void *arg)
+#endif
+{
+    struct ol_txrx_pdev_t *pdev;
+    struct ol_rx_reorder_timeout_wheel_t *wheel;
+    u_int32_t time_now_ms;
+    u_int32_t ticks;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
+    wheel = from_timer(wheel, t, timer);
+#else
+    wheel = (struct ol_rx_reorder_timeout_wheel_t *) arg;
+#endif
+    time_now_ms = adf_os_ticks_to_msecs(adf_os_ticks());
+
+    pdev = wheel->pdev;
+    adf_os_spin_lock(&pdev->rx.mutex);
+// TODO: conditionally take mutex lock during regular rx
+    /*
+     * Expire every slot the wheel has moved past since the last tick.
+     * The (deferrable) timer may have run late; once it is more than a
+     * full turn behind, each slot only needs to be expired once.
+     */
+    ticks = (time_now_ms - wheel->cur_slot_ms) / OL_RX_REORDER_TIMEOUT_TICK_MS;
+    if (ticks > OL_RX_REORDER_TIMEOUT_WHEEL_SLOTS) {
+        ticks = OL_RX_REORDER_TIMEOUT_WHEEL_SLOTS;
+        wheel->cur_slot_ms = time_now_ms -
+            OL_RX_REORDER_TIMEOUT_WHEEL_SLOTS * OL_RX_REORDER_TIMEOUT_TICK_MS;
+    }
+    while (ticks-- && wheel->num_elems) {
+        wheel->cur_slot = (wheel->cur_slot + 1) & OL_RX_REORDER_TIMEOUT_SLOT_MASK;
+        wheel->cur_slot_ms += OL_RX_REORDER_TIMEOUT_TICK_MS;
+        ol_rx_reorder_timeout_expire_slot(wheel, wheel->cur_slot);
+    }
+    /* keep the wheel turning while unexpired elements are left in it */
+    if (wheel->num_elems) {
+        adf_os_timer_mod(&wheel->timer, OL_RX_REORDER_TIMEOUT_TICK_MS);
     }
     adf_os_spin_unlock(&pdev->rx.mutex);
 }
@@ -188,23 +210,26 @@ ol_rx_reorder_timeout(void *arg)
 void
 ol_rx_reorder_timeout_init(struct ol_txrx_pdev_t *pdev)
 {
+    struct ol_rx_reorder_timeout_wheel_t *wheel;
     int i;
 
-    for (i = 0; i < ARRAY_LEN(pdev->rx.reorder_timeout.access_cats); i++) {
-        struct ol_tx_reorder_cat_timeout_t *rx_reorder_timeout_ac;
-        rx_reorder_timeout_ac = &pdev->rx.reorder_timeout.access_cats[i];
-        /* init the per-AC timers */
-        adf_os_timer_init(
-            pdev->osdev, &rx_reorder_timeout_ac->timer,
-            ol_rx_reorder_timeout, rx_reorder_timeout_ac, ADF_DEFERRABLE_TIMER);
-        /* init the virtual timer list */
-        TAILQ_INIT(&rx_reorder_timeout_ac->virtual_timer_list);
-        rx_reorder_timeout_ac->pdev = pdev;
+    wheel = &pdev->rx.reorder_timeout;
+    adf_os_timer_init(
+        pdev->osdev, &wheel->timer,
+        ol_rx_reorder_timeout, wheel, ADF_DEFERRABLE_TIMER);
+    for (i = 0; i < OL_RX_REORDER_TIMEOUT_WHEEL_SLOTS; i++) {
+        TAILQ_INIT(&wheel->slots[i]);
     }
-    pdev->rx.reorder_timeout.access_cats[TXRX_WMM_AC_VO].duration_ms = 40;
-    pdev->rx.reorder_timeout.access_cats[TXRX_WMM_AC_VI].duration_ms = 100;
-    pdev->rx.reorder_timeout.access_cats[TXRX_WMM_AC_BE].duration_ms = 100;
-    pdev->rx.reorder_timeout.access_cats[TXRX_WMM_AC_BK].duration_ms = 100;
+    wheel->cur_slot = 0;
+    wheel->cur_slot_ms = 0;
+    wheel->num_elems = 0;
+    wheel->pdev = pdev;
+
+    /* per-AC timeouts: VO 40 ms, all others 100 ms */
+    wheel->duration_ticks[TXRX_WMM_AC_VO] = 40 / OL_RX_REORDER_TIMEOUT_TICK_MS;
+    wheel->duration_ticks[TXRX_WMM_AC_VI] = 100 / OL_RX_REORDER_TIMEOUT_TICK_MS;
+    wheel->duration_ticks[TXRX_WMM_AC_BE] = 100 / OL_RX_REORDER_TIMEOUT_TICK_MS;
+    wheel->duration_ticks[TXRX_WMM_AC_BK] = 100 / OL_RX_REORDER_TIMEOUT_TICK_MS;
 }
 
 void
@@ -222,14 +247,10 @@ ol_rx_reorder_timeout_peer_cleanup(struct ol_txrx_peer_t *peer)
 void
 ol_rx_reorder_timeout_cleanup(struct ol_txrx_pdev_t *pdev)
 {
-    int i;
+    struct ol_rx_reorder_timeout_wheel_t *wheel = &pdev->rx.reorder_timeout;
 
-    for (i = 0; i < ARRAY_LEN(pdev->rx.reorder_timeout.access_cats); i++) {
-        struct ol_tx_reorder_cat_timeout_t *rx_reorder_timeout_ac;
-        rx_reorder_timeout_ac = &pdev->rx.reorder_timeout.access_cats[i];
-        adf_os_timer_cancel(&rx_reorder_timeout_ac->timer);
-        adf_os_timer_free(&rx_reorder_timeout_ac->timer);
-    }
+    adf_os_timer_cancel(&wheel->timer);
+    adf_os_timer_free(&wheel->timer);
 }
 
 #endif /* QCA_SUPPORT_OL_RX_REORDER_TIMEOUT */
@@ -168,6 +168,10 @@ ol_tx_queue_flush(struct ol_txrx_pdev_t *pdev)
 {
     struct ol_txrx_vdev_t *vdev;
 
+    adf_os_spin_lock_bh(&pdev->tx_queue_spinlock);
+    ol_tx_queue_staged_move(pdev);
+    adf_os_spin_unlock_bh(&pdev->tx_queue_spinlock);
+
     TAILQ_FOREACH(vdev, &pdev->vdev_list, vdev_list_elem) {
         ol_tx_queue_vdev_flush(pdev, vdev);
     }
@@ -183,6 +187,7 @@ ol_tx_queue_discard(
     u_int16_t discarded, actual_discarded = 0;
 
     adf_os_spin_lock_bh(&pdev->tx_queue_spinlock);
+    ol_tx_queue_staged_move(pdev);
 
     if (flush_all == A_TRUE) {
         /* flush all the pending tx queues in the scheduler */
@@ -229,7 +234,6 @@ ol_tx_enqueue(
     struct ol_txrx_msdu_info_t *tx_msdu_info)
 {
     int bytes;
-    struct ol_tx_sched_notify_ctx_t notify_ctx;
 #if defined(CONFIG_PER_VDEV_TX_DESC_POOL)
     ol_txrx_vdev_handle vdev;
 #endif
@@ -257,31 +261,67 @@ ol_tx_enqueue(
         //Discard Frames in Discard List
         ol_tx_desc_frame_list_free(pdev, &tx_descs, 1 /* error */);
     }
-    adf_os_spin_lock_bh(&pdev->tx_queue_spinlock);
-    TAILQ_INSERT_TAIL(&txq->head, tx_desc, tx_desc_list_elem);
-
+    /*
+     * Stage the frame rather than queue it under tx_queue_spinlock, which
+     * the scheduler holds while it selects frames to download.
+     * The first frame staged on a tx queue also puts the queue on the
+     * pdev's list, for ol_tx_queue_staged_move to find.
+     */
+    tx_desc->staged_ext_tid = tx_msdu_info->htt.info.ext_tid;
     bytes = adf_nbuf_len(tx_desc->netbuf);
-    txq->frms++;
-    txq->bytes += bytes;
     OL_TX_QUEUE_LOG_ENQUEUE(pdev, tx_msdu_info, 1, bytes);
 
-    if (txq->flag != ol_tx_queue_paused) {
-        notify_ctx.event = OL_TX_ENQUEUE_FRAME;
-        notify_ctx.frames = 1;
-        notify_ctx.bytes = adf_nbuf_len(tx_desc->netbuf);
-        notify_ctx.txq = txq;
-        notify_ctx.info.tx_msdu_info = tx_msdu_info;
-        ol_tx_sched_notify(pdev, &notify_ctx);
-        txq->flag = ol_tx_queue_active;
+    if (adf_os_llist_add(&tx_desc->staged_elem, &txq->staged)) {
+        adf_os_llist_add(&txq->staged_elem, &pdev->tx_queue.staged_txqs);
     }
 
     if (!ETHERTYPE_IS_EAPOL_WAPI(tx_msdu_info->htt.info.ethertype)) {
         OL_TX_QUEUE_ADDBA_CHECK(pdev, txq, tx_msdu_info);
     }
-    adf_os_spin_unlock_bh(&pdev->tx_queue_spinlock);
     TX_SCHED_DEBUG_PRINT("Leave %s\n", __func__);
 }
 
+void
+ol_tx_queue_staged_move(struct ol_txrx_pdev_t *pdev)
+{
+    adf_os_llist_node_t *txq_node, *next_txq_node, *desc_node;
+    struct ol_tx_sched_notify_ctx_t notify_ctx;
+    struct ol_tx_frms_queue_t *txq;
+    struct ol_tx_desc_t *tx_desc;
+    int bytes;
+
+    txq_node = adf_os_llist_del_all(&pdev->tx_queue.staged_txqs);
+    while (txq_node) {
+        txq = container_of(txq_node, struct ol_tx_frms_queue_t, staged_elem);
+        /*
+         * As soon as its staged list is emptied, ol_tx_enqueue may put
+         * the tx queue back on the pdev's list, so step past it first.
+         */
+        next_txq_node = adf_os_llist_next(txq_node);
+        desc_node = adf_os_llist_reverse(adf_os_llist_del_all(&txq->staged));
+        while (desc_node) {
+            tx_desc = container_of(desc_node, struct ol_tx_desc_t, staged_elem);
+            desc_node = adf_os_llist_next(desc_node);
+
+            TAILQ_INSERT_TAIL(&txq->head, tx_desc, tx_desc_list_elem);
+            bytes = adf_nbuf_len(tx_desc->netbuf);
+            txq->frms++;
+            txq->bytes += bytes;
+
+            if (txq->flag != ol_tx_queue_paused) {
+                notify_ctx.event = OL_TX_ENQUEUE_FRAME;
+                notify_ctx.frames = 1;
+                notify_ctx.bytes = bytes;
+                notify_ctx.txq = txq;
+                notify_ctx.info.ext_tid = tx_desc->staged_ext_tid;
+                ol_tx_sched_notify(pdev, &notify_ctx);
+                txq->flag = ol_tx_queue_active;
+            }
+        }
+        txq_node = next_txq_node;
+    }
+}
+
 u_int16_t
 ol_tx_dequeue(
     struct ol_txrx_pdev_t *pdev,
@@ -372,6 +412,8 @@ ol_tx_queue_free(
     TAILQ_INIT(&tx_tmp_list);
     TX_SCHED_DEBUG_PRINT("Enter %s\n", __func__);
     adf_os_spin_lock_bh(&pdev->tx_queue_spinlock);
+    /* the queue must not be left on the pdev's staged list */
+    ol_tx_queue_staged_move(pdev);
 
     notify_ctx.event = OL_TX_DELETE_QUEUE;
     notify_ctx.txq = txq;
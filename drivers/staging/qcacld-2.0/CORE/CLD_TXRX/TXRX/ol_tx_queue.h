@@ -40,6 +40,10 @@
 
 /**
  * @brief Queue a tx frame to the tid queue.
+ * @details
+ *  The frame is staged on the tx queue's lock-less list rather than
+ *  inserted under tx_queue_spinlock; it becomes visible to the scheduler
+ *  once ol_tx_queue_staged_move has run.
  *
  * @param pdev - the data virtual device sending the data
  *      (for storing the tx desc in the virtual dev's tx_target_list,
@@ -55,6 +59,20 @@ ol_tx_enqueue(
     struct ol_tx_desc_t *tx_desc,
     struct ol_txrx_msdu_info_t *tx_msdu_info);
 
+/**
+ * @brief - move staged tx frames into their tx queues
+ * @details
+ *  Moves the frames that ol_tx_enqueue staged on every tx queue into
+ *  the queue proper, in the order they were enqueued, and notifies the
+ *  scheduler of them.
+ *  Must be called with tx_queue_spinlock held, before looking at the
+ *  frames of any tx queue.
+ *
+ * @param pdev - the physical device object, which stores the txqs
+ */
+void
+ol_tx_queue_staged_move(struct ol_txrx_pdev_t *pdev);
+
 /**
  * @brief - remove the specified number of frames from the head of a tx queue
  * @details
@@ -124,6 +142,7 @@ ol_tx_queue_discard(
 #else
 
 #define ol_tx_enqueue(pdev, txq, tx_desc, tx_msdu_info) /* no-op */
+#define ol_tx_queue_staged_move(pdev) /* no-op */
 #define ol_tx_dequeue(pdev, ext_tid, txq, head, num_frames, credit, bytes) 0
 #define ol_tx_queue_free(pdev, txq, tid, is_peer_txq) /* no-op */
 #define ol_tx_queue_discard(pdev, flush, tx_descs) /* no-op */
@@ -132,12 +132,7 @@ typedef TAILQ_HEAD(ol_tx_frms_queue_list_s, ol_tx_frms_queue_t)
 #define OL_TX_SCHED_NUM_CATEGORIES OL_TX_SCHED_WRR_ADV_NUM_CATEGORIES
 
 #define ol_tx_sched_init                ol_tx_sched_init_wrr_adv
-#define ol_tx_sched_select_init(pdev) \
-    do { \
-        adf_os_spin_lock_bh(&pdev->tx_queue_spinlock); \
-        ol_tx_sched_select_init_wrr_adv(pdev); \
-        adf_os_spin_unlock_bh(&pdev->tx_queue_spinlock); \
-    } while (0)
+#define ol_tx_sched_select_init         ol_tx_sched_select_init_wrr_adv
 #define ol_tx_sched_select_batch        ol_tx_sched_select_batch_wrr_adv
 #define ol_tx_sched_txq_enqueue         ol_tx_sched_txq_enqueue_wrr_adv
 #define ol_tx_sched_txq_deactivate      ol_tx_sched_txq_deactivate_wrr_adv
@@ -1356,8 +1351,8 @@ ol_tx_sched_notify(
 
     switch (ctx->event) {
     case OL_TX_ENQUEUE_FRAME:
-        tid = ctx->info.tx_msdu_info->htt.info.ext_tid;
-        ol_tx_sched_txq_enqueue(pdev, txq, tid, 1, ctx->bytes);
+        tid = ctx->info.ext_tid;
+        ol_tx_sched_txq_enqueue(pdev, txq, tid, ctx->frames, ctx->bytes);
         break;
     case OL_TX_DELETE_QUEUE:
         tid = ctx->info.ext_tid;
@@ -1500,16 +1495,27 @@ ol_tx_sched(struct ol_txrx_pdev_t *pdev)
     //ol_tx_queues_display(pdev);
     adf_os_spin_unlock_bh(&pdev->tx_queue_spinlock);
 
-    TAILQ_INIT(&sctx.head);
-    sctx.frms = 0;
+    /*
+     * Select frames for as much credit as is available in one go, under
+     * a single hold of tx_queue_spinlock, and download them to the target
+     * as one batch.  Credit returned by the target while the batch was
+     * being downloaded does not get to run the scheduler, which is busy,
+     * so go round again until either the credit or the frames run out.
+     */
+    for (;;) {
+        TAILQ_INIT(&sctx.head);
+        sctx.frms = 0;
 
-    ol_tx_sched_select_init(pdev);
-    while (adf_os_atomic_read(&pdev->target_tx_credit) > 0) {
-        int num_credits;
         adf_os_spin_lock_bh(&pdev->tx_queue_spinlock);
-        credit = adf_os_atomic_read(&pdev->target_tx_credit);
-        num_credits = ol_tx_sched_select_batch(pdev, &sctx, credit);
-        if (num_credits > 0){
+        ol_tx_queue_staged_move(pdev);
+        ol_tx_sched_select_init(pdev);
+        while ((credit = adf_os_atomic_read(&pdev->target_tx_credit)) > 0) {
+            int num_credits;
+
+            num_credits = ol_tx_sched_select_batch(pdev, &sctx, credit);
+            if (num_credits <= 0) {
+                break;
+            }
 #if DEBUG_HTT_CREDIT
             VOS_TRACE(VOS_MODULE_ID_TXRX, VOS_TRACE_LEVEL_INFO,
                 " <HTT> Decrease credit %d - %d = %d.\n",
@@ -1519,18 +1525,22 @@ ol_tx_sched(struct ol_txrx_pdev_t *pdev)
 #endif
             adf_os_atomic_add(-num_credits, &pdev->target_tx_credit);
         }
+        if (sctx.frms == 0) {
+            /*
+             * Go idle with the staged frames moved under the same lock
+             * hold, so that frames staged from now on find the scheduler
+             * idle and invoke it themselves.
+             */
+            //adf_os_print("AFTER tx sched:\n");
+            //ol_tx_queues_display(pdev);
+            pdev->tx_sched.tx_sched_status = ol_tx_scheduler_idle;
+            adf_os_spin_unlock_bh(&pdev->tx_queue_spinlock);
+            break;
+        }
         adf_os_spin_unlock_bh(&pdev->tx_queue_spinlock);
 
-        if (num_credits == 0) break;
+        ol_tx_sched_dispatch(pdev, &sctx);
     }
-    ol_tx_sched_dispatch(pdev, &sctx);
-
-    adf_os_spin_lock_bh(&pdev->tx_queue_spinlock);
-    //adf_os_print("AFTER tx sched:\n");
-    //ol_tx_queues_display(pdev);
-
-    pdev->tx_sched.tx_sched_status = ol_tx_scheduler_idle;
-    adf_os_spin_unlock_bh(&pdev->tx_queue_spinlock);
     TX_SCHED_DEBUG_PRINT("Leave %s\n", __func__);
 }
 
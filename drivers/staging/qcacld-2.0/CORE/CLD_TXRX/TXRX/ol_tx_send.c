@@ -59,6 +59,7 @@
 #include <ol_txrx_encap.h>    /* OL_TX_RESTORE_HDR, etc*/
 #endif
 #include <ol_tx_queue.h>
+#include <htc_tx_batch.h>     /* HTCTxBatchBegin, HTCTxBatchEnd */
 #include <ol_txrx.h>
 #include <pktlog_ac_fmt.h>
 
@@ -239,7 +240,13 @@ ol_tx_send_batch(
     adf_nbuf_t rejected;
     OL_TX_CREDIT_RECLAIM(pdev);
 
+    /*
+     * Have HTC hold the frames back until the whole batch is queued, so
+     * that it goes to the target in as few bundles as possible.
+     */
+    HTCTxBatchBegin(pdev->htt_pdev->htc_pdev, pdev->htt_pdev->htc_endpoint);
     rejected = htt_tx_send_batch(pdev->htt_pdev, head_msdu, num_msdus);
+    HTCTxBatchEnd(pdev->htt_pdev->htc_pdev, pdev->htt_pdev->htc_endpoint);
     while (adf_os_unlikely(rejected)) {
         struct ol_tx_desc_t *tx_desc;
         u_int16_t *msdu_id_storage;
@@ -699,6 +699,7 @@ ol_txrx_pdev_attach(
 
     if (ol_cfg_is_high_latency(ctrl_pdev)) {
         adf_os_spinlock_init(&pdev->tx_queue_spinlock);
+        adf_os_llist_init(&pdev->tx_queue.staged_txqs);
         pdev->tx_sched.scheduler = ol_tx_sched_attach(pdev);
         if (pdev->tx_sched.scheduler == NULL) {
             goto sched_attach_fail;
@@ -1235,6 +1236,7 @@ ol_txrx_vdev_attach(
         u_int8_t i;
         for (i = 0; i < OL_TX_VDEV_NUM_QUEUES; i++) {
             TAILQ_INIT(&vdev->txqs[i].head);
+            adf_os_llist_init(&vdev->txqs[i].staged);
             vdev->txqs[i].paused_count.total = 0;
             vdev->txqs[i].frms = 0;
             vdev->txqs[i].bytes = 0;
@@ -1551,6 +1553,7 @@ ol_txrx_peer_attach(
         adf_os_spin_lock_bh(&pdev->tx_queue_spinlock);
         for (i = 0; i < OL_TX_NUM_TIDS; i++) {
             TAILQ_INIT(&peer->txqs[i].head);
+            adf_os_llist_init(&peer->txqs[i].staged);
             peer->txqs[i].paused_count.total = 0;
             peer->txqs[i].frms = 0;
             peer->txqs[i].bytes = 0;
@@ -40,6 +40,7 @@
 #include <wdi_event_api.h>    /* wdi_event_subscribe */
 #include <adf_os_timer.h>     /* adf_os_timer_t */
 #include <adf_os_lock.h>      /* adf_os_spinlock */
+#include <adf_os_llist.h>     /* adf_os_llist_head_t */
 #include <pktlog.h>	      /* ol_pktlog_dev_handle */
 #include <ol_txrx_stats.h>
 #include <txrx.h>
@@ -205,6 +206,15 @@ struct ol_tx_desc_t {
 	void *txq;
 	uint8_t rtap[MAX_RADIOTAP_LEN];
 	uint8_t rtap_len;
+#if defined(CONFIG_HL_SUPPORT)
+	/*
+	 * ol_tx_enqueue() stages the frame on its tx queue's lock-less
+	 * list, together with the ext TID it was classified to, until the
+	 * scheduler moves it into the tx queue proper.
+	 */
+	adf_os_llist_node_t staged_elem;
+	u_int8_t staged_ext_tid;
+#endif
 };
 
 typedef TAILQ_HEAD(, ol_tx_desc_t) ol_tx_desc_list;
@@ -230,10 +240,10 @@ union ol_txrx_align_mac_addr_t {
 struct ol_rx_reorder_timeout_list_elem_t
 {
 	TAILQ_ENTRY(ol_rx_reorder_timeout_list_elem_t) reorder_timeout_list_elem;
-	u_int32_t timestamp_ms;
 	struct ol_txrx_peer_t *peer;
 	u_int8_t tid;
 	u_int8_t active;
+	u_int8_t slot; /* timer wheel slot holding this element */
 };
 
 #define TXRX_TID_TO_WMM_AC(_tid) (\
@@ -268,10 +278,24 @@ A_COMPILE_TIME_ASSERT(ol_tx_sched_htt_ac_values,
     ((int)OL_TX_SCHED_WRR_ADV_CAT_MCAST_DATA == (int)HTT_AC_EXT_MCAST_DATA) &&
     ((int)OL_TX_SCHED_WRR_ADV_CAT_MCAST_MGMT == (int)HTT_AC_EXT_MCAST_MGMT));
 
-struct ol_tx_reorder_cat_timeout_t {
-	TAILQ_HEAD(, ol_rx_reorder_timeout_list_elem_t) virtual_timer_list;
+/*
+ * The rx reorder timeouts of all peer-TIDs are kept in a single timer
+ * wheel per pdev.  Each slot spans OL_RX_REORDER_TIMEOUT_TICK_MS, and
+ * the wheel as a whole has to span more than the longest per-AC timeout.
+ */
+#define OL_RX_REORDER_TIMEOUT_TICK_MS     10
+#define OL_RX_REORDER_TIMEOUT_WHEEL_SLOTS 16 /* must be a power of 2 */
+
+struct ol_rx_reorder_timeout_wheel_t {
+	TAILQ_HEAD(, ol_rx_reorder_timeout_list_elem_t)
+		slots[OL_RX_REORDER_TIMEOUT_WHEEL_SLOTS];
 	adf_os_timer_t timer;
-	u_int32_t duration_ms;
+	/* slot most recently expired, and when it was expired */
+	u_int32_t cur_slot;
+	u_int32_t cur_slot_ms;
+	u_int32_t num_elems;
+	/* per-AC timeout, in wheel ticks */
+	u_int8_t duration_ticks[TXRX_NUM_WMM_AC];
 	struct ol_txrx_pdev_t *pdev;
 };
 
@@ -333,6 +357,14 @@ struct ol_tx_frms_queue_t {
 #if defined(CONFIG_HL_SUPPORT) && defined(QCA_BAD_PEER_TX_FLOW_CL)
 	struct ol_txrx_peer_t *peer;
 #endif
+	/*
+	 * staged - tx frames enqueued without holding tx_queue_spinlock,
+	 * not yet moved into head.
+	 * staged_elem - links the queue into pdev->tx_queue.staged_txqs
+	 * while staged is non-empty.
+	 */
+	adf_os_llist_head_t staged;
+	adf_os_llist_node_t staged_elem;
 };
 
 enum {
@@ -602,9 +634,7 @@ struct ol_txrx_pdev_t {
 			int dup_check;
 		} flags;
 
-		struct {
-			struct ol_tx_reorder_cat_timeout_t access_cats[TXRX_NUM_WMM_AC];
-		} reorder_timeout;
+		struct ol_rx_reorder_timeout_wheel_t reorder_timeout;
 		adf_os_spinlock_t mutex;
 	} rx;
 
@@ -778,6 +808,8 @@ struct ol_txrx_pdev_t {
 	        u_int16_t rsrc_threshold_lo;
 		/* threshold_hi - where to stop during tx desc margin replenishment */
 	        u_int16_t rsrc_threshold_hi;
+		/* tx queues with frames staged by ol_tx_enqueue */
+		adf_os_llist_head_t staged_txqs;
 	} tx_queue;
 
 #if defined(DEBUG_HL_LOGGING) && defined(CONFIG_HL_SUPPORT)
@@ -1097,6 +1129,8 @@ struct ol_rx_reorder_t {
 	u_int8_t win_sz;
 	u_int8_t win_sz_mask;
 	u_int8_t num_mpdus;
+	/* bitmap of the reorder array slots that hold frames */
+	u_int64_t present;
 	struct ol_rx_reorder_array_elem_t *array;
 	/* base - single rx reorder element used for non-aggr cases */
 	struct ol_rx_reorder_array_elem_t base;
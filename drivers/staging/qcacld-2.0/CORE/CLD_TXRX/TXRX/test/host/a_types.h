@@ -0,0 +1,21 @@
+/* Host stand-in for a_types.h, just what the tx scheduler test needs. */
+
+#ifndef _A_TYPES_H_
+#define _A_TYPES_H_
+
+#include <adf_os_types.h>
+
+typedef int8_t   A_INT8;
+typedef int16_t  A_INT16;
+typedef int32_t  A_INT32;
+typedef uint8_t  A_UINT8;
+typedef uint16_t A_UINT16;
+typedef uint32_t A_UINT32;
+typedef uint64_t A_UINT64;
+typedef bool     A_BOOL;
+typedef int      A_STATUS;
+
+#define A_COMPILE_TIME_ASSERT(assertion_name, predicate) \
+    typedef char assertion_name[(predicate) ? 1 : -1]
+
+#endif
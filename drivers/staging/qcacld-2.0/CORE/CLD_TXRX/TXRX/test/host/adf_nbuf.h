@@ -0,0 +1,78 @@
+/* Host stand-in for adf_nbuf.h, just what the tx scheduler test needs. */
+
+#ifndef _ADF_NBUF_H
+#define _ADF_NBUF_H
+
+#include <adf_os_types.h>
+#include <adf_os_util.h>
+#include <adf_os_lock.h>
+#include <adf_net_types.h>
+#include <adf_os_mem.h>
+
+/* a network buffer is just its length and the link to the next one */
+struct adf_nbuf {
+    struct adf_nbuf *next;
+    u_int32_t len;
+    u_int32_t seq;
+    u_int16_t msdu_id;
+};
+typedef struct adf_nbuf *adf_nbuf_t;
+
+#define ADF_NBUF_PKT_ERROR 1
+
+#define NBUF_MAPPED_PADDR_LO(buf) 1
+
+static inline size_t
+adf_nbuf_len(adf_nbuf_t buf)
+{
+    return buf->len;
+}
+
+static inline adf_nbuf_t
+adf_nbuf_next(adf_nbuf_t buf)
+{
+    return buf->next;
+}
+
+static inline void
+adf_nbuf_set_next(adf_nbuf_t buf, adf_nbuf_t next)
+{
+    buf->next = next;
+}
+
+static inline a_uint8_t *
+adf_nbuf_data(adf_nbuf_t buf)
+{
+    return NULL;
+}
+
+static inline void
+adf_nbuf_unmap(adf_os_device_t osdev, adf_nbuf_t buf, int dir)
+{
+}
+
+static inline void
+adf_nbuf_tx_free(adf_nbuf_t buf, int tx_err)
+{
+    free(buf);
+}
+
+static inline int
+adf_nbuf_is_ipa_nbuf(adf_nbuf_t buf)
+{
+    return 0;
+}
+
+static inline a_uint8_t *
+adf_nbuf_get_frag_vaddr(adf_nbuf_t buf, int frag_num)
+{
+    return NULL;
+}
+
+static inline int
+adf_nbuf_get_frag_len(adf_nbuf_t buf, int frag_num)
+{
+    return 0;
+}
+
+#endif
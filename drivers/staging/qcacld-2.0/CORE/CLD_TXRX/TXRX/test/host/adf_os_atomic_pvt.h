@@ -0,0 +1,22 @@
+/* Host stand-in for adf_os_atomic_pvt.h, just what the tx scheduler test needs. */
+
+#ifndef _ADF_CMN_OS_ATOMIC_PVT_H
+#define _ADF_CMN_OS_ATOMIC_PVT_H
+
+#include <adf_os_types.h>
+
+typedef struct { int counter; } __adf_os_atomic_t;
+
+#define __adf_os_atomic_init(v)      ((v)->counter = 0)
+#define __adf_os_atomic_read(v)      __atomic_load_n(&(v)->counter, __ATOMIC_SEQ_CST)
+#define __adf_os_atomic_set(v, i)    __atomic_store_n(&(v)->counter, i, __ATOMIC_SEQ_CST)
+#define __adf_os_atomic_inc(v)       __atomic_add_fetch(&(v)->counter, 1, __ATOMIC_SEQ_CST)
+#define __adf_os_atomic_dec(v)       __atomic_sub_fetch(&(v)->counter, 1, __ATOMIC_SEQ_CST)
+#define __adf_os_atomic_add(i, v)    __atomic_add_fetch(&(v)->counter, i, __ATOMIC_SEQ_CST)
+#define __adf_os_atomic_sub(i, v)    __atomic_sub_fetch(&(v)->counter, i, __ATOMIC_SEQ_CST)
+#define __adf_os_atomic_dec_and_test(v) \
+    (__atomic_sub_fetch(&(v)->counter, 1, __ATOMIC_SEQ_CST) == 0)
+#define __adf_os_atomic_inc_return(v) \
+    __atomic_add_fetch(&(v)->counter, 1, __ATOMIC_SEQ_CST)
+
+#endif
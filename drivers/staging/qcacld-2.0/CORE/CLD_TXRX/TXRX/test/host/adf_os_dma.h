@@ -0,0 +1,8 @@
+/* Host stand-in for adf_os_dma.h, just what the tx scheduler test needs. */
+
+#ifndef _ADF_OS_DMA_H
+#define _ADF_OS_DMA_H
+
+#include <adf_os_types.h>
+
+#endif
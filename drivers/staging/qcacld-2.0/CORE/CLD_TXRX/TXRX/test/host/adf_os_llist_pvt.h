@@ -0,0 +1,67 @@
+/* Host stand-in for adf_os_llist_pvt.h, just what the tx scheduler test needs. */
+
+#ifndef ADF_OS_LLIST_PVT_H
+#define ADF_OS_LLIST_PVT_H
+
+#include <adf_os_types.h> /* a_bool_t */
+
+/* the linux/llist.h operations used by adf, on gcc atomics */
+typedef struct __adf_os_llist_node {
+    struct __adf_os_llist_node *next;
+} __adf_os_llist_node_t;
+
+typedef struct {
+    __adf_os_llist_node_t *first;
+} __adf_os_llist_head_t;
+
+static inline void
+__adf_os_llist_init(__adf_os_llist_head_t *head)
+{
+    head->first = NULL;
+}
+
+static inline a_bool_t
+__adf_os_llist_add(__adf_os_llist_node_t *node, __adf_os_llist_head_t *head)
+{
+    __adf_os_llist_node_t *first = __atomic_load_n(&head->first,
+                                                   __ATOMIC_RELAXED);
+
+    do {
+        node->next = first;
+    } while (!__atomic_compare_exchange_n(&head->first, &first, node, 0,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    return !first;
+}
+
+static inline __adf_os_llist_node_t *
+__adf_os_llist_del_all(__adf_os_llist_head_t *head)
+{
+    return __atomic_exchange_n(&head->first, NULL, __ATOMIC_ACQUIRE);
+}
+
+static inline __adf_os_llist_node_t *
+__adf_os_llist_reverse(__adf_os_llist_node_t *node)
+{
+    __adf_os_llist_node_t *new_head = NULL, *tmp;
+
+    while (node) {
+        tmp = node;
+        node = node->next;
+        tmp->next = new_head;
+        new_head = tmp;
+    }
+    return new_head;
+}
+
+static inline __adf_os_llist_node_t *
+__adf_os_llist_next(__adf_os_llist_node_t *node)
+{
+    return node->next;
+}
+
+static inline a_bool_t
+__adf_os_llist_empty(__adf_os_llist_head_t *head)
+{
+    return __atomic_load_n(&head->first, __ATOMIC_RELAXED) == NULL;
+}
+#endif
@@ -0,0 +1,50 @@
+/* Host stand-in for adf_os_lock_pvt.h, just what the tx scheduler test needs. */
+
+#ifndef _ADF_CMN_OS_LOCK_PVT_H
+#define _ADF_CMN_OS_LOCK_PVT_H
+
+#include <pthread.h>
+
+typedef struct {
+    pthread_mutex_t lock;
+    unsigned long   flags;
+} __adf_os_spinlock_t;
+
+typedef pthread_mutex_t __adf_os_mutex_t;
+
+#define __adf_os_init_mutex(m)                 pthread_mutex_init(m, NULL)
+#define __adf_os_mutex_acquire(osdev, m)       pthread_mutex_lock(m)
+#define __adf_os_mutex_acquire_timeout(osdev, m, t) pthread_mutex_lock(m)
+#define __adf_os_mutex_release(osdev, m)       pthread_mutex_unlock(m)
+
+#define __adf_os_spinlock_init(l)    pthread_mutex_init(&(l)->lock, NULL)
+#define __adf_os_spinlock_destroy(l) pthread_mutex_destroy(&(l)->lock)
+#define __adf_os_spin_lock(l)        pthread_mutex_lock(&(l)->lock)
+#define __adf_os_spin_unlock(l)      pthread_mutex_unlock(&(l)->lock)
+#define __adf_os_spin_lock_bh(l)     pthread_mutex_lock(&(l)->lock)
+#define __adf_os_spin_unlock_bh(l)   pthread_mutex_unlock(&(l)->lock)
+#define __adf_os_spin_lock_irqsave(l)       pthread_mutex_lock(&(l)->lock)
+#define __adf_os_spin_unlock_irqrestore(l)  pthread_mutex_unlock(&(l)->lock)
+#define __adf_os_spin_lock_irq(l, f)        pthread_mutex_lock(&(l)->lock)
+#define __adf_os_spin_unlock_irq(l, f)      pthread_mutex_unlock(&(l)->lock)
+#define __adf_os_raw_spin_lock(l)           __adf_os_spin_lock(l)
+#define __adf_os_raw_spin_unlock(l)         __adf_os_spin_unlock(l)
+#define __adf_os_raw_spin_lock_bh(l)        __adf_os_spin_lock_bh(l)
+#define __adf_os_raw_spin_unlock_bh(l)      __adf_os_spin_unlock_bh(l)
+#define __adf_os_raw_spin_lock_irqsave(l, f)     __adf_os_spin_lock(l)
+#define __adf_os_raw_spin_unlock_irqrestore(l, f) __adf_os_spin_unlock(l)
+#define __adf_os_in_softirq()               0
+
+static inline a_bool_t
+__adf_os_spinlock_irq_exec(adf_os_handle_t hdl, __adf_os_spinlock_t *lock,
+                           adf_os_irqlocked_func_t func, void *arg)
+{
+    a_bool_t ret;
+
+    pthread_mutex_lock(&lock->lock);
+    ret = func(arg);
+    pthread_mutex_unlock(&lock->lock);
+    return ret;
+}
+
+#endif
@@ -0,0 +1,28 @@
+/* Host stand-in for adf_os_mem.h, just what the tx scheduler test needs. */
+
+#ifndef _ADF_OS_MEM_H
+#define _ADF_OS_MEM_H
+
+#include <adf_os_types.h>
+
+struct adf_os_mem_dma_page_t {
+    char *page_v_addr_start;
+    char *page_v_addr_end;
+    adf_os_dma_addr_t page_p_addr;
+};
+
+struct adf_os_mem_multi_page_t {
+    u_int16_t num_element_per_page;
+    u_int16_t num_pages;
+    void **cacheable_pages;
+    struct adf_os_mem_dma_page_t *dma_pages;
+    adf_os_size_t page_size;
+};
+
+#define adf_os_mem_alloc(osdev, size)       calloc(1, size)
+#define adf_os_mem_free(buf)                free(buf)
+#define adf_os_mem_set(ptr, value, num)     memset(ptr, value, num)
+#define adf_os_mem_zero(ptr, num)           memset(ptr, 0, num)
+#define adf_os_mem_copy(dst, src, num)      memcpy(dst, src, num)
+
+#endif
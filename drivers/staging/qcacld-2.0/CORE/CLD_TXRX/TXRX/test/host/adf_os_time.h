@@ -0,0 +1,12 @@
+/* Host stand-in for adf_os_time.h, just what the tx scheduler test needs. */
+
+#ifndef _ADF_OS_TIME_H
+#define _ADF_OS_TIME_H
+
+#include <adf_os_types.h>
+
+typedef unsigned long adf_os_time_t;
+
+#define adf_os_gettimestamp() 0
+
+#endif
@@ -0,0 +1,23 @@
+/* Host stand-in for adf_os_timer.h, just what the tx scheduler test needs. */
+
+#ifndef _ADF_OS_TIMER_H
+#define _ADF_OS_TIMER_H
+
+#include <adf_os_types.h>
+#include <adf_os_time.h>
+
+typedef enum {
+    ADF_DEFERRABLE_TIMER = 0,
+    ADF_NON_DEFERRABLE_TIMER
+} adf_os_timer_type_t;
+
+typedef struct { int pending; } adf_os_timer_t;
+typedef struct { int pending; } adf_os_hrtimer_t;
+
+#define adf_os_timer_init(osdev, timer, func, arg, type) ((timer)->pending = 0)
+#define adf_os_timer_start(timer, msec)  ((timer)->pending = 1)
+#define adf_os_timer_mod(timer, msec)    ((timer)->pending = 1)
+#define adf_os_timer_cancel(timer)       ((timer)->pending = 0)
+#define adf_os_timer_free(timer)         ((timer)->pending = 0)
+
+#endif
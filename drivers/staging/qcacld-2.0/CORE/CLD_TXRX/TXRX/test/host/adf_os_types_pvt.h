@@ -0,0 +1,69 @@
+/* Host stand-in for adf_os_types_pvt.h, just what the tx scheduler test needs. */
+
+#ifndef _ADF_CMN_OS_TYPES_PVT_H
+#define _ADF_CMN_OS_TYPES_PVT_H
+
+#include "host.h"
+
+#define __iomem
+
+#define __ADF_OS_MAX_SCATTER        1
+#define __ADF_OS_NAME_SIZE          16
+
+#define ADF_LITTLE_ENDIAN_MACHINE
+
+#define __adf_os_packed          __attribute__ ((packed))
+#define __adf_os_ull(_num)       _num ## ULL
+
+typedef struct { int done; } __adf_os_comp_t;
+typedef void *                  __adf_os_device_t;
+typedef uintptr_t               __adf_os_dma_addr_t;
+typedef size_t                  __adf_os_dma_size_t;
+typedef uintptr_t               __adf_os_dma_context_t;
+typedef void *                  __adf_os_dma_map_t;
+typedef size_t                  __adf_os_size_t;
+typedef off_t                   __adf_os_off_t;
+typedef uint8_t *               __adf_os_iomem_t;
+
+typedef uint8_t                 __a_uint8_t;
+typedef int8_t                  __a_int8_t;
+typedef uint16_t                __a_uint16_t;
+typedef int16_t                 __a_int16_t;
+typedef uint32_t                __a_uint32_t;
+typedef int32_t                 __a_int32_t;
+typedef uint64_t                __a_uint64_t;
+typedef int64_t                 __a_int64_t;
+
+enum {
+    __ADF_SYNC_PREREAD,
+    __ADF_SYNC_PREWRITE,
+    __ADF_SYNC_POSTREAD,
+    __ADF_SYNC_POSTWRITE,
+};
+
+enum {
+    __ADF_OS_DMA_BIDIRECTIONAL,
+    __ADF_OS_DMA_TO_DEVICE,
+    __ADF_OS_DMA_FROM_DEVICE,
+};
+
+enum {
+    __ADF_IEEE80211_ASSOC,
+    __ADF_IEEE80211_REASSOC,
+    __ADF_IEEE80211_DISASSOC,
+    __ADF_IEEE80211_JOIN,
+    __ADF_IEEE80211_LEAVE,
+    __ADF_IEEE80211_SCAN,
+    __ADF_IEEE80211_REPLAY,
+    __ADF_IEEE80211_MICHAEL,
+    __ADF_IEEE80211_REJOIN,
+    __ADF_CUSTOM_PUSH_BUTTON,
+};
+
+#define __adf_os_print               printf
+#define __adf_os_vprint              vprintf
+#define __adf_os_snprint             snprintf
+#define __adf_os_vsnprint            vsnprintf
+#define __adf_os_inline              inline
+
+#endif
@@ -0,0 +1,34 @@
+/* Host stand-in for adf_os_util_pvt.h, just what the tx scheduler test needs. */
+
+#ifndef _ADF_CMN_OS_UTIL_PVT_H
+#define _ADF_CMN_OS_UTIL_PVT_H
+
+#include <assert.h>
+#include <adf_os_types.h>
+
+#define __adf_os_unlikely(_expr)   __builtin_expect(!!(_expr), 0)
+#define __adf_os_likely(_expr)     __builtin_expect(!!(_expr), 1)
+
+#define __adf_os_wmb()             __atomic_thread_fence(__ATOMIC_RELEASE)
+#define __adf_os_rmb()             __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define __adf_os_mb()              __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#define __adf_os_min(_a, _b)       ((_a) < (_b) ? (_a) : (_b))
+#define __adf_os_max(_a, _b)       ((_a) > (_b) ? (_a) : (_b))
+#define __adf_os_abs(_a)           ((_a) < 0 ? -(_a) : (_a))
+
+#define __adf_os_assert(expr)      assert(expr)
+#define __adf_os_warn(expr)        ((void)(expr))
+#define __adf_os_function          __func__
+
+#define __adf_os_get_rand(hdl, ptr, len) \
+    do { (void)(hdl); memset(ptr, 0, len); } while (0)
+#define __adf_os_ffs64(_a)         __builtin_ffsll(_a)
+#define __adf_os_int_sqrt(_x)      0
+
+#define __adf_os_init_completion(c)    ((c)->done = 0)
+#define __adf_os_re_init_completion(c) ((c).done = 0)
+#define __adf_os_wait_for_completion_timeout(c, t) ((c)->done)
+#define __adf_os_complete(c)           ((c)->done = 1)
+
+#endif
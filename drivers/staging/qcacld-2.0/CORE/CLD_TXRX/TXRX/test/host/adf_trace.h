@@ -0,0 +1,8 @@
+/* Host stand-in for adf_trace.h, just what the tx scheduler test needs. */
+
+#ifndef _ADF_TRACE_H
+#define _ADF_TRACE_H
+
+#include <vos_api.h>
+
+#endif
@@ -0,0 +1,2 @@
+/* Host stand-in for csrApi.h, just what the tx scheduler test needs. */
+
@@ -0,0 +1,18 @@
+/* Host stand-in for enet.h, just what the tx scheduler test needs. */
+
+#ifndef _ENET__H_
+#define _ENET__H_
+
+#include <a_types.h>
+
+#define ETHERNET_ADDR_LEN 6
+#define ETHERNET_TYPE_LEN 2
+#define ETHERNET_HDR_LEN (ETHERNET_ADDR_LEN * 2 + ETHERNET_TYPE_LEN)
+
+#define ETHERTYPE_PAE  0x888e
+#define ETHERTYPE_WAI  0x88b4
+
+#define ETHERTYPE_IS_EAPOL_WAPI(typeorlen) \
+    ((typeorlen) == ETHERTYPE_PAE || (typeorlen) == ETHERTYPE_WAI)
+
+#endif
@@ -0,0 +1,54 @@
+/* Host stand-in for htt.h, just what the tx scheduler test needs. */
+
+#ifndef _HTT_H_
+#define _HTT_H_
+
+#include <a_types.h>
+
+enum htt_pkt_type {
+    htt_pkt_type_raw = 0,
+    htt_pkt_type_native_wifi = 1,
+    htt_pkt_type_ethernet = 2,
+    htt_pkt_type_mgmt = 3,
+
+    /* keep this last */
+    htt_pkt_num_types
+};
+
+enum htt_sec_type {
+    htt_sec_type_none,
+    htt_sec_type_wep128,
+    htt_sec_type_wep104,
+    htt_sec_type_wep40,
+    htt_sec_type_tkip,
+    htt_sec_type_tkip_nomic,
+    htt_sec_type_aes_ccmp,
+    htt_sec_type_wapi,
+
+    /* keep this last! */
+    htt_num_sec_types
+};
+
+enum htt_ac_enum {
+    HTT_AC_WMM_BE = 0,
+    HTT_AC_WMM_BK = 1,
+    HTT_AC_WMM_VI = 2,
+    HTT_AC_WMM_VO = 3,
+    HTT_AC_EXT_NON_QOS = 4,
+    HTT_AC_EXT_UCAST_MGMT = 5,
+    HTT_AC_EXT_MCAST_DATA = 6,
+    HTT_AC_EXT_MCAST_MGMT = 7,
+};
+
+#define HTT_TX_EXT_TID_NON_QOS_MCAST_BCAST 16
+#define HTT_TX_EXT_TID_MGMT                17
+#define HTT_TX_EXT_TID_INVALID             31
+
+union htt_rx_pn_t {
+    u_int16_t pn16;
+    u_int32_t pn24;
+    u_int64_t pn48;
+    u_int32_t pn128[4];
+};
+
+#endif
@@ -0,0 +1,38 @@
+/* Host stand-in for ieee80211_common.h, just what the tx scheduler test needs. */
+
+#ifndef _IEEE80211_COMMON_H_
+#define _IEEE80211_COMMON_H_
+
+#include <a_types.h>
+
+#define IEEE80211_ADDR_LEN 6
+
+struct ieee80211_frame {
+    u_int8_t i_fc[2];
+    u_int8_t i_dur[2];
+    u_int8_t i_addr1[IEEE80211_ADDR_LEN];
+    u_int8_t i_addr2[IEEE80211_ADDR_LEN];
+    u_int8_t i_addr3[IEEE80211_ADDR_LEN];
+    u_int8_t i_seq[2];
+} __attribute__ ((packed));
+
+struct ieee80211_htc {
+    u_int8_t i_htc[4];
+} __attribute__ ((packed));
+
+#define IEEE80211_FC0_TYPE_MASK     0x0c
+#define IEEE80211_FC0_TYPE_MGT      0x00
+#define IEEE80211_FC0_TYPE_CTL      0x04
+#define IEEE80211_FC0_TYPE_DATA     0x08
+#define IEEE80211_FC0_SUBTYPE_MASK  0xf0
+#define IEEE80211_FC0_SUBTYPE_QOS   0x80
+#define IEEE80211_FC1_DIR_MASK      0x03
+#define IEEE80211_FC1_DIR_DSTODS    0x03
+#define IEEE80211_FC1_ORDER         0x80
+
+#define IEEE80211_QOS_HAS_SEQ(wh) \
+    (((wh)->i_fc[0] & \
+      (IEEE80211_FC0_TYPE_MASK | IEEE80211_FC0_SUBTYPE_QOS)) == \
+     (IEEE80211_FC0_TYPE_DATA | IEEE80211_FC0_SUBTYPE_QOS))
+
+#endif
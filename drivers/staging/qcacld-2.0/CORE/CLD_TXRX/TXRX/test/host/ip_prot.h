@@ -0,0 +1,2 @@
+/* Host stand-in for ip_prot.h, just what the tx scheduler test needs. */
+
@@ -0,0 +1,2 @@
+/* Host stand-in for ipv4.h, just what the tx scheduler test needs. */
+
@@ -0,0 +1,2 @@
+/* Host stand-in for ipv6.h, just what the tx scheduler test needs. */
+
@@ -0,0 +1,20 @@
+/* Host stand-in for ol_cfg.h, just what the tx scheduler test needs. */
+
+#ifndef _OL_CFG__H_
+#define _OL_CFG__H_
+
+#include <a_types.h>
+
+struct ol_pdev_t;
+typedef struct ol_pdev_t *ol_pdev_handle;
+
+/* the harness supplies the configuration */
+int ol_cfg_is_high_latency(ol_pdev_handle pdev);
+int ol_cfg_max_peer_id(ol_pdev_handle pdev);
+int ol_cfg_get_wrr_skip_weight(ol_pdev_handle pdev, int ac);
+uint32_t ol_cfg_get_credit_threshold(ol_pdev_handle pdev, int ac);
+uint16_t ol_cfg_get_send_limit(ol_pdev_handle pdev, int ac);
+int ol_cfg_get_credit_reserve(ol_pdev_handle pdev, int ac);
+int ol_cfg_get_discard_weight(ol_pdev_handle pdev, int ac);
+
+#endif
@@ -0,0 +1,2 @@
+/* Host stand-in for ol_ctrl_api.h, just what the tx scheduler test needs. */
+
@@ -0,0 +1,23 @@
+/* Host stand-in for ol_htt_rx_api.h, just what the tx scheduler test needs. */
+
+#ifndef _OL_HTT_RX_API__H_
+#define _OL_HTT_RX_API__H_
+
+#include <adf_nbuf.h>
+#include <htt.h>
+
+struct htt_pdev_t;
+
+static inline int
+htt_rx_msdu_desc_completes_mpdu(struct htt_pdev_t *pdev, void *msdu_desc)
+{
+    return 1;
+}
+
+static inline void *
+htt_rx_msdu_desc_retrieve(struct htt_pdev_t *pdev, adf_nbuf_t msdu)
+{
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,51 @@
+/* Host stand-in for ol_htt_tx_api.h, just what the tx scheduler test needs. */
+
+#ifndef _OL_HTT_TX_API__H_
+#define _OL_HTT_TX_API__H_
+
+#include <a_types.h>
+#include <adf_nbuf.h>
+#include <htt.h>
+
+struct htt_pdev_t;
+typedef struct htt_pdev_t *htt_pdev_handle;
+
+struct htt_msdu_info_t {
+    struct {
+        u_int16_t ethertype;
+        u_int16_t peer_id;
+        u_int8_t vdev_id;
+        u_int8_t ext_tid;
+        u_int8_t l2_hdr_type;
+        u_int8_t l3_hdr_offset;
+        u_int8_t l4_hdr_offset;
+        u_int8_t is_unicast;
+        u_int8_t frame_type;
+        u_int8_t frame_subtype;
+    } info;
+    struct {
+        u_int8_t use_6mbps;
+        u_int8_t do_encrypt;
+        u_int8_t do_tx_complete;
+        u_int8_t tx_comp_req;
+        u_int8_t cksum_offload;
+        u_int8_t band;
+    } action;
+};
+
+int htt_tx_send_std(htt_pdev_handle htt_pdev, adf_nbuf_t msdu,
+                    u_int16_t msdu_id);
+
+static inline int
+htt_tx_msdu_credit(adf_nbuf_t msdu)
+{
+    return 1;
+}
+
+static inline u_int8_t
+htt_tx_desc_tid(htt_pdev_handle pdev, void *desc)
+{
+    return HTT_TX_EXT_TID_INVALID;
+}
+
+#endif
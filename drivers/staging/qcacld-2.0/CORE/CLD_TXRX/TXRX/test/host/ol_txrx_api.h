@@ -0,0 +1,46 @@
+/* Host stand-in for ol_txrx_api.h, just what the tx scheduler test needs. */
+
+#ifndef _OL_TXRX_API__H_
+#define _OL_TXRX_API__H_
+
+#include <a_types.h>
+#include <adf_nbuf.h>
+
+struct ol_txrx_pdev_t;
+typedef struct ol_txrx_pdev_t *ol_txrx_pdev_handle;
+struct ol_txrx_vdev_t;
+typedef struct ol_txrx_vdev_t *ol_txrx_vdev_handle;
+struct ol_txrx_peer_t;
+typedef struct ol_txrx_peer_t *ol_txrx_peer_handle;
+
+enum wlan_op_mode {
+    wlan_op_mode_unknown,
+    wlan_op_mode_ap,
+    wlan_op_mode_ibss,
+    wlan_op_mode_sta,
+    wlan_op_mode_monitor,
+    wlan_op_mode_ocb,
+};
+
+enum wlan_frm_fmt {
+    wlan_frm_fmt_unknown,
+    wlan_frm_fmt_raw,
+    wlan_frm_fmt_native_wifi,
+    wlan_frm_fmt_802_3,
+};
+
+enum ol_sec_type {
+    ol_sec_type_none,
+    ol_sec_type_wep128,
+    ol_sec_type_wep104,
+    ol_sec_type_wep40,
+    ol_sec_type_tkip,
+    ol_sec_type_tkip_nomic,
+    ol_sec_type_aes_ccmp,
+    ol_sec_type_wapi,
+
+    /* keep this last! */
+    ol_sec_type_types
+};
+
+#endif
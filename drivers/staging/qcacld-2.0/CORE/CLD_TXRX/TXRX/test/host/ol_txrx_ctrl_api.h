@@ -0,0 +1,59 @@
+/* Host stand-in for ol_txrx_ctrl_api.h, just what the tx scheduler test needs. */
+
+#ifndef _OL_TXRX_CTRL_API__H_
+#define _OL_TXRX_CTRL_API__H_
+
+#include <ol_txrx_api.h>
+#include <ol_txrx_osif_api.h>
+#include <ol_cfg.h>
+
+enum ol_txrx_peer_state {
+    ol_txrx_peer_state_invalid,
+    ol_txrx_peer_state_disc,
+    ol_txrx_peer_state_conn,
+    ol_txrx_peer_state_auth,
+};
+
+typedef enum {
+    MODE_11A = 0,
+    MODE_UNKNOWN = 21,
+} WLAN_PHY_MODE;
+
+#define OL_RX_NUM_PN_REPLAY_TYPES 2
+
+#define OL_TX_NUM_WMM_AC 4
+
+enum ol_tx_wmm_ac {
+    OL_TX_WMM_AC_BE,
+    OL_TX_WMM_AC_BK,
+    OL_TX_WMM_AC_VI,
+    OL_TX_WMM_AC_VO,
+};
+
+struct ol_tx_ac_param_t {
+    u_int32_t aifs;
+    u_int32_t cwmin;
+    u_int32_t cwmax;
+};
+
+struct ol_tx_wmm_param_t {
+    struct ol_tx_ac_param_t ac[OL_TX_NUM_WMM_AC];
+};
+
+#define OL_TXQ_PAUSE_REASON_FW                (1 << 0)
+#define OL_TXQ_PAUSE_REASON_PEER_UNAUTHORIZED (1 << 1)
+#define OL_TXQ_PAUSE_REASON_TX_ABORT          (1 << 2)
+#define OL_TXQ_PAUSE_REASON_VDEV_STOP         (1 << 3)
+#define OL_TXQ_PAUSE_REASON_VDEV_SUSPEND      (1 << 4)
+#define OL_TXQ_PAUSE_REASON_THROTTLE          (1 << 5)
+#define OL_TXQ_PAUSE_REASON_CRASH_DUMP        (1 << 6)
+
+void ol_txrx_pdev_pause(ol_txrx_pdev_handle data_pdev, u_int32_t reason);
+void ol_txrx_pdev_unpause(ol_txrx_pdev_handle data_pdev, u_int32_t reason);
+void ol_txrx_vdev_pause(ol_txrx_vdev_handle data_vdev, u_int32_t reason);
+void ol_txrx_vdev_unpause(ol_txrx_vdev_handle data_vdev, u_int32_t reason);
+
+typedef void (*tp_ol_packetdump_cb)(adf_nbuf_t netbuf, u_int8_t status,
+                                    u_int8_t vdev_id, u_int8_t type);
+
+#endif
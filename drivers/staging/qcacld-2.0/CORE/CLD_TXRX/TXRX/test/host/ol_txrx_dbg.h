@@ -0,0 +1,2 @@
+/* Host stand-in for ol_txrx_dbg.h, just what the tx scheduler test needs. */
+
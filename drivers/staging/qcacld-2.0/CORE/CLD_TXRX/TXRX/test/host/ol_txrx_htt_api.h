@@ -0,0 +1,23 @@
+/* Host stand-in for ol_txrx_htt_api.h, just what the tx scheduler test needs. */
+
+#ifndef _OL_TXRX_HTT_API__H_
+#define _OL_TXRX_HTT_API__H_
+
+#include <a_types.h>
+
+enum htt_tx_status {
+    htt_tx_status_ok = 0,
+    htt_tx_status_discard = 1,
+    htt_tx_status_no_ack = 2,
+    htt_tx_status_download_fail = 3,
+};
+
+#include <adf_nbuf.h>
+
+static inline u_int16_t *
+ol_tx_msdu_id_storage(adf_nbuf_t msdu)
+{
+    return &msdu->msdu_id;
+}
+
+#endif
@@ -0,0 +1,18 @@
+/* Host stand-in for ol_txrx_osif_api.h, just what the tx scheduler test needs. */
+
+#ifndef _OL_TXRX_OSIF_API__H_
+#define _OL_TXRX_OSIF_API__H_
+
+#include <ol_txrx_api.h>
+
+enum ol_tx_spec {
+    ol_tx_spec_std = 0x0,
+    ol_tx_spec_no_free = 0x8,
+};
+
+typedef void (*ol_txrx_data_tx_cb)(void *ctxt, adf_nbuf_t tx_frm, int had_error);
+typedef void (*ol_txrx_rx_fp)(void *osif_dev, adf_nbuf_t msdus);
+typedef void (*ol_txrx_vir_mon_rx_fp)(void *osif_dev, adf_nbuf_t msdus);
+typedef void (*ol_txrx_tx_flow_control_fp)(void *osif_dev, bool tx_resume);
+
+#endif
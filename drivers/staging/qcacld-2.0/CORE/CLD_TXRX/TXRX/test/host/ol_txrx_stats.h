@@ -0,0 +1,12 @@
+/* Host stand-in for ol_txrx_stats.h, just what the tx scheduler test needs. */
+
+#ifndef _OL_TXRX_STATS__H_
+#define _OL_TXRX_STATS__H_
+
+#define TXRX_STATS_LEVEL_OFF   0
+#define TXRX_STATS_LEVEL_BASIC 1
+#define TXRX_STATS_LEVEL_FULL  2
+
+#define TXRX_STATS_LEVEL TXRX_STATS_LEVEL_OFF
+
+#endif
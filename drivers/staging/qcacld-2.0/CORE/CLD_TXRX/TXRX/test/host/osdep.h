@@ -0,0 +1,13 @@
+/* Host stand-in for osdep.h, just what the tx scheduler test needs. */
+
+#ifndef _OSDEP_H
+#define _OSDEP_H
+
+#include <a_types.h>
+
+#ifndef TRUE
+#define TRUE  1
+#define FALSE 0
+#endif
+
+#endif
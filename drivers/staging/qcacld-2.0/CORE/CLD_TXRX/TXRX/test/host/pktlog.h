@@ -0,0 +1,9 @@
+/* Host stand-in for pktlog.h, just what the tx scheduler test needs. */
+
+#ifndef _PKTLOG_
+#define _PKTLOG_
+
+struct ol_pktlog_dev_t;
+typedef struct ol_pktlog_dev_t *ol_pktlog_dev_handle;
+
+#endif
@@ -0,0 +1,15 @@
+/* Host stand-in for queue.h, just what the tx scheduler test needs. */
+
+#ifndef _QUEUE_H_
+#define _QUEUE_H_
+
+#include <sys/queue.h>
+
+#ifndef TAILQ_FOREACH_SAFE
+#define TAILQ_FOREACH_SAFE(var, head, field, tvar)                      \
+    for ((var) = TAILQ_FIRST((head));                                   \
+         (var) && ((tvar) = TAILQ_NEXT((var), field), 1);               \
+         (var) = (tvar))
+#endif
+
+#endif
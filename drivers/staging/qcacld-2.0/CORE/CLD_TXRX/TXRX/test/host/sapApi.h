@@ -0,0 +1,8 @@
+/* Host stand-in for sapApi.h, just what the tx scheduler test needs. */
+
+#ifndef WLAN_QCT_WLANSAP_H
+#define WLAN_QCT_WLANSAP_H
+
+typedef struct { int unused; } tSap_SoftapStats;
+
+#endif
@@ -0,0 +1,27 @@
+/* Host stand-in for vos_api.h, just what the tx scheduler test needs. */
+
+#ifndef __VOS_API_H
+#define __VOS_API_H
+
+#include "host.h"
+
+typedef enum { VOS_STATUS_SUCCESS, VOS_STATUS_E_FAILURE } VOS_STATUS;
+typedef int8_t v_S7_t;
+typedef struct { uint16_t type; void *bodyptr; } vos_msg_t;
+
+typedef enum { VOS_MODULE_ID_TXRX } VOS_MODULE_ID;
+typedef enum {
+    VOS_TRACE_LEVEL_NONE,
+    VOS_TRACE_LEVEL_FATAL,
+    VOS_TRACE_LEVEL_ERROR,
+    VOS_TRACE_LEVEL_WARN,
+    VOS_TRACE_LEVEL_INFO,
+    VOS_TRACE_LEVEL_INFO_HIGH,
+    VOS_TRACE_LEVEL_INFO_MED,
+    VOS_TRACE_LEVEL_INFO_LOW,
+    VOS_TRACE_LEVEL_DEBUG,
+} VOS_TRACE_LEVEL;
+
+#define VOS_TRACE(arg...)
+
+#endif
@@ -0,0 +1,10 @@
+/* Host stand-in for wdi_event_api.h, just what the tx scheduler test needs. */
+
+#ifndef _WDI_EVENT_API_H_
+#define _WDI_EVENT_API_H_
+
+typedef struct wdi_event_subscribe_t {
+    void *callback;
+} wdi_event_subscribe;
+
+#endif
@@ -0,0 +1,8 @@
+/* Host stand-in for wlan_qct_tl.h, just what the tx scheduler test needs. */
+
+#ifndef WLAN_QCT_TL_H
+#define WLAN_QCT_TL_H
+
+#define WLAN_MAX_STA_COUNT 38
+
+#endif
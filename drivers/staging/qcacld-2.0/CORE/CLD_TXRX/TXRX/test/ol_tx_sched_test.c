@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) 2019 The Linux Foundation. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ * PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Host-only harness for the HL tx scheduler.
+ *
+ * ol_tx_sched.c and ol_tx_queue.c are built as they are, against the
+ * stand-in headers in host/, and driven with synthetic tx queues and
+ * target credit.  The download path ends in ol_tx_send_batch() below,
+ * which checks what the scheduler hands it and, where a test asks for
+ * it, gives the credit straight back as the target would on completion.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <adf_nbuf.h>
+#include <adf_os_atomic.h>
+#include <adf_os_lock.h>
+#include <ol_txrx_types.h>
+#include <ol_txrx.h>
+#include <ol_tx_desc.h>
+#include <ol_tx_queue.h>
+#include <ol_tx_sched.h>
+#include <ol_tx_send.h>
+
+#define TEST_NUM_TXQS        4
+#define TEST_PRODUCER_FRAMES 20000
+#define TEST_FRAME_BYTES     1500
+
+/* a tx frame and its descriptor, allocated together */
+struct test_frame {
+    struct adf_nbuf netbuf;
+    struct ol_tx_desc_t tx_desc;
+    int txq_id;
+};
+
+static struct ol_txrx_pdev_t *pdev;
+static struct ol_tx_frms_queue_t txqs[TEST_NUM_TXQS];
+static u_int8_t txq_tids[TEST_NUM_TXQS] = { 6, 5, 0, 1 }; /* VO VI BE BK */
+
+/* the download sink's view, only touched by the running scheduler */
+static struct {
+    int return_credit;
+    int enqueue_txq_id;
+    int enqueue_frames;
+    int batches;
+    int frames;
+    int discards;
+    u_int32_t next_seq[TEST_NUM_TXQS];
+} sink;
+
+static u_int32_t enqueued_seq[TEST_NUM_TXQS];
+static int failures;
+
+static void test_enqueue(int txq_id, int frames);
+
+#define TEST_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: %s: check failed: %s\n", \
+                __FILE__, __LINE__, __func__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+/*--- stand-ins for the rest of the driver ----------------------------------*/
+
+int ol_cfg_is_high_latency(ol_pdev_handle ctrl_pdev) { return 1; }
+int ol_cfg_max_peer_id(ol_pdev_handle ctrl_pdev) { return 0; }
+/* zero keeps the scheduler's built-in category specs */
+int ol_cfg_get_wrr_skip_weight(ol_pdev_handle ctrl_pdev, int ac) { return 0; }
+uint32_t ol_cfg_get_credit_threshold(ol_pdev_handle ctrl_pdev, int ac) { return 0; }
+uint16_t ol_cfg_get_send_limit(ol_pdev_handle ctrl_pdev, int ac) { return 0; }
+int ol_cfg_get_credit_reserve(ol_pdev_handle ctrl_pdev, int ac) { return 0; }
+int ol_cfg_get_discard_weight(ol_pdev_handle ctrl_pdev, int ac) { return 0; }
+
+u_int16_t
+ol_tx_desc_pool_size_hl(ol_pdev_handle ctrl_pdev)
+{
+    return 1024;
+}
+
+void
+ol_tx_desc_frame_free_nonstd(
+    struct ol_txrx_pdev_t *pdev,
+    struct ol_tx_desc_t *tx_desc,
+    int had_error)
+{
+    sink.discards++;
+    free(container_of(tx_desc, struct test_frame, tx_desc));
+}
+
+void
+ol_tx_desc_frame_list_free(
+    struct ol_txrx_pdev_t *pdev,
+    ol_tx_desc_list *tx_descs,
+    int had_error)
+{
+    struct ol_tx_desc_t *tx_desc, *tmp;
+
+    TAILQ_FOREACH_SAFE(tx_desc, tx_descs, tx_desc_list_elem, tmp) {
+        ol_tx_desc_frame_free_nonstd(pdev, tx_desc, had_error);
+    }
+    TAILQ_INIT(tx_descs);
+}
+
+void
+ol_txrx_peer_unref_delete(struct ol_txrx_peer_t *peer)
+{
+}
+
+void
+ol_tx_vdev_ll_pause_queue_send(void *context)
+{
+}
+
+int
+htt_tx_send_std(htt_pdev_handle htt_pdev, adf_nbuf_t msdu, u_int16_t msdu_id)
+{
+    /* every frame has msdu id storage, so nothing is sent singly */
+    TEST_CHECK(0);
+    return 0;
+}
+
+/*
+ * The download sink: the frames of one tx queue have to arrive in the
+ * order they were enqueued, each of them exactly once.
+ */
+int
+ol_tx_send_batch(
+    struct ol_txrx_pdev_t *pdev,
+    adf_nbuf_t msdu_list, int num_msdus)
+{
+    struct test_frame *frame;
+    adf_nbuf_t msdu, next;
+    int i;
+
+    sink.batches++;
+    for (i = 0, msdu = msdu_list; i < num_msdus; i++, msdu = next) {
+        TEST_CHECK(msdu != NULL);
+        if (!msdu) {
+            break;
+        }
+        next = adf_nbuf_next(msdu);
+        frame = container_of(msdu, struct test_frame, netbuf);
+        TEST_CHECK(msdu->seq == sink.next_seq[frame->txq_id]);
+        sink.next_seq[frame->txq_id] = msdu->seq + 1;
+        sink.frames++;
+        free(frame);
+    }
+    if (sink.return_credit) {
+        adf_os_atomic_add(num_msdus, &pdev->target_tx_credit);
+    }
+    if (sink.enqueue_frames) {
+        /* a producer comes along while the scheduler is busy */
+        test_enqueue(sink.enqueue_txq_id, sink.enqueue_frames);
+        sink.enqueue_frames = 0;
+        ol_tx_sched(pdev);
+    }
+    /* the download takes a while, let the producers run meanwhile */
+    sched_yield();
+    return 0;
+}
+
+/*--- setup -----------------------------------------------------------------*/
+
+static void
+test_pdev_attach(int credit)
+{
+    int tid, i;
+
+    pdev = calloc(1, sizeof(*pdev));
+    adf_os_spinlock_init(&pdev->tx_queue_spinlock);
+    adf_os_llist_init(&pdev->tx_queue.staged_txqs);
+    adf_os_atomic_set(&pdev->tx_queue.rsrc_cnt, 1024);
+    pdev->tx_queue.rsrc_threshold_lo = 0;
+    pdev->tx_queue.rsrc_threshold_hi = 10;
+    pdev->tx_desc.pool_size = 0xffff;
+    adf_os_atomic_set(&pdev->target_tx_credit, credit);
+
+    /* as ol_txrx_pdev_attach does */
+    for (tid = 0; tid < OL_TX_NUM_QOS_TIDS; tid++) {
+        pdev->tid_to_ac[tid] = TXRX_TID_TO_WMM_AC(tid);
+    }
+    pdev->tid_to_ac[OL_TX_NON_QOS_TID] =
+        OL_TX_SCHED_WRR_ADV_CAT_NON_QOS_DATA;
+    pdev->tid_to_ac[OL_TX_MGMT_TID] =
+        OL_TX_SCHED_WRR_ADV_CAT_UCAST_MGMT;
+    pdev->tid_to_ac[OL_TX_NUM_TIDS + OL_TX_VDEV_MCAST_BCAST] =
+        OL_TX_SCHED_WRR_ADV_CAT_MCAST_DATA;
+    pdev->tid_to_ac[OL_TX_NUM_TIDS + OL_TX_VDEV_DEFAULT_MGMT] =
+        OL_TX_SCHED_WRR_ADV_CAT_MCAST_MGMT;
+
+    pdev->tx_sched.scheduler = ol_tx_sched_attach(pdev);
+
+    /* as ol_txrx_peer_attach does */
+    memset(txqs, 0, sizeof(txqs));
+    for (i = 0; i < TEST_NUM_TXQS; i++) {
+        TAILQ_INIT(&txqs[i].head);
+        adf_os_llist_init(&txqs[i].staged);
+        txqs[i].ext_tid = txq_tids[i];
+        txqs[i].flag = ol_tx_queue_empty;
+    }
+    memset(&sink, 0, sizeof(sink));
+    memset(enqueued_seq, 0, sizeof(enqueued_seq));
+}
+
+static void
+test_pdev_detach(void)
+{
+    ol_tx_desc_list tx_descs;
+
+    /* whatever the test left queued is dropped */
+    TAILQ_INIT(&tx_descs);
+    ol_tx_queue_discard(pdev, A_TRUE, &tx_descs);
+    ol_tx_desc_frame_list_free(pdev, &tx_descs, 1);
+
+    ol_tx_sched_detach(pdev);
+    adf_os_spinlock_destroy(&pdev->tx_queue_spinlock);
+    free(pdev);
+    pdev = NULL;
+}
+
+static void
+test_enqueue(int txq_id, int frames)
+{
+    struct ol_txrx_msdu_info_t msdu_info;
+    struct test_frame *frame;
+
+    memset(&msdu_info, 0, sizeof(msdu_info));
+    msdu_info.htt.info.ext_tid = txq_tids[txq_id];
+    while (frames--) {
+        frame = calloc(1, sizeof(*frame));
+        frame->txq_id = txq_id;
+        frame->netbuf.len = TEST_FRAME_BYTES;
+        frame->netbuf.seq = enqueued_seq[txq_id]++;
+        frame->tx_desc.netbuf = &frame->netbuf;
+        ol_tx_enqueue(pdev, &txqs[txq_id], &frame->tx_desc, &msdu_info);
+    }
+}
+
+/*--- tests -----------------------------------------------------------------*/
+
+/*
+ * Frames are only staged by ol_tx_enqueue, and reach their tx queue and
+ * the scheduler when the scheduler runs, even if there's no credit.
+ */
+static void
+test_staged_move(void)
+{
+    test_pdev_attach(0);
+
+    test_enqueue(0, 5);
+    test_enqueue(2, 7);
+    TEST_CHECK(txqs[0].frms == 0 && txqs[2].frms == 0);
+
+    ol_tx_sched(pdev);
+    TEST_CHECK(sink.frames == 0);
+    TEST_CHECK(txqs[0].frms == 5 && txqs[2].frms == 7);
+    TEST_CHECK(txqs[2].bytes == 7 * TEST_FRAME_BYTES);
+    TEST_CHECK(txqs[0].flag == ol_tx_queue_active);
+    TEST_CHECK(pdev->tx_sched.tx_sched_status == ol_tx_scheduler_idle);
+
+    test_pdev_detach();
+}
+
+/*
+ * The scheduler selects frames for all the credit there is and downloads
+ * them as a single batch.
+ */
+static void
+test_credit_sized_batch(void)
+{
+    test_pdev_attach(40);
+
+    test_enqueue(0, 100);
+    ol_tx_sched(pdev);
+    TEST_CHECK(sink.batches == 1);
+    TEST_CHECK(sink.frames == 40);
+    TEST_CHECK(adf_os_atomic_read(&pdev->target_tx_credit) == 0);
+    TEST_CHECK(txqs[0].frms == 60);
+
+    /*
+     * A credit update picks up where the last download left off.  The
+     * VO credit threshold holds back what is left below it, so give
+     * more than the remaining 60 frames need.
+     */
+    adf_os_atomic_add(80, &pdev->target_tx_credit);
+    ol_tx_sched(pdev);
+    TEST_CHECK(sink.batches == 2);
+    TEST_CHECK(sink.frames == 100);
+    TEST_CHECK(adf_os_atomic_read(&pdev->target_tx_credit) == 20);
+    TEST_CHECK(txqs[0].frms == 0);
+    TEST_CHECK(txqs[0].flag == ol_tx_queue_empty);
+
+    test_pdev_detach();
+}
+
+/*
+ * Credit the target returns while a batch is being downloaded is used by
+ * the same scheduler run, rather than waiting for the next credit update.
+ */
+static void
+test_credit_returned_during_download(void)
+{
+    test_pdev_attach(32);
+    sink.return_credit = 1;
+
+    test_enqueue(1, 200);
+    test_enqueue(3, 50);
+    ol_tx_sched(pdev);
+    TEST_CHECK(sink.frames == 250);
+    TEST_CHECK(sink.batches > 1);
+    TEST_CHECK(adf_os_atomic_read(&pdev->target_tx_credit) == 32);
+    TEST_CHECK(pdev->tx_sched.tx_sched_status == ol_tx_scheduler_idle);
+
+    test_pdev_detach();
+}
+
+/*
+ * Frames staged while the scheduler is downloading find it busy, so the
+ * running scheduler has to pick them up before it goes idle.
+ */
+static void
+test_enqueue_during_download(void)
+{
+    test_pdev_attach(32);
+    sink.return_credit = 1;
+    sink.enqueue_txq_id = 3;
+    sink.enqueue_frames = 10;
+
+    test_enqueue(0, 8);
+    ol_tx_sched(pdev);
+    TEST_CHECK(sink.enqueue_frames == 0);
+    TEST_CHECK(sink.frames == 18);
+    TEST_CHECK(txqs[3].frms == 0);
+    TEST_CHECK(pdev->tx_sched.tx_sched_status == ol_tx_scheduler_idle);
+
+    test_pdev_detach();
+}
+
+/* discarding makes room among the staged frames too */
+static void
+test_discard_staged(void)
+{
+    ol_tx_desc_list tx_descs;
+
+    test_pdev_attach(0);
+
+    test_enqueue(2, 30);
+    TAILQ_INIT(&tx_descs);
+    ol_tx_queue_discard(pdev, A_FALSE, &tx_descs);
+    ol_tx_desc_frame_list_free(pdev, &tx_descs, 1);
+    TEST_CHECK(sink.discards == 10);
+    TEST_CHECK(txqs[2].frms == 20);
+
+    test_pdev_detach();
+}
+
+static void *
+test_producer(void *arg)
+{
+    int txq_id = (int)(long)arg;
+    int i;
+
+    for (i = 0; i < TEST_PRODUCER_FRAMES; i++) {
+        test_enqueue(txq_id, 1);
+        ol_tx_sched(pdev);
+    }
+    return NULL;
+}
+
+/*
+ * Producers enqueue without the lock and kick the scheduler, as ol_tx_hl
+ * does.  With the target keeping up, no frame may be left behind once the
+ * producers are done, even though the scheduler runs in whichever thread
+ * finds it idle.
+ */
+static void
+test_concurrent_enqueue(void)
+{
+    pthread_t threads[TEST_NUM_TXQS];
+    long i;
+
+    test_pdev_attach(64);
+    sink.return_credit = 1;
+
+    for (i = 0; i < TEST_NUM_TXQS; i++) {
+        pthread_create(&threads[i], NULL, test_producer, (void *)i);
+    }
+    for (i = 0; i < TEST_NUM_TXQS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    TEST_CHECK(sink.frames == TEST_NUM_TXQS * TEST_PRODUCER_FRAMES);
+    for (i = 0; i < TEST_NUM_TXQS; i++) {
+        TEST_CHECK(sink.next_seq[i] == TEST_PRODUCER_FRAMES);
+        TEST_CHECK(txqs[i].frms == 0);
+    }
+    TEST_CHECK(adf_os_atomic_read(&pdev->target_tx_credit) == 64);
+
+    test_pdev_detach();
+}
+
+int
+main(void)
+{
+    test_staged_move();
+    test_credit_sized_batch();
+    test_credit_returned_during_download();
+    test_enqueue_during_download();
+    test_discard_staged();
+    test_concurrent_enqueue();
+
+    if (failures) {
+        fprintf(stderr, "ol_tx_sched_test: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("ol_tx_sched_test: all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2019 The Linux Foundation. All rights reserved.
+ *
+ * Previously licensed under the ISC license by Qualcomm Atheros, Inc.
+ *
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ * PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * This file was originally distributed by Qualcomm Atheros, Inc.
+ * under proprietary terms before Copyright ownership was assigned
+ * to the Linux Foundation.
+ */
+
+/**
+ * @ingroup adf_os_public
+ * @file adf_os_llist.h
+ * This file abstracts a lock-less singly linked list.
+ */
+
+#ifndef _ADF_OS_LLIST_H
+#define _ADF_OS_LLIST_H
+
+#include <adf_os_llist_pvt.h>
+
+/**
+ * @brief Head of a lock-less list.
+ * Any number of producers may add nodes concurrently without a lock;
+ * nodes are taken off the list all at once by adf_os_llist_del_all.
+ * Nodes come off the list in LIFO order.
+ */
+typedef __adf_os_llist_head_t   adf_os_llist_head_t;
+typedef __adf_os_llist_node_t   adf_os_llist_node_t;
+
+/**
+ * adf_os_llist_init() - initialize a lock-less list head
+ * @head: the list head
+ *
+ * Return: none
+ */
+static inline void
+adf_os_llist_init(adf_os_llist_head_t *head)
+{
+    __adf_os_llist_init(head);
+}
+
+/**
+ * adf_os_llist_add() - add a node to a lock-less list
+ * @node: the node to add
+ * @head: the list head
+ *
+ * Safe against concurrent adders and a concurrent adf_os_llist_del_all.
+ *
+ * Return: true if the list was empty before the node was added
+ */
+static inline a_bool_t
+adf_os_llist_add(adf_os_llist_node_t *node, adf_os_llist_head_t *head)
+{
+    return __adf_os_llist_add(node, head);
+}
+
+/**
+ * adf_os_llist_del_all() - take all nodes off a lock-less list
+ * @head: the list head
+ *
+ * Return: the first node of the removed chain, newest first, or NULL
+ */
+static inline adf_os_llist_node_t *
+adf_os_llist_del_all(adf_os_llist_head_t *head)
+{
+    return __adf_os_llist_del_all(head);
+}
+
+/**
+ * adf_os_llist_reverse() - reverse a chain taken off a lock-less list
+ * @node: the first node of the chain
+ *
+ * Return: the first node of the reversed chain, oldest first
+ */
+static inline adf_os_llist_node_t *
+adf_os_llist_reverse(adf_os_llist_node_t *node)
+{
+    return __adf_os_llist_reverse(node);
+}
+
+/**
+ * adf_os_llist_next() - next node of a chain taken off a lock-less list
+ * @node: the current node
+ *
+ * Return: the next node, or NULL at the end of the chain
+ */
+static inline adf_os_llist_node_t *
+adf_os_llist_next(adf_os_llist_node_t *node)
+{
+    return __adf_os_llist_next(node);
+}
+
+/**
+ * adf_os_llist_empty() - check whether a lock-less list is empty
+ * @head: the list head
+ *
+ * The result is only a hint if nodes may be added concurrently.
+ *
+ * Return: true if the list is empty
+ */
+static inline a_bool_t
+adf_os_llist_empty(adf_os_llist_head_t *head)
+{
+    return __adf_os_llist_empty(head);
+}
+#endif
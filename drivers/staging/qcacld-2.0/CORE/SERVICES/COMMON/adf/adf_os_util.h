@@ -115,6 +115,12 @@ static inline void adf_os_get_rand(adf_os_handle_t  hdl,
  */
 #define adf_os_abs(_a)              __adf_os_abs(_a)
 
+/**
+ * @brief return the index of the least significant set bit of a
+ *        non-zero 64-bit value
+ */
+#define adf_os_ffs64(_a)            __adf_os_ffs64(_a)
+
 /**
  * @brief replace with the name of the current function
  */
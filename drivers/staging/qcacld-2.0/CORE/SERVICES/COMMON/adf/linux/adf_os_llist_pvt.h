@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2019 The Linux Foundation. All rights reserved.
+ *
+ * Previously licensed under the ISC license by Qualcomm Atheros, Inc.
+ *
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ * PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * This file was originally distributed by Qualcomm Atheros, Inc.
+ * under proprietary terms before Copyright ownership was assigned
+ * to the Linux Foundation.
+ */
+
+#ifndef ADF_OS_LLIST_PVT_H
+#define ADF_OS_LLIST_PVT_H
+
+#include <adf_os_types.h> /* a_bool_t */
+
+#include <linux/llist.h>
+
+typedef struct llist_head __adf_os_llist_head_t;
+typedef struct llist_node __adf_os_llist_node_t;
+
+static inline void
+__adf_os_llist_init(__adf_os_llist_head_t *head)
+{
+    init_llist_head(head);
+}
+
+static inline a_bool_t
+__adf_os_llist_add(__adf_os_llist_node_t *node, __adf_os_llist_head_t *head)
+{
+    return llist_add(node, head);
+}
+
+static inline __adf_os_llist_node_t *
+__adf_os_llist_del_all(__adf_os_llist_head_t *head)
+{
+    return llist_del_all(head);
+}
+
+static inline __adf_os_llist_node_t *
+__adf_os_llist_reverse(__adf_os_llist_node_t *node)
+{
+    return llist_reverse_order(node);
+}
+
+static inline __adf_os_llist_node_t *
+__adf_os_llist_next(__adf_os_llist_node_t *node)
+{
+    return node->next;
+}
+
+static inline a_bool_t
+__adf_os_llist_empty(__adf_os_llist_head_t *head)
+{
+    return llist_empty(head);
+}
+#endif
@@ -56,6 +56,8 @@
 
 #define __adf_os_abs(_a)             __builtin_abs(_a)
 
+#define __adf_os_ffs64(_a)           __ffs64(_a)
+
 /**
  * @brief Assert
  */
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2019 The Linux Foundation. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+ * AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR
+ * PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _HTC_TX_BATCH_H_
+#define _HTC_TX_BATCH_H_
+
+#include "htc_api.h" /* HTC_HANDLE, HTC_ENDPOINT_ID */
+
+/*+
+ * HTCTxBatchBegin / HTCTxBatchEnd - batch data frames on an endpoint
+ *
+ * Frames sent on the endpoint between the two calls are only queued, and
+ * go out together at HTCTxBatchEnd, in as few HIF transfers as possible.
+ * The calls nest; only the outermost HTCTxBatchEnd sends.
+ *
+ * @param HTCHandle - HTC handle
+ * @param Endpoint - endpoint the frames are sent on
+ * @return: none
+ +*/
+void HTCTxBatchBegin(HTC_HANDLE HTCHandle, HTC_ENDPOINT_ID Endpoint);
+void HTCTxBatchEnd(HTC_HANDLE HTCHandle, HTC_ENDPOINT_ID Endpoint);
+
+#endif /* _HTC_TX_BATCH_H_ */
@@ -148,6 +148,7 @@ typedef struct _HTC_ENDPOINT {
 #endif
     A_BOOL                      TxCreditFlowEnabled;
     adf_os_spinlock_t           htc_endpoint_rx_lock;
+    int                         TxBatchDepth;       /* open HTCTxBatchBegin() calls */
 } HTC_ENDPOINT;
 
 #ifdef HTC_EP_STAT_PROFILING
@@ -29,6 +29,7 @@
 
 #include "htc_debug.h"
 #include "htc_internal.h"
+#include "htc_tx_batch.h"
 #include <adf_nbuf.h> /* adf_nbuf_t */
 #include <adf_os_mem.h> /* adf_os_mem_alloc */
 #include <vos_getBin.h>
@@ -1396,16 +1397,16 @@ A_STATUS HTCSendDataPkt(HTC_HANDLE HTCHandle, adf_nbuf_t       netbuf, int Epid,
 }
 #else /*ATH_11AC_TXCOMPACT*/
 
+static A_STATUS HTCTrySendData(HTC_TARGET *target, HTC_ENDPOINT *pEndpoint);
+
 A_STATUS HTCSendDataPkt(HTC_HANDLE HTCHandle, HTC_PACKET *pPacket,
                         A_UINT8 more_data)
 {
     HTC_TARGET       *target = GET_HTC_TARGET_FROM_HANDLE(HTCHandle);
     HTC_ENDPOINT     *pEndpoint;
     HTC_FRAME_HDR    *pHtcHdr;
-    HTC_PACKET_QUEUE sendQueue;
     adf_nbuf_t       netbuf;
-    int              tx_resources;
-    A_STATUS         status = A_OK;
+
     if (pPacket){
         AR_DEBUG_ASSERT(pPacket->Endpoint < ENDPOINT_MAX);
         pEndpoint = &target->EndPoint[pPacket->Endpoint];
@@ -1455,7 +1456,8 @@ A_STATUS HTCSendDataPkt(HTC_HANDLE HTCHandle, HTC_PACKET *pPacket,
         /* append new packet to pEndpoint->TxQueue */
         HTC_PACKET_ENQUEUE(&pEndpoint->TxQueue, pPacket);
 #ifdef ENABLE_BUNDLE_TX
-        if (HTC_ENABLE_BUNDLE(target) && (more_data)) {
+        if (HTC_ENABLE_BUNDLE(target) &&
+            (more_data || pEndpoint->TxBatchDepth)) {
             UNLOCK_HTC_TX(target);
             return A_OK;
         }
@@ -1465,6 +1467,21 @@ A_STATUS HTCSendDataPkt(HTC_HANDLE HTCHandle, HTC_PACKET *pPacket,
         pEndpoint = &target->EndPoint[1];
     }
 
+    return HTCTrySendData(target, pEndpoint);
+}
+
+/*
+ * Issue the frames queued on a data endpoint, bundling them where
+ * possible.  Called with the HTC tx lock held, releases it.
+ */
+static A_STATUS HTCTrySendData(HTC_TARGET *target, HTC_ENDPOINT *pEndpoint)
+{
+    HTC_PACKET       *pPacket;
+    HTC_PACKET_QUEUE sendQueue;
+    adf_nbuf_t       netbuf;
+    int              tx_resources;
+    A_STATUS         status = A_OK;
+
     /* increment tx processing count on entry */
     adf_os_atomic_inc(&pEndpoint->TxProcessCount);
     if (adf_os_atomic_read(&pEndpoint->TxProcessCount) > 1) {
@@ -1606,6 +1623,41 @@ A_STATUS HTCSendDataPkt(HTC_HANDLE HTCHandle, HTC_PACKET *pPacket,
 }
 #endif /*ATH_11AC_TXCOMPACT*/
 
+/*
+ * The txrx download scheduler hands HTT a batch of data frames sized from
+ * the target tx credit it holds.  Between HTCTxBatchBegin and
+ * HTCTxBatchEnd the frames are only queued on the endpoint, and the whole
+ * batch is issued at HTCTxBatchEnd, so that it can go out in as few HIF
+ * transfers (bundles) as possible instead of one transfer per frame.
+ */
+void HTCTxBatchBegin(HTC_HANDLE HTCHandle, HTC_ENDPOINT_ID Endpoint)
+{
+    HTC_TARGET *target = GET_HTC_TARGET_FROM_HANDLE(HTCHandle);
+    HTC_ENDPOINT *pEndpoint = &target->EndPoint[Endpoint];
+
+    LOCK_HTC_TX(target);
+    pEndpoint->TxBatchDepth++;
+    UNLOCK_HTC_TX(target);
+}
+
+void HTCTxBatchEnd(HTC_HANDLE HTCHandle, HTC_ENDPOINT_ID Endpoint)
+{
+    HTC_TARGET *target = GET_HTC_TARGET_FROM_HANDLE(HTCHandle);
+    HTC_ENDPOINT *pEndpoint = &target->EndPoint[Endpoint];
+
+    LOCK_HTC_TX(target);
+    A_ASSERT(pEndpoint->TxBatchDepth > 0);
+    if (--pEndpoint->TxBatchDepth > 0) {
+        UNLOCK_HTC_TX(target);
+        return;
+    }
+#ifndef ATH_11AC_TXCOMPACT
+    HTCTrySendData(target, pEndpoint);
+#else
+    UNLOCK_HTC_TX(target);
+#endif
+}
+
 /*
  * In the adapted HIF layer, adf_nbuf_t are passed between HIF and HTC, since upper layers expects
  * HTC_PACKET containers we use the completed netbuf and lookup its corresponding HTC packet buffer
@@ -0,0 +1,452 @@
+/*
+ * devfreq_cooling: Thermal cooling device implementation for devices using
+ *                  devfreq
+ *
+ * Copyright (C) 2014-2015 ARM Limited
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * The cooling device caps the devfreq device through
+ * devfreq->thermal_max_freq, one cooling state per entry of the profile's
+ * frequency table. When the
+ * DT node describes a power model the device also implements the power
+ * actor interface used by the power_allocator governor:
+ *
+ * dynamic-power-coefficient: dynamic power is
+ *	coefficient * f(MHz) * V(mV)^2 / 10^9 mW at 100% load
+ * qcom,freq-voltage-table: <freq uV> pairs, frequencies in devfreq units
+ *	(Hz). Without it the voltages come from the device's OPPs.
+ * qcom,static-power-*: optional leakage model, see struct
+ *	thermal_static_power
+ */
+
+#include <linux/devfreq.h>
+#include <linux/devfreq_cooling.h>
+#include <linux/idr.h>
+#include <linux/pm_opp.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/thermal.h>
+
+#include <trace/events/thermal.h>
+
+static DEFINE_IDR(devfreq_idr);
+static DEFINE_MUTEX(devfreq_lock);
+
+/**
+ * struct devfreq_cooling_device - devfreq cooling device data
+ * @id: unique integer value corresponding to each devfreq cooling device
+ * @cdev: registered thermal cooling device
+ * @devfreq: devfreq device being capped
+ * @cooling_state: current cooling state
+ * @freq_table: frequencies of the device, highest first, indexed by state
+ * @voltage_table: voltage in uV at each @freq_table entry
+ * @power_table: dynamic power in mW at each @freq_table entry, 100% load
+ * @freq_table_size: number of entries in the tables
+ * @static_power: leakage model, coeff 0 if static power is ignored
+ */
+struct devfreq_cooling_device {
+	int id;
+	struct thermal_cooling_device *cdev;
+	struct devfreq *devfreq;
+	unsigned long cooling_state;
+	unsigned long *freq_table;
+	unsigned long *voltage_table;
+	u32 *power_table;
+	unsigned int freq_table_size;
+	struct thermal_static_power static_power;
+};
+
+static int get_idr(int *id)
+{
+	int ret;
+
+	mutex_lock(&devfreq_lock);
+	ret = idr_alloc(&devfreq_idr, NULL, 0, 0, GFP_KERNEL);
+	mutex_unlock(&devfreq_lock);
+	if (unlikely(ret < 0))
+		return ret;
+	*id = ret;
+
+	return 0;
+}
+
+static void release_idr(int id)
+{
+	mutex_lock(&devfreq_lock);
+	idr_remove(&devfreq_idr, id);
+	mutex_unlock(&devfreq_lock);
+}
+
+static unsigned long freq_get_state(struct devfreq_cooling_device *dfc,
+				    unsigned long freq)
+{
+	unsigned long state;
+
+	for (state = 0; state < dfc->freq_table_size - 1; state++)
+		if (freq >= dfc->freq_table[state])
+			break;
+
+	return state;
+}
+
+static u32 get_load(struct devfreq_cooling_device *dfc, unsigned long *freq)
+{
+	struct devfreq *df = dfc->devfreq;
+	struct devfreq_dev_status status;
+
+	mutex_lock(&df->lock);
+	status = df->last_status;
+	*freq = df->previous_freq;
+	mutex_unlock(&df->lock);
+
+	/* no samples yet, assume the worst */
+	if (!status.total_time)
+		return 100;
+
+	return div64_u64((u64)status.busy_time * 100, status.total_time);
+}
+
+static u32 get_static_power(struct devfreq_cooling_device *dfc,
+			    unsigned long state)
+{
+	return thermal_static_power(&dfc->static_power,
+				    dfc->voltage_table[state]);
+}
+
+static int devfreq_cooling_get_max_state(struct thermal_cooling_device *cdev,
+					 unsigned long *state)
+{
+	struct devfreq_cooling_device *dfc = cdev->devdata;
+
+	*state = dfc->freq_table_size - 1;
+
+	return 0;
+}
+
+static int devfreq_cooling_get_cur_state(struct thermal_cooling_device *cdev,
+					 unsigned long *state)
+{
+	struct devfreq_cooling_device *dfc = cdev->devdata;
+
+	*state = dfc->cooling_state;
+
+	return 0;
+}
+
+static int devfreq_cooling_set_cur_state(struct thermal_cooling_device *cdev,
+					 unsigned long state)
+{
+	struct devfreq_cooling_device *dfc = cdev->devdata;
+	struct devfreq *df = dfc->devfreq;
+
+	if (state >= dfc->freq_table_size)
+		return -EINVAL;
+
+	if (state == dfc->cooling_state)
+		return 0;
+
+	mutex_lock(&df->lock);
+	df->thermal_max_freq = state ? dfc->freq_table[state] : 0;
+	/*
+	 * A suspended or governor-less device picks the limit up on its
+	 * next evaluation.
+	 */
+	update_devfreq(df);
+	mutex_unlock(&df->lock);
+
+	dfc->cooling_state = state;
+
+	return 0;
+}
+
+static int devfreq_cooling_get_requested_power(
+		struct thermal_cooling_device *cdev,
+		struct thermal_zone_device *tz, u32 *power)
+{
+	struct devfreq_cooling_device *dfc = cdev->devdata;
+	unsigned long freq, state;
+	u32 load, dyn_power, static_power;
+
+	load = get_load(dfc, &freq);
+	state = freq_get_state(dfc, freq);
+
+	dyn_power = dfc->power_table[state] * load / 100;
+	static_power = get_static_power(dfc, state);
+
+	trace_thermal_power_devfreq_get_power(cdev, freq, load, dyn_power,
+					      static_power);
+
+	*power = dyn_power + static_power;
+
+	return 0;
+}
+
+static int devfreq_cooling_state2power(struct thermal_cooling_device *cdev,
+				       struct thermal_zone_device *tz,
+				       unsigned long state, u32 *power)
+{
+	struct devfreq_cooling_device *dfc = cdev->devdata;
+
+	if (state >= dfc->freq_table_size)
+		return -EINVAL;
+
+	*power = dfc->power_table[state] + get_static_power(dfc, state);
+
+	return 0;
+}
+
+static int devfreq_cooling_power2state(struct thermal_cooling_device *cdev,
+				       struct thermal_zone_device *tz,
+				       u32 power, unsigned long *state)
+{
+	struct devfreq_cooling_device *dfc = cdev->devdata;
+	unsigned long freq, i;
+	u32 load, static_power;
+	s64 dyn_power;
+
+	load = get_load(dfc, &freq);
+	static_power = get_static_power(dfc, freq_get_state(dfc, freq));
+
+	dyn_power = (s64)power - static_power;
+	if (dyn_power <= 0 || !load) {
+		/* idle devices get the top state, at no cost */
+		i = load ? dfc->freq_table_size - 1 : 0;
+		goto out;
+	}
+
+	/* power the device could use at 100% load */
+	dyn_power = div_u64(dyn_power * 100, load);
+	for (i = 0; i < dfc->freq_table_size - 1; i++)
+		if (dyn_power >= dfc->power_table[i])
+			break;
+
+out:
+	*state = i;
+	trace_thermal_power_devfreq_limit(cdev, dfc->freq_table[i], i, power);
+
+	return 0;
+}
+
+static struct thermal_cooling_device_ops devfreq_cooling_ops = {
+	.get_max_state = devfreq_cooling_get_max_state,
+	.get_cur_state = devfreq_cooling_get_cur_state,
+	.set_cur_state = devfreq_cooling_set_cur_state,
+};
+
+static struct thermal_cooling_device_ops devfreq_cooling_power_ops = {
+	.get_max_state = devfreq_cooling_get_max_state,
+	.get_cur_state = devfreq_cooling_get_cur_state,
+	.set_cur_state = devfreq_cooling_set_cur_state,
+	.get_requested_power = devfreq_cooling_get_requested_power,
+	.state2power = devfreq_cooling_state2power,
+	.power2state = devfreq_cooling_power2state,
+};
+
+static int cmp_freq_desc(const void *a, const void *b)
+{
+	unsigned long fa = *(const unsigned long *)a;
+	unsigned long fb = *(const unsigned long *)b;
+
+	if (fa == fb)
+		return 0;
+	return fa > fb ? -1 : 1;
+}
+
+static int devfreq_cooling_gen_freq_table(struct devfreq_cooling_device *dfc)
+{
+	struct devfreq_dev_profile *profile = dfc->devfreq->profile;
+	unsigned int i;
+
+	if (!profile->freq_table || !profile->max_state)
+		return -EINVAL;
+
+	dfc->freq_table = kcalloc(profile->max_state,
+				  sizeof(*dfc->freq_table), GFP_KERNEL);
+	if (!dfc->freq_table)
+		return -ENOMEM;
+
+	for (i = 0; i < profile->max_state; i++)
+		dfc->freq_table[i] = profile->freq_table[i];
+	sort(dfc->freq_table, profile->max_state, sizeof(*dfc->freq_table),
+	     cmp_freq_desc, NULL);
+	dfc->freq_table_size = profile->max_state;
+
+	return 0;
+}
+
+static unsigned long get_voltage(struct devfreq_cooling_device *dfc,
+				 struct device_node *np, unsigned long freq)
+{
+	struct device *dev = dfc->devfreq->dev.parent;
+	struct dev_pm_opp *opp;
+	unsigned long voltage;
+	int i, n;
+	u32 pair[2];
+
+	n = of_property_count_u32_elems(np, "qcom,freq-voltage-table");
+	for (i = 0; i + 1 < n; i += 2) {
+		if (of_property_read_u32_index(np, "qcom,freq-voltage-table",
+					       i, &pair[0]) ||
+		    of_property_read_u32_index(np, "qcom,freq-voltage-table",
+					       i + 1, &pair[1]))
+			break;
+		if (pair[0] == freq)
+			return pair[1];
+	}
+
+	rcu_read_lock();
+	opp = dev_pm_opp_find_freq_exact(dev, freq, true);
+	voltage = IS_ERR(opp) ? 0 : dev_pm_opp_get_voltage(opp);
+	rcu_read_unlock();
+
+	return voltage;
+}
+
+static int devfreq_cooling_gen_power_table(struct devfreq_cooling_device *dfc,
+					   struct device_node *np,
+					   u32 capacitance)
+{
+	unsigned int i;
+
+	dfc->power_table = kcalloc(dfc->freq_table_size,
+				   sizeof(*dfc->power_table), GFP_KERNEL);
+	dfc->voltage_table = kcalloc(dfc->freq_table_size,
+				     sizeof(*dfc->voltage_table), GFP_KERNEL);
+	if (!dfc->power_table || !dfc->voltage_table)
+		return -ENOMEM;
+
+	for (i = 0; i < dfc->freq_table_size; i++) {
+		unsigned long freq = dfc->freq_table[i];
+		u64 freq_mhz = freq / 1000000, voltage_mv, power;
+
+		dfc->voltage_table[i] = get_voltage(dfc, np, freq);
+		if (!dfc->voltage_table[i]) {
+			pr_err("%s: no voltage for %lu\n", np->full_name, freq);
+			return -EINVAL;
+		}
+		voltage_mv = dfc->voltage_table[i] / 1000;
+
+		power = capacitance * freq_mhz * voltage_mv * voltage_mv;
+		do_div(power, 1000000000);
+		dfc->power_table[i] = power;
+	}
+
+	of_thermal_static_power_init(np, &dfc->static_power);
+
+	return 0;
+}
+
+static void devfreq_cooling_free(struct devfreq_cooling_device *dfc)
+{
+	kfree(dfc->power_table);
+	kfree(dfc->voltage_table);
+	kfree(dfc->freq_table);
+	kfree(dfc);
+}
+
+/**
+ * of_devfreq_cooling_register() - create a cooling device for a devfreq device
+ * @np: device tree node of the cooling device, carrying the power model
+ * @df: devfreq device to cap, with a frequency table in its profile
+ *
+ * Registers a cooling device "thermal-devfreq-%d" linked to @np. If @np
+ * has a dynamic-power-coefficient the device implements the power actor
+ * interface. The load reported to the thermal governor is taken from
+ * df->last_status, which the devfreq governor of @df has to keep
+ * updated.
+ *
+ * Return: a valid struct thermal_cooling_device pointer on success,
+ * on failure, it returns a corresponding ERR_PTR().
+ */
+struct thermal_cooling_device *
+of_devfreq_cooling_register(struct device_node *np, struct devfreq *df)
+{
+	struct thermal_cooling_device *cdev;
+	struct thermal_cooling_device_ops *ops = &devfreq_cooling_ops;
+	struct devfreq_cooling_device *dfc;
+	char dev_name[THERMAL_NAME_LENGTH];
+	u32 capacitance = 0;
+	int ret;
+
+	if (!np || !df)
+		return ERR_PTR(-EINVAL);
+
+	dfc = kzalloc(sizeof(*dfc), GFP_KERNEL);
+	if (!dfc)
+		return ERR_PTR(-ENOMEM);
+
+	dfc->devfreq = df;
+
+	ret = devfreq_cooling_gen_freq_table(dfc);
+	if (ret)
+		goto free_dfc;
+
+	of_property_read_u32(np, "dynamic-power-coefficient", &capacitance);
+	if (capacitance) {
+		ret = devfreq_cooling_gen_power_table(dfc, np, capacitance);
+		if (ret)
+			goto free_dfc;
+		ops = &devfreq_cooling_power_ops;
+	}
+
+	ret = get_idr(&dfc->id);
+	if (ret)
+		goto free_dfc;
+
+	snprintf(dev_name, sizeof(dev_name), "thermal-devfreq-%d", dfc->id);
+
+	cdev = thermal_of_cooling_device_register(np, dev_name, dfc, ops);
+	if (IS_ERR(cdev)) {
+		ret = PTR_ERR(cdev);
+		goto remove_idr;
+	}
+
+	dfc->cdev = cdev;
+
+	return cdev;
+
+remove_idr:
+	release_idr(dfc->id);
+free_dfc:
+	devfreq_cooling_free(dfc);
+
+	return ERR_PTR(ret);
+}
+EXPORT_SYMBOL_GPL(of_devfreq_cooling_register);
+
+/**
+ * devfreq_cooling_unregister() - remove a devfreq cooling device
+ * @cdev: cooling device returned by of_devfreq_cooling_register()
+ *
+ * The frequency limit set by the cooling device is lifted.
+ */
+void devfreq_cooling_unregister(struct thermal_cooling_device *cdev)
+{
+	struct devfreq_cooling_device *dfc;
+
+	if (IS_ERR_OR_NULL(cdev))
+		return;
+
+	dfc = cdev->devdata;
+
+	thermal_cooling_device_unregister(cdev);
+
+	if (dfc->cooling_state) {
+		mutex_lock(&dfc->devfreq->lock);
+		dfc->devfreq->thermal_max_freq = 0;
+		update_devfreq(dfc->devfreq);
+		mutex_unlock(&dfc->devfreq->lock);
+	}
+
+	release_idr(dfc->id);
+	devfreq_cooling_free(dfc);
+}
+EXPORT_SYMBOL_GPL(devfreq_cooling_unregister);
@@ -64,6 +64,9 @@
 #define MSM_THERMAL_NAME "msm_thermal"
 #define MSM_TSENS_PRINT  "log_tsens_temperature"
 #define MSM_TSENS_SAMPLING  "tsens_hw_sampling"
+#define MSM_BOOT_MITIGATION "boot_mitigation"
+#define MSM_BOOT_STATS      "stats"
+#define DEFAULT_TEMP_WINDOW_DEGC 5
 #define CPU_BUF_SIZE 64
 #define CPU_DEVICE "cpu%d"
 #define MAX_DEBUGFS_CONFIG_LEN   32
@@ -230,6 +233,26 @@ enum therm_ddr_events {
 	THERM_DDR_MAX_THRESH
 };
 
+/*
+ * State of the PID loop deriving a frequency cap from the distance of the
+ * boot mitigation sensor to limit_temp_degC. err_sum and prev_err are in
+ * degC, one term per check_temp sample.
+ */
+struct freq_pid {
+	bool active;
+	long err_sum;
+	long prev_err;
+};
+
+/* check_temp wakeups and overshoot above limit_temp_degC */
+struct check_temp_stats {
+	u64 timer_wakeups;
+	u64 trip_wakeups;
+	u64 over_limit;
+	long max_overshoot;
+	u64 reset_time;
+};
+
 struct cluster_info {
 	int cluster_id;
 	uint32_t entity_count;
@@ -243,6 +266,7 @@ struct cluster_info {
 	bool sync_cluster;
 	uint32_t limited_max_freq;
 	uint32_t limited_min_freq;
+	struct freq_pid pid;
 };
 
 struct cpu_info {
@@ -361,6 +385,7 @@ struct msm_thermal_debugfs_entry {
 	struct dentry *parent;
 	struct dentry *tsens_print;
 	struct dentry *tsens_sampling;
+	struct dentry *boot_mitigation;
 	struct dentry *config;
 	struct dentry *config_data;
 };
@@ -382,6 +407,12 @@ static struct threshold_info *thresh;
 static bool mx_restr_applied;
 static struct cluster_info *core_ptr;
 static struct msm_thermal_debugfs_entry *msm_therm_debugfs;
+static struct freq_pid boot_freq_pid;
+static struct sensor_threshold check_temp_thresh[MAX_THRESHOLD];
+static int check_temp_zone_id = -ENODEV;
+static atomic_t check_temp_tripped;
+static struct check_temp_stats check_temp_stats;
+static DEFINE_SPINLOCK(check_temp_stats_lock);
 static struct devmgr_devices *devices;
 static struct msm_thermal_debugfs_thresh_config *mit_config;
 static struct msm_bus_scale_pdata *therm_ddr_lm_data;
@@ -1197,6 +1228,61 @@ static const struct file_operations thermal_debugfs_tsens_sampling_ops = {
 	.release = single_release,
 };
 
+static int thermal_boot_stats_debugfs_read(struct seq_file *m, void *data)
+{
+	struct check_temp_stats stats;
+	u64 secs, timer_rate, trip_rate;
+	unsigned long flags;
+
+	spin_lock_irqsave(&check_temp_stats_lock, flags);
+	stats = check_temp_stats;
+	spin_unlock_irqrestore(&check_temp_stats_lock, flags);
+
+	secs = div_u64(get_jiffies_64() - stats.reset_time, HZ);
+	timer_rate = div64_u64(stats.timer_wakeups * 3600, secs ?: 1);
+	trip_rate = div64_u64(stats.trip_wakeups * 3600, secs ?: 1);
+
+	seq_printf(m, "polling:%s\n", polling_enabled ? "enabled" : "disabled");
+	seq_printf(m, "elapsed:%llu s\n", secs);
+	seq_printf(m, "timer wakeups:%llu (%llu/hour)\n",
+			stats.timer_wakeups, timer_rate);
+	seq_printf(m, "threshold wakeups:%llu (%llu/hour)\n",
+			stats.trip_wakeups, trip_rate);
+	seq_printf(m, "samples over limit:%llu\n", stats.over_limit);
+	seq_printf(m, "max overshoot:%ld degC\n", stats.max_overshoot);
+
+	return 0;
+}
+
+static ssize_t thermal_boot_stats_debugfs_write(struct file *file,
+				const char __user *buffer, size_t count,
+				loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&check_temp_stats_lock, flags);
+	memset(&check_temp_stats, 0, sizeof(check_temp_stats));
+	check_temp_stats.reset_time = get_jiffies_64();
+	spin_unlock_irqrestore(&check_temp_stats_lock, flags);
+
+	return count;
+}
+
+static int thermal_boot_stats_debugfs_open(struct inode *inode,
+					struct file *file)
+{
+	return single_open(file, thermal_boot_stats_debugfs_read,
+				inode->i_private);
+}
+
+static const struct file_operations thermal_debugfs_boot_stats_ops = {
+	.open = thermal_boot_stats_debugfs_open,
+	.read = seq_read,
+	.write = thermal_boot_stats_debugfs_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int thermal_config_debugfs_open(struct inode *inode,
 					struct file *file)
 {
@@ -1299,6 +1385,25 @@ static int create_thermal_debugfs(void)
 		goto create_exit;
 	}
 
+	THERM_CREATE_DEBUGFS_DIR(msm_therm_debugfs->boot_mitigation,
+		MSM_BOOT_MITIGATION, msm_therm_debugfs->parent, ret);
+	if (ret)
+		goto create_exit;
+
+	if (!debugfs_create_file(MSM_BOOT_STATS, 0600,
+			msm_therm_debugfs->boot_mitigation, NULL,
+			&thermal_debugfs_boot_stats_ops))
+		pr_err("Error creating debugfs:[%s]\n", MSM_BOOT_STATS);
+	debugfs_create_u32("pid_kp", 0600, msm_therm_debugfs->boot_mitigation,
+			&msm_thermal_info.freq_pid_kp);
+	debugfs_create_u32("pid_ki", 0600, msm_therm_debugfs->boot_mitigation,
+			&msm_thermal_info.freq_pid_ki);
+	debugfs_create_u32("pid_kd", 0600, msm_therm_debugfs->boot_mitigation,
+			&msm_thermal_info.freq_pid_kd);
+	debugfs_create_u32("temp_window_degc", 0600,
+			msm_therm_debugfs->boot_mitigation,
+			&msm_thermal_info.temp_window_degC);
+
 	THERM_CREATE_DEBUGFS_DIR(msm_therm_debugfs->config, MSM_THERMAL_CONFIG,
 		msm_therm_debugfs->parent, ret);
 	if (ret)
@@ -1673,6 +1778,61 @@ static void update_cluster_freq(void)
 	}
 }
 
+static bool freq_pid_enabled(void)
+{
+	return msm_thermal_info.freq_pid_kp || msm_thermal_info.freq_pid_ki
+		|| msm_thermal_info.freq_pid_kd;
+}
+
+/*
+ * Compute the boot mitigation frequency cap for one frequency table from
+ * the headroom to limit_temp_degC. The gains are in KHz per degC, the
+ * output is subtracted from the highest frequency and rounded down to a
+ * table entry. The loop engages once the temperature reaches the
+ * hysteresis band below the limit and stops once the cap is back at the
+ * top of the table below that band. The integral is frozen while the
+ * output is saturated.
+ */
+static int freq_pid_idx(struct freq_pid *pid, long temp,
+	struct cpufreq_frequency_table *freq_table, int idx_low, int idx_high)
+{
+	long clr_temp = msm_thermal_info.limit_temp_degC
+			- msm_thermal_info.temp_hysteresis_degC;
+	long err = msm_thermal_info.limit_temp_degC - temp;
+	long range = freq_table[idx_high].frequency
+			- freq_table[idx_low].frequency;
+	long out, cap;
+	int idx;
+
+	if (!pid->active) {
+		if (temp < clr_temp)
+			return idx_high;
+		pid->active = true;
+		pid->err_sum = 0;
+		pid->prev_err = err;
+	}
+
+	pid->err_sum += err;
+	out = (long)msm_thermal_info.freq_pid_kp * err
+		+ (long)msm_thermal_info.freq_pid_ki * pid->err_sum
+		+ (long)msm_thermal_info.freq_pid_kd * (err - pid->prev_err);
+	pid->prev_err = err;
+	if (out >= 0 || out <= -range) {
+		pid->err_sum -= err;
+		out = clamp_t(long, out, -range, 0);
+	}
+
+	cap = freq_table[idx_high].frequency + out;
+	for (idx = idx_high; idx > idx_low; idx--)
+		if (freq_table[idx].frequency <= cap)
+			break;
+
+	if (idx == idx_high && temp < clr_temp)
+		pid->active = false;
+
+	return idx;
+}
+
 static void do_cluster_freq_ctrl(long temp)
 {
 	uint32_t _cluster = 0;
@@ -1680,6 +1840,9 @@ static void do_cluster_freq_ctrl(long temp)
 	bool mitigate = false;
 	struct cluster_info *cluster_ptr = NULL;
 
+	if (freq_pid_enabled())
+		goto update_clusters;
+
 	if (temp >= msm_thermal_info.limit_temp_degC)
 		mitigate = true;
 	else if (temp < msm_thermal_info.limit_temp_degC -
@@ -1688,13 +1851,20 @@ static void do_cluster_freq_ctrl(long temp)
 	else
 		return;
 
+update_clusters:
+
 	get_online_cpus();
 	for (; _cluster < core_ptr->entity_count; _cluster++) {
 		cluster_ptr = &core_ptr->child_entity_ptr[_cluster];
 		if (!cluster_ptr->freq_table)
 			continue;
 
-		if (mitigate)
+		if (freq_pid_enabled())
+			freq_idx = freq_pid_idx(&cluster_ptr->pid, temp,
+				cluster_ptr->freq_table,
+				cluster_ptr->freq_idx_low,
+				cluster_ptr->freq_idx_high);
+		else if (mitigate)
 			freq_idx = max_t(int, cluster_ptr->freq_idx_low,
 				(cluster_ptr->freq_idx
 				- msm_thermal_info.bootup_freq_step));
@@ -3647,7 +3817,10 @@ static void do_freq_control(long temp)
 	if (!freq_table_get)
 		return;
 
-	if (temp >= msm_thermal_info.limit_temp_degC) {
+	if (freq_pid_enabled()) {
+		limit_idx = freq_pid_idx(&boot_freq_pid, temp, table,
+				limit_idx_low, limit_idx_high);
+	} else if (temp >= msm_thermal_info.limit_temp_degC) {
 		if (limit_idx == limit_idx_low)
 			return;
 
@@ -3686,6 +3859,117 @@ static void do_freq_control(long temp)
 	put_online_cpus();
 }
 
+static int check_temp_notify(enum thermal_trip_type type, int temp, void *data)
+{
+	if (!polling_enabled)
+		return 0;
+
+	atomic_set(&check_temp_tripped, 1);
+	mod_delayed_work(system_wq, &check_temp_work, 0);
+	return 0;
+}
+
+static void update_check_temp_stats(bool tripped, long temp, int ret)
+{
+	long overshoot = temp - msm_thermal_info.limit_temp_degC;
+	unsigned long flags;
+
+	spin_lock_irqsave(&check_temp_stats_lock, flags);
+	if (tripped)
+		check_temp_stats.trip_wakeups++;
+	else
+		check_temp_stats.timer_wakeups++;
+	if (!ret && overshoot > 0) {
+		check_temp_stats.over_limit++;
+		check_temp_stats.max_overshoot =
+			max(check_temp_stats.max_overshoot, overshoot);
+	}
+	spin_unlock_irqrestore(&check_temp_stats_lock, flags);
+}
+
+/*
+ * The frequency PID loop and the one core at a time hotplug release need
+ * periodic samples, everything else is re-evaluated on threshold trips.
+ */
+static bool boot_mitigation_active(long temp)
+{
+	struct cluster_info *cluster_ptr = NULL;
+	int i;
+
+	if (!freq_table_get || cpus_offlined)
+		return true;
+
+	if (freq_pid_enabled() && temp >= msm_thermal_info.limit_temp_degC
+			- msm_thermal_info.temp_hysteresis_degC)
+		return true;
+
+	if (!core_ptr)
+		return limit_idx != limit_idx_high;
+
+	for (i = 0; i < core_ptr->entity_count; i++) {
+		cluster_ptr = &core_ptr->child_entity_ptr[i];
+		if (cluster_ptr->freq_table &&
+			cluster_ptr->freq_idx != cluster_ptr->freq_idx_high)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Arm a TSENS threshold pair temp_window_degC around the current
+ * temperature of the boot mitigation sensor, with the high threshold
+ * pulled in to the next point where mitigation has to start.
+ */
+static int set_check_temp_thresholds(long temp)
+{
+	long window = max_t(long, msm_thermal_info.temp_window_degC, 1);
+	long high = temp + window, low = temp - window;
+	long engage = msm_thermal_info.limit_temp_degC;
+	char tsens_name[TSENS_NAME_MAX] = "";
+	int ret = 0;
+
+	if (freq_pid_enabled())
+		engage -= msm_thermal_info.temp_hysteresis_degC;
+	if (core_control_enabled && msm_thermal_info.core_control_mask)
+		engage = min_t(long, engage,
+				msm_thermal_info.core_limit_temp_degC);
+	if (engage > temp)
+		high = min(high, engage);
+
+	if (check_temp_zone_id < 0) {
+		snprintf(tsens_name, TSENS_NAME_MAX, TSENS_NAME_FORMAT,
+			msm_thermal_info.sensor_id);
+		check_temp_zone_id = sensor_get_id(tsens_name);
+		if (check_temp_zone_id < 0)
+			return check_temp_zone_id;
+	}
+
+	check_temp_thresh[0].temp = high * tsens_scaling_factor;
+	check_temp_thresh[0].trip = THERMAL_TRIP_CONFIGURABLE_HI;
+	check_temp_thresh[1].temp = low * tsens_scaling_factor;
+	check_temp_thresh[1].trip = THERMAL_TRIP_CONFIGURABLE_LOW;
+	check_temp_thresh[0].notify = check_temp_thresh[1].notify =
+		check_temp_notify;
+
+	ret = set_and_activate_threshold(check_temp_zone_id,
+			&check_temp_thresh[0]);
+	if (ret)
+		return ret;
+
+	return set_and_activate_threshold(check_temp_zone_id,
+			&check_temp_thresh[1]);
+}
+
+static void cancel_check_temp_thresholds(void)
+{
+	if (check_temp_zone_id < 0)
+		return;
+
+	sensor_cancel_trip(check_temp_zone_id, &check_temp_thresh[0]);
+	sensor_cancel_trip(check_temp_zone_id, &check_temp_thresh[1]);
+}
+
 static void check_temp(struct work_struct *work)
 {
 	long temp = 0;
@@ -3694,6 +3978,8 @@ static void check_temp(struct work_struct *work)
 	do_therm_reset();
 
 	ret = therm_get_temp(msm_thermal_info.sensor_id, THERM_TSENS_ID, &temp);
+	update_check_temp_stats(atomic_xchg(&check_temp_tripped, 0), temp,
+			ret);
 	if (ret) {
 		pr_err("Unable to read TSENS sensor:%d. err:%d\n",
 				msm_thermal_info.sensor_id, ret);
@@ -3719,7 +4005,15 @@ static void check_temp(struct work_struct *work)
 	do_freq_control(temp);
 
 reschedule:
-	if (polling_enabled)
+	if (!polling_enabled)
+		return;
+
+	/*
+	 * The thresholds stay armed while sampling periodically so that a
+	 * fast ramp is handled before the next sample is due.
+	 */
+	if (ret || set_check_temp_thresholds(temp) ||
+			boot_mitigation_active(temp))
 		schedule_delayed_work(&check_temp_work,
 				msecs_to_jiffies(msm_thermal_info.poll_ms));
 }
@@ -4989,6 +5283,7 @@ static void __ref disable_msm_thermal(void)
 
 	/* make sure check_temp is no longer running */
 	cancel_delayed_work_sync(&check_temp_work);
+	cancel_check_temp_thresholds();
 
 	get_online_cpus();
 	for_each_possible_cpu(cpu) {
@@ -5473,6 +5768,7 @@ int msm_thermal_init(struct msm_thermal_data *pdata)
 	pm_notifier(msm_thermal_suspend_callback, 0);
 	INIT_DELAYED_WORK(&retry_hotplug_work, retry_hotplug);
 	INIT_DELAYED_WORK(&check_temp_work, check_temp);
+	check_temp_stats.reset_time = get_jiffies_64();
 	schedule_delayed_work(&check_temp_work, 0);
 
 	if (num_possible_cpus() > 1) {
@@ -7266,6 +7562,12 @@ static void thermal_boot_config_read(struct seq_file *m, void *data)
 			- msm_thermal_info.temp_hysteresis_degC);
 	seq_printf(m, "frequency step:%d\n",
 			msm_thermal_info.bootup_freq_step);
+	seq_printf(m, "frequency pid gains:%u %u %u KHz/degC\n",
+			msm_thermal_info.freq_pid_kp,
+			msm_thermal_info.freq_pid_ki,
+			msm_thermal_info.freq_pid_kd);
+	seq_printf(m, "threshold window:%u degC\n",
+			msm_thermal_info.temp_window_degC);
 	seq_printf(m, "frequency mask:0x%x\n",
 			msm_thermal_info.bootup_freq_control_mask);
 	seq_printf(m, "hotplug threshold:%d degC\n",
@@ -7604,6 +7906,7 @@ static int msm_thermal_dev_probe(struct platform_device *pdev)
 	char *key = NULL;
 	struct device_node *node = pdev->dev.of_node;
 	struct msm_thermal_data data;
+	u32 pid_gains[3];
 
 	if (!mitigation)
 		return ret;
@@ -7642,6 +7945,17 @@ static int msm_thermal_dev_probe(struct platform_device *pdev)
 	if (ret)
 		goto fail;
 
+	key = "qcom,freq-pid-gains";
+	if (!of_property_read_u32_array(node, key, pid_gains, 3)) {
+		data.freq_pid_kp = pid_gains[0];
+		data.freq_pid_ki = pid_gains[1];
+		data.freq_pid_kd = pid_gains[2];
+	}
+
+	key = "qcom,temp-window";
+	if (of_property_read_u32(node, key, &data.temp_window_degC))
+		data.temp_window_degC = DEFAULT_TEMP_WINDOW_DEGC;
+
 	key = "qcom,online-hotplug-core";
 	if (of_property_read_bool(node, key))
 		online_core = true;
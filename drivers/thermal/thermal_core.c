@@ -929,6 +929,103 @@ exit:
 }
 EXPORT_SYMBOL_GPL(thermal_zone_get_temp);
 
+/**
+ * thermal_zone_get_temp_degc() - temperature of a thermal zone in degC
+ * @tz: a valid pointer to a struct thermal_zone_device
+ * @temp: a valid pointer to where to store the temperature
+ *
+ * Like thermal_zone_get_temp(), converted from the units the zone
+ * declares in its params.
+ *
+ * Return: On success returns 0, an error code otherwise
+ */
+int thermal_zone_get_temp_degc(struct thermal_zone_device *tz, long *temp)
+{
+	unsigned long t;
+	int ret;
+
+	ret = thermal_zone_get_temp(tz, &t);
+	if (ret)
+		return ret;
+
+	*temp = (long)t;
+	if (tz->tzp && tz->tzp->millicelsius)
+		*temp /= 1000;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(thermal_zone_get_temp_degc);
+
+/**
+ * of_thermal_static_power_init() - read a leakage model from DT
+ * @np: node of the power actor
+ * @sp: model to fill in
+ *
+ * Return: 0 if @np has a qcom,static-power-coefficient, -ENODEV otherwise
+ */
+int of_thermal_static_power_init(struct device_node *np,
+				 struct thermal_static_power *sp)
+{
+	memset(sp, 0, sizeof(*sp));
+
+	if (of_property_read_u32(np, "qcom,static-power-coefficient",
+				 &sp->coeff) || !sp->coeff)
+		return -ENODEV;
+
+	if (!of_property_read_u32_array(np, "qcom,static-power-temp-scale",
+					(u32 *)sp->temp_scale, 4))
+		of_property_read_string(np, "qcom,static-power-thermal-zone",
+					&sp->tz_name);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(of_thermal_static_power_init);
+
+/* temperature scale * 10^6, 10^6 if the temperature is not known */
+static s64 thermal_static_temp_scale(struct thermal_static_power *sp)
+{
+	long t;
+
+	if (!sp->tz && sp->tz_name) {
+		sp->tz = thermal_zone_get_zone_by_name(sp->tz_name);
+		if (IS_ERR(sp->tz))
+			sp->tz = NULL;
+	}
+	if (!sp->tz || thermal_zone_get_temp_degc(sp->tz, &t))
+		return 1000000;
+
+	return (((s64)sp->temp_scale[3] * t + sp->temp_scale[2]) * t
+		+ sp->temp_scale[1]) * t + sp->temp_scale[0];
+}
+
+/**
+ * thermal_static_power() - static power of a power actor
+ * @sp: leakage model from of_thermal_static_power_init()
+ * @voltage: supply voltage in uV
+ *
+ * Return: static power in mW at the current temperature
+ */
+u32 thermal_static_power(struct thermal_static_power *sp,
+			 unsigned long voltage)
+{
+	u64 mv = voltage / 1000, p;
+	s64 scale;
+
+	if (!sp->coeff)
+		return 0;
+
+	scale = thermal_static_temp_scale(sp);
+	if (scale <= 0)
+		return 0;
+
+	/* coeff * mV^3 / 10^3 is in mW * 10^6, scale carries another 10^6 */
+	p = div_u64((u64)sp->coeff * mv * mv * mv, 1000);
+	p = div_u64(p * scale, 1000000);
+
+	return div_u64(p, 1000000);
+}
+EXPORT_SYMBOL_GPL(thermal_static_power);
+
 static void update_temperature(struct thermal_zone_device *tz)
 {
 	long temp;
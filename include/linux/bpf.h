@@ -10,6 +10,9 @@
 #include <uapi/linux/bpf.h>
 #include <linux/workqueue.h>
 #include <linux/file.h>
+#include <linux/cpumask.h>
+#include <linux/kernel.h>
+#include <linux/err.h>
 
 struct bpf_map;
 
@@ -22,7 +25,8 @@ struct bpf_map_ops {
 
 	/* funcs callable from userspace and from eBPF programs */
 	void *(*map_lookup_elem)(struct bpf_map *map, void *key);
-	int (*map_update_elem)(struct bpf_map *map, void *key, void *value);
+	int (*map_update_elem)(struct bpf_map *map, void *key, void *value,
+			       u64 flags);
 	int (*map_delete_elem)(struct bpf_map *map, void *key);
 };
 
@@ -36,6 +40,44 @@ struct bpf_map {
 	struct work_struct work;
 };
 
+/* per-cpu maps hold one value slot for every possible CPU. eBPF programs
+ * only see the slot of the CPU they are running on, while the syscall
+ * copies all of them, each rounded up to 8 bytes
+ */
+static inline bool bpf_map_is_percpu(const struct bpf_map *map)
+{
+	return map->map_type == BPF_MAP_TYPE_PERCPU_HASH ||
+	       map->map_type == BPF_MAP_TYPE_PERCPU_ARRAY;
+}
+
+static inline u32 bpf_map_value_size(const struct bpf_map *map)
+{
+	if (bpf_map_is_percpu(map))
+		return round_up(map->value_size, 8) * num_possible_cpus();
+	return map->value_size;
+}
+
+/* an eBPF program may chain into another one through bpf_tail_call()
+ * at most this many times before the call falls through
+ */
+#define MAX_TAIL_CALL_CNT 32
+
+struct bpf_array {
+	struct bpf_map map;
+	u32 elem_size;
+	/* a prog_array is owned by the type and the JIT state of the
+	 * first program stored in it or using it, so that callers and
+	 * callees can always share the same context and stack frame
+	 */
+	enum bpf_prog_type owner_prog_type;
+	bool owner_jited;
+	union {
+		char value[0] __aligned(8);
+		void *ptrs[0] __aligned(8);
+		void __percpu *pptrs[0] __aligned(8);
+	};
+};
+
 struct bpf_map_type_list {
 	struct list_head list_node;
 	struct bpf_map_ops *ops;
@@ -46,6 +88,13 @@ void bpf_register_map_type(struct bpf_map_type_list *tl);
 void bpf_map_put(struct bpf_map *map);
 struct bpf_map *bpf_map_get(struct fd f);
 
+int bpf_percpu_hash_copy(struct bpf_map *map, void *key, void *value);
+int bpf_percpu_hash_update(struct bpf_map *map, void *key, void *value,
+			   u64 flags);
+int bpf_percpu_array_copy(struct bpf_map *map, void *key, void *value);
+int bpf_percpu_array_update(struct bpf_map *map, void *key, void *value,
+			    u64 flags);
+
 /* function argument constraints */
 enum bpf_arg_type {
 	ARG_DONTCARE = 0,	/* unused argument in helper function */
@@ -63,6 +112,7 @@ enum bpf_arg_type {
 	ARG_PTR_TO_STACK,	/* any pointer to eBPF program stack */
 	ARG_CONST_STACK_SIZE,	/* number of bytes accessed from stack */
 
+	ARG_PTR_TO_CTX,		/* pointer to context */
 	ARG_ANYTHING,		/* any (initialized) argument is ok */
 };
 
@@ -107,6 +157,13 @@ struct bpf_verifier_ops {
 	 * with 'type' (read or write) is allowed
 	 */
 	bool (*is_valid_access)(int off, int size, enum bpf_access_type type);
+
+	/* rewrite a load from the user visible context at offset 'ctx_off'
+	 * into loads from the in-kernel structure, return the number of
+	 * instructions written to 'insn_buf'
+	 */
+	u32 (*convert_ctx_access)(int dst_reg, int src_reg, int ctx_off,
+				  struct bpf_insn *insn_buf);
 };
 
 struct bpf_prog_type_list {
@@ -127,12 +184,35 @@ struct bpf_prog_aux {
 	struct bpf_map **used_maps;
 	u32 used_map_cnt;
 	struct bpf_prog *prog;
-	struct work_struct work;
+	union {
+		struct work_struct work;
+		struct rcu_head rcu;
+	};
 };
 
+#ifdef CONFIG_BPF_SYSCALL
 void bpf_prog_put(struct bpf_prog *prog);
 struct bpf_prog *bpf_prog_get(u32 ufd);
+bool bpf_prog_array_compatible(struct bpf_array *array,
+			       const struct bpf_prog *fp);
+void bpf_fd_array_map_clear(struct bpf_map *map);
+#else
+static inline void bpf_prog_put(struct bpf_prog *prog)
+{
+}
+
+static inline struct bpf_prog *bpf_prog_get(u32 ufd)
+{
+	return ERR_PTR(-EOPNOTSUPP);
+}
+#endif
 /* verify correctness of eBPF program */
-int bpf_check(struct bpf_prog *fp, union bpf_attr *attr);
+int bpf_check(struct bpf_prog **fp, union bpf_attr *attr);
+
+/* verifier prototypes for helper functions called from eBPF programs */
+extern const struct bpf_func_proto bpf_map_lookup_elem_proto;
+extern const struct bpf_func_proto bpf_map_update_elem_proto;
+extern const struct bpf_func_proto bpf_map_delete_elem_proto;
+extern const struct bpf_func_proto bpf_tail_call_proto;
 
 #endif /* _LINUX_BPF_H */
@@ -140,6 +140,10 @@ struct devfreq_governor {
  *		touch this.
  * @min_freq:	Limit minimum frequency requested by user (0: none)
  * @max_freq:	Limit maximum frequency requested by user (0: none)
+ * @thermal_max_freq:	Limit maximum frequency set by a cooling device
+ *			(0: none), applied on top of @max_freq
+ * @last_status:	devfreq user device info, performance statistics of
+ *			the last sample taken by the governor
  * @stop_polling:	 devfreq polling status of a device.
  * @total_trans:	Number of devfreq transitions
  * @trans_table:	Statistics of devfreq transitions
@@ -171,6 +175,8 @@ struct devfreq {
 
 	unsigned long min_freq;
 	unsigned long max_freq;
+	unsigned long thermal_max_freq;
+	struct devfreq_dev_status last_status;
 	bool stop_polling;
 
 	/* information for device frequency transition */
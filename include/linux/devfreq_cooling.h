@@ -0,0 +1,52 @@
+/*
+ * devfreq_cooling: Thermal cooling device implementation for devices using
+ *                  devfreq
+ *
+ * Copyright (C) 2014-2015 ARM Limited
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __DEVFREQ_COOLING_H__
+#define __DEVFREQ_COOLING_H__
+
+#include <linux/devfreq.h>
+#include <linux/err.h>
+#include <linux/of.h>
+#include <linux/thermal.h>
+
+#ifdef CONFIG_DEVFREQ_THERMAL
+/**
+ * of_devfreq_cooling_register - create a cooling device for a devfreq device
+ * @np: device tree node of the cooling device, carrying the power model
+ * @df: devfreq device to cap
+ */
+struct thermal_cooling_device *
+of_devfreq_cooling_register(struct device_node *np, struct devfreq *df);
+
+/**
+ * devfreq_cooling_unregister - remove a devfreq cooling device
+ * @cdev: cooling device returned by of_devfreq_cooling_register
+ */
+void devfreq_cooling_unregister(struct thermal_cooling_device *cdev);
+#else /* !CONFIG_DEVFREQ_THERMAL */
+static inline struct thermal_cooling_device *
+of_devfreq_cooling_register(struct device_node *np, struct devfreq *df)
+{
+	return ERR_PTR(-ENOSYS);
+}
+
+static inline void
+devfreq_cooling_unregister(struct thermal_cooling_device *cdev)
+{
+}
+#endif /* CONFIG_DEVFREQ_THERMAL */
+
+#endif /* __DEVFREQ_COOLING_H__ */
@@ -43,6 +43,10 @@ struct msm_thermal_data {
 	int32_t temp_hysteresis_degC;
 	uint32_t bootup_freq_step;
 	uint32_t bootup_freq_control_mask;
+	uint32_t freq_pid_kp;
+	uint32_t freq_pid_ki;
+	uint32_t freq_pid_kd;
+	uint32_t temp_window_degC;
 	int32_t core_limit_temp_degC;
 	int32_t core_temp_hysteresis_degC;
 	int32_t hotplug_temp_degC;
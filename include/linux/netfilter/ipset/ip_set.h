@@ -15,6 +15,9 @@
 #include <linux/netlink.h>
 #include <linux/netfilter.h>
 #include <linux/netfilter/x_tables.h>
+#include <linux/percpu.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
 #include <linux/stringify.h>
 #include <linux/vmalloc.h>
 #include <net/netlink.h>
@@ -103,9 +106,19 @@ struct ip_set_ext {
 	char *comment;
 };
 
+/* The counters are kept per-CPU and folded when read */
+struct ip_set_cpu_counter {
+	u64 bytes;
+	u64 packets;
+};
+
+struct ip_set_counter_data {
+	struct rcu_head rcu;
+	struct ip_set_cpu_counter __percpu *cpu;
+};
+
 struct ip_set_counter {
-	atomic64_t bytes;
-	atomic64_t packets;
+	struct ip_set_counter_data __rcu *data;
 };
 
 struct ip_set_comment {
@@ -165,6 +178,8 @@ struct ip_set_type_variant {
 
 	/* When adding entries and set is full, try to resize the set */
 	int (*resize)(struct ip_set *set, bool retried);
+	/* Make room for the given number of new elements in advance */
+	int (*reserve)(struct ip_set *set, u32 elements);
 	/* Destroy the set */
 	void (*destroy)(struct ip_set *set);
 	/* Flush the elements */
@@ -180,6 +195,9 @@ struct ip_set_type_variant {
 	/* Return true if "b" set is the same as "a"
 	 * according to the create set parameters */
 	bool (*same_set)(const struct ip_set *a, const struct ip_set *b);
+	/* Kernelspace test is RCU safe and can be called
+	 * without holding the set lock */
+	bool lockless_test;
 };
 
 /* The core set type structure */
@@ -248,15 +266,28 @@ struct ip_set {
 	void *data;
 };
 
+/* Destroy the extensions of an element which is overwritten in place
+ * by a re-add: the counters are kept and updated by ip_set_init_counter */
+static inline void
+ip_set_ext_reset(struct ip_set *set, void *data)
+{
+	if (SET_WITH_COMMENT(set))
+		ip_set_extensions[IPSET_EXT_ID_COMMENT].destroy(
+			ext_comment(data, set));
+}
+
+/* Destroy the extensions of an element which is not visible to the
+ * lockless readers anymore */
 static inline void
 ip_set_ext_destroy(struct ip_set *set, void *data)
 {
 	/* Check that the extension is enabled for the set and
 	 * call it's destroy function for its extension part in data.
 	 */
-	if (SET_WITH_COMMENT(set))
-		ip_set_extensions[IPSET_EXT_ID_COMMENT].destroy(
-			ext_comment(data, set));
+	if (SET_WITH_COUNTER(set))
+		ip_set_extensions[IPSET_EXT_ID_COUNTER].destroy(
+			ext_counter(data, set));
+	ip_set_ext_reset(set, data);
 }
 
 static inline int
@@ -282,28 +313,63 @@ ip_set_put_flags(struct sk_buff *skb, struct ip_set *set)
 	return nla_put_net32(skb, IPSET_ATTR_CADT_FLAGS, htonl(cadt_flags));
 }
 
+/* The counters of an element may be freed under the readers, load the
+ * pointer once and use that copy only. The memory stays valid until the
+ * end of the RCU-bh read side section. */
 static inline void
 ip_set_add_bytes(u64 bytes, struct ip_set_counter *counter)
 {
-	atomic64_add((long long)bytes, &(counter)->bytes);
+	struct ip_set_counter_data *c = rcu_dereference_bh(counter->data);
+
+	if (likely(c))
+		this_cpu_add(c->cpu->bytes, bytes);
 }
 
 static inline void
 ip_set_add_packets(u64 packets, struct ip_set_counter *counter)
 {
-	atomic64_add((long long)packets, &(counter)->packets);
+	struct ip_set_counter_data *c = rcu_dereference_bh(counter->data);
+
+	if (likely(c))
+		this_cpu_add(c->cpu->packets, packets);
 }
 
 static inline u64
 ip_set_get_bytes(const struct ip_set_counter *counter)
 {
-	return (u64)atomic64_read(&(counter)->bytes);
+	struct ip_set_counter_data *c = rcu_dereference_bh(counter->data);
+	u64 bytes = 0;
+	int cpu;
+
+	if (unlikely(!c))
+		return 0;
+	for_each_possible_cpu(cpu)
+		bytes += per_cpu_ptr(c->cpu, cpu)->bytes;
+	return bytes;
 }
 
 static inline u64
 ip_set_get_packets(const struct ip_set_counter *counter)
 {
-	return (u64)atomic64_read(&(counter)->packets);
+	struct ip_set_counter_data *c = rcu_dereference_bh(counter->data);
+	u64 packets = 0;
+	int cpu;
+
+	if (unlikely(!c))
+		return 0;
+	for_each_possible_cpu(cpu)
+		packets += per_cpu_ptr(c->cpu, cpu)->packets;
+	return packets;
+}
+
+/* Memory used by the per-CPU counters of the given number of elements */
+static inline size_t
+ip_set_counter_memsize(const struct ip_set *set, u32 elements)
+{
+	if (!SET_WITH_COUNTER(set))
+		return 0;
+	return (size_t)elements * (sizeof(struct ip_set_counter_data) +
+		num_possible_cpus() * sizeof(struct ip_set_cpu_counter));
 }
 
 static inline void
@@ -368,14 +434,42 @@ ip_set_put_counter(struct sk_buff *skb, struct ip_set_counter *counter)
 			     cpu_to_be64(ip_set_get_packets(counter)));
 }
 
-static inline void
+/* Called with the set write-locked. A new element gets new counters,
+ * a re-added one keeps its counters unless new values are given. */
+static inline int
 ip_set_init_counter(struct ip_set_counter *counter,
 		    const struct ip_set_ext *ext)
 {
-	if (ext->bytes != ULLONG_MAX)
-		atomic64_set(&(counter)->bytes, (long long)(ext->bytes));
-	if (ext->packets != ULLONG_MAX)
-		atomic64_set(&(counter)->packets, (long long)(ext->packets));
+	struct ip_set_counter_data *c =
+		rcu_dereference_protected(counter->data, 1);
+	struct ip_set_cpu_counter *cnt;
+	int cpu;
+
+	if (!c) {
+		c = kmalloc(sizeof(*c), GFP_ATOMIC);
+		if (unlikely(!c))
+			return -ENOMEM;
+		c->cpu = alloc_percpu_gfp(struct ip_set_cpu_counter,
+					  GFP_ATOMIC);
+		if (unlikely(!c->cpu)) {
+			kfree(c);
+			return -ENOMEM;
+		}
+	}
+	/* The given values are stored in the slot of the current CPU */
+	cnt = raw_cpu_ptr(c->cpu);
+	if (ext->bytes != ULLONG_MAX) {
+		for_each_possible_cpu(cpu)
+			per_cpu_ptr(c->cpu, cpu)->bytes = 0;
+		cnt->bytes = ext->bytes;
+	}
+	if (ext->packets != ULLONG_MAX) {
+		for_each_possible_cpu(cpu)
+			per_cpu_ptr(c->cpu, cpu)->packets = 0;
+		cnt->packets = ext->packets;
+	}
+	rcu_assign_pointer(counter->data, c);
+	return 0;
 }
 
 /* Netlink CB args */
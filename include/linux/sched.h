@@ -2031,6 +2031,11 @@ struct sched_load {
 	unsigned long predicted_load;
 };
 
+#if defined(CONFIG_SCHED_FREQ_INPUT) || defined(CONFIG_SCHED_HMP)
+/* length of the window task demand is accounted over, in ns */
+extern unsigned int sched_ravg_window;
+#endif
+
 #if defined(CONFIG_SCHED_QHMP) || !defined(CONFIG_SCHED_HMP)
 static inline int sched_update_freq_max_load(const cpumask_t *cpumask)
 {
@@ -356,6 +356,14 @@ struct thermal_zone_params {
 	 * 		Used by thermal zone drivers (default 0).
 	 */
 	int offset;
+
+	/*
+	 * @millicelsius:	the zone reports temperatures in mdegC.
+	 *			Zones without it, and zones registered
+	 *			without params like the tsens ones, report
+	 *			degC.
+	 */
+	bool millicelsius;
 };
 
 struct thermal_genl_event {
@@ -395,6 +403,25 @@ struct thermal_trip {
 	enum thermal_trip_type type;
 };
 
+/**
+ * struct thermal_static_power - leakage model of a power actor
+ * @coeff: static power in mW at 1V and a temperature scale of 1
+ * @temp_scale: polynomial <t0 t1 t2 t3>, the temperature scale * 10^6 is
+ *	t0 + t1 * T + t2 * T^2 + t3 * T^3 with T in degC
+ * @tz_name: thermal zone giving T, the scale is 1 without it
+ * @tz: resolved @tz_name
+ *
+ * Static power is @coeff * V^3 * scale. Filled in from the DT properties
+ * qcom,static-power-coefficient, qcom,static-power-temp-scale and
+ * qcom,static-power-thermal-zone by of_thermal_static_power_init().
+ */
+struct thermal_static_power {
+	u32 coeff;
+	s32 temp_scale[4];
+	const char *tz_name;
+	struct thermal_zone_device *tz;
+};
+
 /* Function declarations */
 #ifdef CONFIG_THERMAL_OF
 struct thermal_zone_device *
@@ -450,6 +477,12 @@ thermal_of_cooling_device_register(struct device_node *np, char *, void *,
 void thermal_cooling_device_unregister(struct thermal_cooling_device *);
 struct thermal_zone_device *thermal_zone_get_zone_by_name(const char *name);
 int thermal_zone_get_temp(struct thermal_zone_device *tz, unsigned long *temp);
+int thermal_zone_get_temp_degc(struct thermal_zone_device *tz, long *temp);
+
+int of_thermal_static_power_init(struct device_node *np,
+				 struct thermal_static_power *sp);
+u32 thermal_static_power(struct thermal_static_power *sp,
+			 unsigned long voltage);
 
 int get_tz_trend(struct thermal_zone_device *, int);
 struct thermal_instance *get_thermal_instance(struct thermal_zone_device *,
@@ -512,6 +545,15 @@ static inline struct thermal_zone_device *thermal_zone_get_zone_by_name(
 static inline int thermal_zone_get_temp(
 		struct thermal_zone_device *tz, unsigned long *temp)
 { return -ENODEV; }
+static inline int thermal_zone_get_temp_degc(
+		struct thermal_zone_device *tz, long *temp)
+{ return -ENODEV; }
+static inline int of_thermal_static_power_init(struct device_node *np,
+		struct thermal_static_power *sp)
+{ return -ENODEV; }
+static inline u32 thermal_static_power(struct thermal_static_power *sp,
+		unsigned long voltage)
+{ return 0; }
 static inline int get_tz_trend(struct thermal_zone_device *tz, int trip)
 { return -ENODEV; }
 static inline struct thermal_instance *
@@ -66,6 +66,7 @@ struct fib6_node {
 	__u16			fn_flags;
 	int			fn_sernum;
 	struct rt6_info		*rr_ptr;
+	struct rcu_head		rcu;
 };
 
 #ifndef CONFIG_IPV6_SUBTREES
@@ -109,6 +110,9 @@ struct rt6_info {
 
 	atomic_t			rt6i_ref;
 
+	/* Per-CPU copies handed out by lookups of gateway routes */
+	struct rt6_info * __percpu	*rt6i_pcpu;
+
 	/* These are in a separate cache line. */
 	struct rt6key			rt6i_dst ____cacheline_aligned_in_smp;
 	u32				rt6i_flags;
@@ -195,6 +199,10 @@ static inline void rt6_set_from(struct rt6_info *rt, struct rt6_info *from)
 
 static inline u32 rt6_get_cookie(const struct rt6_info *rt)
 {
+	/* Per-CPU copies are validated against the route they copy */
+	if (rt->rt6i_flags & RTF_PCPU)
+		rt = (struct rt6_info *)rt->dst.from;
+
 	return rt->rt6i_node ? rt->rt6i_node->fn_sernum : 0;
 }
 
@@ -251,7 +259,7 @@ struct rt6_statistics {
 struct fib6_table {
 	struct hlist_node	tb6_hlist;
 	u32			tb6_id;
-	rwlock_t		tb6_lock;
+	rwlock_t		tb6_lock;	/* writers, walkers; lookups use RCU */
 	struct fib6_node	tb6_root;
 	struct inet_peer_base	tb6_peers;
 };
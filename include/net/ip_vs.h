@@ -1191,6 +1191,7 @@ const char *ip_vs_state_name(__u16 proto, int state);
 void ip_vs_tcp_conn_listen(struct net *net, struct ip_vs_conn *cp);
 int ip_vs_check_template(struct ip_vs_conn *ct);
 void ip_vs_random_dropentry(struct net *net);
+void ip_vs_conn_tab_show(struct net *net, struct seq_file *seq);
 int ip_vs_conn_init(void);
 void ip_vs_conn_cleanup(void);
 
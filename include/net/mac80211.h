@@ -1176,6 +1176,7 @@ enum ieee80211_vif_flags {
  * @debugfs_dir: debugfs dentry, can be used by drivers to create own per
  *	interface debug files. Note that it will be NULL for the virtual
  *	monitor interface (if that is requested.)
+ * @txq: the multicast data TX queue (if driver uses the TXQ abstraction)
  * @drv_priv: data area for driver use, will always be aligned to
  *	sizeof(void *).
  */
@@ -1197,6 +1198,8 @@ struct ieee80211_vif {
 	struct dentry *debugfs_dir;
 #endif
 
+	struct ieee80211_txq *txq;
+
 	/* must be last */
 	u8 drv_priv[0] __aligned(sizeof(void *));
 };
@@ -1426,6 +1429,7 @@ struct ieee80211_sta_rates {
  * @smps_mode: current SMPS mode (off, static or dynamic)
  * @rates: rate control selection table
  * @tdls: indicates whether the STA is a TDLS peer
+ * @txq: per-TID data TX queues (if driver uses the TXQ abstraction)
  */
 struct ieee80211_sta {
 	u32 supp_rates[IEEE80211_NUM_BANDS];
@@ -1443,6 +1447,8 @@ struct ieee80211_sta {
 	struct ieee80211_sta_rates __rcu *rates;
 	bool tdls;
 
+	struct ieee80211_txq *txq[IEEE80211_NUM_TIDS];
+
 	/* must be last */
 	u8 drv_priv[0] __aligned(sizeof(void *));
 };
@@ -1470,6 +1476,28 @@ struct ieee80211_tx_control {
 	struct ieee80211_sta *sta;
 };
 
+/**
+ * struct ieee80211_txq - Software intermediate tx queue
+ *
+ * @vif: &struct ieee80211_vif pointer from the add_interface callback.
+ * @sta: station table entry, %NULL for per-vif queue
+ * @tid: the TID for this queue (unused for per-vif queue)
+ * @ac: the AC for this queue
+ * @drv_priv: driver private area, sized by hw->txq_data_size
+ *
+ * The driver can obtain packets from this queue by calling
+ * ieee80211_tx_dequeue().
+ */
+struct ieee80211_txq {
+	struct ieee80211_vif *vif;
+	struct ieee80211_sta *sta;
+	u8 tid;
+	u8 ac;
+
+	/* must be last */
+	u8 drv_priv[0] __aligned(sizeof(void *));
+};
+
 /**
  * enum ieee80211_hw_flags - hardware flags
  *
@@ -1584,6 +1612,11 @@ struct ieee80211_tx_control {
  *	be created.  It is expected user-space will create vifs as
  *	desired (and thus have them named as desired).
  *
+ * @IEEE80211_HW_AIRTIME_FAIRNESS: The driver reports the airtime used by
+ *	each station with ieee80211_sta_register_airtime(), so the station
+ *	TX queues can be scheduled by airtime deficit round robin. Without
+ *	it, ieee80211_next_txq() serves the active queues round robin.
+ *
  * @IEEE80211_HW_QUEUE_CONTROL: The driver wants to control per-interface
  *	queue mapping in order to use different queues (not just one per AC)
  *	for different virtual interfaces. See the doc section on HW queue
@@ -1637,7 +1670,7 @@ enum ieee80211_hw_flags {
 	IEEE80211_HW_MFP_CAPABLE			= 1<<13,
 	IEEE80211_HW_WANT_MONITOR_VIF			= 1<<14,
 	IEEE80211_HW_NO_AUTO_VIF			= 1<<15,
-	/* free slot */
+	IEEE80211_HW_AIRTIME_FAIRNESS			= 1<<16,
 	IEEE80211_HW_SUPPORTS_UAPSD			= 1<<17,
 	IEEE80211_HW_REPORTS_TX_ACK_STATUS		= 1<<18,
 	IEEE80211_HW_CONNECTION_MONITOR			= 1<<19,
@@ -1748,6 +1781,13 @@ enum ieee80211_hw_flags {
  * @n_cipher_schemes: a size of an array of cipher schemes definitions.
  * @cipher_schemes: a pointer to an array of cipher scheme definitions
  *	supported by HW.
+ *
+ * @txq_data_size: size of the driver private data area in each
+ *	&struct ieee80211_txq, only used if the driver implements the
+ *	wake_tx_queue callback.
+ *
+ * @txq_ac_max_pending: maximum number of frames per AC pending in all txq
+ *	entries for a vif before the corresponding netdev queue is stopped.
  */
 struct ieee80211_hw {
 	struct ieee80211_conf conf;
@@ -1776,6 +1816,8 @@ struct ieee80211_hw {
 	u8 uapsd_max_sp_len;
 	u8 n_cipher_schemes;
 	const struct ieee80211_cipher_scheme *cipher_schemes;
+	int txq_data_size;
+	u16 txq_ac_max_pending;
 };
 
 /**
@@ -2253,6 +2295,44 @@ void ieee80211_free_txskb(struct ieee80211_hw *hw, struct sk_buff *skb);
  * a queue is stopped/woken even if the interface is not in AP mode.
  */
 
+/**
+ * DOC: Intermediate software TX queues
+ *
+ * Drivers that implement the wake_tx_queue callback get data frames from
+ * mac80211 through intermediate software queues instead of the tx callback.
+ * There is one &struct ieee80211_txq per station and TID, plus one per
+ * virtual interface for frames without a station (e.g. multicast). Frames
+ * are put on these queues after all TX handlers have run, i.e. they are
+ * ready to be handed to the hardware as they are dequeued; management
+ * frames and frames that must bypass powersave buffering still go through
+ * the tx callback.
+ *
+ * Whenever frames are added to an idle queue, mac80211 puts the queue on a
+ * per-AC list of active queues and calls wake_tx_queue. The driver then
+ * pulls frames when it has room in its hardware queues, in batches as large
+ * as it wants to build (e.g. a full A-MPDU), as follows:
+ *
+ *	ieee80211_txq_schedule_start(hw, ac);
+ *	while ((txq = ieee80211_next_txq(hw, ac))) {
+ *		while (room && (skb = ieee80211_tx_dequeue(hw, txq)))
+ *			... hand skb to the hardware ...
+ *		ieee80211_return_txq(hw, txq);
+ *	}
+ *	ieee80211_txq_schedule_end(hw, ac);
+ *
+ * ieee80211_next_txq() hands out the station queues of an AC in deficit
+ * round robin order by airtime if the driver sets
+ * %IEEE80211_HW_AIRTIME_FAIRNESS and reports the airtime each station used
+ * with ieee80211_sta_register_airtime(), and plain round robin otherwise. Every
+ * queue is returned at most once between ieee80211_txq_schedule_start() and
+ * ieee80211_txq_schedule_end(); ieee80211_return_txq() puts it back on the
+ * active list if it still holds frames.
+ *
+ * To keep the amount of queued data bounded, the netdev queue of an AC is
+ * stopped when the txqs of a vif hold more than hw.txq_ac_max_pending
+ * frames for that AC, and woken again as the driver dequeues them.
+ */
+
 /**
  * enum ieee80211_filter_flags - hardware filter flags
  *
@@ -2856,6 +2936,11 @@ enum ieee80211_roc_type {
  * @get_expected_throughput: extract the expected throughput towards the
  *	specified station. The returned value is expressed in Kbps. It returns 0
  *	if the RC algorithm does not have proper data to provide.
+ *
+ * @wake_tx_queue: Called when new packets have been added to the queue.
+ *	If implemented, data frames are no longer passed to the tx callback
+ *	but have to be pulled with ieee80211_tx_dequeue(), see the section
+ *	"Intermediate software TX queues". Must be atomic.
  */
 struct ieee80211_ops {
 	void (*tx)(struct ieee80211_hw *hw,
@@ -3057,6 +3142,9 @@ struct ieee80211_ops {
 	int (*join_ibss)(struct ieee80211_hw *hw, struct ieee80211_vif *vif);
 	void (*leave_ibss)(struct ieee80211_hw *hw, struct ieee80211_vif *vif);
 	u32 (*get_expected_throughput)(struct ieee80211_sta *sta);
+
+	void (*wake_tx_queue)(struct ieee80211_hw *hw,
+			      struct ieee80211_txq *txq);
 };
 
 /**
@@ -4930,4 +5018,78 @@ void ieee80211_update_p2p_noa(struct ieee80211_noa_data *data, u32 tsf);
 void ieee80211_tdls_oper_request(struct ieee80211_vif *vif, const u8 *peer,
 				 enum nl80211_tdls_operation oper,
 				 u16 reason_code, gfp_t gfp);
+
+/**
+ * ieee80211_tx_dequeue - dequeue a packet from a software tx queue
+ *
+ * @hw: pointer as obtained from ieee80211_alloc_hw()
+ * @txq: pointer obtained from station or virtual interface, or from
+ *	ieee80211_next_txq()
+ *
+ * Returns the skb if successful, %NULL if no frame was available.
+ */
+struct sk_buff *ieee80211_tx_dequeue(struct ieee80211_hw *hw,
+				     struct ieee80211_txq *txq);
+
+/**
+ * ieee80211_next_txq - get next tx queue to pull packets from
+ *
+ * @hw: pointer as obtained from ieee80211_alloc_hw()
+ * @ac: AC number to return packets from.
+ *
+ * Returns the next txq of the AC that has frames queued and has not been
+ * returned yet in the current scheduling round, skipping (and recharging)
+ * stations that have used up their airtime deficit. Returns %NULL when
+ * there are no more eligible queues. Must be called between
+ * ieee80211_txq_schedule_start() and ieee80211_txq_schedule_end().
+ */
+struct ieee80211_txq *ieee80211_next_txq(struct ieee80211_hw *hw, u8 ac);
+
+/**
+ * ieee80211_return_txq - return a txq previously acquired by
+ *	ieee80211_next_txq()
+ *
+ * @hw: pointer as obtained from ieee80211_alloc_hw()
+ * @txq: pointer obtained from ieee80211_next_txq()
+ *
+ * The txq is put back on the list of active queues if it still has frames
+ * queued. Must be called between ieee80211_txq_schedule_start() and
+ * ieee80211_txq_schedule_end().
+ */
+void ieee80211_return_txq(struct ieee80211_hw *hw, struct ieee80211_txq *txq);
+
+/**
+ * ieee80211_txq_schedule_start - start a new scheduling round for an AC
+ *
+ * @hw: pointer as obtained from ieee80211_alloc_hw()
+ * @ac: AC number to schedule
+ *
+ * Takes the per-AC scheduling lock; the driver must not sleep until the
+ * matching ieee80211_txq_schedule_end().
+ */
+void ieee80211_txq_schedule_start(struct ieee80211_hw *hw, u8 ac);
+
+/**
+ * ieee80211_txq_schedule_end - end a scheduling round for an AC
+ *
+ * @hw: pointer as obtained from ieee80211_alloc_hw()
+ * @ac: AC number the round was started for
+ */
+void ieee80211_txq_schedule_end(struct ieee80211_hw *hw, u8 ac);
+
+/**
+ * ieee80211_sta_register_airtime - register airtime usage for a sta/tid
+ *
+ * @pubsta: the station
+ * @tid: the TID to register airtime for
+ * @tx_airtime: airtime used during TX (in usec)
+ * @rx_airtime: airtime used during RX (in usec)
+ *
+ * Register airtime usage for a given sta on a given tid. The airtime is
+ * charged against the station's deficit for the TID's AC, which drives the
+ * order ieee80211_next_txq() hands out queues in. Drivers should report
+ * the airtime of every transmission attempt, including retries.
+ */
+void ieee80211_sta_register_airtime(struct ieee80211_sta *pubsta, u8 tid,
+				    u32 tx_airtime, u32 rx_airtime);
 #endif /* MAC80211_H */
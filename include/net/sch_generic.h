@@ -62,6 +62,9 @@ struct Qdisc {
 #define TCQ_F_WARN_NONWC	(1 << 16)
 #define TCQ_F_CPUSTATS		0x20 /* run using percpu statistics */
 	u32			limit;
+	u32			bulk_limit; /* bytes dequeued at once when the
+					     * device does not use BQL
+					     */
 	const struct Qdisc_ops	*ops;
 	struct qdisc_size_table	__rcu *stab;
 	struct list_head	list;
@@ -122,14 +125,17 @@ static inline bool qdisc_may_bulk(const struct Qdisc *qdisc)
 	return qdisc->flags & TCQ_F_ONETXQUEUE;
 }
 
-static inline int qdisc_avail_bulklimit(const struct netdev_queue *txq)
+static inline int qdisc_avail_bulklimit(const struct Qdisc *qdisc,
+					const struct netdev_queue *txq)
 {
 #ifdef CONFIG_BQL
-	/* Non-BQL migrated drivers will return 0, too. */
-	return dql_avail(&txq->dql);
-#else
-	return 0;
+	int avail = dql_avail(&txq->dql);
+
+	/* Non-BQL migrated drivers never queue anything and return 0 */
+	if (avail || txq->dql.num_queued)
+		return avail;
 #endif
+	return qdisc->bulk_limit;
 }
 
 static inline bool qdisc_is_throttled(const struct Qdisc *qdisc)
@@ -289,6 +289,7 @@ struct cg_proto;
   *	@sk_send_head: front of stuff to transmit
   *	@sk_security: used by security modules
   *	@sk_mark: generic packet mark
+  *	@sk_cookie: unique socket identifier, see sock_gen_cookie()
   *	@sk_classid: this socket's cgroup classid
   *	@sk_cgrp: this socket's cgroup-specific proto data
   *	@sk_write_pending: a write to stream socket waits to start
@@ -428,6 +429,7 @@ struct sock {
 #endif
 	__u32			sk_mark;
 	kuid_t			sk_uid;
+	atomic64_t		sk_cookie;
 	u32			sk_classid;
 	struct cg_proto		*sk_cgrp;
 	void			(*sk_state_change)(struct sock *sk);
@@ -19,6 +19,13 @@ struct lpm_stats;
 
 #define MAX_STR_LEN 256
 
+/* How the time spent in a level compared to its residency range */
+enum lpm_stats_residency {
+	LPM_STATS_RES_HIT,
+	LPM_STATS_RES_TOO_SHORT,
+	LPM_STATS_RES_TOO_LONG,
+};
+
 struct lifo_stats {
 	uint32_t last_in;
 	uint32_t first_out;
@@ -51,6 +58,9 @@ void lpm_stats_cpu_enter(uint32_t index, uint64_t time);
 void lpm_stats_cpu_exit(uint32_t index, uint64_t time, bool success);
 void lpm_stats_suspend_enter(void);
 void lpm_stats_suspend_exit(void);
+void lpm_stats_cpu_residency(uint32_t index, enum lpm_stats_residency res);
+void lpm_stats_cluster_residency(struct lpm_stats *stats, uint32_t index,
+				enum lpm_stats_residency res);
 #else
 static inline struct lpm_stats *lpm_stats_config_level(const char *name,
 	const char **levels, int num_levels, struct lpm_stats *parent,
@@ -91,5 +101,17 @@ static inline void lpm_stats_suspend_exit(void)
 {
 	return;
 }
+
+static inline void lpm_stats_cpu_residency(uint32_t index,
+					enum lpm_stats_residency res)
+{
+	return;
+}
+
+static inline void lpm_stats_cluster_residency(struct lpm_stats *stats,
+				uint32_t index, enum lpm_stats_residency res)
+{
+	return;
+}
 #endif
 #endif  /* __ARCH_ARM_MACH_MSM_LPM_STATS_H */
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2014-2016, 2019 The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __MSM_PERFORMANCE_H
+#define __MSM_PERFORMANCE_H
+
+#include <linux/errno.h>
+#include <linux/notifier.h>
+
+/* Workload mode bits, as reported in workload_modes/aggr_mode */
+#define MSM_PERF_MODE_SINGLE		1
+#define MSM_PERF_MODE_MULTI		2
+#define MSM_PERF_MODE_PERF_CL_PEAK	4
+
+/**
+ * struct msm_perf_mode_change - aggregate workload mode of all clusters
+ * @mode:	MSM_PERF_MODE_* bits set on any cluster
+ * @iobusy:	any cluster is IO bound
+ *
+ * Passed as data to the mode notifier chain, with @mode as the action.
+ * Notifiers are called from process context, once per change.
+ */
+struct msm_perf_mode_change {
+	unsigned int mode;
+	unsigned int iobusy;
+};
+
+#ifdef CONFIG_MSM_PERFORMANCE
+int msm_perf_register_mode_notifier(struct notifier_block *nb);
+int msm_perf_unregister_mode_notifier(struct notifier_block *nb);
+#else
+static inline int msm_perf_register_mode_notifier(struct notifier_block *nb)
+{
+	return -ENODEV;
+}
+
+static inline int msm_perf_unregister_mode_notifier(struct notifier_block *nb)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif
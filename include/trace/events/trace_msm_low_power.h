@@ -20,15 +20,17 @@
 
 TRACE_EVENT(cpu_power_select,
 
-	TP_PROTO(int index, u32 sleep_us, u32 latency, u32 next_event_us),
+	TP_PROTO(int index, u32 sleep_us, u32 latency, u32 next_event_us,
+		u32 pred_us),
 
-	TP_ARGS(index, sleep_us, latency, next_event_us),
+	TP_ARGS(index, sleep_us, latency, next_event_us, pred_us),
 
 	TP_STRUCT__entry(
 		__field(int, index)
 		__field(u32, sleep_us)
 		__field(u32, latency)
 		__field(u32, next_event_us)
+		__field(u32, pred_us)
 	),
 
 	TP_fast_assign(
@@ -36,11 +38,12 @@ TRACE_EVENT(cpu_power_select,
 		__entry->sleep_us = sleep_us;
 		__entry->latency = latency;
 		__entry->next_event_us = next_event_us;
+		__entry->pred_us = pred_us;
 	),
 
-	TP_printk("idx:%d sleep_time:%u latency:%u next_event:%u",
+	TP_printk("idx:%d sleep_time:%u latency:%u next_event:%u pred:%u",
 		__entry->index, __entry->sleep_us, __entry->latency,
-		__entry->next_event_us)
+		__entry->next_event_us, __entry->pred_us)
 );
 
 TRACE_EVENT(cpu_idle_enter,
@@ -109,14 +109,29 @@ enum bpf_cmd {
 	BPF_PROG_LOAD,
 };
 
+/* Map, program and helper numbers follow mainline, so that programs and
+ * loaders built against mainline headers work unchanged. The holes are
+ * types and helpers this kernel does not provide.
+ */
 enum bpf_map_type {
 	BPF_MAP_TYPE_UNSPEC,
+	BPF_MAP_TYPE_HASH,
+	BPF_MAP_TYPE_ARRAY,
+	BPF_MAP_TYPE_PROG_ARRAY,
+	BPF_MAP_TYPE_PERCPU_HASH = 5,
+	BPF_MAP_TYPE_PERCPU_ARRAY,
 };
 
 enum bpf_prog_type {
 	BPF_PROG_TYPE_UNSPEC,
+	BPF_PROG_TYPE_SCHED_CLS = 3,
 };
 
+/* flags for BPF_MAP_UPDATE_ELEM command */
+#define BPF_ANY		0 /* create new element or update existing */
+#define BPF_NOEXIST	1 /* create new element if it didn't exist */
+#define BPF_EXIST	2 /* update existing element */
+
 union bpf_attr {
 	struct { /* anonymous struct used by BPF_MAP_CREATE command */
 		__u32	map_type;	/* one of enum bpf_map_type */
@@ -132,6 +147,7 @@ union bpf_attr {
 			__aligned_u64 value;
 			__aligned_u64 next_key;
 		};
+		__u64		flags;
 	};
 
 	struct { /* anonymous struct used by BPF_PROG_LOAD command */
@@ -150,7 +166,58 @@ union bpf_attr {
  */
 enum bpf_func_id {
 	BPF_FUNC_unspec,
+
+	/* void *map_lookup_elem(&map, &key)
+	 * Return: Map value or NULL
+	 */
+	BPF_FUNC_map_lookup_elem,
+
+	/* int map_update_elem(&map, &key, &value, flags)
+	 * Return: 0 on success or negative error
+	 */
+	BPF_FUNC_map_update_elem,
+
+	/* int map_delete_elem(&map, &key)
+	 * Return: 0 on success or negative error
+	 */
+	BPF_FUNC_map_delete_elem,
+
+	/* void bpf_tail_call(ctx, prog_array_map, index)
+	 * Jump into another eBPF program of the same type, found at 'index'
+	 * of the program array map. The stack frame of the caller is reused
+	 * and the call never returns on success. Falls through to the next
+	 * instruction when the slot is empty, the index is out of range or
+	 * more than 32 tail calls were made in a row.
+	 */
+	BPF_FUNC_tail_call = 12,
+
+	/* u64 bpf_get_socket_cookie(skb)
+	 * Get the cookie of the socket owning the packet, allocating it on
+	 * first use. Return: 8 bytes non-decreasing number, 0 without socket
+	 */
+	BPF_FUNC_get_socket_cookie = 46,
+
+	/* u32 bpf_get_socket_uid(skb)
+	 * Return: owner UID of the packet socket, overflowuid without a
+	 * full socket
+	 */
+	BPF_FUNC_get_socket_uid,
 	__BPF_FUNC_MAX_ID,
 };
 
+/* user accessible mirror of in-kernel sk_buff.
+ * new fields can only be added to the end of this structure
+ */
+struct __sk_buff {
+	__u32 len;
+	__u32 pkt_type;
+	__u32 mark;
+	__u32 queue_mapping;
+	__u32 protocol;
+	__u32 vlan_present;
+	__u32 vlan_tci;
+	__u32 vlan_proto;
+	__u32 priority;
+};
+
 #endif /* _UAPI__LINUX_BPF_H__ */
@@ -0,0 +1,23 @@
+#ifndef _UAPI_LINUX_CPU_BOOST_H
+#define _UAPI_LINUX_CPU_BOOST_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * Boost profiles of the cpu-boost driver. Each has its own per-CPU
+ * frequency curve, set through the driver's module parameters.
+ */
+enum {
+	CPU_BOOST_TAP		= 0,	/* touch down, key press */
+	CPU_BOOST_FLING		= 1,	/* touch up after a swipe */
+	CPU_BOOST_LAUNCH	= 2,	/* app launch, hint only */
+	CPU_BOOST_NR_PROFILES,
+};
+
+#define CPU_BOOST_IOC_MAGIC	0xCB
+
+/* start (or restart) the curve of the given profile, on /dev/cpu_boost */
+#define CPU_BOOST_IOC_HINT	_IOW(CPU_BOOST_IOC_MAGIC, 1, __u32)
+
+#endif /* _UAPI_LINUX_CPU_BOOST_H */
@@ -708,6 +708,11 @@ enum {
 	TCA_FQ_CODEL_ECN,
 	TCA_FQ_CODEL_FLOWS,
 	TCA_FQ_CODEL_QUANTUM,
+	TCA_FQ_CODEL_CE_THRESHOLD,
+	TCA_FQ_CODEL_DROP_BATCH_SIZE,
+	TCA_FQ_CODEL_MEMORY_LIMIT,
+	/* 10 and 11: reserved, CE_THRESHOLD_SELECTOR and _MASK upstream */
+	TCA_FQ_CODEL_BULK_LIMIT = 12,
 	__TCA_FQ_CODEL_MAX
 };
 
@@ -731,6 +736,11 @@ struct tc_fq_codel_qd_stats {
 				 */
 	__u32	new_flows_len;	/* count of flows in new list */
 	__u32	old_flows_len;	/* count of flows in old list */
+	__u32	ce_mark;	/* packets above ce_threshold */
+	__u32	memory_usage;	/* in bytes */
+	__u32	drop_overmemory;
+	__u32	drop_batches;	/* number of times a fat flow was pruned */
+	__u32	drop_cost;	/* average time spent per prune, in ns */
 };
 
 struct tc_fq_codel_cl_stats {
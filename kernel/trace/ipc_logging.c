@@ -27,7 +27,11 @@
 #include <linux/wait.h>
 #include <linux/delay.h>
 #include <linux/completion.h>
+#include <linux/ctype.h>
 #include <linux/ipc_logging.h>
+#include <linux/log2.h>
+#include <linux/percpu.h>
+#include <asm/sections.h>
 
 #include "ipc_logging_private.h"
 
@@ -487,6 +491,247 @@ int tsv_byte_array_write(struct encode_context *ectxt,
 }
 EXPORT_SYMBOL(tsv_byte_array_write);
 
+static void cpu_buf_copy_in(struct ipc_log_cpu_buf *buf, unsigned long pos,
+			    const void *src, int len)
+{
+	unsigned long off = pos & (buf->size - 1);
+	int first = MIN(len, buf->size - off);
+
+	memcpy(buf->data + off, src, first);
+	memcpy(buf->data, src + first, len - first);
+}
+
+static void cpu_buf_copy_out(struct ipc_log_cpu_buf *buf, unsigned long pos,
+			     void *dst, int len)
+{
+	unsigned long off = pos & (buf->size - 1);
+	int first = MIN(len, buf->size - off);
+
+	memcpy(dst, buf->data + off, first);
+	memcpy(dst + first, buf->data, len - first);
+}
+
+/*
+ * Returns true if @fmt can be formatted after the call returns: it must
+ * stay mapped and must not use %p extensions, which dereference their
+ * argument.
+ */
+static bool deferred_fmt_ok(const char *fmt)
+{
+	if (fmt < __start_rodata || fmt >= __end_rodata)
+		return false;
+
+	while ((fmt = strchr(fmt, '%'))) {
+		if (*++fmt == '%') {
+			fmt++;
+			continue;
+		}
+		/* skip flags, field width, precision and length modifier */
+		while (*fmt && strchr("-+ #0123456789.*hlLqjzt", *fmt))
+			fmt++;
+		if (*fmt == 'p' && isalnum(fmt[1]))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Packs the arguments of an ipc_log_string() call into this cpu's ring
+ * without formatting them.  The oldest records are dropped when the ring
+ * is full.
+ *
+ * @returns 0 if logged; <0 if the caller has to format the string itself
+ */
+static int ipc_log_string_deferred(struct ipc_log_context *ilctxt,
+				   const char *fmt, va_list args)
+{
+	struct ipc_log_deferred rec;
+	struct ipc_log_cpu_buf __percpu *cpu_bufs;
+	struct ipc_log_cpu_buf *buf;
+	unsigned long flags, head, tail;
+	uint32_t size;
+	int words;
+
+	if (!READ_ONCE(ilctxt->cpu_bufs) || !deferred_fmt_ok(fmt))
+		return -EINVAL;
+
+	words = vbin_printf(rec.args, IPC_LOG_DEFERRED_ARGS, fmt, args);
+	if (words > IPC_LOG_DEFERRED_ARGS)
+		return -ENOSPC;
+
+	rec.size = ALIGN(IPC_LOG_DEFERRED_HDR_SIZE + words * sizeof(u32), 8);
+	rec.reserved = 0;
+	rec.fmt = fmt;
+
+	/* interrupts stay off while the ring is used, see cpu_bufs_destroy */
+	local_irq_save(flags);
+	cpu_bufs = READ_ONCE(ilctxt->cpu_bufs);
+	if (!cpu_bufs) {
+		local_irq_restore(flags);
+		return -EINVAL;
+	}
+	buf = this_cpu_ptr(cpu_bufs);
+	rec.time = sched_clock();
+	rec.qtime = arch_counter_get_cntpct();
+
+	head = buf->head;
+	tail = buf->tail;
+	while (head + rec.size - tail > buf->size) {
+		cpu_buf_copy_out(buf, tail, &size, sizeof(size));
+		tail += size;
+	}
+	if (tail != buf->tail) {
+		/* readers must see the drop before the data is overwritten */
+		WRITE_ONCE(buf->tail, tail);
+		smp_wmb();
+	}
+	cpu_buf_copy_in(buf, head, &rec, rec.size);
+	smp_wmb();
+	WRITE_ONCE(buf->head, head + rec.size);
+
+	/*
+	 * Wake readers from irq_work, which completes read_avail under
+	 * context_lock_lhb1.  Pairs with the xchg() in ipc_log_deferred_wake().
+	 */
+	smp_mb();
+	if (!READ_ONCE(ilctxt->deferred_wake_pending) &&
+	    !xchg(&ilctxt->deferred_wake_pending, 1))
+		irq_work_queue(&ilctxt->deferred_wake);
+	local_irq_restore(flags);
+	return 0;
+}
+
+static void ipc_log_deferred_wake(struct irq_work *work)
+{
+	struct ipc_log_context *ilctxt = container_of(work,
+					struct ipc_log_context, deferred_wake);
+
+	xchg(&ilctxt->deferred_wake_pending, 0);
+	spin_lock(&ilctxt->context_lock_lhb1);
+	complete(&ilctxt->read_avail);
+	spin_unlock(&ilctxt->context_lock_lhb1);
+}
+
+/*
+ * Copies the next unread record of @buf to @rec without consuming it.
+ * Records dropped by the writer are skipped.  Caller must hold
+ * context_lock_lhb1.
+ *
+ * @returns size of the record; 0 if @buf has nothing to read
+ */
+static int cpu_buf_peek(struct ipc_log_cpu_buf *buf,
+			struct ipc_log_deferred *rec)
+{
+	unsigned long head, pos;
+
+	for (;;) {
+		head = READ_ONCE(buf->head);
+		smp_rmb();
+		pos = READ_ONCE(buf->tail);
+		if ((long)(buf->nd_read - pos) > 0)
+			pos = buf->nd_read;
+		buf->nd_read = pos;
+		if (pos == head)
+			return 0;
+
+		cpu_buf_copy_out(buf, pos, rec, IPC_LOG_DEFERRED_HDR_SIZE);
+		if (rec->size >= IPC_LOG_DEFERRED_HDR_SIZE &&
+		    rec->size <= sizeof(*rec))
+			cpu_buf_copy_out(buf, pos + IPC_LOG_DEFERRED_HDR_SIZE,
+					 rec->args,
+					 rec->size - IPC_LOG_DEFERRED_HDR_SIZE);
+
+		/* valid unless the writer dropped it while it was copied */
+		smp_rmb();
+		if ((long)(pos - READ_ONCE(buf->tail)) >= 0)
+			return rec->size;
+	}
+}
+
+/*
+ * Finds the oldest unread deferred record over all cpus and copies it
+ * to @rec.  Caller must hold context_lock_lhb1.
+ *
+ * @returns ring holding the record; NULL if there is none
+ */
+static struct ipc_log_cpu_buf *deferred_peek(struct ipc_log_context *ilctxt,
+					     struct ipc_log_deferred *rec)
+{
+	struct ipc_log_cpu_buf *buf, *oldest = NULL;
+	struct ipc_log_deferred next;
+	int cpu;
+
+	if (!ilctxt->cpu_bufs)
+		return NULL;
+
+	for_each_possible_cpu(cpu) {
+		buf = per_cpu_ptr(ilctxt->cpu_bufs, cpu);
+		if (!cpu_buf_peek(buf, &next))
+			continue;
+		if (!oldest || next.time < rec->time) {
+			memcpy(rec, &next, next.size);
+			oldest = buf;
+		}
+	}
+	return oldest;
+}
+
+/*
+ * Decodes a deferred record in the format of dfunc_string().
+ */
+static void deferred_decode(struct ipc_log_deferred *rec,
+			    struct decode_context *dctxt)
+{
+	uint64_t val = rec->time;
+	unsigned long nanosec_rem;
+	int len;
+
+	nanosec_rem = do_div(val, 1000000000U);
+	IPC_SPRINTF_DECODE(dctxt, "[%6u.%09lu/%#18llx] ",
+			(unsigned)val, nanosec_rem, rec->qtime);
+
+	len = bstr_printf(dctxt->buff, MIN(dctxt->size, MAX_MSG_SIZE),
+			  rec->fmt, rec->args);
+	len = MIN(len, MIN(dctxt->size, MAX_MSG_SIZE) - 1);
+	dctxt->buff += len;
+	dctxt->size -= len;
+
+	/* add trailing \n if necessary */
+	if (!len || *(dctxt->buff - 1) != '\n')
+		IPC_SPRINTF_DECODE(dctxt, "\n");
+}
+
+/*
+ * Returns the timestamp of the next unread page message, U64_MAX if
+ * there is none and 0 if it does not start with a timestamp.  Caller
+ * must hold context_lock_lhb1.
+ */
+static uint64_t msg_peek_time(struct ipc_log_context *ilctxt)
+{
+	struct ipc_log_page *pg = ilctxt->nd_read_page;
+	struct ipc_log_page *next_pg = get_next_page(ilctxt, pg);
+	uint16_t offset = pg->hdr.nd_read_offset;
+	uint16_t next_offset = next_pg->hdr.nd_read_offset;
+	struct encode_context ectxt;
+	struct tsv_header hdr;
+	uint64_t t = 0;
+
+	if (is_nd_read_empty(ilctxt))
+		return U64_MAX;
+
+	msg_read(ilctxt, &ectxt);
+	memcpy(&hdr, ectxt.buff + ectxt.offset, sizeof(hdr));
+	if (ectxt.hdr.size >= sizeof(hdr) + sizeof(t) &&
+	    hdr.type == TSV_TYPE_TIMESTAMP && hdr.size == sizeof(t))
+		memcpy(&t, ectxt.buff + ectxt.offset + sizeof(hdr), sizeof(t));
+
+	/* a message spans at most two pages */
+	ilctxt->nd_read_page = pg;
+	pg->hdr.nd_read_offset = offset;
+	next_pg->hdr.nd_read_offset = next_offset;
+	return t;
+}
+
 /*
  * Helper function to log a string
  *
@@ -498,10 +743,17 @@ int ipc_log_string(void *ilctxt, const char *fmt, ...)
 	struct encode_context ectxt;
 	int avail_size, data_size, hdr_size = sizeof(struct tsv_header);
 	va_list arg_list;
+	int ret;
 
 	if (!ilctxt)
 		return -EINVAL;
 
+	va_start(arg_list, fmt);
+	ret = ipc_log_string_deferred(ilctxt, fmt, arg_list);
+	va_end(arg_list);
+	if (!ret)
+		return 0;
+
 	msg_encode_start(&ectxt, TSV_TYPE_STRING);
 	tsv_timestamp_write(&ectxt);
 	tsv_qtimer_write(&ectxt);
@@ -528,12 +780,16 @@ EXPORT_SYMBOL(ipc_log_string);
  *
  * If no data is available to be read, then the ilctxt::read_avail
  * completion is reinitialized.  This allows clients to block
- * until new log data is save.
+ * until new log data is save.  Deferred strings are written without
+ * context_lock_lhb1, so the rings are checked again after the completion
+ * is re-armed.
  */
 int ipc_log_extract(void *ctxt, char *buff, int size)
 {
 	struct encode_context ectxt;
 	struct decode_context dctxt;
+	struct ipc_log_deferred rec;
+	struct ipc_log_cpu_buf *buf;
 	void (*deserialize_func)(struct encode_context *ectxt,
 				 struct decode_context *dctxt);
 	struct ipc_log_context *ilctxt = (struct ipc_log_context *)ctxt;
@@ -547,8 +803,21 @@ int ipc_log_extract(void *ctxt, char *buff, int size)
 	dctxt.size = size;
 	read_lock_irqsave(&context_list_lock_lha1, flags);
 	spin_lock(&ilctxt->context_lock_lhb1);
-	while (dctxt.size >= MAX_MSG_DECODED_SIZE &&
-	       !is_nd_read_empty(ilctxt)) {
+	while (dctxt.size >= MAX_MSG_DECODED_SIZE) {
+		/* merge deferred strings and page messages by timestamp */
+		buf = deferred_peek(ilctxt, &rec);
+		if (buf && rec.time <= msg_peek_time(ilctxt)) {
+			buf->nd_read += rec.size;
+			spin_unlock(&ilctxt->context_lock_lhb1);
+			read_unlock_irqrestore(&context_list_lock_lha1, flags);
+			deferred_decode(&rec, &dctxt);
+			read_lock_irqsave(&context_list_lock_lha1, flags);
+			spin_lock(&ilctxt->context_lock_lhb1);
+			continue;
+		}
+		if (is_nd_read_empty(ilctxt))
+			break;
+
 		msg_read(ilctxt, &ectxt);
 		deserialize_func = get_deserialization_func(ilctxt,
 							ectxt.hdr.type);
@@ -562,8 +831,11 @@ int ipc_log_extract(void *ctxt, char *buff, int size)
 		read_lock_irqsave(&context_list_lock_lha1, flags);
 		spin_lock(&ilctxt->context_lock_lhb1);
 	}
-	if ((size - dctxt.size) == 0)
+	if ((size - dctxt.size) == 0) {
 		reinit_completion(&ilctxt->read_avail);
+		if (deferred_peek(ilctxt, &rec))
+			complete(&ilctxt->read_avail);
+	}
 	spin_unlock(&ilctxt->context_lock_lhb1);
 	read_unlock_irqrestore(&context_list_lock_lha1, flags);
 	return size - dctxt.size;
@@ -752,6 +1024,65 @@ static void *get_deserialization_func(struct ipc_log_context *ilctxt,
 	return NULL;
 }
 
+static void ipc_log_cpu_bufs_destroy(struct ipc_log_context *ilctxt)
+{
+	struct ipc_log_cpu_buf __percpu *cpu_bufs = ilctxt->cpu_bufs;
+	struct ipc_log_cpu_buf *buf;
+	int cpu;
+
+	if (!cpu_bufs)
+		return;
+
+	/*
+	 * Deferred writers use cpu_bufs with interrupts off, so once it is
+	 * cleared a sched grace period waits for all of them.
+	 */
+	WRITE_ONCE(ilctxt->cpu_bufs, NULL);
+	synchronize_sched();
+	irq_work_sync(&ilctxt->deferred_wake);
+
+	for_each_possible_cpu(cpu) {
+		buf = per_cpu_ptr(cpu_bufs, cpu);
+		if (buf->data)
+			free_pages((unsigned long)buf->data,
+				   get_order(buf->size));
+	}
+	free_percpu(cpu_bufs);
+}
+
+/*
+ * Allocates the per-cpu rings for deferred strings.  Records are much
+ * smaller than formatted strings, so the log pages are split over the
+ * cpus.  On failure strings are formatted when logged.
+ */
+static void ipc_log_cpu_bufs_create(struct ipc_log_context *ilctxt,
+				    int max_num_pages)
+{
+	struct ipc_log_cpu_buf *buf;
+	unsigned long size;
+	int cpu;
+
+	size = roundup_pow_of_two(DIV_ROUND_UP(max_num_pages,
+					       num_possible_cpus())) * PAGE_SIZE;
+
+	ilctxt->cpu_bufs = alloc_percpu(struct ipc_log_cpu_buf);
+	if (!ilctxt->cpu_bufs)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		buf = per_cpu_ptr(ilctxt->cpu_bufs, cpu);
+		buf->data = (char *)__get_free_pages(GFP_KERNEL | __GFP_ZERO,
+						     get_order(size));
+		if (!buf->data) {
+			pr_err("%s: cannot create deferred log buffers\n",
+			       __func__);
+			ipc_log_cpu_bufs_destroy(ilctxt);
+			return;
+		}
+		buf->size = size;
+	}
+}
+
 /**
  * ipc_log_context_create: Create a debug log context
  *                         Should not be called from atomic context
@@ -777,6 +1108,7 @@ void *ipc_log_context_create(int max_num_pages,
 	}
 
 	init_completion(&ctxt->read_avail);
+	init_irq_work(&ctxt->deferred_wake, ipc_log_deferred_wake);
 	INIT_LIST_HEAD(&ctxt->page_list);
 	INIT_LIST_HEAD(&ctxt->dfunc_info_list);
 	spin_lock_init(&ctxt->context_lock_lhb1);
@@ -811,6 +1143,8 @@ void *ipc_log_context_create(int max_num_pages,
 	ctxt->nd_read_page = ctxt->first_page;
 	ctxt->write_avail = max_num_pages * LOG_PAGE_DATA_SIZE;
 	ctxt->header_size = sizeof(struct ipc_log_page_header);
+	if (IS_ENABLED(CONFIG_IPC_LOGGING_DEFERRED))
+		ipc_log_cpu_bufs_create(ctxt, max_num_pages);
 	create_ctx_debugfs(ctxt, mod_name);
 
 	/* set magic last to signal context init is complete */
@@ -857,6 +1191,8 @@ int ipc_log_context_destroy(void *ctxt)
 	list_del(&ilctxt->list);
 	write_unlock_irqrestore(&context_list_lock_lha1, flags);
 
+	ipc_log_cpu_bufs_destroy(ilctxt);
+
 	debugfs_remove_recursive(ilctxt->dent);
 
 	kfree(ilctxt);
@@ -14,6 +14,7 @@
 #define _IPC_LOGGING_PRIVATE_H
 
 #include <linux/ipc_logging.h>
+#include <linux/irq_work.h>
 
 #define IPC_LOG_VERSION 0x0003
 #define IPC_LOG_MAX_CONTEXT_NAME_LEN 32
@@ -95,6 +96,9 @@ struct ipc_log_page {
  * @dfunc_info_list:  List of deserialization functions
  * @context_lock_lhb1:  Lock for entire structure
  * @read_avail:  Completed when new data is added to the log
+ * @cpu_bufs:  Per-cpu rings of deferred strings (IPC_LOGGING_DEFERRED)
+ * @deferred_wake:  Completes @read_avail for deferred strings
+ * @deferred_wake_pending:  Set while @deferred_wake is queued
  */
 struct ipc_log_context {
 	uint32_t magic;
@@ -119,8 +123,54 @@ struct ipc_log_context {
 	struct list_head dfunc_info_list;
 	spinlock_t context_lock_lhb1;
 	struct completion read_avail;
+	struct ipc_log_cpu_buf __percpu *cpu_bufs;
+	struct irq_work deferred_wake;
+	int deferred_wake_pending;
 };
 
+/**
+ * struct ipc_log_cpu_buf - Per-cpu ring of deferred string records
+ *
+ * @data:  Ring storage of @size bytes (power of two)
+ * @size:  Size of @data
+ * @head:  Write position, only advanced by the owning cpu
+ * @tail:  Oldest record, advanced by the owning cpu when the ring is full
+ * @nd_read:  Non-destructive read position, protected by context_lock_lhb1
+ *
+ * Positions are free running byte counts, masked with @size - 1 on access.
+ * Writers run with interrupts disabled on the owning cpu and take no lock;
+ * readers detect records overwritten while copying them through @tail.
+ */
+struct ipc_log_cpu_buf {
+	char *data;
+	unsigned long size;
+	unsigned long head;
+	unsigned long tail;
+	unsigned long nd_read;
+};
+
+#define IPC_LOG_DEFERRED_ARGS 64
+
+/**
+ * struct ipc_log_deferred - ipc_log_string() record formatted at read time
+ *
+ * @size:  Record size in bytes, including the header (multiple of 8)
+ * @time:  Scheduler clock when logged
+ * @qtime:  QTimer count when logged
+ * @fmt:  Format string (always in kernel rodata)
+ * @args:  Arguments packed by vbin_printf()
+ */
+struct ipc_log_deferred {
+	uint32_t size;
+	uint32_t reserved;
+	uint64_t time;
+	uint64_t qtime;
+	const char *fmt;
+	u32 args[IPC_LOG_DEFERRED_ARGS];
+};
+
+#define IPC_LOG_DEFERRED_HDR_SIZE offsetof(struct ipc_log_deferred, args)
+
 struct dfunc_info {
 	struct list_head list;
 	int type;
@@ -24,7 +24,10 @@
 #include <linux/list.h>
 #include <linux/cpu.h>
 #include <linux/fs.h>
+#include <linux/mm.h>
+#include <uapi/linux/trace_mmap.h>
 
+#include <asm/cacheflush.h>
 #include <asm/local.h>
 
 static void update_pages_handler(struct work_struct *work);
@@ -358,6 +361,7 @@ struct buffer_page {
 	unsigned	 read;		/* index for next read */
 	local_t		 entries;	/* entries on this page */
 	unsigned long	 real_end;	/* real end of data */
+	unsigned	 id;		/* ID for user-space mapping */
 	struct buffer_data_page *page;	/* Actual data page */
 };
 
@@ -497,6 +501,11 @@ struct ring_buffer_per_cpu {
 	struct completion		update_done;
 
 	struct rb_irq_work		irq_work;
+
+	/* user-space mapping, protected by buffer->mutex and reader_lock */
+	int				mapped;
+	unsigned long			*subbuf_ids;	/* ID to data page */
+	struct trace_buffer_meta	*meta_page;
 };
 
 struct ring_buffer {
@@ -4203,6 +4212,22 @@ unsigned long ring_buffer_size(struct ring_buffer *buffer, int cpu)
 }
 EXPORT_SYMBOL_GPL(ring_buffer_size);
 
+/* Caller must hold reader_lock */
+static void rb_update_meta_page(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+
+	meta->reader.read = cpu_buffer->reader_page->read;
+	meta->reader.id = cpu_buffer->reader_page->id;
+
+	meta->entries = local_read(&cpu_buffer->entries);
+	meta->overrun = local_read(&cpu_buffer->overrun);
+	meta->read = cpu_buffer->read;
+
+	/* Some archs do not have data cache coherency with user-space */
+	flush_dcache_page(virt_to_page(meta));
+}
+
 static void
 rb_reset_cpu(struct ring_buffer_per_cpu *cpu_buffer)
 {
@@ -4242,6 +4267,11 @@ rb_reset_cpu(struct ring_buffer_per_cpu *cpu_buffer)
 	cpu_buffer->lost_events = 0;
 	cpu_buffer->last_overrun = 0;
 
+	if (cpu_buffer->meta_page) {
+		cpu_buffer->meta_page->reader.lost_events = 0;
+		rb_update_meta_page(cpu_buffer);
+	}
+
 	rb_head_page_activate(cpu_buffer);
 }
 
@@ -4392,6 +4422,11 @@ int ring_buffer_swap_cpu(struct ring_buffer *buffer_a,
 	if (cpu_buffer_a->nr_pages != cpu_buffer_b->nr_pages)
 		goto out;
 
+	/* mapped pages must stay with the mapped buffer */
+	ret = -EBUSY;
+	if (cpu_buffer_a->mapped || cpu_buffer_b->mapped)
+		goto out;
+
 	ret = -EAGAIN;
 
 	if (ring_buffer_flags != RB_BUFFERS_ON)
@@ -4519,6 +4554,7 @@ EXPORT_SYMBOL_GPL(ring_buffer_free_read_page);
  *
  * Returns:
  *  >=0 if data has been transferred, returns the offset of consumed data.
+ *  -EBUSY if the buffer is mapped to user space.
  *  <0 if no data has been transferred.
  */
 int ring_buffer_read_page(struct ring_buffer *buffer,
@@ -4556,6 +4592,12 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 
 	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
 
+	/* A mapped buffer is consumed with ring_buffer_map_get_reader() */
+	if (cpu_buffer->mapped) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
 	reader = rb_get_reader_page(cpu_buffer);
 	if (!reader)
 		goto out_unlock;
@@ -4685,6 +4727,241 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 }
 EXPORT_SYMBOL_GPL(ring_buffer_read_page);
 
+static int rb_map_pages(struct ring_buffer_per_cpu *cpu_buffer,
+			struct vm_area_struct *vma)
+{
+	unsigned long nr_pages = vma_pages(vma);
+	unsigned long addr = vma->vm_start;
+	unsigned long i;
+	int ret;
+
+	/* The meta page is at offset 0, the sub-buffers follow it */
+	if (vma->vm_pgoff || !nr_pages || nr_pages > cpu_buffer->nr_pages + 2)
+		return -EINVAL;
+
+	/* Only the kernel writes the pages, never let them be shared */
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_DONTCOPY | VM_DONTEXPAND | VM_DONTDUMP;
+
+	for (i = 0; i < nr_pages; i++, addr += PAGE_SIZE) {
+		void *page = i ? (void *)cpu_buffer->subbuf_ids[i - 1] :
+				 (void *)cpu_buffer->meta_page;
+
+		ret = vm_insert_page(vma, addr, virt_to_page(page));
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * ring_buffer_map - map a per cpu buffer to user space
+ * @buffer: the buffer to map
+ * @cpu: the cpu buffer to map
+ * @vma: the user mapping, or NULL to take another reference on it
+ *
+ * The meta page goes at offset 0 of @vma, followed by the data pages
+ * in the order of their IDs. While a cpu buffer is mapped its pages are
+ * never swapped out of the ring: it cannot be resized, swapped with
+ * another buffer or read with ring_buffer_read_page(). It is consumed
+ * with ring_buffer_map_get_reader() instead.
+ *
+ * A NULL @vma is for a vma that is duplicated by a split and already
+ * maps the pages. Each successful call needs a ring_buffer_unmap().
+ */
+int ring_buffer_map(struct ring_buffer *buffer, int cpu,
+		    struct vm_area_struct *vma)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct trace_buffer_meta *meta;
+	struct buffer_page *bpage;
+	unsigned long *subbuf_ids;
+	unsigned long flags;
+	int id, ret = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&buffer->mutex);
+
+	if (cpu_buffer->mapped) {
+		if (vma)
+			ret = rb_map_pages(cpu_buffer, vma);
+		if (!ret)
+			cpu_buffer->mapped++;
+		goto out;
+	}
+
+	if (!vma) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	meta = (void *)get_zeroed_page(GFP_KERNEL);
+	subbuf_ids = kcalloc(cpu_buffer->nr_pages + 1, sizeof(*subbuf_ids),
+			     GFP_KERNEL);
+	if (!meta || !subbuf_ids) {
+		ret = -ENOMEM;
+		goto out_free;
+	}
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+
+	/* The reader page is ID 0, the ring follows from cpu_buffer->pages */
+	bpage = cpu_buffer->reader_page;
+	bpage->id = 0;
+	subbuf_ids[0] = (unsigned long)bpage->page;
+
+	bpage = list_entry(cpu_buffer->pages, struct buffer_page, list);
+	for (id = 1; id <= cpu_buffer->nr_pages; id++) {
+		bpage->id = id;
+		subbuf_ids[id] = (unsigned long)bpage->page;
+		rb_inc_page(cpu_buffer, &bpage);
+	}
+
+	meta->meta_page_size = PAGE_SIZE;
+	meta->meta_struct_len = sizeof(*meta);
+	meta->subbuf_size = PAGE_SIZE;
+	meta->nr_subbufs = cpu_buffer->nr_pages + 1;
+
+	cpu_buffer->meta_page = meta;
+	cpu_buffer->subbuf_ids = subbuf_ids;
+	rb_update_meta_page(cpu_buffer);
+
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	ret = rb_map_pages(cpu_buffer, vma);
+	if (ret) {
+		raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+		cpu_buffer->meta_page = NULL;
+		cpu_buffer->subbuf_ids = NULL;
+		raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+		goto out_free;
+	}
+
+	cpu_buffer->mapped = 1;
+	atomic_inc(&buffer->resize_disabled);
+	goto out;
+
+ out_free:
+	kfree(subbuf_ids);
+	free_page((unsigned long)meta);
+ out:
+	mutex_unlock(&buffer->mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map);
+
+/**
+ * ring_buffer_unmap - drop a reference taken by ring_buffer_map()
+ * @buffer: the mapped buffer
+ * @cpu: the mapped cpu buffer
+ *
+ * The meta page is freed once the last mapping is gone.
+ */
+int ring_buffer_unmap(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct trace_buffer_meta *meta;
+	unsigned long *subbuf_ids;
+	unsigned long flags;
+	int ret = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&buffer->mutex);
+
+	if (!cpu_buffer->mapped) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	if (--cpu_buffer->mapped)
+		goto out;
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	meta = cpu_buffer->meta_page;
+	subbuf_ids = cpu_buffer->subbuf_ids;
+	cpu_buffer->meta_page = NULL;
+	cpu_buffer->subbuf_ids = NULL;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	kfree(subbuf_ids);
+	free_page((unsigned long)meta);
+	atomic_dec(&buffer->resize_disabled);
+ out:
+	mutex_unlock(&buffer->mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_unmap);
+
+/**
+ * ring_buffer_map_get_reader - consume the mapped reader page
+ * @buffer: the mapped buffer
+ * @cpu: the mapped cpu buffer
+ * @read: bytes of the reader page consumed by user space
+ *
+ * The events of the reader page up to @read are consumed. Once the whole
+ * reader page is consumed, the next page with unread events is swapped
+ * in as the reader page. The meta page then describes the new reader,
+ * with the number of events lost before it, if any.
+ */
+int ring_buffer_map_get_reader(struct ring_buffer *buffer, int cpu,
+			       unsigned long read)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct buffer_page *reader;
+	unsigned long flags;
+	int ret = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+
+	if (!cpu_buffer->meta_page) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	reader = cpu_buffer->reader_page;
+
+	/* Consume the events user space has read, never past the commit */
+	read = min_t(unsigned long, read, rb_page_size(reader));
+	while (reader->read < read)
+		rb_advance_reader(cpu_buffer);
+
+	if (reader->read >= rb_page_size(reader)) {
+		if (rb_get_reader_page(cpu_buffer)) {
+			cpu_buffer->meta_page->reader.lost_events =
+				cpu_buffer->lost_events;
+			cpu_buffer->lost_events = 0;
+		} else {
+			/* Already reported with the page just consumed */
+			cpu_buffer->meta_page->reader.lost_events = 0;
+		}
+	}
+
+	rb_update_meta_page(cpu_buffer);
+
+	/* The writer may have filled the reader page behind user space */
+	flush_dcache_page(virt_to_page(cpu_buffer->reader_page->page));
+ out:
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_get_reader);
+
 #ifdef CONFIG_HOTPLUG_CPU
 static int rb_cpu_notify(struct notifier_block *self,
 			 unsigned long action, void *hcpu)
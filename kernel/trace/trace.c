@@ -43,6 +43,7 @@
 #include <linux/fs.h>
 #include <linux/sched/rt.h>
 #include <linux/coresight-stm.h>
+#include <uapi/linux/trace_mmap.h>
 
 #include "trace.h"
 #include "trace_output.h"
@@ -607,6 +608,10 @@ static int alloc_snapshot(struct trace_array *tr)
 {
 	int ret;
 
+	/* The snapshot swaps pages under the mapped buffers */
+	if (tr->mapped)
+		return -EBUSY;
+
 	if (!tr->allocated_snapshot) {
 
 		/* allocate spare buffer */
@@ -5539,6 +5544,10 @@ tracing_buffers_read(struct file *filp, char __user *ubuf,
 	trace_access_unlock(iter->cpu_file);
 
 	if (ret < 0) {
+		if (ret == -EBUSY) {
+			size = ret;
+			goto out_unlock;
+		}
 		if (trace_empty(iter)) {
 			if ((filp->f_flags & O_NONBLOCK)) {
 				size = -EAGAIN;
@@ -5730,6 +5739,8 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 		if (r < 0) {
 			ring_buffer_free_read_page(ref->buffer, ref->page);
 			kfree(ref);
+			if (r == -EBUSY)
+				ret = r;
 			break;
 		}
 
@@ -5775,12 +5786,99 @@ unlock:
 	return ret;
 }
 
+static long tracing_buffers_ioctl(struct file *file, unsigned int cmd,
+				  unsigned long arg)
+{
+	struct ftrace_buffer_info *info = file->private_data;
+	struct trace_iterator *iter = &info->iter;
+	int ret;
+
+	if (cmd != TRACE_MMAP_IOCTL_GET_READER)
+		return -ENOTTY;
+
+	if (!(file->f_flags & O_NONBLOCK) &&
+	    ring_buffer_empty_cpu(iter->trace_buffer->buffer, iter->cpu_file)) {
+		ret = wait_on_pipe(iter, false);
+		if (ret)
+			return ret;
+	}
+
+	trace_access_lock(iter->cpu_file);
+	ret = ring_buffer_map_get_reader(iter->trace_buffer->buffer,
+					 iter->cpu_file, arg);
+	trace_access_unlock(iter->cpu_file);
+
+	return ret;
+}
+
+static void tracing_buffers_mmap_open(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	mutex_lock(&trace_types_lock);
+	/* A split vma maps pages that are already mapped */
+	if (!ring_buffer_map(iter->trace_buffer->buffer, iter->cpu_file, NULL))
+		iter->tr->mapped++;
+	mutex_unlock(&trace_types_lock);
+}
+
+static void tracing_buffers_mmap_close(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	mutex_lock(&trace_types_lock);
+	if (!ring_buffer_unmap(iter->trace_buffer->buffer, iter->cpu_file))
+		iter->tr->mapped--;
+	mutex_unlock(&trace_types_lock);
+}
+
+static const struct vm_operations_struct tracing_buffers_vmops = {
+	.open		= tracing_buffers_mmap_open,
+	.close		= tracing_buffers_mmap_close,
+};
+
+static int tracing_buffers_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = filp->private_data;
+	struct trace_iterator *iter = &info->iter;
+	int ret = 0;
+
+	/* Only the per cpu trace_pipe_raw files can be mapped */
+	if (iter->cpu_file == RING_BUFFER_ALL_CPUS)
+		return -EINVAL;
+
+	mutex_lock(&trace_types_lock);
+
+#ifdef CONFIG_TRACER_MAX_TRACE
+	/* The snapshot would swap pages under the mapping */
+	if (iter->snapshot || iter->tr->allocated_snapshot) {
+		ret = -EBUSY;
+		goto out;
+	}
+#endif
+
+	ret = ring_buffer_map(iter->trace_buffer->buffer, iter->cpu_file, vma);
+	if (ret)
+		goto out;
+
+	iter->tr->mapped++;
+	vma->vm_ops = &tracing_buffers_vmops;
+ out:
+	mutex_unlock(&trace_types_lock);
+
+	return ret;
+}
+
 static const struct file_operations tracing_buffers_fops = {
 	.open		= tracing_buffers_open,
 	.read		= tracing_buffers_read,
 	.poll		= tracing_buffers_poll,
 	.release	= tracing_buffers_release,
 	.splice_read	= tracing_buffers_splice_read,
+	.unlocked_ioctl	= tracing_buffers_ioctl,
+	.mmap		= tracing_buffers_mmap,
 	.llseek		= no_llseek,
 };
 
@@ -215,6 +215,7 @@ struct trace_array {
 #endif
 	int			stop_count;
 	int			clock_id;
+	int			mapped;		/* mmapped cpu buffers */
 	struct tracer		*current_trace;
 	unsigned int		flags;
 	raw_spinlock_t		start_lock;
@@ -1006,11 +1007,14 @@ struct ftrace_event_field {
 	int			is_signed;
 };
 
+struct prog_entry;
+
 struct event_filter {
 	int			n_preds;	/* Number assigned */
 	int			a_preds;	/* allocated */
 	struct filter_pred	*preds;
 	struct filter_pred	*root;
+	struct prog_entry	*prog;		/* compiled preds */
 	char			*filter_string;
 };
 
@@ -1032,12 +1036,11 @@ struct ftrace_subsystem_dir {
 
 #define FILTER_PRED_INVALID	((unsigned short)-1)
 #define FILTER_PRED_IS_RIGHT	(1 << 15)
-#define FILTER_PRED_FOLD	(1 << 15)
 
 /*
  * The max preds is the size of unsigned short with
- * two flags at the MSBs. One bit is used for both the IS_RIGHT
- * and FOLD flags. The other is reserved.
+ * two flags at the MSBs. One bit is used for the IS_RIGHT
+ * flag. The other is reserved.
  *
  * 2^14 preds is way more than enough.
  */
@@ -1068,7 +1071,6 @@ struct filter_pred {
 	filter_pred_fn_t 	fn;
 	u64 			val;
 	struct regex		regex;
-	unsigned short		*ops;
 	struct ftrace_event_field *field;
 	int 			offset;
 	int 			not;
@@ -1115,6 +1117,13 @@ extern struct mutex event_mutex;
 extern struct list_head ftrace_events;
 
 extern const struct file_operations event_trigger_fops;
+extern const struct file_operations event_hist_fops;
+
+#ifdef CONFIG_HIST_TRIGGERS
+extern int register_trigger_hist_cmd(void);
+#else
+static inline int register_trigger_hist_cmd(void) { return 0; }
+#endif
 
 extern int register_trigger_cmds(void);
 extern void clear_event_triggers(struct trace_array *tr);
@@ -1127,9 +1136,23 @@ struct event_trigger_data {
 	struct event_filter __rcu	*filter;
 	char				*filter_str;
 	void				*private_data;
+	bool				paused;
 	struct list_head		list;
 };
 
+extern int event_trigger_init(struct event_trigger_ops *ops,
+			      struct event_trigger_data *data);
+extern int trace_event_trigger_enable_disable(struct ftrace_event_file *file,
+					      int trigger_enable);
+extern void update_cond_flag(struct ftrace_event_file *file);
+extern void unregister_trigger(char *glob, struct event_trigger_ops *ops,
+			       struct event_trigger_data *test,
+			       struct ftrace_event_file *file);
+extern int set_trigger_filter(char *filter_str,
+			      struct event_trigger_data *trigger_data,
+			      struct ftrace_event_file *file);
+extern int register_event_command(struct event_command *cmd);
+
 /**
  * struct event_trigger_ops - callbacks for trace event triggers
  *
@@ -1142,7 +1165,9 @@ struct event_trigger_data {
  * @func: The trigger 'probe' function called when the triggering
  *	event occurs.  The data passed into this callback is the data
  *	that was supplied to the event_command @reg() function that
- *	registered the trigger (see struct event_command).
+ *	registered the trigger (see struct event_command).  The record
+ *	of the event is passed too, or NULL if the trigger was invoked
+ *	unconditionally or after the event was committed.
  *
  * @init: An optional initialization function called for the trigger
  *	when the trigger is registered (via the event_command reg()
@@ -1167,7 +1192,8 @@ struct event_trigger_data {
  *	(see trace_event_triggers.c).
  */
 struct event_trigger_ops {
-	void			(*func)(struct event_trigger_data *data);
+	void			(*func)(struct event_trigger_data *data,
+					void *rec);
 	int			(*init)(struct event_trigger_ops *ops,
 					struct event_trigger_data *data);
 	void			(*free)(struct event_trigger_ops *ops,
@@ -1191,8 +1217,8 @@ struct event_trigger_ops {
  * The data members in this structure provide per-event command data
  * for various event commands.
  *
- * All the data members below, except for @post_trigger, must be set
- * for each event command.
+ * All the data members below, except for @post_trigger and
+ * @needs_rec, must be set for each event command.
  *
  * @name: The unique name that identifies the event command.  This is
  *	the name used when setting triggers via trigger files.
@@ -1230,6 +1256,11 @@ struct event_trigger_ops {
  *	itself logs to the trace buffer, this flag should be set,
  *	otherwise it can be left unspecified.
  *
+ * @needs_rec: A flag that says whether or not this command needs
+ *	the record of the event, such as the hist command which
+ *	reads its fields.  It makes the event always record its
+ *	fields for the triggers, as if the trigger had a filter.
+ *
  * All the methods below, except for @set_filter(), must be
  * implemented.
  *
@@ -1270,6 +1301,7 @@ struct event_command {
 	char			*name;
 	enum event_trigger_type	trigger_type;
 	bool			post_trigger;
+	bool			needs_rec;
 	int			(*func)(struct event_command *cmd_ops,
 					struct ftrace_event_file *file,
 					char *glob, char *cmd, char *params);
@@ -30,6 +30,10 @@ static unsigned int bm_std;
  * reported as "first", which is shown in the second write to the
  * tracepoint. The "first" field is writen within the statics from
  * then on but never changes.
+ *
+ * The last time is also passed as the numeric "delta" field. Setting
+ * a filter on it (say "delta > 0 && delta < 100000") adds the cost of
+ * the filter to the times measured, which benchmarks the filters.
  */
 static void trace_do_benchmark(void)
 {
@@ -48,7 +52,7 @@ static void trace_do_benchmark(void)
 
 	local_irq_disable();
 	start = trace_clock_local();
-	trace_benchmark_event(bm_str);
+	trace_benchmark_event(bm_str, bm_last);
 	stop = trace_clock_local();
 	local_irq_enable();
 
@@ -456,119 +456,43 @@ static int walk_pred_tree(struct filter_pred *preds,
 }
 
 /*
- * A series of AND or ORs where found together. Instead of
- * climbing up and down the tree branches, an array of the
- * ops were made in order of checks. We can just move across
- * the array and short circuit if needed.
+ * The predicate tree is compiled into a flat program when the filter
+ * is set. Each entry runs one leaf predicate, and jumps to @target if
+ * the result is @when_to_branch or falls through to the next entry
+ * otherwise. This gives the same short circuits as walking the tree
+ * without climbing up and down its branches for every event. The
+ * program ends with two entries without a predicate whose @target is
+ * the result of the filter.
  */
-static int process_ops(struct filter_pred *preds,
-		       struct filter_pred *op, void *rec)
-{
-	struct filter_pred *pred;
-	int match = 0;
-	int type;
-	int i;
-
-	/*
-	 * Micro-optimization: We set type to true if op
-	 * is an OR and false otherwise (AND). Then we
-	 * just need to test if the match is equal to
-	 * the type, and if it is, we can short circuit the
-	 * rest of the checks:
-	 *
-	 * if ((match && op->op == OP_OR) ||
-	 *     (!match && op->op == OP_AND))
-	 *	  return match;
-	 */
-	type = op->op == OP_OR;
-
-	for (i = 0; i < op->val; i++) {
-		pred = &preds[op->ops[i]];
-		if (!WARN_ON_ONCE(!pred->fn))
-			match = pred->fn(pred, rec);
-		if (!!match == type)
-			return match;
-	}
-	return match;
-}
-
-struct filter_match_preds_data {
-	struct filter_pred *preds;
-	int match;
-	void *rec;
+struct prog_entry {
+	int			target;
+	int			when_to_branch;
+	struct filter_pred	*pred;
 };
 
-static int filter_match_preds_cb(enum move_type move, struct filter_pred *pred,
-				 int *err, void *data)
-{
-	struct filter_match_preds_data *d = data;
-
-	*err = 0;
-	switch (move) {
-	case MOVE_DOWN:
-		/* only AND and OR have children */
-		if (pred->left != FILTER_PRED_INVALID) {
-			/* If ops is set, then it was folded. */
-			if (!pred->ops)
-				return WALK_PRED_DEFAULT;
-			/* We can treat folded ops as a leaf node */
-			d->match = process_ops(d->preds, pred, d->rec);
-		} else {
-			if (!WARN_ON_ONCE(!pred->fn))
-				d->match = pred->fn(pred, d->rec);
-		}
-
-		return WALK_PRED_PARENT;
-	case MOVE_UP_FROM_LEFT:
-		/*
-		 * Check for short circuits.
-		 *
-		 * Optimization: !!match == (pred->op == OP_OR)
-		 *   is the same as:
-		 * if ((match && pred->op == OP_OR) ||
-		 *     (!match && pred->op == OP_AND))
-		 */
-		if (!!d->match == (pred->op == OP_OR))
-			return WALK_PRED_PARENT;
-		break;
-	case MOVE_UP_FROM_RIGHT:
-		break;
-	}
-
-	return WALK_PRED_DEFAULT;
-}
-
 /* return 1 if event matches, 0 otherwise (discard) */
 int filter_match_preds(struct event_filter *filter, void *rec)
 {
-	struct filter_pred *preds;
-	struct filter_pred *root;
-	struct filter_match_preds_data data = {
-		/* match is currently meaningless */
-		.match = -1,
-		.rec   = rec,
-	};
-	int n_preds, ret;
+	struct prog_entry *prog;
+	struct filter_pred *pred;
+	int i = 0;
 
 	/* no filter is considered a match */
 	if (!filter)
 		return 1;
 
-	n_preds = filter->n_preds;
-	if (!n_preds)
+	/* prog and the preds it points to are protected by preempt disable */
+	prog = rcu_dereference_sched(filter->prog);
+	if (!prog)
 		return 1;
 
-	/*
-	 * n_preds, root and filter->preds are protect with preemption disabled.
-	 */
-	root = rcu_dereference_sched(filter->root);
-	if (!root)
-		return 1;
-
-	data.preds = preds = rcu_dereference_sched(filter->preds);
-	ret = walk_pred_tree(preds, root, filter_match_preds_cb, &data);
-	WARN_ON(ret);
-	return data.match;
+	while ((pred = prog[i].pred)) {
+		if (!!pred->fn(pred, rec) == prog[i].when_to_branch)
+			i = prog[i].target;
+		else
+			i++;
+	}
+	return prog[i].target;
 }
 EXPORT_SYMBOL_GPL(filter_match_preds);
 
@@ -732,22 +656,10 @@ static int filter_set_pred(struct event_filter *filter,
 		left = __pop_pred_stack(stack);
 		if (!left || !right)
 			return -EINVAL;
-		/*
-		 * If both children can be folded
-		 * and they are the same op as this op or a leaf,
-		 * then this op can be folded.
-		 */
-		if (left->index & FILTER_PRED_FOLD &&
-		    (left->op == dest->op ||
-		     left->left == FILTER_PRED_INVALID) &&
-		    right->index & FILTER_PRED_FOLD &&
-		    (right->op == dest->op ||
-		     right->left == FILTER_PRED_INVALID))
-			dest->index |= FILTER_PRED_FOLD;
-
-		dest->left = left->index & ~FILTER_PRED_FOLD;
-		dest->right = right->index & ~FILTER_PRED_FOLD;
-		left->parent = dest->index & ~FILTER_PRED_FOLD;
+
+		dest->left = left->index;
+		dest->right = right->index;
+		left->parent = dest->index;
 		right->parent = dest->index | FILTER_PRED_IS_RIGHT;
 	} else {
 		/*
@@ -755,9 +667,6 @@ static int filter_set_pred(struct event_filter *filter,
 		 * way to know this is a leaf node.
 		 */
 		dest->left = FILTER_PRED_INVALID;
-
-		/* All leafs allow folding the parent ops. */
-		dest->index |= FILTER_PRED_FOLD;
 	}
 
 	return __push_pred_stack(stack, dest);
@@ -765,11 +674,10 @@ static int filter_set_pred(struct event_filter *filter,
 
 static void __free_preds(struct event_filter *filter)
 {
-	int i;
+	kfree(filter->prog);
+	filter->prog = NULL;
 
 	if (filter->preds) {
-		for (i = 0; i < filter->n_preds; i++)
-			kfree(filter->preds[i].ops);
 		kfree(filter->preds);
 		filter->preds = NULL;
 	}
@@ -1453,110 +1361,121 @@ static int check_pred_tree(struct event_filter *filter,
 			      check_pred_tree_cb, &data);
 }
 
-static int count_leafs_cb(enum move_type move, struct filter_pred *pred,
-			  int *err, void *data)
-{
-	int *count = data;
-
-	if ((move == MOVE_DOWN) &&
-	    (pred->left == FILTER_PRED_INVALID))
-		(*count)++;
+/* Jump labels of the program, nodes start theirs at FILTER_LABEL_NODE */
+#define FILTER_LABEL_FALSE	0
+#define FILTER_LABEL_TRUE	1
+#define FILTER_LABEL_NODE	2
 
-	return WALK_PRED_DEFAULT;
-}
-
-static int count_leafs(struct filter_pred *preds, struct filter_pred *root)
-{
-	int count = 0, ret;
-
-	ret = walk_pred_tree(preds, root, count_leafs_cb, &count);
-	WARN_ON(ret);
-	return count;
-}
+/*
+ * Where the result of a node goes: the labels to jump to when it is
+ * true or false, and which of the two directly follows its code.
+ */
+struct prog_dest {
+	unsigned short		true_label;
+	unsigned short		false_label;
+	bool			fall_true;
+};
 
-struct fold_pred_data {
-	struct filter_pred *root;
-	int count;
-	int children;
+struct compile_pred_data {
+	struct filter_pred	*preds;
+	struct prog_entry	*prog;
+	struct prog_dest	*dest;
+	int			*label_pos;
+	int			n;
 };
 
-static int fold_pred_cb(enum move_type move, struct filter_pred *pred,
-			int *err, void *data)
+static int compile_pred_cb(enum move_type move, struct filter_pred *pred,
+			   int *err, void *data)
 {
-	struct fold_pred_data *d = data;
-	struct filter_pred *root = d->root;
+	struct compile_pred_data *d = data;
+	int idx = pred - d->preds;
+	struct prog_dest *dest = &d->dest[idx];
+	struct prog_entry *entry;
 
-	if (move != MOVE_DOWN)
-		return WALK_PRED_DEFAULT;
-	if (pred->left != FILTER_PRED_INVALID)
-		return WALK_PRED_DEFAULT;
+	switch (move) {
+	case MOVE_DOWN:
+		if (pred->left == FILTER_PRED_INVALID) {
+			/* Branch on the result that does not fall through */
+			entry = &d->prog[d->n++];
+			entry->pred = pred;
+			entry->when_to_branch = !dest->fall_true;
+			entry->target = dest->fall_true ? dest->false_label :
+							  dest->true_label;
+			break;
+		}
 
-	if (WARN_ON(d->count == d->children)) {
-		*err = -EINVAL;
-		return WALK_PRED_ABORT;
+		/*
+		 * The code of the left child is followed by the code of
+		 * the right child, starting at the label of this node.
+		 * The left child of an AND falls through to the right one
+		 * when true, the left child of an OR when false.
+		 */
+		d->dest[pred->right] = *dest;
+		if (pred->op == OP_AND) {
+			d->dest[pred->left].true_label = idx + FILTER_LABEL_NODE;
+			d->dest[pred->left].false_label = dest->false_label;
+			d->dest[pred->left].fall_true = true;
+		} else {
+			d->dest[pred->left].true_label = dest->true_label;
+			d->dest[pred->left].false_label = idx + FILTER_LABEL_NODE;
+			d->dest[pred->left].fall_true = false;
+		}
+		break;
+	case MOVE_UP_FROM_LEFT:
+		d->label_pos[idx + FILTER_LABEL_NODE] = d->n;
+		break;
+	case MOVE_UP_FROM_RIGHT:
+		break;
 	}
 
-	pred->index &= ~FILTER_PRED_FOLD;
-	root->ops[d->count++] = pred->index;
 	return WALK_PRED_DEFAULT;
 }
 
-static int fold_pred(struct filter_pred *preds, struct filter_pred *root)
+/*
+ * Compile the tree under @root into the flat program that
+ * filter_match_preds() runs. The program is not visible to
+ * the matching until filter->prog is set by the caller.
+ */
+static int compile_pred_tree(struct event_filter *filter,
+			     struct filter_pred *root,
+			     struct prog_entry **progp)
 {
-	struct fold_pred_data data = {
-		.root  = root,
-		.count = 0,
+	struct compile_pred_data data = {
+		.preds = filter->preds,
 	};
-	int children;
-
-	/* No need to keep the fold flag */
-	root->index &= ~FILTER_PRED_FOLD;
+	int n_preds = filter->n_preds;
+	int i, err = -ENOMEM;
 
-	/* If the root is a leaf then do nothing */
-	if (root->left == FILTER_PRED_INVALID)
-		return 0;
-
-	/* count the children */
-	children = count_leafs(preds, &preds[root->left]);
-	children += count_leafs(preds, &preds[root->right]);
+	data.prog = kcalloc(n_preds + 2, sizeof(*data.prog), GFP_KERNEL);
+	data.dest = kcalloc(n_preds, sizeof(*data.dest), GFP_KERNEL);
+	data.label_pos = kcalloc(n_preds + FILTER_LABEL_NODE,
+				 sizeof(*data.label_pos), GFP_KERNEL);
+	if (!data.prog || !data.dest || !data.label_pos)
+		goto out;
 
-	root->ops = kcalloc(children, sizeof(*root->ops), GFP_KERNEL);
-	if (!root->ops)
-		return -ENOMEM;
+	/* The false result directly follows the code of the root */
+	data.dest[root - filter->preds].true_label = FILTER_LABEL_TRUE;
+	data.dest[root - filter->preds].false_label = FILTER_LABEL_FALSE;
 
-	root->val = children;
-	data.children = children;
-	return walk_pred_tree(preds, root, fold_pred_cb, &data);
-}
-
-static int fold_pred_tree_cb(enum move_type move, struct filter_pred *pred,
-			     int *err, void *data)
-{
-	struct filter_pred *preds = data;
-
-	if (move != MOVE_DOWN)
-		return WALK_PRED_DEFAULT;
-	if (!(pred->index & FILTER_PRED_FOLD))
-		return WALK_PRED_DEFAULT;
-
-	*err = fold_pred(preds, pred);
-	if (*err)
-		return WALK_PRED_ABORT;
-
-	/* eveyrhing below is folded, continue with parent */
-	return WALK_PRED_PARENT;
-}
-
-/*
- * To optimize the processing of the ops, if we have several "ors" or
- * "ands" together, we can put them in an array and process them all
- * together speeding up the filter logic.
- */
-static int fold_pred_tree(struct event_filter *filter,
-			   struct filter_pred *root)
-{
-	return walk_pred_tree(filter->preds, root, fold_pred_tree_cb,
-			      filter->preds);
+	err = walk_pred_tree(filter->preds, root, compile_pred_cb, &data);
+	if (err)
+		goto out;
+
+	data.label_pos[FILTER_LABEL_FALSE] = data.n;
+	data.prog[data.n].target = 0;
+	data.label_pos[FILTER_LABEL_TRUE] = data.n + 1;
+	data.prog[data.n + 1].target = 1;
+
+	for (i = 0; i < data.n; i++)
+		data.prog[i].target = data.label_pos[data.prog[i].target];
+
+	*progp = data.prog;
+	data.prog = NULL;
+ out:
+	kfree(data.prog);
+	kfree(data.dest);
+	kfree(data.label_pos);
+	return err;
 }
 
 static int replace_preds(struct ftrace_event_call *call,
@@ -1567,6 +1486,7 @@ static int replace_preds(struct ftrace_event_call *call,
 	char *operand1 = NULL, *operand2 = NULL;
 	struct filter_pred *pred;
 	struct filter_pred *root;
+	struct prog_entry *prog;
 	struct postfix_elt *elt;
 	struct pred_stack stack = { }; /* init to NULL */
 	int err;
@@ -1645,14 +1565,14 @@ static int replace_preds(struct ftrace_event_call *call,
 		if (err)
 			goto fail;
 
-		/* Optimize the tree */
-		err = fold_pred_tree(filter, root);
+		err = compile_pred_tree(filter, root, &prog);
 		if (err)
 			goto fail;
 
-		/* We don't set root until we know it works */
+		/* We don't set root and prog until we know it works */
 		barrier();
 		filter->root = root;
+		filter->prog = prog;
 	}
 
 	err = 0;
@@ -2323,6 +2243,12 @@ static struct test_filter_data_t {
 	DATA_REC(YES, 1, 1, 1, 1, 1, 1, 1, 1, "bdfh"),
 	DATA_REC(YES, 0, 1, 0, 1, 0, 1, 0, 1, ""),
 	DATA_REC(YES, 1, 0, 1, 0, 1, 0, 1, 0, "bdfh"),
+#undef FILTER
+#define FILTER "a != 1 && (b == 1 || c != 1) || d == 1 && e == 1 || " \
+	       "f < 1 && g > 0 || h == 1"
+	DATA_REC(YES, 0, 1, 1, 1, 1, 1, 1, 1, "cdefgh"),
+	DATA_REC(NO,  1, 0, 0, 0, 0, 1, 0, 0, "bceg"),
+	DATA_REC(YES, 1, 1, 1, 1, 1, 0, 1, 0, "bcfgh"),
 };
 
 #undef DATA_REC
@@ -2365,6 +2291,58 @@ static int test_walk_pred_cb(enum move_type move, struct filter_pred *pred,
 	return WALK_PRED_DEFAULT;
 }
 
+struct test_match_data {
+	void *rec;
+	int match;
+};
+
+/* Reference matcher: walk the predicate tree with short circuits */
+static int test_match_cb(enum move_type move, struct filter_pred *pred,
+			 int *err, void *data)
+{
+	struct test_match_data *d = data;
+
+	switch (move) {
+	case MOVE_DOWN:
+		if (pred->left != FILTER_PRED_INVALID)
+			return WALK_PRED_DEFAULT;
+		d->match = !!pred->fn(pred, d->rec);
+		return WALK_PRED_PARENT;
+	case MOVE_UP_FROM_LEFT:
+		if (d->match == (pred->op == OP_OR))
+			return WALK_PRED_PARENT;
+		break;
+	case MOVE_UP_FROM_RIGHT:
+		break;
+	}
+
+	return WALK_PRED_DEFAULT;
+}
+
+/*
+ * Check that the compiled program matches the tree walk for every
+ * record with the fields set to 0 or 1.
+ */
+static int test_compiled_filter(struct event_filter *filter)
+{
+	struct ftrace_raw_ftrace_test_filter rec;
+	struct test_match_data data = { .rec = &rec };
+	int *fields[] = { &rec.a, &rec.b, &rec.c, &rec.d,
+			  &rec.e, &rec.f, &rec.g, &rec.h };
+	int i, bits;
+
+	for (bits = 0; bits < (1 << ARRAY_SIZE(fields)); bits++) {
+		for (i = 0; i < ARRAY_SIZE(fields); i++)
+			*fields[i] = (bits >> i) & 1;
+
+		walk_pred_tree(filter->preds, filter->root,
+			       test_match_cb, &data);
+		if (filter_match_preds(filter, &rec) != data.match)
+			return bits;
+	}
+	return -1;
+}
+
 static __init int ftrace_test_event_filter(void)
 {
 	int i;
@@ -2391,6 +2369,16 @@ static __init int ftrace_test_event_filter(void)
 		 * tests, but the rcu dereference will complain without it.
 		 */
 		preempt_disable();
+		err = test_compiled_filter(filter);
+		if (err >= 0) {
+			preempt_enable();
+			printk(KERN_INFO
+			       "Failed, compiled filter '%s' differs for %02x\n",
+			       d->filter, err);
+			__free_filter(filter);
+			break;
+		}
+
 		if (*d->not_visited)
 			walk_pred_tree(filter->preds, filter->root,
 				       test_walk_pred_cb,
@@ -0,0 +1,1074 @@
+/*
+ * trace_events_hist - trace event hist triggers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * A hist trigger aggregates the events it is hit by into a map keyed
+ * by one or more event fields, counting the hits and summing value
+ * fields per key, so that statistics such as bytes per device or IRQ
+ * counts can be gathered without streaming every event to user space:
+ *
+ *   echo 'hist:keys=dev:vals=nr_sector:sort=nr_sector.descending' > \
+ *	events/block/block_rq_issue/trigger
+ *   cat events/block/block_rq_issue/hist
+ *
+ * The map is preallocated and updated with cmpxchg() only, as events
+ * can hit it from any context including NMI. Keys that do not fit are
+ * counted as dropped.
+ */
+
+#include <linux/module.h>
+#include <linux/kallsyms.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/jhash.h>
+#include <linux/sort.h>
+
+#include "trace.h"
+
+#define HIST_KEYS_MAX		3
+#define HIST_VALS_MAX		4
+#define HIST_SORT_KEYS_MAX	2
+#define HIST_KEY_STR_MAX	64	/* string keys are truncated to this */
+#define HIST_KEY_SIZE_MAX	(HIST_KEYS_MAX * HIST_KEY_STR_MAX)
+
+#define HIST_MAP_BITS_DEFAULT	11
+#define HIST_MAP_BITS_MIN	7
+#define HIST_MAP_BITS_MAX	17
+
+enum hist_field_flags {
+	HIST_FIELD_HEX		= 1 << 0,
+	HIST_FIELD_SYM		= 1 << 1,
+	HIST_FIELD_EXECNAME	= 1 << 2,
+	HIST_FIELD_LOG2		= 1 << 3,
+	HIST_FIELD_STRING	= 1 << 4,
+};
+
+struct hist_elt {
+	atomic64_t		hitcount;
+	atomic64_t		sums[HIST_VALS_MAX];
+	void			*key;
+	char			comm[TASK_COMM_LEN];
+};
+
+struct hist_map_entry {
+	u32			key_hash;
+	struct hist_elt		*elt;
+};
+
+/*
+ * Open addressing hash with twice as many slots as elements. A slot is
+ * claimed by a cmpxchg() of its key_hash and published by setting elt
+ * once the key is copied. A writer that finds the slot of its key not
+ * published yet moves on, so the same key may end up in two elements;
+ * the readers merge those.
+ */
+struct hist_map {
+	unsigned int		bits;
+	unsigned int		max_elts;
+	unsigned int		nr_entries;
+	unsigned int		key_size;
+	bool			save_comm;
+	struct hist_map_entry	*entries;
+	struct hist_elt		*elts;
+	void			*keys;
+	atomic_t		next_elt;
+	atomic64_t		hits;
+	atomic64_t		drops;
+};
+
+struct hist_field {
+	struct ftrace_event_field	*field;
+	unsigned long			flags;
+	unsigned int			offset;	/* in the key */
+	unsigned int			size;	/* in the key */
+};
+
+struct hist_sort_key {
+	struct hist_field		*key;	/* sort on a key field */
+	int				val;	/* or on a value, -1 is hitcount */
+	bool				descending;
+};
+
+struct hist_trigger_attrs {
+	char				*keys_str;
+	char				*vals_str;
+	char				*sort_key_str;
+	bool				pause;
+	bool				cont;
+	bool				clear;
+	unsigned int			map_bits;
+};
+
+struct hist_trigger_data {
+	struct hist_field		keys[HIST_KEYS_MAX];
+	unsigned int			n_keys;
+	struct hist_field		vals[HIST_VALS_MAX];
+	unsigned int			n_vals;
+	struct hist_sort_key		sort_keys[HIST_SORT_KEYS_MAX];
+	unsigned int			n_sort_keys;
+	unsigned int			key_size;
+	struct hist_trigger_attrs	*attrs;
+	struct hist_map			*map;
+};
+
+/* A snapshot of one element, for sorting and printing */
+struct hist_sort_entry {
+	struct hist_trigger_data	*hist_data;
+	struct hist_elt			*elt;
+	u64				hitcount;
+	u64				sums[HIST_VALS_MAX];
+};
+
+static void hist_map_destroy(struct hist_map *map)
+{
+	if (!map)
+		return;
+
+	vfree(map->entries);
+	vfree(map->elts);
+	vfree(map->keys);
+	kfree(map);
+}
+
+static struct hist_map *hist_map_create(unsigned int bits,
+					unsigned int key_size, bool save_comm)
+{
+	struct hist_map *map;
+	unsigned int i;
+
+	map = kzalloc(sizeof(*map), GFP_KERNEL);
+	if (!map)
+		return NULL;
+
+	map->bits = bits;
+	map->max_elts = 1 << bits;
+	map->nr_entries = 2 << bits;
+	map->key_size = key_size;
+	map->save_comm = save_comm;
+
+	map->entries = vzalloc(map->nr_entries * sizeof(*map->entries));
+	map->elts = vzalloc(map->max_elts * sizeof(*map->elts));
+	map->keys = vzalloc(map->max_elts * key_size);
+	if (!map->entries || !map->elts || !map->keys) {
+		hist_map_destroy(map);
+		return NULL;
+	}
+
+	for (i = 0; i < map->max_elts; i++)
+		map->elts[i].key = map->keys + i * key_size;
+
+	return map;
+}
+
+/* Caller must make sure the map is not being updated */
+static void hist_map_clear(struct hist_map *map)
+{
+	unsigned int i, j;
+
+	memset(map->entries, 0, map->nr_entries * sizeof(*map->entries));
+	memset(map->keys, 0, map->max_elts * map->key_size);
+	for (i = 0; i < map->max_elts; i++) {
+		atomic64_set(&map->elts[i].hitcount, 0);
+		for (j = 0; j < HIST_VALS_MAX; j++)
+			atomic64_set(&map->elts[i].sums[j], 0);
+	}
+	atomic_set(&map->next_elt, 0);
+	atomic64_set(&map->hits, 0);
+	atomic64_set(&map->drops, 0);
+}
+
+static struct hist_elt *hist_map_get_elt(struct hist_map *map)
+{
+	int idx = atomic_inc_return(&map->next_elt) - 1;
+
+	if (idx >= map->max_elts)
+		return NULL;
+
+	return &map->elts[idx];
+}
+
+static struct hist_elt *hist_map_insert(struct hist_map *map, void *key)
+{
+	struct hist_map_entry *entry;
+	struct hist_elt *elt;
+	u32 key_hash, test_key, idx;
+	unsigned int i;
+
+	key_hash = jhash2(key, map->key_size / sizeof(u32), 0);
+	if (!key_hash)
+		key_hash = 1;	/* 0 marks a free slot */
+
+	idx = key_hash >> (32 - (map->bits + 1));
+
+	for (i = 0; i < map->nr_entries; i++) {
+		entry = &map->entries[idx];
+		test_key = ACCESS_ONCE(entry->key_hash);
+
+		if (test_key == key_hash) {
+			elt = ACCESS_ONCE(entry->elt);
+			/* Pairs with the smp_wmb() before publishing */
+			smp_rmb();
+			if (elt && !memcmp(elt->key, key, map->key_size))
+				return elt;
+		} else if (!test_key) {
+			if (cmpxchg(&entry->key_hash, 0, key_hash)) {
+				/* Lost the slot, look at it again */
+				continue;
+			}
+
+			elt = hist_map_get_elt(map);
+			if (!elt)
+				break;
+
+			memcpy(elt->key, key, map->key_size);
+			if (map->save_comm)
+				memcpy(elt->comm, current->comm, TASK_COMM_LEN);
+			smp_wmb();
+			ACCESS_ONCE(entry->elt) = elt;
+			return elt;
+		}
+
+		idx = (idx + 1) & (map->nr_entries - 1);
+	}
+
+	atomic64_inc(&map->drops);
+	return NULL;
+}
+
+static bool hist_field_is_string(struct ftrace_event_field *field)
+{
+	return field->filter_type == FILTER_STATIC_STRING ||
+	       field->filter_type == FILTER_DYN_STRING ||
+	       field->filter_type == FILTER_PTR_STRING;
+}
+
+static bool hist_field_is_numeric(struct ftrace_event_field *field)
+{
+	if (field->filter_type != FILTER_OTHER)
+		return false;
+
+	return field->size == 1 || field->size == 2 ||
+	       field->size == 4 || field->size == 8;
+}
+
+static u64 hist_field_read(struct ftrace_event_field *field, void *rec)
+{
+	void *addr = rec + field->offset;
+
+	switch (field->size) {
+	case 1:
+		return field->is_signed ? (u64)*(s8 *)addr : *(u8 *)addr;
+	case 2:
+		return field->is_signed ? (u64)*(s16 *)addr : *(u16 *)addr;
+	case 4:
+		return field->is_signed ? (u64)*(s32 *)addr : *(u32 *)addr;
+	default:
+		return *(u64 *)addr;
+	}
+}
+
+static void hist_field_read_str(struct ftrace_event_field *field, void *rec,
+				char *str)
+{
+	unsigned int len = HIST_KEY_STR_MAX - 1;
+	char *src = rec + field->offset;
+	u32 loc;
+
+	switch (field->filter_type) {
+	case FILTER_STATIC_STRING:
+		len = min_t(unsigned int, len, field->size);
+		break;
+	case FILTER_DYN_STRING:
+		loc = *(u32 *)src;
+		src = rec + (loc & 0xffff);
+		len = min_t(unsigned int, len, loc >> 16);
+		break;
+	case FILTER_PTR_STRING:
+		src = *(char **)src;
+		if (!src)
+			return;
+		break;
+	}
+
+	strncpy(str, src, len);
+}
+
+static void hist_field_key(struct hist_field *hf, void *rec, void *key)
+{
+	u64 val;
+
+	if (hf->flags & HIST_FIELD_STRING) {
+		hist_field_read_str(hf->field, rec, key + hf->offset);
+		return;
+	}
+
+	val = hist_field_read(hf->field, rec);
+	/* The bucket of val is the power of two it rounds up to */
+	if (hf->flags & HIST_FIELD_LOG2)
+		val = val ? fls64(val - 1) : 0;
+
+	memcpy(key + hf->offset, &val, sizeof(val));
+}
+
+static void event_hist_trigger(struct event_trigger_data *data, void *rec)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	struct hist_map *map = hist_data->map;
+	u64 key[HIST_KEY_SIZE_MAX / sizeof(u64)];
+	struct hist_elt *elt;
+	unsigned int i;
+
+	if (!rec)
+		return;
+
+	memset(key, 0, hist_data->key_size);
+	for (i = 0; i < hist_data->n_keys; i++)
+		hist_field_key(&hist_data->keys[i], rec, key);
+
+	atomic64_inc(&map->hits);
+
+	elt = hist_map_insert(map, key);
+	if (!elt)
+		return;
+
+	atomic64_inc(&elt->hitcount);
+	for (i = 0; i < hist_data->n_vals; i++)
+		atomic64_add(hist_field_read(hist_data->vals[i].field, rec),
+			     &elt->sums[i]);
+}
+
+static const char *hist_field_modifier(struct hist_field *hf)
+{
+	if (hf->flags & HIST_FIELD_HEX)
+		return ".hex";
+	if (hf->flags & HIST_FIELD_SYM)
+		return ".sym";
+	if (hf->flags & HIST_FIELD_EXECNAME)
+		return ".execname";
+	if (hf->flags & HIST_FIELD_LOG2)
+		return ".log2";
+	return "";
+}
+
+static int event_hist_trigger_print(struct seq_file *m,
+				    struct event_trigger_ops *ops,
+				    struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	struct hist_sort_key *sk;
+	unsigned int i;
+
+	seq_puts(m, "hist:keys=");
+	for (i = 0; i < hist_data->n_keys; i++)
+		seq_printf(m, "%s%s%s", i ? "," : "",
+			   hist_data->keys[i].field->name,
+			   hist_field_modifier(&hist_data->keys[i]));
+
+	seq_puts(m, ":vals=hitcount");
+	for (i = 0; i < hist_data->n_vals; i++)
+		seq_printf(m, ",%s", hist_data->vals[i].field->name);
+
+	seq_puts(m, ":sort=");
+	for (i = 0; i < hist_data->n_sort_keys; i++) {
+		sk = &hist_data->sort_keys[i];
+		seq_printf(m, "%s%s%s", i ? "," : "",
+			   sk->key ? sk->key->field->name :
+			   sk->val < 0 ? "hitcount" :
+			   hist_data->vals[sk->val].field->name,
+			   sk->descending ? ".descending" : "");
+	}
+
+	seq_printf(m, ":size=%u", hist_data->map->max_elts);
+
+	if (data->filter_str)
+		seq_printf(m, " if %s", data->filter_str);
+
+	seq_puts(m, data->paused ? " [paused]\n" : " [active]\n");
+
+	return 0;
+}
+
+static void hist_trigger_attrs_free(struct hist_trigger_attrs *attrs)
+{
+	if (!attrs)
+		return;
+
+	kfree(attrs->keys_str);
+	kfree(attrs->vals_str);
+	kfree(attrs->sort_key_str);
+	kfree(attrs);
+}
+
+static struct hist_trigger_attrs *hist_trigger_attrs_parse(char *trigger_str)
+{
+	struct hist_trigger_attrs *attrs;
+	char *str, *val, **dst;
+	unsigned long size;
+	int ret = -EINVAL;
+
+	attrs = kzalloc(sizeof(*attrs), GFP_KERNEL);
+	if (!attrs)
+		return ERR_PTR(-ENOMEM);
+
+	attrs->map_bits = HIST_MAP_BITS_DEFAULT;
+
+	while (trigger_str) {
+		str = strsep(&trigger_str, ":");
+		val = str;
+		strsep(&val, "=");
+
+		if (!val) {
+			if (!strcmp(str, "pause"))
+				attrs->pause = true;
+			else if (!strcmp(str, "cont") ||
+				 !strcmp(str, "continue"))
+				attrs->cont = true;
+			else if (!strcmp(str, "clear"))
+				attrs->clear = true;
+			else
+				goto free;
+			continue;
+		}
+
+		if (!strcmp(str, "size")) {
+			if (kstrtoul(val, 0, &size) || !size)
+				goto free;
+			attrs->map_bits = clamp_t(unsigned int,
+						  order_base_2(size),
+						  HIST_MAP_BITS_MIN,
+						  HIST_MAP_BITS_MAX);
+			continue;
+		}
+
+		if (!strcmp(str, "keys") || !strcmp(str, "key"))
+			dst = &attrs->keys_str;
+		else if (!strcmp(str, "vals") || !strcmp(str, "val") ||
+			 !strcmp(str, "values"))
+			dst = &attrs->vals_str;
+		else if (!strcmp(str, "sort"))
+			dst = &attrs->sort_key_str;
+		else
+			goto free;
+
+		kfree(*dst);
+		*dst = kstrdup(val, GFP_KERNEL);
+		if (!*dst) {
+			ret = -ENOMEM;
+			goto free;
+		}
+	}
+
+	if (!attrs->keys_str)
+		goto free;
+
+	return attrs;
+ free:
+	hist_trigger_attrs_free(attrs);
+	return ERR_PTR(ret);
+}
+
+static int hist_field_parse(struct ftrace_event_file *file,
+			    struct hist_field *hf, char *str, bool key)
+{
+	char *field_name = strsep(&str, ".");
+	struct ftrace_event_field *field;
+
+	field = trace_find_event_field(file->event_call, field_name);
+	if (!field)
+		return -EINVAL;
+
+	hf->field = field;
+
+	if (str) {
+		if (!key)
+			return -EINVAL;
+		if (!strcmp(str, "hex"))
+			hf->flags |= HIST_FIELD_HEX;
+		else if (!strcmp(str, "sym"))
+			hf->flags |= HIST_FIELD_SYM;
+		else if (!strcmp(str, "log2"))
+			hf->flags |= HIST_FIELD_LOG2;
+		else if (!strcmp(str, "execname") &&
+			 !strcmp(field->name, "common_pid"))
+			hf->flags |= HIST_FIELD_EXECNAME;
+		else
+			return -EINVAL;
+	}
+
+	if (key && hist_field_is_string(field)) {
+		if (hf->flags)
+			return -EINVAL;
+		hf->flags |= HIST_FIELD_STRING;
+		hf->size = HIST_KEY_STR_MAX;
+		return 0;
+	}
+
+	if (!hist_field_is_numeric(field))
+		return -EINVAL;
+
+	hf->size = sizeof(u64);
+	return 0;
+}
+
+static int hist_trigger_create_fields(struct hist_trigger_data *hist_data,
+				      struct ftrace_event_file *file)
+{
+	struct hist_trigger_attrs *attrs = hist_data->attrs;
+	char *fields, *str;
+	int ret;
+
+	fields = attrs->keys_str;
+	while ((str = strsep(&fields, ","))) {
+		struct hist_field *hf = &hist_data->keys[hist_data->n_keys];
+
+		if (hist_data->n_keys == HIST_KEYS_MAX)
+			return -EINVAL;
+
+		ret = hist_field_parse(file, hf, str, true);
+		if (ret)
+			return ret;
+
+		hf->offset = hist_data->key_size;
+		hist_data->key_size += hf->size;
+		hist_data->n_keys++;
+	}
+
+	fields = attrs->vals_str;
+	while (fields && (str = strsep(&fields, ","))) {
+		/* The hitcount is always there */
+		if (!strcmp(str, "hitcount"))
+			continue;
+
+		if (hist_data->n_vals == HIST_VALS_MAX)
+			return -EINVAL;
+
+		ret = hist_field_parse(file, &hist_data->vals[hist_data->n_vals],
+				       str, false);
+		if (ret)
+			return ret;
+
+		hist_data->n_vals++;
+	}
+
+	return 0;
+}
+
+static int hist_trigger_create_sort_keys(struct hist_trigger_data *hist_data)
+{
+	char *fields = hist_data->attrs->sort_key_str;
+	struct hist_sort_key *sk;
+	char *str, *name;
+	unsigned int i;
+
+	/* Default to the hitcount, ascending */
+	if (!fields) {
+		hist_data->sort_keys[0].val = -1;
+		hist_data->n_sort_keys = 1;
+		return 0;
+	}
+
+	while ((str = strsep(&fields, ","))) {
+		if (hist_data->n_sort_keys == HIST_SORT_KEYS_MAX)
+			return -EINVAL;
+
+		sk = &hist_data->sort_keys[hist_data->n_sort_keys];
+		name = strsep(&str, ".");
+		if (str) {
+			if (!strcmp(str, "descending"))
+				sk->descending = true;
+			else if (strcmp(str, "ascending"))
+				return -EINVAL;
+		}
+
+		sk->val = -2;
+		if (!strcmp(name, "hitcount"))
+			sk->val = -1;
+		for (i = 0; sk->val == -2 && i < hist_data->n_vals; i++)
+			if (!strcmp(name, hist_data->vals[i].field->name))
+				sk->val = i;
+		for (i = 0; sk->val == -2 && i < hist_data->n_keys; i++) {
+			if (!strcmp(name, hist_data->keys[i].field->name)) {
+				sk->key = &hist_data->keys[i];
+				sk->val = 0;
+			}
+		}
+		if (sk->val == -2)
+			return -EINVAL;
+
+		hist_data->n_sort_keys++;
+	}
+
+	return 0;
+}
+
+static void destroy_hist_data(struct hist_trigger_data *hist_data)
+{
+	if (!hist_data)
+		return;
+
+	hist_map_destroy(hist_data->map);
+	hist_trigger_attrs_free(hist_data->attrs);
+	kfree(hist_data);
+}
+
+static struct hist_trigger_data *
+create_hist_data(struct hist_trigger_attrs *attrs,
+		 struct ftrace_event_file *file)
+{
+	struct hist_trigger_data *hist_data;
+	bool save_comm = false;
+	unsigned int i;
+	int ret;
+
+	hist_data = kzalloc(sizeof(*hist_data), GFP_KERNEL);
+	if (!hist_data)
+		return ERR_PTR(-ENOMEM);
+
+	hist_data->attrs = attrs;
+
+	ret = hist_trigger_create_fields(hist_data, file);
+	if (ret)
+		goto free;
+
+	ret = hist_trigger_create_sort_keys(hist_data);
+	if (ret)
+		goto free;
+
+	for (i = 0; i < hist_data->n_keys; i++)
+		if (hist_data->keys[i].flags & HIST_FIELD_EXECNAME)
+			save_comm = true;
+
+	ret = -ENOMEM;
+	hist_data->map = hist_map_create(attrs->map_bits, hist_data->key_size,
+					 save_comm);
+	if (!hist_data->map)
+		goto free;
+
+	return hist_data;
+ free:
+	/* The caller frees the attrs on failure */
+	hist_data->attrs = NULL;
+	destroy_hist_data(hist_data);
+	return ERR_PTR(ret);
+}
+
+static void event_hist_trigger_free(struct event_trigger_ops *ops,
+				    struct event_trigger_data *data)
+{
+	if (WARN_ON_ONCE(data->ref <= 0))
+		return;
+
+	data->ref--;
+	if (data->ref)
+		return;
+
+	set_trigger_filter(NULL, data, NULL);
+	synchronize_sched(); /* make sure current triggers exit before free */
+	destroy_hist_data(data->private_data);
+	kfree(data);
+}
+
+static struct event_trigger_ops event_hist_trigger_ops = {
+	.func			= event_hist_trigger,
+	.print			= event_hist_trigger_print,
+	.init			= event_trigger_init,
+	.free			= event_hist_trigger_free,
+};
+
+static struct event_trigger_ops *event_hist_get_trigger_ops(char *cmd,
+							    char *param)
+{
+	return &event_hist_trigger_ops;
+}
+
+static void hist_clear(struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	bool paused = data->paused;
+
+	data->paused = true;
+	synchronize_sched();
+	hist_map_clear(hist_data->map);
+	data->paused = paused;
+}
+
+/*
+ * There is one hist trigger per event. Writing one with :pause, :cont
+ * or :clear when it already exists acts on the existing one instead.
+ */
+static int hist_register_trigger(char *glob, struct event_trigger_ops *ops,
+				 struct event_trigger_data *data,
+				 struct ftrace_event_file *file)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	struct hist_trigger_attrs *attrs = hist_data->attrs;
+	struct event_trigger_data *test;
+	int ret = 0;
+
+	list_for_each_entry_rcu(test, &file->triggers, list) {
+		if (test->cmd_ops->trigger_type != ETT_EVENT_HIST)
+			continue;
+
+		if (attrs->pause)
+			test->paused = true;
+		else if (attrs->cont)
+			test->paused = false;
+		else if (attrs->clear)
+			hist_clear(test);
+		else
+			ret = -EEXIST;
+		goto out;
+	}
+
+	if (attrs->pause)
+		data->paused = true;
+
+	if (data->ops->init) {
+		ret = data->ops->init(data->ops, data);
+		if (ret < 0)
+			goto out;
+	}
+
+	list_add_rcu(&data->list, &file->triggers);
+	ret++;
+
+	/* The trigger needs the record before it can be enabled */
+	update_cond_flag(file);
+	if (trace_event_trigger_enable_disable(file, 1) < 0) {
+		list_del_rcu(&data->list);
+		update_cond_flag(file);
+		ret--;
+	}
+ out:
+	return ret;
+}
+
+static int event_hist_trigger_func(struct event_command *cmd_ops,
+				   struct ftrace_event_file *file,
+				   char *glob, char *cmd, char *param)
+{
+	struct hist_trigger_attrs *attrs;
+	struct event_trigger_ops *trigger_ops;
+	struct hist_trigger_data *hist_data;
+	struct event_trigger_data *trigger_data;
+	char *trigger;
+	int ret;
+
+	if (!param)
+		return -EINVAL;
+
+	/* separate the trigger from the filter (k:v [if filter]) */
+	trigger = strsep(&param, " \t");
+	if (!trigger)
+		return -EINVAL;
+	if (param) {
+		param = skip_spaces(param);
+		if (!*param)
+			param = NULL;
+	}
+
+	trigger_ops = cmd_ops->get_trigger_ops(cmd, trigger);
+
+	trigger_data = kzalloc(sizeof(*trigger_data), GFP_KERNEL);
+	if (!trigger_data)
+		return -ENOMEM;
+
+	trigger_data->count = -1;
+	trigger_data->ops = trigger_ops;
+	trigger_data->cmd_ops = cmd_ops;
+	INIT_LIST_HEAD(&trigger_data->list);
+
+	if (glob[0] == '!') {
+		cmd_ops->unreg(glob + 1, trigger_ops, trigger_data, file);
+		kfree(trigger_data);
+		return 0;
+	}
+
+	attrs = hist_trigger_attrs_parse(trigger);
+	if (IS_ERR(attrs)) {
+		kfree(trigger_data);
+		return PTR_ERR(attrs);
+	}
+
+	hist_data = create_hist_data(attrs, file);
+	if (IS_ERR(hist_data)) {
+		hist_trigger_attrs_free(attrs);
+		kfree(trigger_data);
+		return PTR_ERR(hist_data);
+	}
+	trigger_data->private_data = hist_data;
+
+	/* Up the trigger_data count to make sure reg doesn't free it */
+	event_trigger_init(trigger_ops, trigger_data);
+
+	if (param) {
+		ret = cmd_ops->set_filter(param, trigger_data, file);
+		if (ret < 0)
+			goto out_free;
+	}
+
+	ret = cmd_ops->reg(glob, trigger_ops, trigger_data, file);
+	if (ret > 0)
+		ret = 0;
+ out_free:
+	/* Down the counter of trigger_data or free it if not used */
+	event_hist_trigger_free(trigger_ops, trigger_data);
+	return ret;
+}
+
+static struct event_command trigger_hist_cmd = {
+	.name			= "hist",
+	.trigger_type		= ETT_EVENT_HIST,
+	.needs_rec		= true,
+	.func			= event_hist_trigger_func,
+	.reg			= hist_register_trigger,
+	.unreg			= unregister_trigger,
+	.get_trigger_ops	= event_hist_get_trigger_ops,
+	.set_filter		= set_trigger_filter,
+};
+
+__init int register_trigger_hist_cmd(void)
+{
+	int ret;
+
+	ret = register_event_command(&trigger_hist_cmd);
+	WARN_ON(ret < 0);
+
+	return ret;
+}
+
+static u64 hist_key_u64(struct hist_sort_entry *e, struct hist_field *hf)
+{
+	u64 val;
+
+	memcpy(&val, e->elt->key + hf->offset, sizeof(val));
+	return val;
+}
+
+static int cmp_hist_keys(const void *a, const void *b)
+{
+	const struct hist_sort_entry *ea = a, *eb = b;
+
+	return memcmp(ea->elt->key, eb->elt->key, ea->hist_data->key_size);
+}
+
+static int cmp_hist_sort_key(struct hist_sort_entry *ea,
+			     struct hist_sort_entry *eb,
+			     struct hist_sort_key *sk)
+{
+	struct hist_field *hf = sk->key;
+	u64 va, vb;
+
+	if (hf && (hf->flags & HIST_FIELD_STRING))
+		return strncmp(ea->elt->key + hf->offset,
+			       eb->elt->key + hf->offset, hf->size);
+
+	if (hf) {
+		va = hist_key_u64(ea, hf);
+		vb = hist_key_u64(eb, hf);
+		if (hf->field->is_signed && !(hf->flags & HIST_FIELD_LOG2))
+			return (s64)va < (s64)vb ? -1 : (s64)va > (s64)vb;
+	} else if (sk->val < 0) {
+		va = ea->hitcount;
+		vb = eb->hitcount;
+	} else {
+		va = ea->sums[sk->val];
+		vb = eb->sums[sk->val];
+	}
+
+	return va < vb ? -1 : va > vb;
+}
+
+static int cmp_hist_entries(const void *a, const void *b)
+{
+	struct hist_sort_entry *ea = (void *)a, *eb = (void *)b;
+	struct hist_trigger_data *hist_data = ea->hist_data;
+	struct hist_sort_key *sk;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < hist_data->n_sort_keys; i++) {
+		sk = &hist_data->sort_keys[i];
+		ret = cmp_hist_sort_key(ea, eb, sk);
+		if (ret)
+			return sk->descending ? -ret : ret;
+	}
+
+	return cmp_hist_keys(a, b);
+}
+
+/*
+ * Snapshot the published elements of the map, merge the ones a race
+ * left with the same key, and sort them. Returns the number of entries.
+ */
+static int hist_sort_entries(struct hist_trigger_data *hist_data,
+			     struct hist_sort_entry **entriesp)
+{
+	struct hist_map *map = hist_data->map;
+	struct hist_sort_entry *entries, *e;
+	struct hist_elt *elt;
+	unsigned int i, j, k, n = 0, nr;
+
+	nr = min_t(unsigned int, atomic_read(&map->next_elt), map->max_elts);
+	if (!nr)
+		return 0;
+
+	entries = vmalloc(nr * sizeof(*entries));
+	if (!entries)
+		return -ENOMEM;
+
+	for (i = 0; i < map->nr_entries && n < nr; i++) {
+		elt = ACCESS_ONCE(map->entries[i].elt);
+		if (!elt)
+			continue;
+		smp_rmb();
+
+		e = &entries[n++];
+		e->hist_data = hist_data;
+		e->elt = elt;
+		e->hitcount = atomic64_read(&elt->hitcount);
+		for (j = 0; j < hist_data->n_vals; j++)
+			e->sums[j] = atomic64_read(&elt->sums[j]);
+	}
+
+	sort(entries, n, sizeof(*entries), cmp_hist_keys, NULL);
+	for (i = 1, j = 0; i < n; i++) {
+		if (cmp_hist_keys(&entries[j], &entries[i])) {
+			entries[++j] = entries[i];
+			continue;
+		}
+		entries[j].hitcount += entries[i].hitcount;
+		for (k = 0; k < hist_data->n_vals; k++)
+			entries[j].sums[k] += entries[i].sums[k];
+	}
+	if (n)
+		n = j + 1;
+
+	sort(entries, n, sizeof(*entries), cmp_hist_entries, NULL);
+
+	*entriesp = entries;
+	return n;
+}
+
+static void hist_print_key(struct seq_file *m, struct hist_sort_entry *e,
+			   struct hist_field *hf)
+{
+	const char *name = hf->field->name;
+	u64 val;
+
+	if (hf->flags & HIST_FIELD_STRING) {
+		seq_printf(m, "%s: %-50s", name, (char *)e->elt->key + hf->offset);
+		return;
+	}
+
+	val = hist_key_u64(e, hf);
+	if (hf->flags & HIST_FIELD_HEX)
+		seq_printf(m, "%s: %llx", name, val);
+	else if (hf->flags & HIST_FIELD_SYM)
+		seq_printf(m, "%s: [%llx] %-45pS", name, val,
+			   (void *)(unsigned long)val);
+	else if (hf->flags & HIST_FIELD_EXECNAME)
+		seq_printf(m, "%s: %-16s[%10llu]", name, e->elt->comm, val);
+	else if (hf->flags & HIST_FIELD_LOG2)
+		seq_printf(m, "%s: ~ 2^%-2llu", name, val);
+	else if (hf->field->is_signed)
+		seq_printf(m, "%s: %10lld", name, (s64)val);
+	else
+		seq_printf(m, "%s: %10llu", name, val);
+}
+
+static void hist_trigger_show(struct seq_file *m,
+			      struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	struct hist_map *map = hist_data->map;
+	struct hist_sort_entry *entries = NULL, *e;
+	int i, j, n;
+
+	seq_puts(m, "# event histogram\n#\n# trigger info: ");
+	data->ops->print(m, data->ops, data);
+	seq_puts(m, "#\n\n");
+
+	n = hist_sort_entries(hist_data, &entries);
+	if (n < 0) {
+		seq_printf(m, "# unable to sort entries: %d\n", n);
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		e = &entries[i];
+
+		seq_puts(m, "{ ");
+		for (j = 0; j < hist_data->n_keys; j++) {
+			if (j)
+				seq_puts(m, ", ");
+			hist_print_key(m, e, &hist_data->keys[j]);
+		}
+		seq_printf(m, " } hitcount: %10llu", e->hitcount);
+
+		for (j = 0; j < hist_data->n_vals; j++) {
+			if (hist_data->vals[j].field->is_signed)
+				seq_printf(m, "  %s: %10lld",
+					   hist_data->vals[j].field->name,
+					   (s64)e->sums[j]);
+			else
+				seq_printf(m, "  %s: %10llu",
+					   hist_data->vals[j].field->name,
+					   e->sums[j]);
+		}
+		seq_putc(m, '\n');
+	}
+	vfree(entries);
+
+	seq_printf(m, "\nTotals:\n    Hits: %llu\n    Entries: %d\n"
+		   "    Dropped: %llu\n",
+		   (u64)atomic64_read(&map->hits), n,
+		   (u64)atomic64_read(&map->drops));
+}
+
+static int hist_show(struct seq_file *m, void *v)
+{
+	struct event_trigger_data *data;
+	struct ftrace_event_file *event_file;
+	int ret = 0;
+
+	mutex_lock(&event_mutex);
+
+	event_file = event_file_data(m->private);
+	if (unlikely(!event_file)) {
+		ret = -ENODEV;
+		goto out_unlock;
+	}
+
+	list_for_each_entry_rcu(data, &event_file->triggers, list) {
+		if (data->cmd_ops->trigger_type == ETT_EVENT_HIST)
+			hist_trigger_show(m, data);
+	}
+
+ out_unlock:
+	mutex_unlock(&event_mutex);
+
+	return ret;
+}
+
+static int event_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hist_show, file);
+}
+
+const struct file_operations event_hist_fops = {
+	.open = event_hist_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
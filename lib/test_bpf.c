@@ -0,0 +1,780 @@
+/*
+ * Testsuite for the eBPF interpreter and JIT compilers
+ *
+ * Every vector is run through the runtime picked by
+ * bpf_prog_select_runtime(), that is the JIT when
+ * net.core.bpf_jit_enable is set and the interpreter otherwise. Loading
+ * the module in both modes (tools/testing/selftests/net/test_bpf.sh does
+ * that) checks both runtimes against the same expected results and
+ * prints the cost of one run of every vector in either mode.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/filter.h>
+#include <linux/bpf.h>
+#include <linux/skbuff.h>
+#include <linux/netdevice.h>
+#include <linux/if_ether.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+
+/* Short aliases, vectors read better with them */
+#define R0	BPF_REG_0
+#define R1	BPF_REG_1
+#define R2	BPF_REG_2
+#define R3	BPF_REG_3
+#define R4	BPF_REG_4
+#define R5	BPF_REG_5
+#define R6	BPF_REG_6
+#define R7	BPF_REG_7
+#define R8	BPF_REG_8
+#define R9	BPF_REG_9
+#define R10	BPF_REG_10
+
+#define MAX_INSNS	64
+#define MAX_DATA	16
+
+static unsigned int runs = 1000;
+module_param(runs, uint, 0444);
+MODULE_PARM_DESC(runs, "number of runs of every vector used for timing");
+
+struct bpf_test {
+	const char *descr;
+	struct bpf_insn insns[MAX_INSNS];
+	u32 result;
+};
+
+/* Packet the programs run on, LD_ABS/LD_IND read from it */
+static const u8 test_data[MAX_DATA] = {
+	0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+	0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10,
+};
+
+static struct bpf_test tests[] = {
+	{
+		"ALU_MOV_X: dst = 2",
+		.insns = {
+			BPF_MOV32_IMM(R1, 2),
+			BPF_MOV32_REG(R0, R1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 2,
+	},
+	{
+		"ALU_MOV_K: upper half is cleared",
+		.insns = {
+			BPF_LD_IMM64(R2, 0x00000000ffffffffLL),
+			BPF_MOV32_IMM(R1, -1),
+			BPF_JMP_REG(BPF_JEQ, R1, R2, 2),
+			BPF_MOV32_IMM(R0, 2),
+			BPF_EXIT_INSN(),
+			BPF_MOV32_IMM(R0, 1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 1,
+	},
+	{
+		"ALU64_MOV_K: immediate is sign extended",
+		.insns = {
+			BPF_LD_IMM64(R2, 0xffffffffffffffffLL),
+			BPF_MOV64_IMM(R1, -1),
+			BPF_JMP_REG(BPF_JEQ, R1, R2, 2),
+			BPF_MOV32_IMM(R0, 2),
+			BPF_EXIT_INSN(),
+			BPF_MOV32_IMM(R0, 1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 1,
+	},
+	{
+		"ALU64_ADD_K: 12 bit immediate",
+		.insns = {
+			BPF_MOV64_IMM(R0, 0x7ffffffe),
+			BPF_ALU64_IMM(BPF_ADD, R0, 1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0x7fffffff,
+	},
+	{
+		"ALU64_ADD_K: wide immediate",
+		.insns = {
+			BPF_MOV64_IMM(R0, 1),
+			BPF_ALU64_IMM(BPF_ADD, R0, 0x12345),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0x12346,
+	},
+	{
+		"ALU64_SUB_K: negative immediates",
+		.insns = {
+			BPF_MOV64_IMM(R0, 10),
+			BPF_ALU64_IMM(BPF_SUB, R0, -5),
+			BPF_ALU64_IMM(BPF_ADD, R0, -3),
+			BPF_EXIT_INSN(),
+		},
+		.result = 12,
+	},
+	{
+		"ALU_SUB_K: 32 bit wrap around",
+		.insns = {
+			BPF_MOV32_IMM(R0, 1),
+			BPF_ALU32_IMM(BPF_SUB, R0, 2),
+			BPF_ALU64_IMM(BPF_RSH, R0, 16),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0xffff,
+	},
+	{
+		"ALU_ADD_K: negative 12 bit immediate",
+		.insns = {
+			BPF_MOV32_IMM(R0, 1),
+			BPF_ALU32_IMM(BPF_ADD, R0, -2),
+			BPF_ALU64_IMM(BPF_RSH, R0, 8),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0x00ffffff,
+	},
+	{
+		"ALU64_MUL_X: 3 * 7 = 21",
+		.insns = {
+			BPF_MOV64_IMM(R0, 3),
+			BPF_MOV64_IMM(R1, 7),
+			BPF_ALU64_REG(BPF_MUL, R0, R1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 21,
+	},
+	{
+		"ALU64_DIV_X: 64 bit dividend",
+		.insns = {
+			BPF_LD_IMM64(R0, 0x10000000000LL),
+			BPF_MOV64_IMM(R1, 256),
+			BPF_ALU64_REG(BPF_DIV, R0, R1),
+			BPF_ALU64_IMM(BPF_RSH, R0, 16),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0x10000,
+	},
+	{
+		"ALU_DIV_X: division by zero returns 0",
+		.insns = {
+			BPF_MOV32_IMM(R0, 5),
+			BPF_MOV32_IMM(R1, 0),
+			BPF_ALU32_REG(BPF_DIV, R0, R1),
+			BPF_MOV32_IMM(R0, 1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0,
+	},
+	{
+		"ALU64_MOD_X: modulo by zero returns 0",
+		.insns = {
+			BPF_MOV64_IMM(R0, 5),
+			BPF_MOV64_IMM(R1, 0),
+			BPF_ALU64_REG(BPF_MOD, R0, R1),
+			BPF_MOV64_IMM(R0, 1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0,
+	},
+	{
+		"ALU_DIV_X: upper half of the divisor is ignored",
+		.insns = {
+			BPF_LD_IMM64(R1, 0x100000002LL),
+			BPF_MOV32_IMM(R0, 9),
+			BPF_ALU32_REG(BPF_DIV, R0, R1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 4,
+	},
+	{
+		"ALU_MOD_K: 100 % 7 = 2",
+		.insns = {
+			BPF_MOV32_IMM(R0, 100),
+			BPF_ALU32_IMM(BPF_MOD, R0, 7),
+			BPF_EXIT_INSN(),
+		},
+		.result = 2,
+	},
+	{
+		"ALU64_MOD_X: 100 % 9 = 1",
+		.insns = {
+			BPF_MOV64_IMM(R0, 100),
+			BPF_MOV64_IMM(R1, 9),
+			BPF_ALU64_REG(BPF_MOD, R0, R1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 1,
+	},
+	{
+		"ALU64_ARSH_K: -16 >> 2 = -4",
+		.insns = {
+			BPF_MOV64_IMM(R0, -16),
+			BPF_ALU64_IMM(BPF_ARSH, R0, 2),
+			BPF_EXIT_INSN(),
+		},
+		.result = -4,
+	},
+	{
+		"ALU64_ARSH_X: -16 >> 2 = -4",
+		.insns = {
+			BPF_MOV64_IMM(R0, -16),
+			BPF_MOV64_IMM(R1, 2),
+			BPF_ALU64_REG(BPF_ARSH, R0, R1),
+			BPF_EXIT_INSN(),
+		},
+		.result = -4,
+	},
+	{
+		"ALU_LSH_X: 32 bit result",
+		.insns = {
+			BPF_MOV32_IMM(R0, -2147483647),
+			BPF_MOV32_IMM(R1, 1),
+			BPF_ALU32_REG(BPF_LSH, R0, R1),
+			BPF_ALU64_IMM(BPF_RSH, R0, 1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 1,
+	},
+	{
+		"ALU64_AND_K/OR_K/XOR_K",
+		.insns = {
+			BPF_MOV64_IMM(R0, 0xff00),
+			BPF_ALU64_IMM(BPF_AND, R0, 0x0ff0),
+			BPF_ALU64_IMM(BPF_OR, R0, 0x000f),
+			BPF_ALU64_IMM(BPF_XOR, R0, 0x0101),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0x0e0e,
+	},
+	{
+		"ALU_NEG: 32 bit result",
+		.insns = {
+			BPF_MOV64_IMM(R0, 3),
+			BPF_ALU32_IMM(BPF_NEG, R0, 0),
+			BPF_ALU64_IMM(BPF_RSH, R0, 4),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0x0fffffff,
+	},
+	{
+		"ALU_END_FROM_BE 16",
+		.insns = {
+			BPF_LD_IMM64(R0, 0x0123456789abcdefLL),
+			BPF_ENDIAN(BPF_FROM_BE, R0, 16),
+			BPF_EXIT_INSN(),
+		},
+		.result = cpu_to_be16(0xcdef),
+	},
+	{
+		"ALU_END_FROM_BE 16: upper bits are cleared",
+		.insns = {
+			BPF_LD_IMM64(R0, 0x0123456789abcdefLL),
+			BPF_ENDIAN(BPF_FROM_BE, R0, 16),
+			BPF_ALU64_IMM(BPF_RSH, R0, 16),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0,
+	},
+	{
+		"ALU_END_FROM_BE 32",
+		.insns = {
+			BPF_LD_IMM64(R0, 0x0123456789abcdefLL),
+			BPF_ENDIAN(BPF_FROM_BE, R0, 32),
+			BPF_EXIT_INSN(),
+		},
+		.result = cpu_to_be32(0x89abcdef),
+	},
+	{
+		"ALU_END_FROM_BE 64",
+		.insns = {
+			BPF_LD_IMM64(R0, 0x0123456789abcdefLL),
+			BPF_ENDIAN(BPF_FROM_BE, R0, 64),
+			BPF_EXIT_INSN(),
+		},
+		.result = (u32) cpu_to_be64(0x0123456789abcdefLL),
+	},
+	{
+		"ALU_END_FROM_LE 16",
+		.insns = {
+			BPF_LD_IMM64(R0, 0x0123456789abcdefLL),
+			BPF_ENDIAN(BPF_FROM_LE, R0, 16),
+			BPF_EXIT_INSN(),
+		},
+		.result = cpu_to_le16(0xcdef),
+	},
+	{
+		"ALU_END_FROM_LE 32: upper half is cleared",
+		.insns = {
+			BPF_LD_IMM64(R0, 0x0123456789abcdefLL),
+			BPF_ENDIAN(BPF_FROM_LE, R0, 32),
+			BPF_ALU64_IMM(BPF_RSH, R0, 32),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0,
+	},
+	{
+		"ST_MEM_DW: immediate is sign extended",
+		.insns = {
+			BPF_ST_MEM(BPF_DW, R10, -8, -1),
+			BPF_LDX_MEM(BPF_DW, R0, R10, -8),
+			BPF_ALU64_IMM(BPF_RSH, R0, 32),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0xffffffff,
+	},
+	{
+		"ST_MEM_W: bottom of the stack",
+		.insns = {
+			BPF_ST_MEM(BPF_W, R10, -512, 0x12345678),
+			BPF_LDX_MEM(BPF_W, R0, R10, -512),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0x12345678,
+	},
+	{
+		"ST_MEM_H",
+		.insns = {
+			BPF_ST_MEM(BPF_H, R10, -6, 0xabcd),
+			BPF_LDX_MEM(BPF_H, R0, R10, -6),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0xabcd,
+	},
+	{
+		"ST_MEM_B",
+		.insns = {
+			BPF_ST_MEM(BPF_B, R10, -1, 0x5a),
+			BPF_LDX_MEM(BPF_B, R0, R10, -1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0x5a,
+	},
+	{
+		"STX_XADD_W: 0x12 + 0x22 = 0x34",
+		.insns = {
+			BPF_ST_MEM(BPF_W, R10, -4, 0x12),
+			BPF_MOV32_IMM(R0, 0x22),
+			BPF_STX_XADD(BPF_W, R10, R0, -4),
+			BPF_LDX_MEM(BPF_W, R0, R10, -4),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0x34,
+	},
+	{
+		"STX_XADD_DW: carry into the upper half",
+		.insns = {
+			BPF_LD_IMM64(R1, 0xffffffffLL),
+			BPF_STX_MEM(BPF_DW, R10, R1, -8),
+			BPF_MOV64_IMM(R0, 1),
+			BPF_STX_XADD(BPF_DW, R10, R0, -8),
+			BPF_LDX_MEM(BPF_DW, R0, R10, -8),
+			BPF_ALU64_IMM(BPF_RSH, R0, 32),
+			BPF_EXIT_INSN(),
+		},
+		.result = 1,
+	},
+	{
+		"JMP_JSGT_K: signed compare",
+		.insns = {
+			BPF_MOV64_IMM(R0, 0),
+			BPF_MOV64_IMM(R1, -1),
+			BPF_JMP_IMM(BPF_JSGT, R1, -2, 1),
+			BPF_EXIT_INSN(),
+			BPF_MOV64_IMM(R0, 1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 1,
+	},
+	{
+		"JMP_JGT_K: unsigned compare",
+		.insns = {
+			BPF_MOV64_IMM(R0, 0),
+			BPF_MOV64_IMM(R1, -1),
+			BPF_JMP_IMM(BPF_JGT, R1, 1, 1),
+			BPF_EXIT_INSN(),
+			BPF_MOV64_IMM(R0, 1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 1,
+	},
+	{
+		"JMP_JSET_X",
+		.insns = {
+			BPF_MOV64_IMM(R0, 0),
+			BPF_MOV64_IMM(R1, 0x10),
+			BPF_MOV64_IMM(R2, 0x30),
+			BPF_JMP_REG(BPF_JSET, R1, R2, 1),
+			BPF_EXIT_INSN(),
+			BPF_MOV64_IMM(R0, 1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 1,
+	},
+	{
+		"JMP_JNE_K: backward loop, 10 + 9 + ... + 1",
+		.insns = {
+			BPF_MOV64_IMM(R0, 0),
+			BPF_MOV64_IMM(R1, 10),
+			BPF_ALU64_REG(BPF_ADD, R0, R1),
+			BPF_ALU64_IMM(BPF_SUB, R1, 1),
+			BPF_JMP_IMM(BPF_JNE, R1, 0, -3),
+			BPF_EXIT_INSN(),
+		},
+		.result = 55,
+	},
+	{
+		"CALL: R6-R9 survive a helper call",
+		.insns = {
+			BPF_MOV64_IMM(R6, 40),
+			BPF_MOV64_IMM(R9, 2),
+			BPF_MOV64_IMM(R0, 7),
+			/* __bpf_call_base() returns 0 */
+			BPF_RAW_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, 0),
+			BPF_ALU64_REG(BPF_ADD, R0, R6),
+			BPF_ALU64_REG(BPF_ADD, R0, R9),
+			BPF_EXIT_INSN(),
+		},
+		.result = 42,
+	},
+	{
+		"LD_ABS_W",
+		.insns = {
+			BPF_MOV64_REG(R6, R1),
+			BPF_LD_ABS(BPF_W, 0),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0x01020304,
+	},
+	{
+		"LD_ABS_H",
+		.insns = {
+			BPF_MOV64_REG(R6, R1),
+			BPF_LD_ABS(BPF_H, 2),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0x0304,
+	},
+	{
+		"LD_ABS_B",
+		.insns = {
+			BPF_MOV64_REG(R6, R1),
+			BPF_LD_ABS(BPF_B, 5),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0x06,
+	},
+	{
+		"LD_IND_H",
+		.insns = {
+			BPF_MOV64_REG(R6, R1),
+			BPF_MOV64_IMM(R2, 1),
+			BPF_LD_IND(BPF_H, R2, 1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0x0304,
+	},
+	{
+		"LD_ABS_W: out of bounds load returns 0",
+		.insns = {
+			BPF_MOV64_REG(R6, R1),
+			BPF_LD_ABS(BPF_W, 100),
+			BPF_MOV64_IMM(R0, 1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 0,
+	},
+};
+
+/* Tail call vectors all share one program array, TAIL_CALL(index) jumps
+ * to the vector at that index. The slot behind the last vector is left
+ * empty.
+ */
+#define TAIL_CALL_MARKER	0x7a11ca11
+#define TAIL_CALL_NULL		ARRAY_SIZE(tail_call_tests)
+
+#define TAIL_CALL(index)					\
+	BPF_MOV64_IMM(R3, index),				\
+	BPF_LD_IMM64(R2, TAIL_CALL_MARKER),			\
+	BPF_RAW_INSN(BPF_JMP | BPF_CALL | BPF_X, 0, 0, 0, 0)
+
+static struct bpf_test tail_call_tests[] = {
+	{
+		"Tail call leaf",
+		.insns = {
+			BPF_MOV64_IMM(R0, 1),
+			BPF_ALU64_IMM(BPF_ADD, R0, 2),
+			BPF_EXIT_INSN(),
+		},
+		.result = 3,
+	},
+	{
+		"Tail call 2",
+		.insns = {
+			TAIL_CALL(0),
+			BPF_MOV64_IMM(R0, -1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 3,
+	},
+	{
+		"Tail call 3",
+		.insns = {
+			BPF_ST_MEM(BPF_DW, R10, -8, 5),
+			TAIL_CALL(1),
+			BPF_MOV64_IMM(R0, -1),
+			BPF_EXIT_INSN(),
+		},
+		.result = 3,
+	},
+	{
+		"Tail call error path, max count reached",
+		.insns = {
+			TAIL_CALL(3),
+			BPF_MOV64_IMM(R0, 7),
+			BPF_EXIT_INSN(),
+		},
+		.result = 7,
+	},
+	{
+		"Tail call error path, index out of range",
+		.insns = {
+			TAIL_CALL(-1),
+			BPF_MOV64_IMM(R0, 5),
+			BPF_EXIT_INSN(),
+		},
+		.result = 5,
+	},
+	{
+		"Tail call error path, NULL target",
+		.insns = {
+			TAIL_CALL(5),
+			BPF_MOV64_IMM(R0, 6),
+			BPF_EXIT_INSN(),
+		},
+		.result = 6,
+	},
+};
+
+static int probe_filter_length(const struct bpf_insn *fp)
+{
+	int len;
+
+	for (len = MAX_INSNS - 1; len > 0; --len)
+		if (fp[len].code != 0 || fp[len].imm != 0)
+			break;
+
+	return len + 1;
+}
+
+static struct sk_buff *populate_skb(void)
+{
+	struct sk_buff *skb;
+
+	skb = alloc_skb(MAX_DATA, GFP_KERNEL);
+	if (!skb)
+		return NULL;
+
+	memcpy(skb_put(skb, MAX_DATA), test_data, MAX_DATA);
+	skb_reset_mac_header(skb);
+	skb_reset_network_header(skb);
+	skb->protocol = htons(ETH_P_IP);
+	skb->dev = init_net.loopback_dev;
+
+	return skb;
+}
+
+/* Patch the program array address into the TAIL_CALL() sequences */
+static void fixup_tail_calls(struct bpf_insn *insns, struct bpf_array *array)
+{
+	int i, len = probe_filter_length(insns);
+
+	for (i = 0; i < len - 1; i++) {
+		struct bpf_insn *insn = &insns[i];
+
+		if (insn->code != (BPF_LD | BPF_IMM | BPF_DW) ||
+		    insn->imm != TAIL_CALL_MARKER)
+			continue;
+
+		insn[0].imm = (u32)(unsigned long) array;
+		insn[1].imm = (u64)(unsigned long) array >> 32;
+		i++;
+	}
+}
+
+static struct bpf_prog *generate_filter(const struct bpf_insn *insns)
+{
+	unsigned int flen = probe_filter_length(insns);
+	struct bpf_prog *fp;
+
+	fp = bpf_prog_alloc(bpf_prog_size(flen), 0);
+	if (!fp)
+		return NULL;
+
+	fp->len = flen;
+	memcpy(fp->insnsi, insns, flen * sizeof(struct bpf_insn));
+
+	/* JIT when net.core.bpf_jit_enable is set, interpreter otherwise */
+	bpf_prog_select_runtime(fp);
+
+	return fp;
+}
+
+static u32 run_one(const struct bpf_prog *fp, struct sk_buff *skb, u64 *ns)
+{
+	u64 start, finish;
+	u32 ret = 0;
+	int i;
+
+	rcu_read_lock();
+	preempt_disable();
+	start = ktime_get_ns();
+	for (i = 0; i < runs; i++)
+		ret = BPF_PROG_RUN(fp, skb);
+	finish = ktime_get_ns();
+	preempt_enable();
+	rcu_read_unlock();
+
+	*ns = div_u64(finish - start, runs);
+	return ret;
+}
+
+static int check_one(int nr, const struct bpf_test *test,
+		     const struct bpf_prog *fp, struct sk_buff *skb)
+{
+	u64 ns;
+	u32 ret;
+
+	ret = run_one(fp, skb, &ns);
+	if (ret != test->result) {
+		pr_info("#%d %s jited:%u ret %u != %u FAIL\n", nr,
+			test->descr, fp->jited, ret, test->result);
+		return -EINVAL;
+	}
+
+	pr_info("#%d %s jited:%u %llu ns PASS\n", nr, test->descr,
+		fp->jited, ns);
+	return 0;
+}
+
+static int test_bpf(struct sk_buff *skb, int *pass, int *fail, int *jited)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tests); i++) {
+		struct bpf_prog *fp;
+
+		fp = generate_filter(tests[i].insns);
+		if (!fp)
+			return -ENOMEM;
+
+		*jited += fp->jited;
+		if (check_one(i, &tests[i], fp, skb))
+			(*fail)++;
+		else
+			(*pass)++;
+		bpf_prog_free(fp);
+	}
+
+	return 0;
+}
+
+static int test_tail_calls(struct sk_buff *skb, int *pass, int *fail,
+			   int *jited)
+{
+	int i, nr = ARRAY_SIZE(tail_call_tests), nr_jited = 0;
+	struct bpf_array *array;
+	int err = 0;
+
+	array = kzalloc(sizeof(*array) + (nr + 1) * sizeof(void *),
+			GFP_KERNEL);
+	if (!array)
+		return -ENOMEM;
+	array->map.max_entries = nr + 1;
+
+	for (i = 0; i < nr; i++) {
+		struct bpf_prog *fp;
+
+		fixup_tail_calls(tail_call_tests[i].insns, array);
+		fp = generate_filter(tail_call_tests[i].insns);
+		if (!fp) {
+			err = -ENOMEM;
+			goto out;
+		}
+		array->ptrs[i] = fp;
+		nr_jited += fp->jited;
+	}
+
+	/* callers and callees must all run the same way, like the prog_array
+	 * ownership check enforces for programs loaded from user space
+	 */
+	if (nr_jited && nr_jited != nr) {
+		pr_info("tail calls skipped, only %d of %d programs JITed\n",
+			nr_jited, nr);
+		goto out;
+	}
+	*jited += nr_jited;
+
+	for (i = 0; i < nr; i++) {
+		if (check_one(ARRAY_SIZE(tests) + i, &tail_call_tests[i],
+			      array->ptrs[i], skb))
+			(*fail)++;
+		else
+			(*pass)++;
+	}
+out:
+	for (i = 0; i < nr; i++)
+		if (array->ptrs[i])
+			bpf_prog_free(array->ptrs[i]);
+	kfree(array);
+	return err;
+}
+
+static int __init test_bpf_init(void)
+{
+	int pass = 0, fail = 0, jited = 0;
+	struct sk_buff *skb;
+	int err;
+
+	BUILD_BUG_ON(TAIL_CALL_NULL != 6);
+
+	if (!runs)
+		return -EINVAL;
+
+	skb = populate_skb();
+	if (!skb)
+		return -ENOMEM;
+
+	err = test_bpf(skb, &pass, &fail, &jited);
+	if (!err)
+		err = test_tail_calls(skb, &pass, &fail, &jited);
+	kfree_skb(skb);
+	if (err)
+		return err;
+
+	pr_info("Summary: %d PASSED, %d FAILED, [%d/%d JIT'ed]\n",
+		pass, fail, jited, pass + fail);
+
+	return fail ? -EINVAL : 0;
+}
+
+static void __exit test_bpf_exit(void)
+{
+}
+
+module_init(test_bpf_init);
+module_exit(test_bpf_exit);
+
+MODULE_LICENSE("GPL");
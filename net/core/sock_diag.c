@@ -13,6 +13,25 @@ static const struct sock_diag_handler *sock_diag_handlers[AF_MAX];
 static int (*inet_rcv_compat)(struct sk_buff *skb, struct nlmsghdr *nlh);
 static DEFINE_MUTEX(sock_diag_table_mutex);
 
+static atomic64_t cookie_gen;
+
+/* Return a cookie identifying the socket for its whole lifetime. Cookies
+ * are handed out on first use and are never reused, unlike the socket
+ * address that sock_diag_save_cookie() reports.
+ */
+u64 sock_gen_cookie(struct sock *sk)
+{
+	while (1) {
+		u64 res = atomic64_read(&sk->sk_cookie);
+
+		if (res)
+			return res;
+		res = atomic64_inc_return(&cookie_gen);
+		atomic64_cmpxchg(&sk->sk_cookie, 0, res);
+	}
+}
+EXPORT_SYMBOL_GPL(sock_gen_cookie);
+
 int sock_diag_check_cookie(void *sk, __u32 *cookie)
 {
 	if ((cookie[0] != INET_DIAG_NOCOOKIE ||
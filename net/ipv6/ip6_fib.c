@@ -149,15 +149,55 @@ static struct fib6_node *node_alloc(void)
 	return fn;
 }
 
-static void node_free(struct fib6_node *fn)
+static void node_free_immediate(struct fib6_node *fn)
+{
+	kmem_cache_free(fib6_node_kmem, fn);
+}
+
+static void node_free_rcu(struct rcu_head *head)
 {
+	struct fib6_node *fn = container_of(head, struct fib6_node, rcu);
+
 	kmem_cache_free(fib6_node_kmem, fn);
 }
 
+/* Route lookups walk the tree under rcu_read_lock() only, so a node that
+ * was linked into the tree must survive a grace period once unlinked.
+ */
+static void node_free(struct fib6_node *fn)
+{
+	call_rcu(&fn->rcu, node_free_rcu);
+}
+
+static void rt6_free_pcpu(struct rt6_info *rt)
+{
+	int cpu;
+
+	if (!rt->rt6i_pcpu)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct rt6_info **ppcpu_rt = per_cpu_ptr(rt->rt6i_pcpu, cpu);
+		struct rt6_info *pcpu_rt = xchg(ppcpu_rt, NULL);
+
+		if (pcpu_rt)
+			dst_free(&pcpu_rt->dst);
+	}
+}
+
+static void rt6_free_rcu(struct rcu_head *head)
+{
+	struct rt6_info *rt = container_of(head, struct rt6_info, dst.rcu_head);
+
+	/* no lookup can reach rt or its per-CPU copies any more */
+	rt6_free_pcpu(rt);
+	dst_free(&rt->dst);
+}
+
 static void rt6_release(struct rt6_info *rt)
 {
 	if (atomic_dec_and_test(&rt->rt6i_ref))
-		dst_free(&rt->dst);
+		call_rcu(&rt->dst.rcu_head, rt6_free_rcu);
 }
 
 static void fib6_free_table(struct fib6_table *table)
@@ -517,9 +557,9 @@ static struct fib6_node *fib6_add_1(struct fib6_node *root,
 	ln->fn_sernum = sernum;
 
 	if (dir)
-		pn->right = ln;
+		rcu_assign_pointer(pn->right, ln);
 	else
-		pn->left  = ln;
+		rcu_assign_pointer(pn->left, ln);
 
 	return ln;
 
@@ -554,9 +594,9 @@ insert_above:
 
 		if (!in || !ln) {
 			if (in)
-				node_free(in);
+				node_free_immediate(in);
 			if (ln)
-				node_free(ln);
+				node_free_immediate(ln);
 			return ERR_PTR(-ENOMEM);
 		}
 
@@ -576,12 +616,6 @@ insert_above:
 
 		in->fn_sernum = sernum;
 
-		/* update parent pointer */
-		if (dir)
-			pn->right = in;
-		else
-			pn->left  = in;
-
 		ln->fn_bit = plen;
 
 		ln->parent = in;
@@ -596,6 +630,12 @@ insert_above:
 			in->left  = ln;
 			in->right = fn;
 		}
+
+		/* update parent pointer, lookups may follow it right away */
+		if (dir)
+			rcu_assign_pointer(pn->right, in);
+		else
+			rcu_assign_pointer(pn->left, in);
 	} else { /* plen <= bit */
 
 		/*
@@ -615,17 +655,17 @@ insert_above:
 
 		ln->fn_sernum = sernum;
 
-		if (dir)
-			pn->right = ln;
-		else
-			pn->left  = ln;
-
 		if (addr_bit_set(&key->addr, plen))
 			ln->right = fn;
 		else
 			ln->left  = fn;
 
 		fn->parent = ln;
+
+		if (dir)
+			rcu_assign_pointer(pn->right, ln);
+		else
+			rcu_assign_pointer(pn->left, ln);
 	}
 	return ln;
 }
@@ -774,8 +814,8 @@ static int fib6_add_rt2node(struct fib6_node *fn, struct rt6_info *rt,
 		while (sibling) {
 			if (sibling->rt6i_metric == rt->rt6i_metric &&
 			    rt6_qualify_for_ecmp(sibling)) {
-				list_add_tail(&rt->rt6i_siblings,
-					      &sibling->rt6i_siblings);
+				list_add_tail_rcu(&rt->rt6i_siblings,
+						  &sibling->rt6i_siblings);
 				break;
 			}
 			sibling = sibling->dst.rt6_next;
@@ -808,11 +848,13 @@ add:
 				return err;
 		}
 		rt->dst.rt6_next = iter;
-		*ins = rt;
+		rcu_assign_pointer(*ins, rt);
 		rcu_assign_pointer(rt->rt6i_node, fn);
 		atomic_inc(&rt->rt6i_ref);
 		inet6_rt_notify(RTM_NEWROUTE, rt, info);
 		info->nl_net->ipv6.rt6_stats->fib_rt_entries++;
+		if (rt->rt6i_flags & RTF_CACHE)
+			info->nl_net->ipv6.rt6_stats->fib_rt_cache++;
 
 		if (!(fn->fn_flags & RTN_RTINFO)) {
 			info->nl_net->ipv6.rt6_stats->fib_route_nodes++;
@@ -831,9 +873,9 @@ add:
 			if (err)
 				return err;
 		}
-		*ins = rt;
-		rcu_assign_pointer(rt->rt6i_node, fn);
 		rt->dst.rt6_next = iter->dst.rt6_next;
+		rcu_assign_pointer(*ins, rt);
+		rcu_assign_pointer(rt->rt6i_node, fn);
 		atomic_inc(&rt->rt6i_ref);
 		inet6_rt_notify(RTM_NEWROUTE, rt, info);
 		if (!(fn->fn_flags & RTN_RTINFO)) {
@@ -938,14 +980,14 @@ int fib6_add(struct fib6_node *root, struct rt6_info *rt, struct nl_info *info,
 				   root, and then (in failure) stale node
 				   in main tree.
 				 */
-				node_free(sfn);
+				node_free_immediate(sfn);
 				err = PTR_ERR(sn);
 				goto failure;
 			}
 
 			/* Now link new subtree to main tree */
 			sfn->parent = fn;
-			fn->subtree = sfn;
+			rcu_assign_pointer(fn->subtree, sfn);
 		} else {
 			sn = fib6_add_1(fn->subtree, &rt->rt6i_src.addr,
 					rt->rt6i_src.plen,
@@ -1042,7 +1084,8 @@ static struct fib6_node *fib6_lookup_1(struct fib6_node *root,
 
 		dir = addr_bit_set(args->addr, fn->fn_bit);
 
-		next = dir ? fn->right : fn->left;
+		next = dir ? rcu_dereference_raw(fn->right) :
+			     rcu_dereference_raw(fn->left);
 
 		if (next) {
 			fn = next;
@@ -1053,10 +1096,16 @@ static struct fib6_node *fib6_lookup_1(struct fib6_node *root,
 
 	while (fn) {
 		if (FIB6_SUBTREE(fn) || fn->fn_flags & RTN_RTINFO) {
+			struct rt6_info *leaf = rcu_dereference_raw(fn->leaf);
 			struct rt6key *key;
 
-			key = (struct rt6key *) ((u8 *) fn->leaf +
-						 args->offset);
+			/* fn may have lost its last route under a lockless
+			 * lookup, treat it like an intermediate node
+			 */
+			if (!leaf)
+				goto backtrack;
+
+			key = (struct rt6key *) ((u8 *) leaf + args->offset);
 
 			if (ipv6_prefix_equal(&key->addr, args->addr, key->plen)) {
 #ifdef CONFIG_IPV6_SUBTREES
@@ -1073,9 +1122,7 @@ static struct fib6_node *fib6_lookup_1(struct fib6_node *root,
 					return fn;
 			}
 		}
-#ifdef CONFIG_IPV6_SUBTREES
 backtrack:
-#endif
 		if (fn->fn_flags & RTN_ROOT)
 			break;
 
@@ -1317,6 +1364,8 @@ static void fib6_del_route(struct fib6_node *fn, struct rt6_info **rtp,
 	*rtp = rt->dst.rt6_next;
 	rt->rt6i_node = NULL;
 	net->ipv6.rt6_stats->fib_rt_entries--;
+	if (rt->rt6i_flags & RTF_CACHE)
+		net->ipv6.rt6_stats->fib_rt_cache--;
 	net->ipv6.rt6_stats->fib_discarded_routes++;
 
 	/* Reset round-robin state, if necessary */
@@ -1799,6 +1848,11 @@ static void fib6_net_exit(struct net *net)
 	rt6_ifdown(net, NULL);
 	del_timer_sync(&net->ipv6.ip6_fib_timer);
 
+	/* released routes are freed from RCU callbacks, which need the
+	 * dst_ops and peer trees torn down after this
+	 */
+	rcu_barrier();
+
 	for (i = 0; i < FIB6_TABLE_HASHSZ; i++) {
 		struct hlist_head *head = &net->ipv6.fib_table_hash[i];
 		struct hlist_node *tmp;
@@ -1853,6 +1907,7 @@ out_kmem_cache_create:
 void fib6_gc_cleanup(void)
 {
 	unregister_pernet_subsys(&fib6_net_ops);
+	rcu_barrier(); /* wait for node_free_rcu() */
 	kmem_cache_destroy(fib6_node_kmem);
 }
 
@@ -327,6 +327,10 @@ static void ip6_dst_destroy(struct dst_entry *dst)
 	if (!(rt->dst.flags & DST_HOST))
 		dst_destroy_metrics_generic(dst);
 
+	/* the per-CPU copies were freed before, they hold a reference */
+	free_percpu(rt->rt6i_pcpu);
+	rt->rt6i_pcpu = NULL;
+
 	if (idev) {
 		rt->rt6i_idev = NULL;
 		in6_dev_put(idev);
@@ -429,7 +433,7 @@ static struct rt6_info *rt6_multipath_select(struct rt6_info *match,
 }
 
 /*
- *	Route lookup. Any table->tb6_lock is implied.
+ *	Route lookup. Either table->tb6_lock or rcu_read_lock() is implied.
  */
 
 static inline struct rt6_info *rt6_device_match(struct net *net,
@@ -645,7 +649,7 @@ out:
 	return match;
 }
 
-static struct rt6_info *find_rr_leaf(struct fib6_node *fn,
+static struct rt6_info *find_rr_leaf(struct rt6_info *leaf,
 				     struct rt6_info *rr_head,
 				     u32 metric, int oif, int strict,
 				     bool *do_rr)
@@ -655,40 +659,61 @@ static struct rt6_info *find_rr_leaf(struct fib6_node *fn,
 
 	match = NULL;
 	for (rt = rr_head; rt && rt->rt6i_metric == metric;
-	     rt = rt->dst.rt6_next)
+	     rt = rcu_dereference(rt->dst.rt6_next))
 		match = find_match(rt, oif, strict, &mpri, match, do_rr);
-	for (rt = fn->leaf; rt && rt != rr_head && rt->rt6i_metric == metric;
-	     rt = rt->dst.rt6_next)
+	for (rt = leaf; rt && rt != rr_head && rt->rt6i_metric == metric;
+	     rt = rcu_dereference(rt->dst.rt6_next))
 		match = find_match(rt, oif, strict, &mpri, match, do_rr);
 
 	return match;
 }
 
-static struct rt6_info *rt6_select(struct fib6_node *fn, int oif, int strict)
+/* Called under rcu_read_lock(), fn can be changed under our feet */
+static struct rt6_info *rt6_select(struct net *net, struct fib6_table *table,
+				   struct fib6_node *fn, int oif, int strict)
 {
+	struct rt6_info *leaf = rcu_dereference(fn->leaf);
 	struct rt6_info *match, *rt0;
-	struct net *net;
 	bool do_rr = false;
+	int key_plen;
+
+	if (!leaf)
+		return net->ipv6.ip6_null_entry;
 
-	rt0 = fn->rr_ptr;
+	rt0 = rcu_dereference(fn->rr_ptr);
 	if (!rt0)
-		fn->rr_ptr = rt0 = fn->leaf;
+		rt0 = leaf;
+
+	/* fn may have turned into an intermediate node whose leaf is a
+	 * route of one of its children, do not match against that
+	 */
+	key_plen = rt0->rt6i_dst.plen;
+#ifdef CONFIG_IPV6_SUBTREES
+	if (rt0->rt6i_src.plen)
+		key_plen = rt0->rt6i_src.plen;
+#endif
+	if (fn->fn_bit != key_plen)
+		return net->ipv6.ip6_null_entry;
 
-	match = find_rr_leaf(fn, rt0, rt0->rt6i_metric, oif, strict,
+	match = find_rr_leaf(leaf, rt0, rt0->rt6i_metric, oif, strict,
 			     &do_rr);
 
 	if (do_rr) {
-		struct rt6_info *next = rt0->dst.rt6_next;
+		struct rt6_info *next = rcu_dereference(rt0->dst.rt6_next);
 
 		/* no entries matched; do round-robin */
 		if (!next || next->rt6i_metric != rt0->rt6i_metric)
-			next = fn->leaf;
-
-		if (next != rt0)
-			fn->rr_ptr = next;
+			next = leaf;
+
+		if (next != rt0) {
+			write_lock_bh(&table->tb6_lock);
+			/* next must still be in the tree */
+			if (next->rt6i_node)
+				fn->rr_ptr = next;
+			write_unlock_bh(&table->tb6_lock);
+		}
 	}
 
-	net = dev_net(rt0->dst.dev);
 	return match ? match : net->ipv6.ip6_null_entry;
 }
 
@@ -790,17 +815,21 @@ static struct rt6_info *ip6_pol_route_lookup(struct net *net,
 	struct fib6_node *fn;
 	struct rt6_info *rt;
 
-	read_lock_bh(&table->tb6_lock);
+	rcu_read_lock();
 	fn = fib6_lookup(&table->tb6_root, &fl6->daddr, &fl6->saddr);
 restart:
-	rt = fn->leaf;
-	rt = rt6_device_match(net, rt, &fl6->saddr, fl6->flowi6_oif, flags);
+	rt = rcu_dereference(fn->leaf);
+	if (!rt)
+		rt = net->ipv6.ip6_null_entry;
+	else
+		rt = rt6_device_match(net, rt, &fl6->saddr,
+				      fl6->flowi6_oif, flags);
 	if (rt->rt6i_nsiblings && fl6->flowi6_oif == 0)
 		rt = rt6_multipath_select(rt, fl6, fl6->flowi6_oif, flags);
 	BACKTRACK(net, &fl6->saddr);
 out:
 	dst_use(&rt->dst, jiffies);
-	read_unlock_bh(&table->tb6_lock);
+	rcu_read_unlock();
 	return rt;
 
 }
@@ -905,6 +934,95 @@ static struct rt6_info *rt6_alloc_clone(struct rt6_info *ort,
 	return rt;
 }
 
+/* Per-CPU copies of gateway routes
+ *
+ * Every destination behind a gateway route uses the same nexthop, so
+ * instead of cloning a host route into the tree for each of them, a
+ * lookup hands out a copy of the route private to the current CPU.
+ * This keeps the tree and the clone gc out of the output path and lets
+ * the lookup run under rcu_read_lock() alone. The copies share the
+ * metrics of their route and are freed with it, see rt6_free_rcu().
+ */
+static struct rt6_info *ip6_rt_pcpu_alloc(struct rt6_info *rt)
+{
+	struct net *net = dev_net(rt->dst.dev);
+	struct rt6_info *pcpu_rt;
+
+	pcpu_rt = ip6_dst_alloc(net, rt->dst.dev, rt->dst.flags,
+				rt->rt6i_table);
+	if (!pcpu_rt)
+		return NULL;
+
+	pcpu_rt->dst.input = rt->dst.input;
+	pcpu_rt->dst.output = rt->dst.output;
+	pcpu_rt->dst.error = rt->dst.error;
+	dst_init_metrics(&pcpu_rt->dst, dst_metrics_ptr(&rt->dst), true);
+	pcpu_rt->rt6i_idev = rt->rt6i_idev;
+	if (pcpu_rt->rt6i_idev)
+		in6_dev_hold(pcpu_rt->rt6i_idev);
+	pcpu_rt->dst.lastuse = jiffies;
+
+	pcpu_rt->rt6i_gateway = rt->rt6i_gateway;
+	pcpu_rt->rt6i_flags = rt->rt6i_flags | RTF_PCPU;
+	rt6_set_from(pcpu_rt, rt);
+	pcpu_rt->rt6i_metric = rt->rt6i_metric;
+	pcpu_rt->rt6i_protocol = rt->rt6i_protocol;
+
+	pcpu_rt->rt6i_dst = rt->rt6i_dst;
+#ifdef CONFIG_IPV6_SUBTREES
+	pcpu_rt->rt6i_src = rt->rt6i_src;
+#endif
+	pcpu_rt->rt6i_prefsrc = rt->rt6i_prefsrc;
+	pcpu_rt->rt6i_table = rt->rt6i_table;
+
+	return pcpu_rt;
+}
+
+/* The route may have got new metrics since the copy was made */
+static void rt6_pcpu_metrics_check(struct rt6_info *pcpu_rt)
+{
+	struct dst_entry *from = pcpu_rt->dst.from;
+
+	if (dst_metrics_ptr(&pcpu_rt->dst) != dst_metrics_ptr(from))
+		dst_init_metrics(&pcpu_rt->dst, dst_metrics_ptr(from), true);
+}
+
+/* Called with BHs disabled and under rcu_read_lock() */
+static struct rt6_info *rt6_get_pcpu_route(struct rt6_info *rt)
+{
+	struct rt6_info **p = this_cpu_ptr(rt->rt6i_pcpu);
+	struct rt6_info *pcpu_rt = *p;
+
+	if (pcpu_rt) {
+		dst_hold(&pcpu_rt->dst);
+		rt6_pcpu_metrics_check(pcpu_rt);
+	}
+	return pcpu_rt;
+}
+
+/* Called with BHs disabled and under rcu_read_lock(). rt6_free_rcu()
+ * runs after the current grace period, so it sees the copy installed
+ * here even if rt is being removed from the tree right now.
+ */
+static struct rt6_info *rt6_make_pcpu_route(struct rt6_info *rt)
+{
+	struct rt6_info *pcpu_rt, *prev, **p;
+
+	pcpu_rt = ip6_rt_pcpu_alloc(rt);
+	if (!pcpu_rt) {
+		dst_hold(&rt->dst);
+		return rt;
+	}
+
+	/* nothing else fills this CPU's slot while BHs are off */
+	p = this_cpu_ptr(rt->rt6i_pcpu);
+	prev = cmpxchg(p, NULL, pcpu_rt);
+	BUG_ON(prev);
+
+	dst_hold(&pcpu_rt->dst);
+	return pcpu_rt;
+}
+
 static struct rt6_info *ip6_pol_route(struct net *net, struct fib6_table *table, int oif,
 				      struct flowi6 *fl6, int flags)
 {
@@ -918,13 +1036,13 @@ static struct rt6_info *ip6_pol_route(struct net *net, struct fib6_table *table,
 	strict |= flags & RT6_LOOKUP_F_IFACE;
 
 relookup:
-	read_lock_bh(&table->tb6_lock);
+	rcu_read_lock();
 
 restart_2:
 	fn = fib6_lookup(&table->tb6_root, &fl6->daddr, &fl6->saddr);
 
 restart:
-	rt = rt6_select(fn, oif, strict | reachable);
+	rt = rt6_select(net, table, fn, oif, strict | reachable);
 	if (rt->rt6i_nsiblings)
 		rt = rt6_multipath_select(rt, fl6, oif, strict | reachable);
 	BACKTRACK(net, &fl6->saddr);
@@ -932,8 +1050,25 @@ restart:
 	    rt->rt6i_flags & RTF_CACHE)
 		goto out;
 
+	if (rt->rt6i_pcpu) {
+		struct rt6_info *pcpu_rt;
+
+		rt->dst.lastuse = jiffies;
+		rt->dst.__use++;
+
+		local_bh_disable();
+		pcpu_rt = rt6_get_pcpu_route(rt);
+		if (!pcpu_rt)
+			pcpu_rt = rt6_make_pcpu_route(rt);
+		local_bh_enable();
+		rcu_read_unlock();
+
+		rt = pcpu_rt;
+		goto out2;
+	}
+
 	dst_hold(&rt->dst);
-	read_unlock_bh(&table->tb6_lock);
+	rcu_read_unlock();
 
 	if (!(rt->rt6i_flags & (RTF_NONEXTHOP | RTF_GATEWAY)))
 		nrt = rt6_alloc_cow(rt, &fl6->daddr, &fl6->saddr);
@@ -956,7 +1091,7 @@ restart:
 		goto out2;
 
 	/*
-	 * Race condition! In the gap, when table->tb6_lock was
+	 * Race condition! In the gap, when rcu_read_lock() was
 	 * released someone could insert this route.  Relookup.
 	 */
 	ip6_rt_put(rt);
@@ -968,7 +1103,7 @@ out:
 		goto restart_2;
 	}
 	dst_hold(&rt->dst);
-	read_unlock_bh(&table->tb6_lock);
+	rcu_read_unlock();
 out2:
 	rt->dst.lastuse = jiffies;
 	rt->dst.__use++;
@@ -1078,15 +1213,26 @@ struct dst_entry *ip6_blackhole_route(struct net *net, struct dst_entry *dst_ori
 
 static struct dst_entry *ip6_dst_check(struct dst_entry *dst, u32 cookie)
 {
-	struct rt6_info *rt;
+	struct rt6_info *rt, *from;
+	struct fib6_node *fn;
+	bool valid;
 
 	rt = (struct rt6_info *) dst;
 
+	/* Per-CPU copies are valid as long as the route they copy is */
+	from = rt;
+	if (rt->rt6i_flags & RTF_PCPU)
+		from = (struct rt6_info *) rt->dst.from;
+
 	/* All IPV6 dsts are created with ->obsolete set to the value
 	 * DST_OBSOLETE_FORCE_CHK which forces validation calls down
 	 * into this function always.
 	 */
-	if (!rt->rt6i_node || (rt->rt6i_node->fn_sernum != cookie))
+	rcu_read_lock();
+	fn = rcu_dereference(from->rt6i_node);
+	valid = fn && fn->fn_sernum == cookie;
+	rcu_read_unlock();
+	if (!valid)
 		return NULL;
 
 	if (rt6_check_expired(rt))
@@ -1125,30 +1271,75 @@ static void ip6_link_failure(struct sk_buff *skb)
 			dst_hold(&rt->dst);
 			if (ip6_del_rt(rt))
 				dst_free(&rt->dst);
-		} else if (rt->rt6i_node && (rt->rt6i_flags & RTF_DEFAULT)) {
-			rt->rt6i_node->fn_sernum = -1;
+		} else if (rt->rt6i_flags & RTF_DEFAULT) {
+			struct fib6_node *fn;
+
+			if (rt->rt6i_flags & RTF_PCPU)
+				rt = (struct rt6_info *) rt->dst.from;
+
+			rcu_read_lock();
+			fn = rcu_dereference(rt->rt6i_node);
+			if (fn)
+				fn->fn_sernum = -1;
+			rcu_read_unlock();
 		}
 	}
 }
 
-static void ip6_rt_update_pmtu(struct dst_entry *dst, struct sock *sk,
-			       struct sk_buff *skb, u32 mtu)
+static void rt6_do_update_pmtu(struct rt6_info *rt6, u32 mtu)
+{
+	struct net *net = dev_net(rt6->dst.dev);
+
+	rt6->rt6i_flags |= RTF_MODIFIED;
+	if (mtu < IPV6_MIN_MTU)
+		mtu = IPV6_MIN_MTU;
+
+	dst_metric_set(&rt6->dst, RTAX_MTU, mtu);
+	rt6_update_expires(rt6, net->ipv6.sysctl.ip6_rt_mtu_expires);
+}
+
+static void __ip6_rt_update_pmtu(struct dst_entry *dst, const struct sock *sk,
+				 const struct ipv6hdr *iph, u32 mtu)
 {
 	struct rt6_info *rt6 = (struct rt6_info *)dst;
+	const struct in6_addr *daddr;
+	struct rt6_info *nrt6;
 
 	dst_confirm(dst);
-	if (mtu < dst_mtu(dst) && rt6->rt6i_dst.plen == 128) {
-		struct net *net = dev_net(dst->dev);
+	if (mtu >= dst_mtu(dst))
+		return;
+
+	if (!(rt6->rt6i_flags & RTF_PCPU)) {
+		if (rt6->rt6i_dst.plen == 128)
+			rt6_do_update_pmtu(rt6, mtu);
+		return;
+	}
 
-		rt6->rt6i_flags |= RTF_MODIFIED;
-		if (mtu < IPV6_MIN_MTU)
-			mtu = IPV6_MIN_MTU;
+	/* A per-CPU copy serves every destination behind its route, so
+	 * the path MTU goes into a host clone for this destination. Adding
+	 * the clone bumps the serial number of the route's node, callers
+	 * caching the copy will look up again and find the clone.
+	 */
+	if (iph)
+		daddr = &iph->daddr;
+	else if (sk)
+		daddr = &sk->sk_v6_daddr;
+	else
+		return;
 
-		dst_metric_set(dst, RTAX_MTU, mtu);
-		rt6_update_expires(rt6, net->ipv6.sysctl.ip6_rt_mtu_expires);
+	nrt6 = rt6_alloc_clone(rt6, daddr);
+	if (nrt6) {
+		rt6_do_update_pmtu(nrt6, mtu);
+		ip6_ins_rt(nrt6);
 	}
 }
 
+static void ip6_rt_update_pmtu(struct dst_entry *dst, struct sock *sk,
+			       struct sk_buff *skb, u32 mtu)
+{
+	__ip6_rt_update_pmtu(dst, sk, skb ? ipv6_hdr(skb) : NULL, mtu);
+}
+
 void ip6_update_pmtu(struct sk_buff *skb, struct net *net, __be32 mtu,
 		     int oif, u32 mark, kuid_t uid)
 {
@@ -1166,7 +1357,7 @@ void ip6_update_pmtu(struct sk_buff *skb, struct net *net, __be32 mtu,
 
 	dst = ip6_route_output(net, NULL, &fl6);
 	if (!dst->error)
-		ip6_rt_update_pmtu(dst, NULL, skb, ntohl(mtu));
+		__ip6_rt_update_pmtu(dst, NULL, iph, ntohl(mtu));
 	dst_release(dst);
 }
 EXPORT_SYMBOL_GPL(ip6_update_pmtu);
@@ -1468,6 +1659,9 @@ int ip6_route_add(struct fib6_config *cfg)
 
 	if (cfg->fc_dst_len > 128 || cfg->fc_src_len > 128)
 		return -EINVAL;
+	/* RTF_PCPU is an internal flag; can not be set by userspace */
+	if (cfg->fc_flags & RTF_PCPU)
+		return -EINVAL;
 #ifndef CONFIG_IPV6_SUBTREES
 	if (cfg->fc_src_len)
 		return -EINVAL;
@@ -1652,6 +1846,13 @@ int ip6_route_add(struct fib6_config *cfg)
 
 	rt->rt6i_flags = cfg->fc_flags;
 
+	/* Lookups of a gateway prefix hand out per-CPU copies rather than
+	 * cloning it for every destination. Without the slots they fall
+	 * back to cloning, so an allocation failure is not fatal.
+	 */
+	if ((rt->rt6i_flags & RTF_GATEWAY) && !(rt->dst.flags & DST_HOST))
+		rt->rt6i_pcpu = alloc_percpu_gfp(struct rt6_info *, GFP_ATOMIC);
+
 install_route:
 	rt->dst.dev = dev;
 	rt->rt6i_idev = idev;
@@ -1866,8 +2067,13 @@ static struct rt6_info *ip6_rt_copy(struct rt6_info *ort,
 				    const struct in6_addr *dest)
 {
 	struct net *net = dev_net(ort->dst.dev);
-	struct rt6_info *rt = ip6_dst_alloc(net, ort->dst.dev, 0,
-					    ort->rt6i_table);
+	struct rt6_info *rt;
+
+	/* clone the route in the tree, not its per-CPU copy */
+	if (ort->rt6i_flags & RTF_PCPU)
+		ort = (struct rt6_info *) ort->dst.from;
+
+	rt = ip6_dst_alloc(net, ort->dst.dev, 0, ort->rt6i_table);
 
 	if (rt) {
 		rt->dst.input = ort->dst.input;
@@ -327,6 +327,9 @@ int ___ieee80211_stop_tx_ba_session(struct sta_info *sta, u16 tid,
 	 * with locking to ensure proper access.
 	 */
 	clear_bit(HT_AGG_STATE_OPERATIONAL, &tid_tx->state);
+	if (sta->sta.txq[tid])
+		clear_bit(IEEE80211_TXQ_AMPDU,
+			  &to_txq_info(sta->sta.txq[tid])->flags);
 
 	/*
 	 * There might be a few packets being processed right now (on
@@ -664,6 +667,9 @@ static void ieee80211_agg_tx_operational(struct ieee80211_local *local,
 	 * the common case.
 	 */
 	set_bit(HT_AGG_STATE_OPERATIONAL, &tid_tx->state);
+	if (sta->sta.txq[tid])
+		set_bit(IEEE80211_TXQ_AMPDU,
+			&to_txq_info(sta->sta.txq[tid])->flags);
 	ieee80211_agg_splice_finish(sta->sdata, tid);
 
 	spin_unlock_bh(&sta->lock);
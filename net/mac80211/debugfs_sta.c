@@ -522,6 +522,56 @@ static ssize_t sta_tx_latency_stat_reset_write(struct file *file,
 }
 STA_OPS_W(tx_latency_stat_reset);
 
+static ssize_t sta_airtime_read(struct file *file, char __user *userbuf,
+				size_t count, loff_t *ppos)
+{
+	struct sta_info *sta = file->private_data;
+	struct ieee80211_local *local = sta->local;
+	char buf[80 * IEEE80211_NUM_ACS + 64], *p = buf;
+	int ac, tid, queued[IEEE80211_NUM_ACS] = {};
+
+	for (tid = 0; tid < IEEE80211_NUM_TIDS; tid++) {
+		if (!sta->sta.txq[tid])
+			continue;
+		queued[sta->sta.txq[tid]->ac] +=
+			skb_queue_len(&to_txq_info(sta->sta.txq[tid])->queue);
+	}
+
+	p += scnprintf(p, sizeof(buf) + buf - p, "weight: %u\n",
+		       sta->airtime_weight);
+	for (ac = 0; ac < IEEE80211_NUM_ACS; ac++) {
+		spin_lock_bh(&local->active_txq_lock[ac]);
+		p += scnprintf(p, sizeof(buf) + buf - p,
+			       "AC%d: rx %llu us tx %llu us deficit %lld queued %d\n",
+			       ac, sta->airtime[ac].rx_airtime,
+			       sta->airtime[ac].tx_airtime,
+			       sta->airtime[ac].deficit, queued[ac]);
+		spin_unlock_bh(&local->active_txq_lock[ac]);
+	}
+
+	return simple_read_from_buffer(userbuf, count, ppos, buf, p - buf);
+}
+
+static ssize_t sta_airtime_write(struct file *file, const char __user *userbuf,
+				 size_t count, loff_t *ppos)
+{
+	struct sta_info *sta = file->private_data;
+	struct ieee80211_local *local = sta->local;
+	int ac;
+
+	/* any write resets the counters */
+	for (ac = 0; ac < IEEE80211_NUM_ACS; ac++) {
+		spin_lock_bh(&local->active_txq_lock[ac]);
+		sta->airtime[ac].rx_airtime = 0;
+		sta->airtime[ac].tx_airtime = 0;
+		sta->airtime[ac].deficit = sta->airtime_weight;
+		spin_unlock_bh(&local->active_txq_lock[ac]);
+	}
+
+	return count;
+}
+STA_OPS_RW(airtime);
+
 #define DEBUGFS_ADD(name) \
 	debugfs_create_file(#name, 0400, \
 		sta->debugfs.dir, sta, &sta_ ##name## _ops);
@@ -577,6 +627,9 @@ void ieee80211_sta_debugfs_add(struct sta_info *sta)
 	DEBUGFS_ADD(last_rx_rate);
 	DEBUGFS_ADD(tx_latency_stat);
 	DEBUGFS_ADD(tx_latency_stat_reset);
+	if (local->ops->wake_tx_queue)
+		debugfs_create_file("airtime", 0600, sta->debugfs.dir, sta,
+				    &sta_airtime_ops);
 
 	DEBUGFS_ADD_COUNTER(rx_packets, rx_packets);
 	DEBUGFS_ADD_COUNTER(tx_packets, tx_packets);
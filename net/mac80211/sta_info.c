@@ -126,6 +126,12 @@ static void __cleanup_single_sta(struct sta_info *sta)
 		ieee80211_purge_tx_queue(&local->hw, &sta->tx_filtered[ac]);
 	}
 
+	if (sta->sta.txq[0]) {
+		for (i = 0; i < ARRAY_SIZE(sta->sta.txq); i++)
+			ieee80211_txq_purge(local,
+					    to_txq_info(sta->sta.txq[i]));
+	}
+
 	if (ieee80211_vif_is_mesh(&sdata->vif))
 		mesh_sta_cleanup(sta);
 
@@ -262,6 +268,8 @@ void sta_info_free(struct ieee80211_local *local, struct sta_info *sta)
 
 	sta_dbg(sta->sdata, "Destroyed STA %pM\n", sta->sta.addr);
 
+	if (sta->sta.txq[0])
+		kfree(to_txq_info(sta->sta.txq[0]));
 	kfree(rcu_dereference_raw(sta->sta.rates));
 	kfree(sta);
 }
@@ -379,6 +387,26 @@ struct sta_info *sta_info_alloc(struct ieee80211_sub_if_data *sdata,
 	for (i = 0; i < ARRAY_SIZE(sta->chain_signal_avg); i++)
 		ewma_init(&sta->chain_signal_avg[i], 1024, 8);
 
+	if (local->ops->wake_tx_queue) {
+		void *txq_data;
+		int size = sizeof(struct txq_info) +
+			   ALIGN(local->hw.txq_data_size, sizeof(void *));
+
+		txq_data = kcalloc(ARRAY_SIZE(sta->sta.txq), size, gfp);
+		if (!txq_data)
+			goto free;
+
+		for (i = 0; i < ARRAY_SIZE(sta->sta.txq); i++) {
+			struct txq_info *txq = txq_data + i * size;
+
+			ieee80211_init_tx_queue(sdata, sta, txq, i);
+		}
+	}
+
+	for (i = 0; i < IEEE80211_NUM_ACS; i++)
+		sta->airtime[i].deficit = IEEE80211_DEFAULT_AIRTIME_WEIGHT;
+	sta->airtime_weight = IEEE80211_DEFAULT_AIRTIME_WEIGHT;
+
 	if (sta_prepare_rate_control(local, sta, gfp))
 		goto free;
 
@@ -433,6 +461,8 @@ free:
 			kfree(sta->tx_lat[i].bins);
 		kfree(sta->tx_lat);
 	}
+	if (sta->sta.txq[0])
+		kfree(to_txq_info(sta->sta.txq[0]));
 	kfree(sta);
 	return NULL;
 }
@@ -1122,6 +1152,53 @@ struct ieee80211_sta *ieee80211_find_sta(struct ieee80211_vif *vif,
 EXPORT_SYMBOL(ieee80211_find_sta);
 
 /* powersave support code */
+/*
+ * Frames still sitting on the intermediate TX queues of a station that
+ * just went to sleep haven't reached the hardware yet; treat them just
+ * like frames the hardware filtered, so they get released by PS-Poll or
+ * U-APSD or when the station wakes up, rather than being sent right away.
+ */
+void ieee80211_sta_ps_filter_txqs(struct sta_info *sta)
+{
+	struct ieee80211_sub_if_data *sdata;
+	struct sk_buff *skb;
+	int tid, filtered = 0;
+
+	if (!sta->sta.txq[0])
+		return;
+
+	for (tid = 0; tid < ARRAY_SIZE(sta->sta.txq); tid++) {
+		struct txq_info *txqi = to_txq_info(sta->sta.txq[tid]);
+		u8 ac = txqi->txq.ac;
+
+		sdata = vif_to_sdata(txqi->txq.vif);
+
+		spin_lock_bh(&txqi->queue.lock);
+		while ((skb = __skb_dequeue(&txqi->queue))) {
+			struct ieee80211_tx_info *info = IEEE80211_SKB_CB(skb);
+			struct ieee80211_vif *vif = info->control.vif;
+
+			/* same as ieee80211_handle_filtered_frame() */
+			memset(&info->control, 0, sizeof(info->control));
+			info->control.jiffies = jiffies;
+			info->control.vif = vif;
+			info->flags |= IEEE80211_TX_INTFL_NEED_TXPROCESSING |
+				       IEEE80211_TX_INTFL_RETRANSMISSION;
+			info->flags &= ~IEEE80211_TX_TEMPORARY_FLAGS;
+
+			atomic_dec(&sdata->txqs_len[ac]);
+			skb_queue_tail(&sta->tx_filtered[ac], skb);
+			filtered++;
+		}
+		spin_unlock_bh(&txqi->queue.lock);
+	}
+
+	if (filtered) {
+		sta->tx_filtered_count += filtered;
+		sta_info_recalc_tim(sta);
+	}
+}
+
 void ieee80211_sta_ps_deliver_wakeup(struct sta_info *sta)
 {
 	struct ieee80211_sub_if_data *sdata = sta->sdata;
@@ -251,6 +251,25 @@ struct ieee80211_tx_latency_stat {
 	u32 bin_count;
 };
 
+/* Default airtime weight (quantum) of a station, in usec */
+#define IEEE80211_DEFAULT_AIRTIME_WEIGHT	256
+
+/**
+ * struct airtime_info - per-AC airtime accounting of a station
+ *
+ * @rx_airtime: total airtime used receiving from the station (usec)
+ * @tx_airtime: total airtime used transmitting to the station (usec)
+ * @deficit: DRR deficit; the station's queues are skipped by
+ *	ieee80211_next_txq() while this is negative
+ *
+ * Protected by the local->active_txq_lock of the AC.
+ */
+struct airtime_info {
+	u64 rx_airtime;
+	u64 tx_airtime;
+	s64 deficit;
+};
+
 /**
  * struct sta_info - STA information
  *
@@ -339,6 +358,8 @@ struct ieee80211_tx_latency_stat {
  *	AP only.
  * @cipher_scheme: optional cipher scheme for this station
  * @last_tdls_pkt_time: holds the time in jiffies of last TDLS pkt ACKed
+ * @airtime: per-AC airtime accounting for airtime fair TXQ scheduling
+ * @airtime_weight: DRR quantum added to the deficit of each AC per round
  */
 struct sta_info {
 	/* General information, mostly static */
@@ -456,6 +477,9 @@ struct sta_info {
 	/* TDLS timeout data */
 	unsigned long last_tdls_pkt_time;
 
+	struct airtime_info airtime[IEEE80211_NUM_ACS];
+	u16 airtime_weight;
+
 	/* keep last! */
 	struct ieee80211_sta sta;
 };
@@ -645,6 +669,7 @@ void ieee80211_sta_expire(struct ieee80211_sub_if_data *sdata,
 			  unsigned long exp_time);
 u8 sta_info_tx_streams(struct sta_info *sta);
 
+void ieee80211_sta_ps_filter_txqs(struct sta_info *sta);
 void ieee80211_sta_ps_deliver_wakeup(struct sta_info *sta);
 void ieee80211_sta_ps_deliver_poll_response(struct sta_info *sta);
 void ieee80211_sta_ps_deliver_uapsd(struct sta_info *sta);
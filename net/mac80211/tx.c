@@ -1193,13 +1193,259 @@ ieee80211_tx_prepare(struct ieee80211_sub_if_data *sdata,
 	return TX_CONTINUE;
 }
 
+void ieee80211_init_tx_queue(struct ieee80211_sub_if_data *sdata,
+			     struct sta_info *sta,
+			     struct txq_info *txqi, int tid)
+{
+	/* frames for AP_VLAN stations are sent on the AP interface */
+	if (sta && sdata->vif.type == NL80211_IFTYPE_AP_VLAN)
+		sdata = container_of(sdata->bss, struct ieee80211_sub_if_data,
+				     u.ap);
+
+	skb_queue_head_init(&txqi->queue);
+	INIT_LIST_HEAD(&txqi->schedule_order);
+	txqi->txq.vif = &sdata->vif;
+
+	if (sta) {
+		txqi->txq.sta = &sta->sta;
+		sta->sta.txq[tid] = &txqi->txq;
+		txqi->txq.tid = tid;
+		txqi->txq.ac = ieee802_1d_to_ac[tid & 7];
+	} else {
+		sdata->vif.txq = &txqi->txq;
+		txqi->txq.tid = 0;
+		txqi->txq.ac = IEEE80211_AC_BE;
+	}
+}
+
+void ieee80211_txq_purge(struct ieee80211_local *local,
+			 struct txq_info *txqi)
+{
+	struct ieee80211_sub_if_data *sdata = vif_to_sdata(txqi->txq.vif);
+	struct sk_buff_head frames;
+	u8 ac = txqi->txq.ac;
+
+	spin_lock_bh(&local->active_txq_lock[ac]);
+	list_del_init(&txqi->schedule_order);
+	spin_unlock_bh(&local->active_txq_lock[ac]);
+
+	__skb_queue_head_init(&frames);
+	spin_lock_bh(&txqi->queue.lock);
+	skb_queue_splice_init(&txqi->queue, &frames);
+	spin_unlock_bh(&txqi->queue.lock);
+
+	atomic_sub(skb_queue_len(&frames), &sdata->txqs_len[ac]);
+	ieee80211_purge_tx_queue(&local->hw, &frames);
+}
+
+/* must hold local->active_txq_lock of the queue's AC */
+static void __ieee80211_schedule_txq(struct ieee80211_local *local,
+				     struct txq_info *txqi)
+{
+	if (!list_empty(&txqi->schedule_order) ||
+	    skb_queue_empty(&txqi->queue))
+		return;
+
+	/*
+	 * With airtime fairness, station queues go to the head of the
+	 * list: ieee80211_next_txq() moves them to the back only once
+	 * they've used up their deficit, which also takes care of a
+	 * station that comes back with a negative deficit.
+	 */
+	if (txqi->txq.sta && local->hw.flags & IEEE80211_HW_AIRTIME_FAIRNESS)
+		list_add(&txqi->schedule_order,
+			 &local->active_txqs[txqi->txq.ac]);
+	else
+		list_add_tail(&txqi->schedule_order,
+			      &local->active_txqs[txqi->txq.ac]);
+}
+
+static void ieee80211_drv_tx(struct ieee80211_local *local,
+			     struct ieee80211_vif *vif,
+			     struct ieee80211_sta *pubsta,
+			     struct sk_buff *skb)
+{
+	struct ieee80211_hdr *hdr = (struct ieee80211_hdr *) skb->data;
+	struct ieee80211_tx_info *info = IEEE80211_SKB_CB(skb);
+	struct ieee80211_tx_control control = {
+		.sta = pubsta,
+	};
+	struct ieee80211_sub_if_data *sdata;
+	struct ieee80211_txq *txq = NULL;
+	struct txq_info *txqi;
+	u8 ac;
+
+	/*
+	 * Only data frames go through the intermediate queues; anything
+	 * that has to bypass powersave buffering (e.g. responses to PS-Poll
+	 * or frames released in a U-APSD service period) goes straight to
+	 * the driver so it isn't held back behind queued frames.
+	 */
+	if (!local->ops->wake_tx_queue ||
+	    !ieee80211_is_data(hdr->frame_control) ||
+	    info->flags & IEEE80211_TX_CTL_NO_PS_BUFFER)
+		goto tx_normal;
+
+	if (pubsta) {
+		u8 tid = skb->priority & IEEE80211_QOS_CTL_TID_MASK;
+
+		txq = pubsta->txq[tid];
+	} else if (vif) {
+		txq = vif->txq;
+	}
+
+	if (!txq)
+		goto tx_normal;
+
+	ac = txq->ac;
+	txqi = to_txq_info(txq);
+	sdata = vif_to_sdata(txq->vif);
+
+	if (atomic_inc_return(&sdata->txqs_len[ac]) >=
+	    local->hw.txq_ac_max_pending)
+		netif_stop_subqueue(sdata->dev, ac);
+
+	skb_queue_tail(&txqi->queue, skb);
+
+	spin_lock_bh(&local->active_txq_lock[ac]);
+	__ieee80211_schedule_txq(local, txqi);
+	spin_unlock_bh(&local->active_txq_lock[ac]);
+
+	drv_wake_tx_queue(local, txqi);
+
+	return;
+
+tx_normal:
+	drv_tx(local, &control, skb);
+}
+
+struct sk_buff *ieee80211_tx_dequeue(struct ieee80211_hw *hw,
+				     struct ieee80211_txq *txq)
+{
+	struct ieee80211_local *local = hw_to_local(hw);
+	struct ieee80211_sub_if_data *sdata = vif_to_sdata(txq->vif);
+	struct txq_info *txqi = to_txq_info(txq);
+	struct ieee80211_hdr *hdr;
+	struct sk_buff *skb;
+	unsigned long flags;
+	u8 ac = txq->ac;
+	int q;
+
+	skb = skb_dequeue(&txqi->queue);
+	if (!skb)
+		return NULL;
+
+	hdr = (struct ieee80211_hdr *)skb->data;
+	if (txq->sta && ieee80211_is_data_qos(hdr->frame_control)) {
+		struct ieee80211_tx_info *info = IEEE80211_SKB_CB(skb);
+
+		/* the aggregation session may have changed while queued */
+		if (test_bit(IEEE80211_TXQ_AMPDU, &txqi->flags))
+			info->flags |= IEEE80211_TX_CTL_AMPDU;
+		else
+			info->flags &= ~IEEE80211_TX_CTL_AMPDU;
+	}
+
+	if (atomic_dec_return(&sdata->txqs_len[ac]) >=
+	    local->hw.txq_ac_max_pending ||
+	    !__netif_subqueue_stopped(sdata->dev, ac))
+		return skb;
+
+	/* don't wake the netdev queue if it's stopped for other reasons */
+	q = sdata->vif.hw_queue[ac];
+	spin_lock_irqsave(&local->queue_stop_reason_lock, flags);
+	if (!local->queue_stop_reasons[q] && skb_queue_empty(&local->pending[q]))
+		netif_wake_subqueue(sdata->dev, ac);
+	spin_unlock_irqrestore(&local->queue_stop_reason_lock, flags);
+
+	return skb;
+}
+EXPORT_SYMBOL(ieee80211_tx_dequeue);
+
+struct ieee80211_txq *ieee80211_next_txq(struct ieee80211_hw *hw, u8 ac)
+{
+	struct ieee80211_local *local = hw_to_local(hw);
+	struct txq_info *txqi;
+
+	lockdep_assert_held(&local->active_txq_lock[ac]);
+
+ begin:
+	txqi = list_first_entry_or_null(&local->active_txqs[ac],
+					struct txq_info, schedule_order);
+	if (!txqi)
+		return NULL;
+
+	if (txqi->txq.sta && local->hw.flags & IEEE80211_HW_AIRTIME_FAIRNESS) {
+		struct sta_info *sta = container_of(txqi->txq.sta,
+						    struct sta_info, sta);
+
+		if (sta->airtime[ac].deficit < 0) {
+			sta->airtime[ac].deficit += sta->airtime_weight;
+			list_move_tail(&txqi->schedule_order,
+				       &local->active_txqs[ac]);
+			goto begin;
+		}
+	}
+
+	/* each queue is handed out at most once per round */
+	if (txqi->schedule_round == local->schedule_round[ac])
+		return NULL;
+
+	list_del_init(&txqi->schedule_order);
+	txqi->schedule_round = local->schedule_round[ac];
+	return &txqi->txq;
+}
+EXPORT_SYMBOL(ieee80211_next_txq);
+
+void ieee80211_return_txq(struct ieee80211_hw *hw, struct ieee80211_txq *txq)
+{
+	struct ieee80211_local *local = hw_to_local(hw);
+
+	lockdep_assert_held(&local->active_txq_lock[txq->ac]);
+
+	__ieee80211_schedule_txq(local, to_txq_info(txq));
+}
+EXPORT_SYMBOL(ieee80211_return_txq);
+
+void ieee80211_txq_schedule_start(struct ieee80211_hw *hw, u8 ac)
+{
+	struct ieee80211_local *local = hw_to_local(hw);
+
+	spin_lock_bh(&local->active_txq_lock[ac]);
+	local->schedule_round[ac]++;
+}
+EXPORT_SYMBOL(ieee80211_txq_schedule_start);
+
+void ieee80211_txq_schedule_end(struct ieee80211_hw *hw, u8 ac)
+	__releases(&local->active_txq_lock[ac])
+{
+	struct ieee80211_local *local = hw_to_local(hw);
+
+	spin_unlock_bh(&local->active_txq_lock[ac]);
+}
+EXPORT_SYMBOL(ieee80211_txq_schedule_end);
+
+void ieee80211_sta_register_airtime(struct ieee80211_sta *pubsta, u8 tid,
+				    u32 tx_airtime, u32 rx_airtime)
+{
+	struct sta_info *sta = container_of(pubsta, struct sta_info, sta);
+	struct ieee80211_local *local = sta->local;
+	u8 ac = ieee802_1d_to_ac[tid & 7];
+
+	spin_lock_bh(&local->active_txq_lock[ac]);
+	sta->airtime[ac].tx_airtime += tx_airtime;
+	sta->airtime[ac].rx_airtime += rx_airtime;
+	sta->airtime[ac].deficit -= tx_airtime + rx_airtime;
+	spin_unlock_bh(&local->active_txq_lock[ac]);
+}
+EXPORT_SYMBOL(ieee80211_sta_register_airtime);
+
 static bool ieee80211_tx_frags(struct ieee80211_local *local,
 			       struct ieee80211_vif *vif,
 			       struct ieee80211_sta *sta,
 			       struct sk_buff_head *skbs,
 			       bool txpending)
 {
-	struct ieee80211_tx_control control;
 	struct sk_buff *skb, *tmp;
 	unsigned long flags;
 
@@ -1257,10 +1503,9 @@ static bool ieee80211_tx_frags(struct ieee80211_local *local,
 		spin_unlock_irqrestore(&local->queue_stop_reason_lock, flags);
 
 		info->control.vif = vif;
-		control.sta = sta;
 
 		__skb_unlink(skb, skbs);
-		drv_tx(local, &control, skb);
+		ieee80211_drv_tx(local, vif, sta, skb);
 	}
 
 	return true;
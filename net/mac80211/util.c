@@ -308,6 +308,12 @@ void ieee80211_propagate_queue_wake(struct ieee80211_local *local, int queue)
 		for (ac = 0; ac < n_acs; ac++) {
 			int ac_queue = sdata->vif.hw_queue[ac];
 
+			/* still backlogged in the intermediate queues */
+			if (local->ops->wake_tx_queue &&
+			    atomic_read(&sdata->txqs_len[ac]) >=
+			    local->hw.txq_ac_max_pending)
+				continue;
+
 			if (ac_queue == queue ||
 			    (sdata->vif.cab_queue == queue &&
 			     local->queue_stop_reasons[ac_queue] == 0 &&
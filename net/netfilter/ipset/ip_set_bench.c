@@ -0,0 +1,239 @@
+/* Copyright (c) 2026, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/* Kernel module measuring the cost of the kernel side test operation of
+ * an existing IPv4 set: the lockless (RCU) path of ip_set_test() is
+ * compared to the same lookup done under the read-locked set, as it was
+ * done before the set types became RCU safe.
+ *
+ * Usage:
+ *	ipset create bench hash:net; ipset add bench ...
+ *	insmod ip_set_bench.ko set=bench addr=10.0.0.1 range=65536
+ *
+ * The results are printed to the kernel log, the module refuses to stay
+ * loaded.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/skbuff.h>
+#include <linux/ip.h>
+#include <linux/udp.h>
+#include <linux/inet.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/netdevice.h>
+#include <net/net_namespace.h>
+
+#include <linux/netfilter/ipset/ip_set.h>
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("ipset lookup microbenchmark");
+
+static char *set = "bench";
+module_param(set, charp, 0444);
+MODULE_PARM_DESC(set, "name of the IPv4 set to test against");
+
+static char *addr = "10.0.0.1";
+module_param(addr, charp, 0444);
+MODULE_PARM_DESC(addr, "first source address to look up");
+
+static unsigned int range = 256;
+module_param(range, uint, 0444);
+MODULE_PARM_DESC(range, "number of consecutive source addresses to cycle");
+
+static unsigned int iterations = 1000000;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "lookups per CPU and per mode");
+
+static unsigned int threads;
+module_param(threads, uint, 0444);
+MODULE_PARM_DESC(threads, "number of CPUs to run on (default: all online)");
+
+struct ip_set_bench {
+	struct ip_set *set;
+	ip_set_id_t index;
+	struct net_device *dev;
+	__be32 first;
+	bool locked;
+	atomic_t running;
+	struct completion start;
+	struct completion done;
+};
+
+struct ip_set_bench_cpu {
+	struct ip_set_bench *b;
+	u64 ns;
+	u32 matched;
+};
+
+static struct sk_buff *
+ip_set_bench_skb(__be32 saddr)
+{
+	struct sk_buff *skb;
+	struct iphdr *iph;
+	struct udphdr *uh;
+
+	skb = alloc_skb(sizeof(*iph) + sizeof(*uh), GFP_KERNEL);
+	if (!skb)
+		return NULL;
+	skb_reset_network_header(skb);
+	iph = (struct iphdr *)skb_put(skb, sizeof(*iph));
+	memset(iph, 0, sizeof(*iph));
+	iph->version = 4;
+	iph->ihl = 5;
+	iph->ttl = 64;
+	iph->protocol = IPPROTO_UDP;
+	iph->tot_len = htons(sizeof(*iph) + sizeof(*uh));
+	iph->saddr = saddr;
+	iph->daddr = saddr;
+	skb_set_transport_header(skb, sizeof(*iph));
+	uh = (struct udphdr *)skb_put(skb, sizeof(*uh));
+	memset(uh, 0, sizeof(*uh));
+	uh->source = htons(1024);
+	uh->dest = htons(53);
+	uh->len = htons(sizeof(*uh));
+
+	return skb;
+}
+
+static int
+ip_set_bench_thread(void *data)
+{
+	struct ip_set_bench_cpu *c = data;
+	struct ip_set_bench *b = c->b;
+	struct xt_action_param par = {
+		.in = b->dev,
+		.family = NFPROTO_IPV4,
+	};
+	struct ip_set_adt_opt opt = {
+		.family = NFPROTO_IPV4,
+		.dim = IPSET_DIM_MAX,
+		.flags = IPSET_DIM_ONE_SRC | IPSET_DIM_TWO_SRC |
+			 IPSET_DIM_THREE_SRC,
+		.ext.timeout = UINT_MAX,
+		.ext.packets = ULLONG_MAX,
+		.ext.bytes = ULLONG_MAX,
+	};
+	struct sk_buff *skb;
+	u32 i, host = ntohl(b->first);
+	ktime_t t0;
+	int ret;
+
+	skb = ip_set_bench_skb(b->first);
+	if (!skb)
+		goto out;
+
+	wait_for_completion(&b->start);
+	t0 = ktime_get();
+	for (i = 0; i < iterations; i++) {
+		ip_hdr(skb)->saddr = htonl(host + i % range);
+		if (b->locked) {
+			/* The former locked lookup path of ip_set_test() */
+			read_lock_bh(&b->set->lock);
+			ret = b->set->variant->kadt(b->set, skb, &par,
+						    IPSET_TEST, &opt);
+			read_unlock_bh(&b->set->lock);
+		} else {
+			ret = ip_set_test(b->index, skb, &par, &opt);
+		}
+		if (ret > 0)
+			c->matched++;
+	}
+	c->ns = ktime_to_ns(ktime_sub(ktime_get(), t0));
+	kfree_skb(skb);
+out:
+	if (atomic_dec_and_test(&b->running))
+		complete(&b->done);
+	return 0;
+}
+
+static int
+ip_set_bench_run(struct ip_set_bench *b, bool locked)
+{
+	struct ip_set_bench_cpu *c;
+	struct task_struct *tsk;
+	unsigned int cpu, n = 0, nr = threads ?: num_online_cpus();
+	u64 ns = 0;
+	u32 matched = 0;
+
+	c = kcalloc(nr_cpu_ids, sizeof(*c), GFP_KERNEL);
+	if (!c)
+		return -ENOMEM;
+
+	b->locked = locked;
+	init_completion(&b->start);
+	init_completion(&b->done);
+	atomic_set(&b->running, 1);
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		if (n == nr)
+			break;
+		c[cpu].b = b;
+		tsk = kthread_create(ip_set_bench_thread, &c[cpu],
+				     "ipset_bench/%u", cpu);
+		if (IS_ERR(tsk))
+			continue;
+		kthread_bind(tsk, cpu);
+		atomic_inc(&b->running);
+		wake_up_process(tsk);
+		n++;
+	}
+	put_online_cpus();
+
+	complete_all(&b->start);
+	if (!atomic_dec_and_test(&b->running))
+		wait_for_completion(&b->done);
+
+	for_each_possible_cpu(cpu) {
+		ns += c[cpu].ns;
+		matched += c[cpu].matched;
+	}
+	kfree(c);
+
+	if (!n)
+		return -ECHILD;
+	pr_info("set %s, %s: %u CPUs, %llu ns/lookup, %u matched\n",
+		b->set->name, locked ? "read-locked" : "lockless", n,
+		div_u64(ns, (u64)n * iterations), matched);
+	return 0;
+}
+
+static int __init
+ip_set_bench_init(void)
+{
+	struct ip_set_bench b = {};
+	int ret;
+
+	if (!iterations || !range || !in4_pton(addr, -1, (u8 *)&b.first,
+					       -1, NULL))
+		return -EINVAL;
+
+	b.dev = init_net.loopback_dev;
+	b.index = ip_set_get_byname(&init_net, set, &b.set);
+	if (b.index == IPSET_INVALID_ID) {
+		pr_err("set %s not found\n", set);
+		return -ENOENT;
+	}
+	if (b.set->family != NFPROTO_IPV4 &&
+	    b.set->family != NFPROTO_UNSPEC) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = ip_set_bench_run(&b, true);
+	if (!ret)
+		ret = ip_set_bench_run(&b, false);
+out:
+	ip_set_put_byindex(&init_net, b.index);
+	/* Nothing to keep loaded */
+	return ret ?: -EAGAIN;
+}
+
+module_init(ip_set_bench_init);
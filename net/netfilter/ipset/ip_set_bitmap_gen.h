@@ -35,6 +35,12 @@
 
 #define get_ext(set, map, id)	((map)->extensions + (set)->dsize * (id))
 
+/* The kernel side test operation runs under rcu_read_lock_bh() only,
+ * without the set lock. The bitmap and the extension area are never
+ * reallocated while the set exists, the members are tested and modified
+ * with atomic bitops and the extensions which are read by the test
+ * operation are word sized or RCU protected pointers. */
+
 static void
 mtype_gc_init(struct ip_set *set, void (*gc)(unsigned long ul_set))
 {
@@ -101,7 +107,10 @@ mtype_head(struct ip_set *set, struct sk_buff *skb)
 	    nla_put_net32(skb, IPSET_ATTR_MEMSIZE,
 			  htonl(sizeof(*map) +
 				map->memsize +
-				set->dsize * map->elements)))
+				set->dsize * map->elements +
+				ip_set_counter_memsize(set,
+					bitmap_weight(map->members,
+						      map->elements)))))
 		goto nla_put_failure;
 	if (unlikely(ip_set_put_flags(skb, set)))
 		goto nla_put_failure;
@@ -141,15 +150,26 @@ mtype_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 	const struct mtype_adt_elem *e = value;
 	void *x = get_ext(set, map, e->id);
 	int ret = mtype_do_add(e, map, flags, set->dsize);
+	bool readd = ret == IPSET_ADD_FAILED;
 
-	if (ret == IPSET_ADD_FAILED) {
+	if (readd) {
 		if (SET_WITH_TIMEOUT(set) &&
 		    ip_set_timeout_expired(ext_timeout(x, set)))
 			ret = 0;
 		else if (!(flags & IPSET_FLAG_EXIST))
 			return -IPSET_ERR_EXIST;
 		/* Element is re-added, cleanup extensions */
-		ip_set_ext_destroy(set, x);
+		ip_set_ext_reset(set, x);
+	}
+
+	if (SET_WITH_COUNTER(set)) {
+		int err = ip_set_init_counter(ext_counter(x, set), ext);
+
+		if (err) {
+			if (!readd)
+				mtype_do_del(e, map);
+			return err;
+		}
 	}
 
 	if (SET_WITH_TIMEOUT(set))
@@ -159,8 +179,6 @@ mtype_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 		ip_set_timeout_set(ext_timeout(x, set), ext->timeout);
 #endif
 
-	if (SET_WITH_COUNTER(set))
-		ip_set_init_counter(ext_counter(x, set), ext);
 	if (SET_WITH_COMMENT(set))
 		ip_set_init_comment(ext_comment(x, set), ext);
 	if (SET_WITH_SKBINFO(set))
@@ -288,6 +306,7 @@ static const struct ip_set_type_variant mtype = {
 	.head	= mtype_head,
 	.list	= mtype_list,
 	.same_set = mtype_same_set,
+	.lockless_test = true,
 };
 
 #endif /* __IP_SET_BITMAP_IP_GEN_H */
@@ -88,9 +88,12 @@ bitmap_ipmac_do_test(const struct bitmap_ipmac_adt_elem *e,
 	if (!test_bit(e->id, map->members))
 		return 0;
 	elem = get_elem(map->extensions, e->id, dsize);
-	if (elem->filled == MAC_FILLED)
+	if (elem->filled == MAC_FILLED) {
+		/* Pairs with smp_wmb() in bitmap_ipmac_do_add() */
+		smp_rmb();
 		return e->ether == NULL ||
 		       ether_addr_equal(e->ether, elem->ether);
+	}
 	/* Trigger kernel to fill out the ethernet address */
 	return -EAGAIN;
 }
@@ -156,11 +159,13 @@ bitmap_ipmac_do_add(const struct bitmap_ipmac_adt_elem *e,
 			return IPSET_ADD_FAILED;
 		/* Fill the MAC address and trigger the timer activation */
 		memcpy(elem->ether, e->ether, ETH_ALEN);
+		smp_wmb();
 		elem->filled = MAC_FILLED;
 		return IPSET_ADD_START_STORED_TIMEOUT;
 	} else if (e->ether) {
 		/* We can store MAC too */
 		memcpy(elem->ether, e->ether, ETH_ALEN);
+		smp_wmb();
 		elem->filled = MAC_FILLED;
 		return 0;
 	} else {
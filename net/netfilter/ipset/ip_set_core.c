@@ -239,6 +239,8 @@ unlock:
 	ip_set_type_unlock();
 
 	synchronize_rcu();
+	/* Wait for the pending element frees of the type module */
+	rcu_barrier_bh();
 }
 EXPORT_SYMBOL_GPL(ip_set_type_unregister);
 
@@ -325,12 +327,37 @@ EXPORT_SYMBOL_GPL(ip_set_get_ipaddr6);
 typedef void (*destroyer)(void *);
 /* ipset data extension types, in size order */
 
+static void
+ip_set_counter_free_rcu(struct rcu_head *head)
+{
+	struct ip_set_counter_data *c =
+		container_of(head, struct ip_set_counter_data, rcu);
+
+	free_percpu(c->cpu);
+	kfree(c);
+}
+
+/* The element is not visible anymore, but lockless readers which found
+ * it before may still update its counters until a grace period elapses */
+static void
+ip_set_counter_free(struct ip_set_counter *counter)
+{
+	struct ip_set_counter_data *c =
+		rcu_dereference_protected(counter->data, 1);
+
+	if (!c)
+		return;
+	RCU_INIT_POINTER(counter->data, NULL);
+	call_rcu_bh(&c->rcu, ip_set_counter_free_rcu);
+}
+
 const struct ip_set_ext_type ip_set_extensions[] = {
 	[IPSET_EXT_ID_COUNTER] = {
-		.type	= IPSET_EXT_COUNTER,
-		.flag	= IPSET_FLAG_WITH_COUNTERS,
-		.len	= sizeof(struct ip_set_counter),
-		.align	= __alignof__(struct ip_set_counter),
+		.type	 = IPSET_EXT_COUNTER | IPSET_EXT_DESTROY,
+		.flag	 = IPSET_FLAG_WITH_COUNTERS,
+		.len	 = sizeof(struct ip_set_counter),
+		.align	 = __alignof__(struct ip_set_counter),
+		.destroy = (destroyer) ip_set_counter_free,
 	},
 	[IPSET_EXT_ID_TIMEOUT] = {
 		.type	= IPSET_EXT_TIMEOUT,
@@ -496,9 +523,15 @@ ip_set_test(ip_set_id_t index, const struct sk_buff *skb,
 	    !(opt->family == set->family || set->family == NFPROTO_UNSPEC))
 		return 0;
 
-	read_lock_bh(&set->lock);
-	ret = set->variant->kadt(set, skb, par, IPSET_TEST, opt);
-	read_unlock_bh(&set->lock);
+	if (set->variant->lockless_test) {
+		rcu_read_lock_bh();
+		ret = set->variant->kadt(set, skb, par, IPSET_TEST, opt);
+		rcu_read_unlock_bh();
+	} else {
+		read_lock_bh(&set->lock);
+		ret = set->variant->kadt(set, skb, par, IPSET_TEST, opt);
+		read_unlock_bh(&set->lock);
+	}
 
 	if (ret == -EAGAIN) {
 		/* Type requests element to be completed */
@@ -747,6 +780,7 @@ static const struct nla_policy ip_set_create_policy[IPSET_ATTR_CMD_MAX + 1] = {
 	[IPSET_ATTR_REVISION]	= { .type = NLA_U8 },
 	[IPSET_ATTR_FAMILY]	= { .type = NLA_U8 },
 	[IPSET_ATTR_DATA]	= { .type = NLA_NESTED },
+	[IPSET_ATTR_SIZE_HINT]	= { .type = NLA_U32 },
 };
 
 static struct ip_set *
@@ -876,6 +910,14 @@ ip_set_create(struct sock *ctnl, struct sk_buff *skb,
 	if (ret != 0)
 		goto put_out;
 
+	/* Size the set once for the restore which is about to follow */
+	if (attr[IPSET_ATTR_SIZE_HINT] && set->variant->reserve) {
+		ret = set->variant->reserve(set,
+				nla_get_u32(attr[IPSET_ATTR_SIZE_HINT]));
+		if (ret < 0)
+			goto cleanup;
+	}
+
 	/* BTW, ret==0 here. */
 
 	/*
@@ -1483,6 +1525,21 @@ ip_set_uadd(struct sock *ctnl, struct sk_buff *skb,
 	if (set == NULL)
 		return -ENOENT;
 
+	/* Size the set once for the whole batch instead of resizing it
+	 * repeatedly */
+	if (set->variant->reserve && attr[IPSET_ATTR_ADT]) {
+		u32 elements = 0;
+		int nla_rem;
+
+		nla_for_each_nested(nla, attr[IPSET_ATTR_ADT], nla_rem)
+			elements++;
+		if (elements > 1) {
+			ret = set->variant->reserve(set, elements);
+			if (ret < 0)
+				return ret;
+		}
+	}
+
 	use_lineno = !!attr[IPSET_ATTR_LINENO];
 	if (attr[IPSET_ATTR_DATA]) {
 		if (nla_parse_nested(tb, IPSET_ATTR_ADT_MAX,
@@ -2038,6 +2095,8 @@ ip_set_fini(void)
 	unregister_pernet_subsys(&ip_set_net_ops);
 	nf_unregister_sockopt(&so_set);
 	nfnetlink_subsys_unregister(&ip_set_netlink_subsys);
+	/* Wait for the pending counter frees */
+	rcu_barrier_bh();
 	pr_debug("these are the famous last words\n");
 }
 
@@ -30,6 +30,16 @@
  * are serialized by the nfnl mutex. During resizing the set is
  * read-locked, so the only possible concurrent operations are
  * the kernel side readers. Those must be protected by proper RCU locking.
+ *
+ * Readers and writers
+ *
+ * The kernel side test operation runs under rcu_read_lock_bh() only,
+ * without the set lock. Writers (add, del, gc) are serialized by the
+ * write-locked set and never modify a bucket visible to the readers:
+ * a private copy of the bucket is modified and then published with
+ * rcu_assign_pointer(); the old bucket is freed after a RCU-bh grace
+ * period. The copies of an element share its per-CPU counters, which
+ * are freed after a grace period once the element is unpublished.
  */
 
 /* Number of elements to store in an initial array block */
@@ -64,18 +74,23 @@ tune_ahash_max(u8 curr, u32 multi)
 
 /* A hash bucket */
 struct hbucket {
-	void *value;		/* the array of the values */
+	struct rcu_head rcu;	/* for call_rcu_bh */
 	u8 size;		/* size of the array */
 	u8 pos;			/* position of the first free entry */
+	unsigned char value[0]	/* the array of the values */
+		__aligned(__alignof__(u64));
 };
 
 /* The hash table: the table size stored here in order to make resizing easy */
 struct htable {
 	u8 htable_bits;		/* size of hash table == 2^htable_bits */
-	struct hbucket bucket[0]; /* hashtable buckets */
+	struct hbucket __rcu *bucket[0]; /* hashtable buckets */
 };
 
-#define hbucket(h, i)		(&((h)->bucket[i]))
+#define hbucket(h, i)		((h)->bucket[i])
+
+/* Get the ith element of a bucket as raw data */
+#define hbucket_data(n, i, dsize)	((void *)((n)->value + (i) * (dsize)))
 
 #ifndef IPSET_NET_COUNT
 #define IPSET_NET_COUNT		1
@@ -97,11 +112,11 @@ htable_size(u8 hbits)
 	if (hbits > 31)
 		return 0;
 	hsize = jhash_size(hbits);
-	if ((((size_t)-1) - sizeof(struct htable))/sizeof(struct hbucket)
+	if ((((size_t)-1) - sizeof(struct htable))/sizeof(struct hbucket *)
 	    < hsize)
 		return 0;
 
-	return hsize * sizeof(struct hbucket) + sizeof(struct htable);
+	return hsize * sizeof(struct hbucket *) + sizeof(struct htable);
 }
 
 /* Compute htable_bits from the user input parameter hashsize */
@@ -117,30 +132,85 @@ htable_bits(u32 hashsize)
 	return bits;
 }
 
+static struct hbucket *
+hbucket_alloc(u8 size, size_t dsize)
+{
+	struct hbucket *n;
+
+	n = kzalloc(sizeof(struct hbucket) + size * dsize, GFP_ATOMIC);
+	if (n)
+		n->size = size;
+	return n;
+}
+
+static void
+hbucket_free_rcu(struct rcu_head *head)
+{
+	kfree(container_of(head, struct hbucket, rcu));
+}
+
+/* Make room for a new element in a bucket which is not visible
+ * to the readers yet */
 static int
-hbucket_elem_add(struct hbucket *n, u8 ahash_max, size_t dsize)
+hbucket_elem_add(struct hbucket **pn, u8 ahash_max, size_t dsize)
 {
-	if (n->pos >= n->size) {
-		void *tmp;
+	struct hbucket *n = *pn, *tmp;
 
-		if (n->size >= ahash_max)
-			/* Trigger rehashing */
-			return -EAGAIN;
-
-		tmp = kzalloc((n->size + AHASH_INIT_SIZE) * dsize,
-			      GFP_ATOMIC);
-		if (!tmp)
-			return -ENOMEM;
-		if (n->size) {
-			memcpy(tmp, n->value, n->size * dsize);
-			kfree(n->value);
-		}
-		n->value = tmp;
-		n->size += AHASH_INIT_SIZE;
+	if (n && n->pos < n->size)
+		return 0;
+	if (n && n->size >= ahash_max)
+		/* Trigger rehashing */
+		return -EAGAIN;
+
+	tmp = hbucket_alloc((n ? n->size : 0) + AHASH_INIT_SIZE, dsize);
+	if (!tmp)
+		return -ENOMEM;
+	if (n) {
+		memcpy(tmp->value, n->value, n->size * dsize);
+		tmp->pos = n->pos;
+		kfree(n);
 	}
+	*pn = tmp;
 	return 0;
 }
 
+/* Copy a bucket published to the readers, leaving out the element
+ * at position skip (if not negative) and reserving room for extra
+ * new elements. The copy is private until published. */
+static struct hbucket *
+hbucket_copy(const struct hbucket *n, int skip, u8 extra, size_t dsize)
+{
+	struct hbucket *m;
+	u8 pos = n ? n->pos : 0;
+	int i;
+
+	m = hbucket_alloc(roundup(pos + extra, AHASH_INIT_SIZE), dsize);
+	if (!m)
+		return NULL;
+	for (i = 0; i < pos; i++) {
+		if (i == skip)
+			continue;
+		memcpy(hbucket_data(m, m->pos++, dsize),
+		       hbucket_data(n, i, dsize), dsize);
+	}
+	return m;
+}
+
+/* Replace a published bucket by its modified copy (which can be NULL
+ * when the bucket becomes empty) */
+static void
+hbucket_replace(struct htable *t, u32 key, struct hbucket *n,
+		struct hbucket *m)
+{
+	if (m && !m->pos) {
+		kfree(m);
+		m = NULL;
+	}
+	rcu_assign_pointer(hbucket(t, key), m);
+	if (n)
+		call_rcu_bh(&n->rcu, hbucket_free_rcu);
+}
+
 #ifdef IP_SET_HASH_WITH_NETS
 #if IPSET_NET_COUNT > 1
 #define __CIDR(cidr, i)		(cidr[i])
@@ -198,7 +268,9 @@ hbucket_elem_add(struct hbucket *n, u8 ahash_max, size_t dsize)
 #undef mtype_test_cidrs
 #undef mtype_test
 #undef mtype_expire
+#undef mtype_rehash
 #undef mtype_resize
+#undef mtype_reserve
 #undef mtype_head
 #undef mtype_list
 #undef mtype_gc
@@ -239,7 +311,9 @@ hbucket_elem_add(struct hbucket *n, u8 ahash_max, size_t dsize)
 #define mtype_test_cidrs	IPSET_TOKEN(MTYPE, _test_cidrs)
 #define mtype_test		IPSET_TOKEN(MTYPE, _test)
 #define mtype_expire		IPSET_TOKEN(MTYPE, _expire)
+#define mtype_rehash		IPSET_TOKEN(MTYPE, _rehash)
 #define mtype_resize		IPSET_TOKEN(MTYPE, _resize)
+#define mtype_reserve		IPSET_TOKEN(MTYPE, _reserve)
 #define mtype_head		IPSET_TOKEN(MTYPE, _head)
 #define mtype_list		IPSET_TOKEN(MTYPE, _list)
 #define mtype_gc		IPSET_TOKEN(MTYPE, _gc)
@@ -346,17 +420,21 @@ mtype_ahash_memsize(const struct htype *h, const struct htable *t,
 #ifdef IP_SET_HASH_WITH_NETS
 			 + sizeof(struct net_prefixes) * nets_length
 #endif
-			 + jhash_size(t->htable_bits) * sizeof(struct hbucket);
+			 + jhash_size(t->htable_bits) * sizeof(struct hbucket *);
+	const struct hbucket *n;
 
-	for (i = 0; i < jhash_size(t->htable_bits); i++)
-		memsize += t->bucket[i].size * dsize;
+	for (i = 0; i < jhash_size(t->htable_bits); i++) {
+		n = rcu_dereference_bh_nfnl(hbucket(t, i));
+		if (n)
+			memsize += sizeof(struct hbucket) + n->size * dsize;
+	}
 
 	return memsize;
 }
 
 /* Get the ith element from the array block n */
 #define ahash_data(n, i, dsize)	\
-	((struct mtype_elem *)((n)->value + ((i) * (dsize))))
+	((struct mtype_elem *)hbucket_data(n, i, dsize))
 
 static void
 mtype_ext_cleanup(struct ip_set *set, struct hbucket *n)
@@ -378,14 +456,12 @@ mtype_flush(struct ip_set *set)
 
 	t = rcu_dereference_bh_nfnl(h->table);
 	for (i = 0; i < jhash_size(t->htable_bits); i++) {
-		n = hbucket(t, i);
-		if (n->size) {
-			if (set->extensions & IPSET_EXT_DESTROY)
-				mtype_ext_cleanup(set, n);
-			n->size = n->pos = 0;
-			/* FIXME: use slab cache */
-			kfree(n->value);
-		}
+		n = rcu_dereference_bh_nfnl(hbucket(t, i));
+		if (!n)
+			continue;
+		if (set->extensions & IPSET_EXT_DESTROY)
+			mtype_ext_cleanup(set, n);
+		hbucket_replace(t, i, n, NULL);
 	}
 #ifdef IP_SET_HASH_WITH_NETS
 	memset(h->nets, 0, sizeof(struct net_prefixes) * NLEN(set->family));
@@ -393,7 +469,8 @@ mtype_flush(struct ip_set *set)
 	h->elements = 0;
 }
 
-/* Destroy the hashtable part of the set */
+/* Destroy the hashtable part of the set: the table must not be
+ * visible to the readers anymore */
 static void
 mtype_ahash_destroy(struct ip_set *set, struct htable *t, bool ext_destroy)
 {
@@ -401,13 +478,12 @@ mtype_ahash_destroy(struct ip_set *set, struct htable *t, bool ext_destroy)
 	u32 i;
 
 	for (i = 0; i < jhash_size(t->htable_bits); i++) {
-		n = hbucket(t, i);
-		if (n->size) {
-			if (set->extensions & IPSET_EXT_DESTROY && ext_destroy)
-				mtype_ext_cleanup(set, n);
-			/* FIXME: use slab cache */
-			kfree(n->value);
-		}
+		n = rcu_dereference_bh_nfnl(hbucket(t, i));
+		if (!n)
+			continue;
+		if (set->extensions & IPSET_EXT_DESTROY && ext_destroy)
+			mtype_ext_cleanup(set, n);
+		kfree(n);
 	}
 
 	ip_set_free(t);
@@ -468,10 +544,12 @@ static void
 mtype_expire(struct ip_set *set, struct htype *h, u8 nets_length, size_t dsize)
 {
 	struct htable *t;
-	struct hbucket *n;
+	struct hbucket *n, *m;
 	struct mtype_elem *data;
+	u64 expired;
 	u32 i;
 	int j;
+	u8 size;
 #ifdef IP_SET_HASH_WITH_NETS
 	u8 k;
 #endif
@@ -479,38 +557,43 @@ mtype_expire(struct ip_set *set, struct htype *h, u8 nets_length, size_t dsize)
 	rcu_read_lock_bh();
 	t = rcu_dereference_bh(h->table);
 	for (i = 0; i < jhash_size(t->htable_bits); i++) {
-		n = hbucket(t, i);
-		for (j = 0; j < n->pos; j++) {
+		n = rcu_dereference_bh(hbucket(t, i));
+		if (!n)
+			continue;
+		for (j = 0, size = 0; j < n->pos; j++) {
 			data = ahash_data(n, j, dsize);
-			if (ip_set_timeout_expired(ext_timeout(data, set))) {
-				pr_debug("expired %u/%u\n", i, j);
-#ifdef IP_SET_HASH_WITH_NETS
-				for (k = 0; k < IPSET_NET_COUNT; k++)
-					mtype_del_cidr(h, CIDR(data->cidr, k),
-						       nets_length, k);
-#endif
-				ip_set_ext_destroy(set, data);
-				if (j != n->pos - 1)
-					/* Not last one */
-					memcpy(data,
-					       ahash_data(n, n->pos - 1, dsize),
-					       dsize);
-				n->pos--;
-				h->elements--;
-			}
+			if (!ip_set_timeout_expired(ext_timeout(data, set)))
+				size++;
 		}
-		if (n->pos + AHASH_INIT_SIZE < n->size) {
-			void *tmp = kzalloc((n->size - AHASH_INIT_SIZE)
-					    * dsize,
-					    GFP_ATOMIC);
-			if (!tmp)
-				/* Still try to delete expired elements */
+		if (size == n->pos)
+			continue;
+		/* Build the new bucket from the unexpired elements */
+		m = hbucket_alloc(roundup(size, AHASH_INIT_SIZE), dsize);
+		if (!m)
+			/* Try again at the next run */
+			continue;
+		/* A bucket holds at most 64 elements, see tune_ahash_max() */
+		for (j = 0, expired = 0; j < n->pos; j++) {
+			data = ahash_data(n, j, dsize);
+			if (!ip_set_timeout_expired(ext_timeout(data, set))) {
+				memcpy(ahash_data(m, m->pos++, dsize), data,
+				       dsize);
 				continue;
-			n->size -= AHASH_INIT_SIZE;
-			memcpy(tmp, n->value, n->size * dsize);
-			kfree(n->value);
-			n->value = tmp;
+			}
+			pr_debug("expired %u/%u\n", i, j);
+#ifdef IP_SET_HASH_WITH_NETS
+			for (k = 0; k < IPSET_NET_COUNT; k++)
+				mtype_del_cidr(h, CIDR(data->cidr, k),
+					       nets_length, k);
+#endif
+			expired |= 1ULL << j;
+			h->elements--;
 		}
+		hbucket_replace(t, i, n, m);
+		/* Only the old bucket holds the expired elements now */
+		for (j = 0; j < n->pos; j++)
+			if (expired & (1ULL << j))
+				ip_set_ext_destroy(set, ahash_data(n, j, dsize));
 	}
 	rcu_read_unlock_bh();
 }
@@ -530,37 +613,25 @@ mtype_gc(unsigned long ul_set)
 	add_timer(&h->gc);
 }
 
-/* Resize a hash: create a new hash table with doubling the hashsize
- * and inserting the elements to it. Repeat until we succeed or
- * fail due to memory pressures. */
+/* Rehash into a new table of size 2^htable_bits (or larger, if an array
+ * block of the new table overflows), built off-line and then swapped in. */
 static int
-mtype_resize(struct ip_set *set, bool retried)
+mtype_rehash(struct ip_set *set, u8 htable_bits)
 {
 	struct htype *h = set->data;
 	struct htable *t, *orig = rcu_dereference_bh_nfnl(h->table);
-	u8 htable_bits = orig->htable_bits;
 #ifdef IP_SET_HASH_WITH_NETS
+	struct mtype_elem tmp;
 	u8 flags;
 #endif
 	struct mtype_elem *data;
 	struct mtype_elem *d;
 	struct hbucket *n, *m;
-	u32 i, j;
+	u32 i, j, key;
 	int ret;
 
-	/* Try to cleanup once */
-	if (SET_WITH_TIMEOUT(set) && !retried) {
-		i = h->elements;
-		write_lock_bh(&set->lock);
-		mtype_expire(set, set->data, NLEN(set->family), set->dsize);
-		write_unlock_bh(&set->lock);
-		if (h->elements < i)
-			return 0;
-	}
-
 retry:
 	ret = 0;
-	htable_bits++;
 	pr_debug("attempt to resize set %s from %u to %u, t %p\n",
 		 set->name, orig->htable_bits, htable_bits, orig);
 	if (!htable_bits) {
@@ -570,37 +641,43 @@ retry:
 		return -IPSET_ERR_HASH_FULL;
 	}
 	t = ip_set_alloc(sizeof(*t)
-			 + jhash_size(htable_bits) * sizeof(struct hbucket));
+			 + jhash_size(htable_bits) * sizeof(struct hbucket *));
 	if (!t)
 		return -ENOMEM;
 	t->htable_bits = htable_bits;
 
 	read_lock_bh(&set->lock);
 	for (i = 0; i < jhash_size(orig->htable_bits); i++) {
-		n = hbucket(orig, i);
+		n = rcu_dereference_bh_nfnl(hbucket(orig, i));
+		if (!n)
+			continue;
 		for (j = 0; j < n->pos; j++) {
 			data = ahash_data(n, j, set->dsize);
 #ifdef IP_SET_HASH_WITH_NETS
+			/* The element is visible to the readers: compute
+			 * the key from a copy with the flags reset */
+			memcpy(&tmp, data, sizeof(tmp));
 			flags = 0;
-			mtype_data_reset_flags(data, &flags);
+			mtype_data_reset_flags(&tmp, &flags);
+			key = HKEY(&tmp, h->initval, htable_bits);
+#else
+			key = HKEY(data, h->initval, htable_bits);
 #endif
-			m = hbucket(t, HKEY(data, h->initval, htable_bits));
-			ret = hbucket_elem_add(m, AHASH_MAX(h), set->dsize);
+			/* The new table is private, fill it out in place */
+			m = rcu_dereference_bh_nfnl(hbucket(t, key));
+			ret = hbucket_elem_add(&m, AHASH_MAX(h), set->dsize);
 			if (ret < 0) {
-#ifdef IP_SET_HASH_WITH_NETS
-				mtype_data_reset_flags(data, &flags);
-#endif
 				read_unlock_bh(&set->lock);
 				mtype_ahash_destroy(set, t, false);
-				if (ret == -EAGAIN)
+				if (ret == -EAGAIN) {
+					htable_bits++;
 					goto retry;
+				}
 				return ret;
 			}
+			RCU_INIT_POINTER(hbucket(t, key), m);
 			d = ahash_data(m, m->pos++, set->dsize);
 			memcpy(d, data, set->dsize);
-#ifdef IP_SET_HASH_WITH_NETS
-			mtype_data_reset_flags(d, &flags);
-#endif
 		}
 	}
 
@@ -617,6 +694,49 @@ retry:
 	return 0;
 }
 
+/* Resize a hash: create a new hash table with doubling the hashsize
+ * and inserting the elements to it. Repeat until we succeed or
+ * fail due to memory pressures. */
+static int
+mtype_resize(struct ip_set *set, bool retried)
+{
+	struct htype *h = set->data;
+	u32 elements = h->elements;
+
+	/* Try to cleanup once */
+	if (SET_WITH_TIMEOUT(set) && !retried) {
+		write_lock_bh(&set->lock);
+		mtype_expire(set, set->data, NLEN(set->family), set->dsize);
+		write_unlock_bh(&set->lock);
+		if (h->elements < elements)
+			return 0;
+	}
+
+	return mtype_rehash(set,
+			    rcu_dereference_bh_nfnl(h->table)->htable_bits + 1);
+}
+
+/* Size the hash in advance for the expected number of new elements, so
+ * that a large restore does not trigger a resize every time the table
+ * would need doubling */
+static int
+mtype_reserve(struct ip_set *set, u32 elements)
+{
+	struct htype *h = set->data;
+	u8 hbits;
+
+	elements = min_t(u64, (u64)h->elements + elements, h->maxelem);
+	/* Aim at half filled initial array blocks */
+	hbits = htable_bits(max_t(u32, DIV_ROUND_UP(elements,
+						    AHASH_INIT_SIZE / 2),
+				  IPSET_MIMINAL_HASHSIZE));
+	if (hbits <= rcu_dereference_bh_nfnl(h->table)->htable_bits ||
+	    !htable_size(hbits))
+		return 0;
+
+	return mtype_rehash(set, hbits);
+}
+
 /* Add an element to a hash and update the internal counters when succeeded,
  * otherwise report the proper error code. */
 static int
@@ -627,7 +747,7 @@ mtype_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 	struct htable *t;
 	const struct mtype_elem *d = value;
 	struct mtype_elem *data;
-	struct hbucket *n;
+	struct hbucket *n, *m;
 	int i, ret = 0;
 	int j = AHASH_MAX(h) + 1;
 	bool flag_exist = flags & IPSET_FLAG_EXIST;
@@ -637,8 +757,8 @@ mtype_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 		rcu_read_lock_bh();
 		t = rcu_dereference_bh(h->table);
 		key = HKEY(value, h->initval, t->htable_bits);
-		n = hbucket(t,key);
-		if (n->pos) {
+		n = rcu_dereference_bh(hbucket(t, key));
+		if (n && n->pos) {
 			/* Choosing the first entry in the array to replace */
 			j = 0;
 			goto reuse_slot;
@@ -659,8 +779,8 @@ mtype_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 	rcu_read_lock_bh();
 	t = rcu_dereference_bh(h->table);
 	key = HKEY(value, h->initval, t->htable_bits);
-	n = hbucket(t, key);
-	for (i = 0; i < n->pos; i++) {
+	n = rcu_dereference_bh(hbucket(t, key));
+	for (i = 0; n && i < n->pos; i++) {
 		data = ahash_data(n, i, set->dsize);
 		if (mtype_data_equal(data, d, &multi)) {
 			if (flag_exist ||
@@ -682,8 +802,21 @@ mtype_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 	}
 reuse_slot:
 	if (j != AHASH_MAX(h) + 1) {
-		/* Fill out reused slot */
-		data = ahash_data(n, j, set->dsize);
+		/* Fill out reused slot in a copy of the bucket */
+		m = hbucket_copy(n, -1, 0, set->dsize);
+		if (!m) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		data = ahash_data(m, j, set->dsize);
+		/* The copy shares the counters with the published element */
+		if (SET_WITH_COUNTER(set)) {
+			ret = ip_set_init_counter(ext_counter(data, set), ext);
+			if (ret) {
+				kfree(m);
+				goto out;
+			}
+		}
 #ifdef IP_SET_HASH_WITH_NETS
 		for (i = 0; i < IPSET_NET_COUNT; i++) {
 			mtype_del_cidr(h, CIDR(data->cidr, i),
@@ -692,17 +825,29 @@ reuse_slot:
 				       NLEN(set->family), i);
 		}
 #endif
-		ip_set_ext_destroy(set, data);
+		ip_set_ext_reset(set, data);
 	} else {
-		/* Use/create a new slot */
+		/* Use/create a new slot in a copy of the bucket */
 		TUNE_AHASH_MAX(h, multi);
-		ret = hbucket_elem_add(n, AHASH_MAX(h), set->dsize);
-		if (ret != 0) {
-			if (ret == -EAGAIN)
-				mtype_data_next(&h->next, d);
+		if (n && n->pos >= AHASH_MAX(h)) {
+			/* Trigger rehashing */
+			mtype_data_next(&h->next, d);
+			ret = -EAGAIN;
 			goto out;
 		}
-		data = ahash_data(n, n->pos++, set->dsize);
+		m = hbucket_copy(n, -1, 1, set->dsize);
+		if (!m) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		data = ahash_data(m, m->pos++, set->dsize);
+		if (SET_WITH_COUNTER(set)) {
+			ret = ip_set_init_counter(ext_counter(data, set), ext);
+			if (ret) {
+				kfree(m);
+				goto out;
+			}
+		}
 #ifdef IP_SET_HASH_WITH_NETS
 		for (i = 0; i < IPSET_NET_COUNT; i++)
 			mtype_add_cidr(h, CIDR(d->cidr, i), NLEN(set->family),
@@ -716,20 +861,20 @@ reuse_slot:
 #endif
 	if (SET_WITH_TIMEOUT(set))
 		ip_set_timeout_set(ext_timeout(data, set), ext->timeout);
-	if (SET_WITH_COUNTER(set))
-		ip_set_init_counter(ext_counter(data, set), ext);
 	if (SET_WITH_COMMENT(set))
 		ip_set_init_comment(ext_comment(data, set), ext);
 	if (SET_WITH_SKBINFO(set))
 		ip_set_init_skbinfo(ext_skbinfo(data, set), ext);
+	/* Publish the new bucket, readers see either the old or the new one */
+	hbucket_replace(t, key, n, m);
 
 out:
 	rcu_read_unlock_bh();
 	return ret;
 }
 
-/* Delete an element from the hash: swap it with the last element
- * and free up space if possible.
+/* Delete an element from the hash: replace the bucket by a copy
+ * without the element.
  */
 static int
 mtype_del(struct ip_set *set, void *value, const struct ip_set_ext *ext,
@@ -739,7 +884,7 @@ mtype_del(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 	struct htable *t;
 	const struct mtype_elem *d = value;
 	struct mtype_elem *data;
-	struct hbucket *n;
+	struct hbucket *n, *m;
 	int i, ret = -IPSET_ERR_EXIST;
 #ifdef IP_SET_HASH_WITH_NETS
 	u8 j;
@@ -749,40 +894,28 @@ mtype_del(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 	rcu_read_lock_bh();
 	t = rcu_dereference_bh(h->table);
 	key = HKEY(value, h->initval, t->htable_bits);
-	n = hbucket(t, key);
-	for (i = 0; i < n->pos; i++) {
+	n = rcu_dereference_bh(hbucket(t, key));
+	for (i = 0; n && i < n->pos; i++) {
 		data = ahash_data(n, i, set->dsize);
 		if (!mtype_data_equal(data, d, &multi))
 			continue;
 		if (SET_WITH_TIMEOUT(set) &&
 		    ip_set_timeout_expired(ext_timeout(data, set)))
 			goto out;
-		if (i != n->pos - 1)
-			/* Not last one */
-			memcpy(data, ahash_data(n, n->pos - 1, set->dsize),
-			       set->dsize);
-
-		n->pos--;
+		m = hbucket_copy(n, i, 0, set->dsize);
+		if (!m) {
+			ret = -ENOMEM;
+			goto out;
+		}
 		h->elements--;
 #ifdef IP_SET_HASH_WITH_NETS
 		for (j = 0; j < IPSET_NET_COUNT; j++)
 			mtype_del_cidr(h, CIDR(d->cidr, j), NLEN(set->family),
 				       j);
 #endif
+		hbucket_replace(t, key, n, m);
+		/* The old bucket is freed after the grace period only */
 		ip_set_ext_destroy(set, data);
-		if (n->pos + AHASH_INIT_SIZE < n->size) {
-			void *tmp = kzalloc((n->size - AHASH_INIT_SIZE)
-					    * set->dsize,
-					    GFP_ATOMIC);
-			if (!tmp) {
-				ret = 0;
-				goto out;
-			}
-			n->size -= AHASH_INIT_SIZE;
-			memcpy(tmp, n->value, n->size * set->dsize);
-			kfree(n->value);
-			n->value = tmp;
-		}
 		ret = 0;
 		goto out;
 	}
@@ -838,8 +971,8 @@ mtype_test_cidrs(struct ip_set *set, struct mtype_elem *d,
 		mtype_data_netmask(d, h->nets[j].cidr[0]);
 #endif
 		key = HKEY(d, h->initval, t->htable_bits);
-		n = hbucket(t, key);
-		for (i = 0; i < n->pos; i++) {
+		n = rcu_dereference_bh(hbucket(t, key));
+		for (i = 0; n && i < n->pos; i++) {
 			data = ahash_data(n, i, set->dsize);
 			if (!mtype_data_equal(data, d, &multi))
 				continue;
@@ -892,8 +1025,8 @@ mtype_test(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 #endif
 
 	key = HKEY(d, h->initval, t->htable_bits);
-	n = hbucket(t, key);
-	for (i = 0; i < n->pos; i++) {
+	n = rcu_dereference_bh(hbucket(t, key));
+	for (i = 0; n && i < n->pos; i++) {
 		data = ahash_data(n, i, set->dsize);
 		if (mtype_data_equal(data, d, &multi) &&
 		    !(SET_WITH_TIMEOUT(set) &&
@@ -917,7 +1050,8 @@ mtype_head(struct ip_set *set, struct sk_buff *skb)
 	size_t memsize;
 
 	t = rcu_dereference_bh_nfnl(h->table);
-	memsize = mtype_ahash_memsize(h, t, NLEN(set->family), set->dsize);
+	memsize = mtype_ahash_memsize(h, t, NLEN(set->family), set->dsize) +
+		  ip_set_counter_memsize(set, h->elements);
 
 	nested = ipset_nest_start(skb, IPSET_ATTR_DATA);
 	if (!nested)
@@ -969,10 +1103,11 @@ mtype_list(const struct ip_set *set,
 	for (; cb->args[IPSET_CB_ARG0] < jhash_size(t->htable_bits);
 	     cb->args[IPSET_CB_ARG0]++) {
 		incomplete = skb_tail_pointer(skb);
-		n = hbucket(t, cb->args[IPSET_CB_ARG0]);
+		n = rcu_dereference_bh_nfnl(hbucket(t,
+						    cb->args[IPSET_CB_ARG0]));
 		pr_debug("cb->arg bucket: %lu, t %p n %p\n",
 			 cb->args[IPSET_CB_ARG0], t, n);
-		for (i = 0; i < n->pos; i++) {
+		for (i = 0; n && i < n->pos; i++) {
 			e = ahash_data(n, i, set->dsize);
 			if (SET_WITH_TIMEOUT(set) &&
 			    ip_set_timeout_expired(ext_timeout(e, set)))
@@ -1034,7 +1169,9 @@ static const struct ip_set_type_variant mtype_variant = {
 	.head	= mtype_head,
 	.list	= mtype_list,
 	.resize	= mtype_resize,
+	.reserve = mtype_reserve,
 	.same_set = mtype_same_set,
+	.lockless_test = true,
 };
 
 #ifdef IP_SET_EMIT_CREATE
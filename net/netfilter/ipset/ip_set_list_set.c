@@ -173,6 +173,15 @@ list_set_add(struct ip_set *set, u32 i, struct set_adt_elem *d,
 {
 	struct list_set *map = set->data;
 	struct set_elem *e = list_set_elem(set, map, i);
+	struct ip_set_counter counter = { NULL };
+	int ret;
+
+	/* Allocate first, so that a failure leaves the list untouched */
+	if (SET_WITH_COUNTER(set)) {
+		ret = ip_set_init_counter(&counter, ext);
+		if (ret)
+			return ret;
+	}
 
 	if (e->id != IPSET_INVALID_ID) {
 		if (i == map->size - 1) {
@@ -199,7 +208,7 @@ list_set_add(struct ip_set *set, u32 i, struct set_adt_elem *d,
 	if (SET_WITH_TIMEOUT(set))
 		ip_set_timeout_set(ext_timeout(e, set), ext->timeout);
 	if (SET_WITH_COUNTER(set))
-		ip_set_init_counter(ext_counter(e, set), ext);
+		*ext_counter(e, set) = counter;
 	if (SET_WITH_COMMENT(set))
 		ip_set_init_comment(ext_comment(e, set), ext);
 	if (SET_WITH_SKBINFO(set))
@@ -305,13 +314,16 @@ list_set_uadd(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 		if (!flag_exist)
 			/* Can't re-add */
 			return -IPSET_ERR_EXIST;
-		/* Update extensions */
-		ip_set_ext_destroy(set, e);
+		/* Update extensions, the counters are kept */
+		if (SET_WITH_COUNTER(set)) {
+			ret = ip_set_init_counter(ext_counter(e, set), ext);
+			if (ret)
+				return ret;
+		}
+		ip_set_ext_reset(set, e);
 
 		if (SET_WITH_TIMEOUT(set))
 			ip_set_timeout_set(ext_timeout(e, set), ext->timeout);
-		if (SET_WITH_COUNTER(set))
-			ip_set_init_counter(ext_counter(e, set), ext);
 		if (SET_WITH_COMMENT(set))
 			ip_set_init_comment(ext_comment(e, set), ext);
 		if (SET_WITH_SKBINFO(set))
@@ -478,6 +490,11 @@ list_set_head(struct ip_set *set, struct sk_buff *skb)
 {
 	const struct list_set *map = set->data;
 	struct nlattr *nested;
+	u32 i, elements = 0;
+
+	for (i = 0; i < map->size; i++)
+		if (list_set_elem(set, map, i)->id != IPSET_INVALID_ID)
+			elements++;
 
 	nested = ipset_nest_start(skb, IPSET_ATTR_DATA);
 	if (!nested)
@@ -485,7 +502,8 @@ list_set_head(struct ip_set *set, struct sk_buff *skb)
 	if (nla_put_net32(skb, IPSET_ATTR_SIZE, htonl(map->size)) ||
 	    nla_put_net32(skb, IPSET_ATTR_REFERENCES, htonl(set->ref - 1)) ||
 	    nla_put_net32(skb, IPSET_ATTR_MEMSIZE,
-			  htonl(sizeof(*map) + map->size * set->dsize)))
+			  htonl(sizeof(*map) + map->size * set->dsize +
+				ip_set_counter_memsize(set, elements))))
 		goto nla_put_failure;
 	if (unlikely(ip_set_put_flags(skb, set)))
 		goto nla_put_failure;
@@ -37,6 +37,10 @@
 #include <linux/seq_file.h>
 #include <linux/jhash.h>
 #include <linux/random.h>
+#include <linux/log2.h>
+#include <linux/mutex.h>
+#include <linux/seqlock.h>
+#include <linux/workqueue.h>
 
 #include <net/net_namespace.h>
 #include <net/ip_vs.h>
@@ -48,19 +52,51 @@
 
 /*
  * Connection hash size. Default is what was selected at compile time.
+ * The table is resized on demand between this initial size and
+ * 2^conn_tab_max_bits buckets.
 */
 static int ip_vs_conn_tab_bits = CONFIG_IP_VS_TAB_BITS;
 module_param_named(conn_tab_bits, ip_vs_conn_tab_bits, int, 0444);
 MODULE_PARM_DESC(conn_tab_bits, "Set connections' hash size");
 
-/* size and mask values */
+/* Bounds of both parameters, the lower one is the lock array size */
+#define IP_VS_CONN_TAB_MIN_BITS	CT_LOCKARRAY_BITS
+#define IP_VS_CONN_TAB_MAX_BITS	20
+
+static int ip_vs_conn_tab_max_bits = IP_VS_CONN_TAB_MAX_BITS;
+
+/* current size value */
 int ip_vs_conn_tab_size __read_mostly;
-static int ip_vs_conn_tab_mask __read_mostly;
 
 /*
  *  Connection hash table: for input and output packets lookups of IPVS
+ *
+ *  While the table is resized, the connections are moved bucket by bucket
+ *  to the table pointed by next, which receives the new connections too.
+ *  Lookups walk both tables and are retried when they miss while a
+ *  connection was being moved.
  */
-static struct hlist_head *ip_vs_conn_tab __read_mostly;
+struct ip_vs_conn_tab {
+	struct ip_vs_conn_tab __rcu	*next;
+	unsigned int			size;
+	unsigned int			mask;
+	struct hlist_head		buckets[0];
+};
+
+static struct ip_vs_conn_tab __rcu *ip_vs_conn_tab __read_mostly;
+
+/* Bumped around each moved bucket, checked by the lookups which miss */
+static seqcount_t ip_vs_conn_tab_seq;
+
+/* Serializes the resizer with the table walkers which may sleep */
+static DEFINE_MUTEX(ip_vs_conn_tab_mutex);
+
+static void ip_vs_conn_tab_resize(struct work_struct *work);
+static DECLARE_WORK(ip_vs_conn_tab_work, ip_vs_conn_tab_resize);
+
+/* number of hashed connections and of completed resizes */
+static atomic_t ip_vs_conn_hashed = ATOMIC_INIT(0);
+static unsigned int ip_vs_conn_tab_resizes;
 
 /*  SLAB cache for IPVS connections */
 static struct kmem_cache *ip_vs_conn_cachep __read_mostly;
@@ -72,12 +108,39 @@ static atomic_t ip_vs_conn_no_cport_cnt = ATOMIC_INIT(0);
 static unsigned int ip_vs_conn_rnd __read_mostly;
 
 /*
- *  Fine locking granularity for big connection hash table
+ *  Fine locking granularity for big connection hash table.
+ *  The lock is selected by the low bits of the unmasked hash value, so a
+ *  connection keeps its lock when it is moved to a resized table. The
+ *  table never shrinks below the lock array, there is one lock per bucket
+ *  at the minimal table size.
  */
-#define CT_LOCKARRAY_BITS  5
+#define CT_LOCKARRAY_BITS  8
 #define CT_LOCKARRAY_SIZE  (1<<CT_LOCKARRAY_BITS)
 #define CT_LOCKARRAY_MASK  (CT_LOCKARRAY_SIZE-1)
 
+static int ip_vs_conn_tab_max_bits_set(const char *val,
+				       const struct kernel_param *kp)
+{
+	int bits, ret;
+
+	ret = kstrtoint(val, 0, &bits);
+	if (ret)
+		return ret;
+	*(int *)kp->arg = clamp(bits, IP_VS_CONN_TAB_MIN_BITS,
+				IP_VS_CONN_TAB_MAX_BITS);
+	return 0;
+}
+
+static const struct kernel_param_ops ip_vs_conn_tab_max_bits_ops = {
+	.set = ip_vs_conn_tab_max_bits_set,
+	.get = param_get_int,
+};
+
+module_param_cb(conn_tab_max_bits, &ip_vs_conn_tab_max_bits_ops,
+		&ip_vs_conn_tab_max_bits, 0644);
+MODULE_PARM_DESC(conn_tab_max_bits, "Set connections' maximal hash size "
+		 "(8..20)");
+
 /* We need an addrstrlen that works with or without v6 */
 #ifdef CONFIG_IP_VS_IPV6
 #define IP_VS_ADDRSTRLEN INET6_ADDRSTRLEN
@@ -106,7 +169,8 @@ static inline void ct_write_unlock_bh(unsigned int key)
 
 
 /*
- *	Returns hash value for IPVS connection entry
+ *	Returns hash value for IPVS connection entry, to be masked with the
+ *	size of the table it is looked up in
  */
 static unsigned int ip_vs_conn_hashkey(struct net *net, int af, unsigned int proto,
 				       const union nf_inet_addr *addr,
@@ -114,13 +178,13 @@ static unsigned int ip_vs_conn_hashkey(struct net *net, int af, unsigned int pro
 {
 #ifdef CONFIG_IP_VS_IPV6
 	if (af == AF_INET6)
-		return (jhash_3words(jhash(addr, 16, ip_vs_conn_rnd),
+		return jhash_3words(jhash(addr, 16, ip_vs_conn_rnd),
 				    (__force u32)port, proto, ip_vs_conn_rnd) ^
-			((size_t)net>>8)) & ip_vs_conn_tab_mask;
+			((size_t)net>>8);
 #endif
-	return (jhash_3words((__force u32)addr->ip, (__force u32)port, proto,
+	return jhash_3words((__force u32)addr->ip, (__force u32)port, proto,
 			    ip_vs_conn_rnd) ^
-		((size_t)net>>8)) & ip_vs_conn_tab_mask;
+		((size_t)net>>8);
 }
 
 static unsigned int ip_vs_conn_hashkey_param(const struct ip_vs_conn_param *p,
@@ -130,8 +194,7 @@ static unsigned int ip_vs_conn_hashkey_param(const struct ip_vs_conn_param *p,
 	__be16 port;
 
 	if (p->pe_data && p->pe->hashkey_raw)
-		return p->pe->hashkey_raw(p, ip_vs_conn_rnd, inverse) &
-			ip_vs_conn_tab_mask;
+		return p->pe->hashkey_raw(p, ip_vs_conn_rnd, inverse);
 
 	if (likely(!inverse)) {
 		addr = p->caddr;
@@ -160,12 +223,38 @@ static unsigned int ip_vs_conn_hashkey_conn(const struct ip_vs_conn *cp)
 	return ip_vs_conn_hashkey_param(&p, false);
 }
 
+static inline struct hlist_head *
+ip_vs_conn_bucket(struct ip_vs_conn_tab *t, unsigned int hash)
+{
+	return &t->buckets[hash & t->mask];
+}
+
+/* Walk the current table and the one being filled by a resize */
+#define ip_vs_conn_tab_for_each_rcu(t)				\
+	for (t = rcu_dereference(ip_vs_conn_tab); t;		\
+	     t = rcu_dereference(t->next))
+
+/* Grow the table when it holds more than 2 entries per bucket, shrink it
+ * back when it falls under 1 entry per 8 buckets.
+ */
+static inline void ip_vs_conn_tab_check(int hashed)
+{
+	int size = ACCESS_ONCE(ip_vs_conn_tab_size);
+	int max_bits = ACCESS_ONCE(ip_vs_conn_tab_max_bits);
+
+	if (unlikely((hashed > 2 * size && size < (1 << max_bits)) ||
+		     (hashed < size / 8 &&
+		      size > (1 << ip_vs_conn_tab_bits))))
+		schedule_work(&ip_vs_conn_tab_work);
+}
+
 /*
  *	Hashes ip_vs_conn in ip_vs_conn_tab by netns,proto,addr,port.
  *	returns bool success.
  */
 static inline int ip_vs_conn_hash(struct ip_vs_conn *cp)
 {
+	struct ip_vs_conn_tab *t, *next;
 	unsigned int hash;
 	int ret;
 
@@ -181,7 +270,14 @@ static inline int ip_vs_conn_hash(struct ip_vs_conn *cp)
 	if (!(cp->flags & IP_VS_CONN_F_HASHED)) {
 		cp->flags |= IP_VS_CONN_F_HASHED;
 		atomic_inc(&cp->refcnt);
-		hlist_add_head_rcu(&cp->c_list, &ip_vs_conn_tab[hash]);
+		rcu_read_lock();
+		t = rcu_dereference(ip_vs_conn_tab);
+		/* The buckets of a table being resized are moved away */
+		next = rcu_dereference(t->next);
+		if (next)
+			t = next;
+		hlist_add_head_rcu(&cp->c_list, ip_vs_conn_bucket(t, hash));
+		rcu_read_unlock();
 		ret = 1;
 	} else {
 		pr_err("%s(): request for already hashed, called from %pF\n",
@@ -192,6 +288,9 @@ static inline int ip_vs_conn_hash(struct ip_vs_conn *cp)
 	spin_unlock(&cp->lock);
 	ct_write_unlock_bh(hash);
 
+	if (ret)
+		ip_vs_conn_tab_check(atomic_inc_return(&ip_vs_conn_hashed));
+
 	return ret;
 }
 
@@ -222,6 +321,9 @@ static inline int ip_vs_conn_unhash(struct ip_vs_conn *cp)
 	spin_unlock(&cp->lock);
 	ct_write_unlock_bh(hash);
 
+	if (ret)
+		ip_vs_conn_tab_check(atomic_dec_return(&ip_vs_conn_hashed));
+
 	return ret;
 }
 
@@ -244,6 +346,7 @@ static inline bool ip_vs_conn_unlink(struct ip_vs_conn *cp)
 		if (atomic_cmpxchg(&cp->refcnt, 1, 0) == 1) {
 			hlist_del_rcu(&cp->c_list);
 			cp->flags &= ~IP_VS_CONN_F_HASHED;
+			atomic_dec(&ip_vs_conn_hashed);
 			ret = true;
 		}
 	} else
@@ -263,16 +366,12 @@ static inline bool ip_vs_conn_unlink(struct ip_vs_conn *cp)
  *	p->vaddr, p->vport: pkt dest address (load balancer)
  */
 static inline struct ip_vs_conn *
-__ip_vs_conn_in_get(const struct ip_vs_conn_param *p)
+__ip_vs_conn_in_get_tab(struct ip_vs_conn_tab *t, unsigned int hash,
+			const struct ip_vs_conn_param *p)
 {
-	unsigned int hash;
 	struct ip_vs_conn *cp;
 
-	hash = ip_vs_conn_hashkey_param(p, false);
-
-	rcu_read_lock();
-
-	hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[hash], c_list) {
+	hlist_for_each_entry_rcu(cp, ip_vs_conn_bucket(t, hash), c_list) {
 		if (p->cport == cp->cport && p->vport == cp->vport &&
 		    cp->af == p->af &&
 		    ip_vs_addr_equal(p->af, p->caddr, &cp->caddr) &&
@@ -283,14 +382,37 @@ __ip_vs_conn_in_get(const struct ip_vs_conn_param *p)
 			if (!__ip_vs_conn_get(cp))
 				continue;
 			/* HIT */
-			rcu_read_unlock();
 			return cp;
 		}
 	}
 
+	return NULL;
+}
+
+static inline struct ip_vs_conn *
+__ip_vs_conn_in_get(const struct ip_vs_conn_param *p)
+{
+	struct ip_vs_conn_tab *t;
+	unsigned int hash, seq;
+	struct ip_vs_conn *cp;
+
+	hash = ip_vs_conn_hashkey_param(p, false);
+
+	rcu_read_lock();
+
+	do {
+		seq = read_seqcount_begin(&ip_vs_conn_tab_seq);
+		ip_vs_conn_tab_for_each_rcu(t) {
+			cp = __ip_vs_conn_in_get_tab(t, hash, p);
+			if (cp)
+				goto out;
+		}
+	} while (read_seqcount_retry(&ip_vs_conn_tab_seq, seq));
+
+out:
 	rcu_read_unlock();
 
-	return NULL;
+	return cp;
 }
 
 struct ip_vs_conn *ip_vs_conn_in_get(const struct ip_vs_conn_param *p)
@@ -347,23 +469,19 @@ ip_vs_conn_in_get_proto(int af, const struct sk_buff *skb,
 }
 EXPORT_SYMBOL_GPL(ip_vs_conn_in_get_proto);
 
-/* Get reference to connection template */
-struct ip_vs_conn *ip_vs_ct_in_get(const struct ip_vs_conn_param *p)
+static inline struct ip_vs_conn *
+__ip_vs_ct_in_get_tab(struct ip_vs_conn_tab *t, unsigned int hash,
+		      const struct ip_vs_conn_param *p)
 {
-	unsigned int hash;
 	struct ip_vs_conn *cp;
 
-	hash = ip_vs_conn_hashkey_param(p, false);
-
-	rcu_read_lock();
-
-	hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[hash], c_list) {
+	hlist_for_each_entry_rcu(cp, ip_vs_conn_bucket(t, hash), c_list) {
 		if (unlikely(p->pe_data && p->pe->ct_match)) {
 			if (!ip_vs_conn_net_eq(cp, p->net))
 				continue;
 			if (p->pe == cp->pe && p->pe->ct_match(p, cp)) {
 				if (__ip_vs_conn_get(cp))
-					goto out;
+					return cp;
 			}
 			continue;
 		}
@@ -379,10 +497,32 @@ struct ip_vs_conn *ip_vs_ct_in_get(const struct ip_vs_conn_param *p)
 		    p->protocol == cp->protocol &&
 		    ip_vs_conn_net_eq(cp, p->net)) {
 			if (__ip_vs_conn_get(cp))
-				goto out;
+				return cp;
 		}
 	}
-	cp = NULL;
+
+	return NULL;
+}
+
+/* Get reference to connection template */
+struct ip_vs_conn *ip_vs_ct_in_get(const struct ip_vs_conn_param *p)
+{
+	struct ip_vs_conn_tab *t;
+	unsigned int hash, seq;
+	struct ip_vs_conn *cp;
+
+	hash = ip_vs_conn_hashkey_param(p, false);
+
+	rcu_read_lock();
+
+	do {
+		seq = read_seqcount_begin(&ip_vs_conn_tab_seq);
+		ip_vs_conn_tab_for_each_rcu(t) {
+			cp = __ip_vs_ct_in_get_tab(t, hash, p);
+			if (cp)
+				goto out;
+		}
+	} while (read_seqcount_retry(&ip_vs_conn_tab_seq, seq));
 
   out:
 	rcu_read_unlock();
@@ -396,14 +536,38 @@ struct ip_vs_conn *ip_vs_ct_in_get(const struct ip_vs_conn_param *p)
 	return cp;
 }
 
+static inline struct ip_vs_conn *
+__ip_vs_conn_out_get_tab(struct ip_vs_conn_tab *t, unsigned int hash,
+			 const struct ip_vs_conn_param *p)
+{
+	struct ip_vs_conn *cp;
+
+	hlist_for_each_entry_rcu(cp, ip_vs_conn_bucket(t, hash), c_list) {
+		if (p->vport == cp->cport && p->cport == cp->dport &&
+		    cp->af == p->af &&
+		    ip_vs_addr_equal(p->af, p->vaddr, &cp->caddr) &&
+		    ip_vs_addr_equal(p->af, p->caddr, &cp->daddr) &&
+		    p->protocol == cp->protocol &&
+		    ip_vs_conn_net_eq(cp, p->net)) {
+			if (!__ip_vs_conn_get(cp))
+				continue;
+			/* HIT */
+			return cp;
+		}
+	}
+
+	return NULL;
+}
+
 /* Gets ip_vs_conn associated with supplied parameters in the ip_vs_conn_tab.
  * Called for pkts coming from inside-to-OUTside.
  *	p->caddr, p->cport: pkt source address (inside host)
  *	p->vaddr, p->vport: pkt dest address (foreign host) */
 struct ip_vs_conn *ip_vs_conn_out_get(const struct ip_vs_conn_param *p)
 {
-	unsigned int hash;
-	struct ip_vs_conn *cp, *ret=NULL;
+	struct ip_vs_conn_tab *t;
+	unsigned int hash, seq;
+	struct ip_vs_conn *ret;
 
 	/*
 	 *	Check for "full" addressed entries
@@ -412,21 +576,16 @@ struct ip_vs_conn *ip_vs_conn_out_get(const struct ip_vs_conn_param *p)
 
 	rcu_read_lock();
 
-	hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[hash], c_list) {
-		if (p->vport == cp->cport && p->cport == cp->dport &&
-		    cp->af == p->af &&
-		    ip_vs_addr_equal(p->af, p->vaddr, &cp->caddr) &&
-		    ip_vs_addr_equal(p->af, p->caddr, &cp->daddr) &&
-		    p->protocol == cp->protocol &&
-		    ip_vs_conn_net_eq(cp, p->net)) {
-			if (!__ip_vs_conn_get(cp))
-				continue;
-			/* HIT */
-			ret = cp;
-			break;
+	do {
+		seq = read_seqcount_begin(&ip_vs_conn_tab_seq);
+		ip_vs_conn_tab_for_each_rcu(t) {
+			ret = __ip_vs_conn_out_get_tab(t, hash, p);
+			if (ret)
+				goto out;
 		}
-	}
+	} while (read_seqcount_retry(&ip_vs_conn_tab_seq, seq));
 
+out:
 	rcu_read_unlock();
 
 	IP_VS_DBG_BUF(9, "lookup/out %s %s:%d->%s:%d %s\n",
@@ -978,22 +1137,24 @@ ip_vs_conn_new(const struct ip_vs_conn_param *p, int dest_af,
 #ifdef CONFIG_PROC_FS
 struct ip_vs_iter_state {
 	struct seq_net_private	p;
-	struct hlist_head	*l;
+	struct ip_vs_conn_tab	*t;
+	unsigned int		idx;
 };
 
 static void *ip_vs_conn_array(struct seq_file *seq, loff_t pos)
 {
-	int idx;
+	unsigned int idx;
 	struct ip_vs_conn *cp;
 	struct ip_vs_iter_state *iter = seq->private;
+	struct ip_vs_conn_tab *t = iter->t;
 
-	for (idx = 0; idx < ip_vs_conn_tab_size; idx++) {
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[idx], c_list) {
+	for (idx = 0; idx < t->size; idx++) {
+		hlist_for_each_entry_rcu(cp, &t->buckets[idx], c_list) {
 			/* __ip_vs_conn_get() is not needed by
 			 * ip_vs_conn_seq_show and ip_vs_conn_sync_seq_show
 			 */
 			if (pos-- == 0) {
-				iter->l = &ip_vs_conn_tab[idx];
+				iter->idx = idx;
 				return cp;
 			}
 		}
@@ -1003,13 +1164,18 @@ static void *ip_vs_conn_array(struct seq_file *seq, loff_t pos)
 	return NULL;
 }
 
+/* The table can not be resized while it is walked, the mutex keeps it
+ * alive over cond_resched_rcu().
+ */
 static void *ip_vs_conn_seq_start(struct seq_file *seq, loff_t *pos)
 	__acquires(RCU)
 {
 	struct ip_vs_iter_state *iter = seq->private;
 
-	iter->l = NULL;
+	mutex_lock(&ip_vs_conn_tab_mutex);
 	rcu_read_lock();
+	iter->t = rcu_dereference(ip_vs_conn_tab);
+	iter->idx = 0;
 	return *pos ? ip_vs_conn_array(seq, *pos - 1) :SEQ_START_TOKEN;
 }
 
@@ -1017,9 +1183,9 @@ static void *ip_vs_conn_seq_next(struct seq_file *seq, void *v, loff_t *pos)
 {
 	struct ip_vs_conn *cp = v;
 	struct ip_vs_iter_state *iter = seq->private;
+	struct ip_vs_conn_tab *t = iter->t;
 	struct hlist_node *e;
-	struct hlist_head *l = iter->l;
-	int idx;
+	unsigned int idx;
 
 	++*pos;
 	if (v == SEQ_START_TOKEN)
@@ -1030,15 +1196,15 @@ static void *ip_vs_conn_seq_next(struct seq_file *seq, void *v, loff_t *pos)
 	if (e)
 		return hlist_entry(e, struct ip_vs_conn, c_list);
 
-	idx = l - ip_vs_conn_tab;
-	while (++idx < ip_vs_conn_tab_size) {
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[idx], c_list) {
-			iter->l = &ip_vs_conn_tab[idx];
+	idx = iter->idx;
+	while (++idx < t->size) {
+		hlist_for_each_entry_rcu(cp, &t->buckets[idx], c_list) {
+			iter->idx = idx;
 			return cp;
 		}
 		cond_resched_rcu();
 	}
-	iter->l = NULL;
+	iter->idx = t->size;
 	return NULL;
 }
 
@@ -1046,6 +1212,7 @@ static void ip_vs_conn_seq_stop(struct seq_file *seq, void *v)
 	__releases(RCU)
 {
 	rcu_read_unlock();
+	mutex_unlock(&ip_vs_conn_tab_mutex);
 }
 
 static int ip_vs_conn_seq_show(struct seq_file *seq, void *v)
@@ -1242,17 +1409,21 @@ static inline int todrop_entry(struct ip_vs_conn *cp)
 /* Called from keventd and must protect itself from softirqs */
 void ip_vs_random_dropentry(struct net *net)
 {
-	int idx;
+	unsigned int idx;
 	struct ip_vs_conn *cp, *cp_c;
+	struct ip_vs_conn_tab *t;
 
+	mutex_lock(&ip_vs_conn_tab_mutex);
 	rcu_read_lock();
+	t = rcu_dereference(ip_vs_conn_tab);
 	/*
 	 * Randomly scan 1/32 of the whole table every second
 	 */
-	for (idx = 0; idx < (ip_vs_conn_tab_size>>5); idx++) {
-		unsigned int hash = prandom_u32() & ip_vs_conn_tab_mask;
+	for (idx = 0; idx < (t->size >> 5); idx++) {
+		unsigned int hash = prandom_u32();
 
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[hash], c_list) {
+		hlist_for_each_entry_rcu(cp, ip_vs_conn_bucket(t, hash),
+					 c_list) {
 			if (cp->flags & IP_VS_CONN_F_TEMPLATE)
 				/* connection template */
 				continue;
@@ -1302,6 +1473,7 @@ void ip_vs_random_dropentry(struct net *net)
 		cond_resched_rcu();
 	}
 	rcu_read_unlock();
+	mutex_unlock(&ip_vs_conn_tab_mutex);
 }
 
 
@@ -1310,15 +1482,18 @@ void ip_vs_random_dropentry(struct net *net)
  */
 static void ip_vs_conn_flush(struct net *net)
 {
-	int idx;
+	unsigned int idx;
 	struct ip_vs_conn *cp, *cp_c;
+	struct ip_vs_conn_tab *t;
 	struct netns_ipvs *ipvs = net_ipvs(net);
 
 flush_again:
+	mutex_lock(&ip_vs_conn_tab_mutex);
 	rcu_read_lock();
-	for (idx = 0; idx < ip_vs_conn_tab_size; idx++) {
+	t = rcu_dereference(ip_vs_conn_tab);
+	for (idx = 0; idx < t->size; idx++) {
 
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[idx], c_list) {
+		hlist_for_each_entry_rcu(cp, &t->buckets[idx], c_list) {
 			if (!ip_vs_conn_net_eq(cp, net))
 				continue;
 			IP_VS_DBG(4, "del connection\n");
@@ -1334,6 +1509,7 @@ flush_again:
 		cond_resched_rcu();
 	}
 	rcu_read_unlock();
+	mutex_unlock(&ip_vs_conn_tab_mutex);
 
 	/* the counter may be not NULL, because maybe some conn entries
 	   are run by slow timer handler or unhashed but still referred */
@@ -1342,6 +1518,126 @@ flush_again:
 		goto flush_again;
 	}
 }
+
+static struct ip_vs_conn_tab *ip_vs_conn_tab_alloc(int bits)
+{
+	struct ip_vs_conn_tab *t;
+	unsigned int idx, size = 1U << bits;
+
+	t = vmalloc(sizeof(*t) + size * sizeof(t->buckets[0]));
+	if (!t)
+		return NULL;
+
+	RCU_INIT_POINTER(t->next, NULL);
+	t->size = size;
+	t->mask = size - 1;
+	for (idx = 0; idx < size; idx++)
+		INIT_HLIST_HEAD(&t->buckets[idx]);
+
+	return t;
+}
+
+/*
+ *	Resize the connection table to about one entry per bucket
+ */
+static void ip_vs_conn_tab_resize(struct work_struct *work)
+{
+	struct ip_vs_conn_tab *t, *nt;
+	struct hlist_node *n;
+	struct ip_vs_conn *cp;
+	unsigned int idx, hash;
+	int bits;
+
+	mutex_lock(&ip_vs_conn_tab_mutex);
+	t = rcu_dereference_protected(ip_vs_conn_tab,
+			lockdep_is_held(&ip_vs_conn_tab_mutex));
+
+	bits = ilog2(roundup_pow_of_two(max(atomic_read(&ip_vs_conn_hashed),
+					    1)));
+	bits = max(min(bits, ACCESS_ONCE(ip_vs_conn_tab_max_bits)),
+		   ip_vs_conn_tab_bits);
+	if ((1U << bits) == t->size)
+		goto out;
+
+	nt = ip_vs_conn_tab_alloc(bits);
+	if (!nt)
+		goto out;
+
+	rcu_assign_pointer(t->next, nt);
+	/* Nobody adds to the old table after this point */
+	synchronize_rcu();
+
+	/* Both tables have at least CT_LOCKARRAY_SIZE buckets, so all the
+	 * entries of bucket idx are protected by the same lock which also
+	 * protects their new bucket.
+	 */
+	for (idx = 0; idx < t->size; idx++) {
+		ct_write_lock_bh(idx);
+		write_seqcount_begin(&ip_vs_conn_tab_seq);
+		hlist_for_each_entry_safe(cp, n, &t->buckets[idx], c_list) {
+			hash = ip_vs_conn_hashkey_conn(cp);
+			hlist_del_rcu(&cp->c_list);
+			hlist_add_head_rcu(&cp->c_list,
+					   ip_vs_conn_bucket(nt, hash));
+		}
+		write_seqcount_end(&ip_vs_conn_tab_seq);
+		ct_write_unlock_bh(idx);
+		cond_resched();
+	}
+
+	rcu_assign_pointer(ip_vs_conn_tab, nt);
+	ip_vs_conn_tab_size = nt->size;
+	ip_vs_conn_tab_resizes++;
+	synchronize_rcu();
+	vfree(t);
+
+	IP_VS_DBG(2, "Connection hash table resized to %u buckets\n",
+		  nt->size);
+out:
+	mutex_unlock(&ip_vs_conn_tab_mutex);
+}
+
+/*
+ *	Chain length statistics of the connections of a netns for
+ *	/proc/net/ip_vs_stats. The table size and the resizes are global,
+ *	the table is shared by all the netns.
+ */
+void ip_vs_conn_tab_show(struct net *net, struct seq_file *seq)
+{
+	unsigned int idx, len, used, entries, max_len;
+	struct ip_vs_conn_tab *t;
+	struct ip_vs_conn *cp;
+
+	rcu_read_lock();
+restart:
+	used = entries = max_len = 0;
+	t = rcu_dereference(ip_vs_conn_tab);
+	for (idx = 0; idx < t->size; idx++) {
+		len = 0;
+		hlist_for_each_entry_rcu(cp, &t->buckets[idx], c_list)
+			if (net_eq(ip_vs_conn_net(cp), net))
+				len++;
+		if (len) {
+			used++;
+			entries += len;
+			max_len = max(max_len, len);
+		}
+		cond_resched_rcu();
+		/* A resize frees the table after a grace period, which may
+		 * have elapsed while we were rescheduled */
+		if (unlikely(rcu_access_pointer(ip_vs_conn_tab) != t))
+			goto restart;
+	}
+
+/*               01234567 01234567 01234567 01234567 01234567 01234567 */
+	seq_puts(seq,
+		 "\nHashSize  Entries  Buckets AvgChain MaxChain  Resizes\n");
+	seq_printf(seq, "%8X %8X %8X %8X %8X %8X\n", t->size, entries, used,
+		   used ? DIV_ROUND_UP(entries, used) : 0, max_len,
+		   ACCESS_ONCE(ip_vs_conn_tab_resizes));
+	rcu_read_unlock();
+}
+
 /*
  * per netns init and exit
  */
@@ -1366,25 +1662,28 @@ void __net_exit ip_vs_conn_net_cleanup(struct net *net)
 
 int __init ip_vs_conn_init(void)
 {
+	struct ip_vs_conn_tab *t;
 	int idx;
 
-	/* Compute size and mask */
-	ip_vs_conn_tab_size = 1 << ip_vs_conn_tab_bits;
-	ip_vs_conn_tab_mask = ip_vs_conn_tab_size - 1;
+	/* The table never gets less buckets than locks */
+	ip_vs_conn_tab_bits = clamp(ip_vs_conn_tab_bits,
+				    IP_VS_CONN_TAB_MIN_BITS,
+				    IP_VS_CONN_TAB_MAX_BITS);
 
 	/*
 	 * Allocate the connection hash table and initialize its list heads
 	 */
-	ip_vs_conn_tab = vmalloc(ip_vs_conn_tab_size * sizeof(*ip_vs_conn_tab));
-	if (!ip_vs_conn_tab)
+	t = ip_vs_conn_tab_alloc(ip_vs_conn_tab_bits);
+	if (!t)
 		return -ENOMEM;
+	ip_vs_conn_tab_size = t->size;
 
 	/* Allocate ip_vs_conn slab cache */
 	ip_vs_conn_cachep = kmem_cache_create("ip_vs_conn",
 					      sizeof(struct ip_vs_conn), 0,
 					      SLAB_HWCACHE_ALIGN, NULL);
 	if (!ip_vs_conn_cachep) {
-		vfree(ip_vs_conn_tab);
+		vfree(t);
 		return -ENOMEM;
 	}
 
@@ -1395,24 +1694,25 @@ int __init ip_vs_conn_init(void)
 	IP_VS_DBG(0, "Each connection entry needs %Zd bytes at least\n",
 		  sizeof(struct ip_vs_conn));
 
-	for (idx = 0; idx < ip_vs_conn_tab_size; idx++)
-		INIT_HLIST_HEAD(&ip_vs_conn_tab[idx]);
-
 	for (idx = 0; idx < CT_LOCKARRAY_SIZE; idx++)  {
 		spin_lock_init(&__ip_vs_conntbl_lock_array[idx].l);
 	}
+	seqcount_init(&ip_vs_conn_tab_seq);
 
 	/* calculate the random value for connection hash */
 	get_random_bytes(&ip_vs_conn_rnd, sizeof(ip_vs_conn_rnd));
 
+	RCU_INIT_POINTER(ip_vs_conn_tab, t);
+
 	return 0;
 }
 
 void ip_vs_conn_cleanup(void)
 {
+	cancel_work_sync(&ip_vs_conn_tab_work);
 	/* Wait all ip_vs_conn_rcu_free() callbacks to complete */
 	rcu_barrier();
 	/* Release the empty cache */
 	kmem_cache_destroy(ip_vs_conn_cachep);
-	vfree(ip_vs_conn_tab);
+	vfree(rcu_dereference_protected(ip_vs_conn_tab, 1));
 }
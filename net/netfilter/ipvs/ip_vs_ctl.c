@@ -2081,6 +2081,8 @@ static int ip_vs_stats_show(struct seq_file *seq, void *v)
 			show.cps, show.inpps, show.outpps,
 			show.inbps, show.outbps);
 
+	ip_vs_conn_tab_show(net, seq);
+
 	return 0;
 }
 
@@ -39,6 +39,11 @@
  * head drops only.
  * ECN capability is on by default.
  * Low memory footprint (64 bytes per flow)
+ *
+ * When the packet or memory limit is hit, packets are dropped from the
+ * head of the fattest flow. Flows are kept on lists indexed by log2 of
+ * their backlog, so a flow at least half as fat as the fattest one is
+ * found in constant time.
  */
 
 struct fq_codel_flow {
@@ -50,17 +55,29 @@ struct fq_codel_flow {
 	struct codel_vars cvars;
 }; /* please try to keep this structure <= 64 bytes */
 
+#define FQ_CODEL_FAT_LISTS	32	/* one per bit of a backlog */
+
 struct fq_codel_sched_data {
 	struct tcf_proto __rcu *filter_list; /* optional external classifier */
 	struct fq_codel_flow *flows;	/* Flows table [flows_cnt] */
 	u32		*backlogs;	/* backlog table [flows_cnt] */
+	struct list_head *fat_nodes;	/* fat list nodes [flows_cnt] */
 	u32		flows_cnt;	/* number of flows */
 	siphash_key_t	perturbation;	/* hash perturbation */
 	u32		quantum;	/* psched_mtu(qdisc_dev(sch)); */
+	u32		drop_batch_size;
+	u32		memory_limit;
 	struct codel_params cparams;
 	struct codel_stats cstats;
+	u32		memory_usage;
+	u32		drop_overmemory;
 	u32		drop_overlimit;
 	u32		new_flow_count;
+	u32		drop_batches;
+	u64		drop_time;	/* ns spent pruning fat flows */
+
+	u32		fat_map;	/* bitmap of non empty fat lists */
+	struct list_head fat_lists[FQ_CODEL_FAT_LISTS]; /* by fls(backlog) */
 
 	struct list_head new_flows;	/* list of new flows */
 	struct list_head old_flows;	/* list of old flows */
@@ -133,42 +150,92 @@ static inline void flow_queue_add(struct fq_codel_flow *flow,
 	skb->next = NULL;
 }
 
-static unsigned int fq_codel_drop(struct Qdisc *sch)
+/* Set the backlog of a flow, moving it to the fat list matching its
+ * new size when the highest bit of the backlog changed.
+ */
+static void fq_codel_set_backlog(struct fq_codel_sched_data *q,
+				 unsigned int idx, u32 backlog)
+{
+	unsigned int old = fls(q->backlogs[idx]);
+	unsigned int new = fls(backlog);
+
+	q->backlogs[idx] = backlog;
+	if (old == new)
+		return;
+
+	if (old) {
+		list_del(&q->fat_nodes[idx]);
+		if (list_empty(&q->fat_lists[old - 1]))
+			q->fat_map &= ~(1U << (old - 1));
+	}
+	if (new) {
+		list_add(&q->fat_nodes[idx], &q->fat_lists[new - 1]);
+		q->fat_map |= 1U << (new - 1);
+	}
+}
+
+static unsigned int fq_codel_drop(struct Qdisc *sch, unsigned int max_packets)
 {
 	struct fq_codel_sched_data *q = qdisc_priv(sch);
 	struct sk_buff *skb;
-	unsigned int maxbacklog = 0, idx = 0, i, len;
+	unsigned int maxbacklog, idx, i, len, threshold;
 	struct fq_codel_flow *flow;
+	u32 mem = 0;
+	u64 start;
 
-	/* Queue is full! Find the fat flow and drop packet from it.
-	 * This might sound expensive, but with 1024 flows, we scan
-	 * 4KB of memory, and we dont need to handle a complex tree
-	 * in fast path (packet queue/enqueue) with many cache misses.
+	/* Queue is full! Take a flow from the highest fat list: its
+	 * backlog is at least half the one of the fattest flow.
 	 */
-	for (i = 0; i < q->flows_cnt; i++) {
-		if (q->backlogs[i] > maxbacklog) {
-			maxbacklog = q->backlogs[i];
-			idx = i;
-		}
-	}
+	if (!q->fat_map)
+		return q->flows_cnt;
+
+	start = ktime_get_ns();
+	i = fls(q->fat_map) - 1;
+	idx = q->fat_lists[i].next - q->fat_nodes;
+	maxbacklog = q->backlogs[idx];
+
+	/* Our goal is to drop half of this fat flow backlog */
+	threshold = maxbacklog >> 1;
+
 	flow = &q->flows[idx];
-	skb = dequeue_head(flow);
-	len = qdisc_pkt_len(skb);
-	q->backlogs[idx] -= len;
-	kfree_skb(skb);
-	sch->q.qlen--;
-	qdisc_qstats_drop(sch);
-	qdisc_qstats_backlog_dec(sch, skb);
-	flow->dropped++;
+	len = 0;
+	i = 0;
+	do {
+		skb = dequeue_head(flow);
+		len += qdisc_pkt_len(skb);
+		mem += skb->truesize;
+		kfree_skb(skb);
+	} while (++i < max_packets && len < threshold);
+
+	flow->dropped += i;
+	fq_codel_set_backlog(q, idx, maxbacklog - len);
+	q->memory_usage -= mem;
+	sch->qstats.drops += i;
+	sch->qstats.backlog -= len;
+	sch->q.qlen -= i;
+
+	q->drop_batches++;
+	q->drop_time += ktime_get_ns() - start;
 	return idx;
 }
 
+static unsigned int fq_codel_qdisc_drop(struct Qdisc *sch)
+{
+	unsigned int prev_backlog;
+
+	prev_backlog = sch->qstats.backlog;
+	fq_codel_drop(sch, 1U);
+	return prev_backlog - sch->qstats.backlog;
+}
+
 static int fq_codel_enqueue(struct sk_buff *skb, struct Qdisc *sch)
 {
 	struct fq_codel_sched_data *q = qdisc_priv(sch);
-	unsigned int idx, prev_backlog;
+	unsigned int idx, prev_backlog, prev_qlen;
 	struct fq_codel_flow *flow;
 	int uninitialized_var(ret);
+	unsigned int pkt_len;
+	bool memory_limited;
 
 	idx = fq_codel_classify(skb, sch, &ret);
 	if (idx == 0) {
@@ -182,7 +249,7 @@ static int fq_codel_enqueue(struct sk_buff *skb, struct Qdisc *sch)
 	codel_set_enqueue_time(skb);
 	flow = &q->flows[idx];
 	flow_queue_add(flow, skb);
-	q->backlogs[idx] += qdisc_pkt_len(skb);
+	fq_codel_set_backlog(q, idx, q->backlogs[idx] + qdisc_pkt_len(skb));
 	qdisc_qstats_backlog_inc(sch, skb);
 
 	if (list_empty(&flow->flowchain)) {
@@ -191,19 +258,36 @@ static int fq_codel_enqueue(struct sk_buff *skb, struct Qdisc *sch)
 		flow->deficit = q->quantum;
 		flow->dropped = 0;
 	}
-	if (++sch->q.qlen <= sch->limit)
+	q->memory_usage += skb->truesize;
+	memory_limited = q->memory_usage > q->memory_limit;
+	if (++sch->q.qlen <= sch->limit && !memory_limited)
 		return NET_XMIT_SUCCESS;
 
 	prev_backlog = sch->qstats.backlog;
-	q->drop_overlimit++;
-	/* Return Congestion Notification only if we dropped a packet
-	 * from this flow.
+	prev_qlen = sch->q.qlen;
+	pkt_len = qdisc_pkt_len(skb);
+
+	/* Drop half of the fat flow backlog, up to drop_batch_size
+	 * packets, so that the next packets do not hit the limit again.
 	 */
-	if (fq_codel_drop(sch) == idx)
-		return NET_XMIT_CN;
+	ret = fq_codel_drop(sch, q->drop_batch_size);
+
+	prev_qlen -= sch->q.qlen;
+	prev_backlog -= sch->qstats.backlog;
+	q->drop_overlimit += prev_qlen;
+	if (memory_limited)
+		q->drop_overmemory += prev_qlen;
 
-	/* As we dropped a packet, better let upper stack know this */
-	qdisc_tree_reduce_backlog(sch, 1, prev_backlog - sch->qstats.backlog);
+	/* As we dropped packet(s), better let upper stack know this.
+	 * If we dropped a packet for this flow, return NET_XMIT_CN,
+	 * but in this case, our parents wont increase their backlogs.
+	 */
+	if (ret == idx) {
+		qdisc_tree_reduce_backlog(sch, prev_qlen - 1,
+					  prev_backlog - pkt_len);
+		return NET_XMIT_CN;
+	}
+	qdisc_tree_reduce_backlog(sch, prev_qlen, prev_backlog);
 	return NET_XMIT_SUCCESS;
 }
 
@@ -219,8 +303,12 @@ static struct sk_buff *dequeue(struct codel_vars *vars, struct Qdisc *sch)
 
 	flow = container_of(vars, struct fq_codel_flow, cvars);
 	if (flow->head) {
+		unsigned int idx = flow - q->flows;
+
 		skb = dequeue_head(flow);
-		q->backlogs[flow - q->flows] -= qdisc_pkt_len(skb);
+		fq_codel_set_backlog(q, idx,
+				     q->backlogs[idx] - qdisc_pkt_len(skb));
+		q->memory_usage -= skb->truesize;
 		sch->q.qlen--;
 	}
 	return skb;
@@ -297,6 +385,10 @@ static const struct nla_policy fq_codel_policy[TCA_FQ_CODEL_MAX + 1] = {
 	[TCA_FQ_CODEL_ECN]	= { .type = NLA_U32 },
 	[TCA_FQ_CODEL_FLOWS]	= { .type = NLA_U32 },
 	[TCA_FQ_CODEL_QUANTUM]	= { .type = NLA_U32 },
+	[TCA_FQ_CODEL_CE_THRESHOLD] = { .type = NLA_U32 },
+	[TCA_FQ_CODEL_DROP_BATCH_SIZE] = { .type = NLA_U32 },
+	[TCA_FQ_CODEL_MEMORY_LIMIT] = { .type = NLA_U32 },
+	[TCA_FQ_CODEL_BULK_LIMIT] = { .type = NLA_U32 },
 };
 
 static int fq_codel_change(struct Qdisc *sch, struct nlattr *opt)
@@ -327,6 +419,12 @@ static int fq_codel_change(struct Qdisc *sch, struct nlattr *opt)
 		q->cparams.target = (target * NSEC_PER_USEC) >> CODEL_SHIFT;
 	}
 
+	if (tb[TCA_FQ_CODEL_CE_THRESHOLD]) {
+		u64 val = nla_get_u32(tb[TCA_FQ_CODEL_CE_THRESHOLD]);
+
+		q->cparams.ce_threshold = (val * NSEC_PER_USEC) >> CODEL_SHIFT;
+	}
+
 	if (tb[TCA_FQ_CODEL_INTERVAL]) {
 		u64 interval = nla_get_u32(tb[TCA_FQ_CODEL_INTERVAL]);
 
@@ -342,7 +440,19 @@ static int fq_codel_change(struct Qdisc *sch, struct nlattr *opt)
 	if (tb[TCA_FQ_CODEL_QUANTUM])
 		q->quantum = max(256U, nla_get_u32(tb[TCA_FQ_CODEL_QUANTUM]));
 
-	while (sch->q.qlen > sch->limit) {
+	if (tb[TCA_FQ_CODEL_DROP_BATCH_SIZE])
+		q->drop_batch_size =
+			max(1U, nla_get_u32(tb[TCA_FQ_CODEL_DROP_BATCH_SIZE]));
+
+	if (tb[TCA_FQ_CODEL_MEMORY_LIMIT])
+		q->memory_limit =
+			min(1U << 31, nla_get_u32(tb[TCA_FQ_CODEL_MEMORY_LIMIT]));
+
+	if (tb[TCA_FQ_CODEL_BULK_LIMIT])
+		sch->bulk_limit = nla_get_u32(tb[TCA_FQ_CODEL_BULK_LIMIT]);
+
+	while (sch->q.qlen > sch->limit ||
+	       q->memory_usage > q->memory_limit) {
 		struct sk_buff *skb = fq_codel_dequeue(sch);
 
 		q->cstats.drop_len += qdisc_pkt_len(skb);
@@ -376,6 +486,7 @@ static void fq_codel_destroy(struct Qdisc *sch)
 	struct fq_codel_sched_data *q = qdisc_priv(sch);
 
 	tcf_destroy_chain(&q->filter_list);
+	fq_codel_free(q->fat_nodes);
 	fq_codel_free(q->backlogs);
 	fq_codel_free(q->flows);
 }
@@ -387,10 +498,14 @@ static int fq_codel_init(struct Qdisc *sch, struct nlattr *opt)
 
 	sch->limit = 10*1024;
 	q->flows_cnt = 1024;
+	q->memory_limit = 32 << 20; /* 32 MBytes */
+	q->drop_batch_size = 64;
 	q->quantum = psched_mtu(qdisc_dev(sch));
 	get_random_bytes(&q->perturbation, sizeof(q->perturbation));
 	INIT_LIST_HEAD(&q->new_flows);
 	INIT_LIST_HEAD(&q->old_flows);
+	for (i = 0; i < FQ_CODEL_FAT_LISTS; i++)
+		INIT_LIST_HEAD(&q->fat_lists[i]);
 	codel_params_init(&q->cparams);
 	codel_stats_init(&q->cstats);
 	q->cparams.ecn = true;
@@ -411,6 +526,13 @@ static int fq_codel_init(struct Qdisc *sch, struct nlattr *opt)
 			fq_codel_free(q->flows);
 			return -ENOMEM;
 		}
+		q->fat_nodes = fq_codel_zalloc(q->flows_cnt *
+					       sizeof(struct list_head));
+		if (!q->fat_nodes) {
+			fq_codel_free(q->backlogs);
+			fq_codel_free(q->flows);
+			return -ENOMEM;
+		}
 		for (i = 0; i < q->flows_cnt; i++) {
 			struct fq_codel_flow *flow = q->flows + i;
 
@@ -444,10 +566,21 @@ static int fq_codel_dump(struct Qdisc *sch, struct sk_buff *skb)
 			q->cparams.ecn) ||
 	    nla_put_u32(skb, TCA_FQ_CODEL_QUANTUM,
 			q->quantum) ||
+	    nla_put_u32(skb, TCA_FQ_CODEL_DROP_BATCH_SIZE,
+			q->drop_batch_size) ||
+	    nla_put_u32(skb, TCA_FQ_CODEL_MEMORY_LIMIT,
+			q->memory_limit) ||
+	    nla_put_u32(skb, TCA_FQ_CODEL_BULK_LIMIT,
+			sch->bulk_limit) ||
 	    nla_put_u32(skb, TCA_FQ_CODEL_FLOWS,
 			q->flows_cnt))
 		goto nla_put_failure;
 
+	if (q->cparams.ce_threshold != CODEL_DISABLED_THRESHOLD &&
+	    nla_put_u32(skb, TCA_FQ_CODEL_CE_THRESHOLD,
+			codel_time_to_us(q->cparams.ce_threshold)))
+		goto nla_put_failure;
+
 	return nla_nest_end(skb, opts);
 
 nla_put_failure:
@@ -466,6 +599,13 @@ static int fq_codel_dump_stats(struct Qdisc *sch, struct gnet_dump *d)
 	st.qdisc_stats.drop_overlimit = q->drop_overlimit;
 	st.qdisc_stats.ecn_mark = q->cstats.ecn_mark;
 	st.qdisc_stats.new_flow_count = q->new_flow_count;
+	st.qdisc_stats.ce_mark = q->cstats.ce_mark;
+	st.qdisc_stats.memory_usage = q->memory_usage;
+	st.qdisc_stats.drop_overmemory = q->drop_overmemory;
+	st.qdisc_stats.drop_batches = q->drop_batches;
+	if (q->drop_batches)
+		st.qdisc_stats.drop_cost = div_u64(q->drop_time,
+						   q->drop_batches);
 
 	list_for_each(pos, &q->new_flows)
 		st.qdisc_stats.new_flows_len++;
@@ -598,7 +738,7 @@ static struct Qdisc_ops fq_codel_qdisc_ops __read_mostly = {
 	.enqueue	=	fq_codel_enqueue,
 	.dequeue	=	fq_codel_dequeue,
 	.peek		=	qdisc_peek_dequeued,
-	.drop		=	fq_codel_drop,
+	.drop		=	fq_codel_qdisc_drop,
 	.init		=	fq_codel_init,
 	.reset		=	fq_codel_reset,
 	.destroy	=	fq_codel_destroy,
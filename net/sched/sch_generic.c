@@ -61,7 +61,7 @@ static void try_bulk_dequeue_skb(struct Qdisc *q,
 				 const struct netdev_queue *txq,
 				 int *packets)
 {
-	int bytelimit = qdisc_avail_bulklimit(txq) - skb->len;
+	int bytelimit = qdisc_avail_bulklimit(q, txq) - skb->len;
 
 	while (bytelimit > 0) {
 		struct sk_buff *nskb = q->dequeue(q);
@@ -0,0 +1,338 @@
+/*
+ * Load trace replay for the interactive governor
+ *
+ * Replays a load trace on one CPU twice, once with the interactive
+ * governor's fast_switch tunable off (load notifications evaluated after
+ * the 1 ms notif_timer) and once with it on (evaluated from irq_work right
+ * away), and compares:
+ *
+ *  - reaction latency: time from the start of each load step-up in the
+ *    trace until scaling_cur_freq first rises above its value at the step
+ *  - energy proxies from time_in_state: sum of f * t (MHz * s) and of
+ *    f^3 * t normalized to the max frequency, the latter roughly following
+ *    dynamic power when voltage scales with frequency
+ *
+ * The trace is a text file with one "<duration_ms> <busy_percent>" pair
+ * per line; a built-in bursty trace is used when none is given.
+ *
+ * Needs root and the interactive governor on the CPU; skips otherwise.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_SEGS	1024
+#define MAX_FREQS	64
+#define MAX_SAMPLES	(1 << 18)
+#define SAMPLE_US	250
+#define PERIOD_US	1000
+#define STEP_UP_PCT	50
+
+struct seg {
+	unsigned int ms;
+	unsigned int busy;
+};
+
+struct sample {
+	double t;
+	unsigned int freq;
+};
+
+static struct seg segs[MAX_SEGS];
+static int nr_segs;
+
+static struct sample samples[MAX_SAMPLES];
+static volatile int nr_samples;
+static volatile int sampling;
+
+static int cpu;
+static char path_buf[256];
+
+/* light load with periodic bursts, repeated */
+static const struct seg default_trace[] = {
+	{ 200, 5 }, { 40, 100 }, { 160, 10 }, { 20, 90 }, { 180, 5 },
+	{ 100, 60 }, { 100, 5 }, { 10, 100 }, { 190, 20 }, { 60, 100 },
+	{ 300, 0 },
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const char *cpufreq_path(const char *file)
+{
+	snprintf(path_buf, sizeof(path_buf),
+		 "/sys/devices/system/cpu/cpu%d/cpufreq/%s", cpu, file);
+	return path_buf;
+}
+
+static int read_str(const char *path, char *buf, int len)
+{
+	FILE *f = fopen(path, "r");
+	int ok;
+
+	if (!f)
+		return -1;
+	ok = fgets(buf, len, f) != NULL;
+	fclose(f);
+	if (!ok)
+		return -1;
+	buf[strcspn(buf, "\n")] = 0;
+	return 0;
+}
+
+static int write_str(const char *path, const char *val)
+{
+	FILE *f = fopen(path, "w");
+	int ret;
+
+	if (!f)
+		return -1;
+	ret = fputs(val, f) < 0 ? -1 : 0;
+	if (fclose(f))
+		ret = -1;
+	return ret;
+}
+
+/* per-policy tunables when the governor runs per policy, global otherwise */
+static const char *fast_switch_path(void)
+{
+	static char path[256];
+
+	snprintf(path, sizeof(path),
+		 "/sys/devices/system/cpu/cpu%d/cpufreq/interactive/fast_switch",
+		 cpu);
+	if (!access(path, W_OK))
+		return path;
+	snprintf(path, sizeof(path),
+		 "/sys/devices/system/cpu/cpufreq/interactive/fast_switch");
+	if (!access(path, W_OK))
+		return path;
+	return NULL;
+}
+
+struct tis {
+	int n;
+	unsigned int freq[MAX_FREQS];
+	unsigned long long ticks[MAX_FREQS];
+};
+
+static int read_time_in_state(struct tis *t)
+{
+	FILE *f = fopen(cpufreq_path("stats/time_in_state"), "r");
+
+	if (!f)
+		return -1;
+	t->n = 0;
+	while (t->n < MAX_FREQS &&
+	       fscanf(f, "%u %llu", &t->freq[t->n], &t->ticks[t->n]) == 2)
+		t->n++;
+	fclose(f);
+	return t->n ? 0 : -1;
+}
+
+static void *sampler(void *arg)
+{
+	char buf[32];
+
+	(void)arg;
+	while (sampling) {
+		if (nr_samples < MAX_SAMPLES &&
+		    !read_str(cpufreq_path("scaling_cur_freq"), buf,
+			      sizeof(buf))) {
+			samples[nr_samples].t = now();
+			samples[nr_samples].freq = strtoul(buf, NULL, 10);
+			nr_samples++;
+		}
+		usleep(SAMPLE_US);
+	}
+	return NULL;
+}
+
+/* run busy/idle periods for one segment of the trace */
+static void replay_seg(const struct seg *s)
+{
+	double end = now() + s->ms / 1000.0;
+	double busy = PERIOD_US * s->busy / 100.0 / 1e6;
+
+	while (now() < end) {
+		double start = now();
+
+		while (now() - start < busy)
+			;
+		if (s->busy < 100)
+			usleep(PERIOD_US - (unsigned int)(busy * 1e6));
+	}
+}
+
+static int run_mode(const char *name, const char *fs_path, const char *val,
+		    unsigned int max_freq)
+{
+	double seg_start[MAX_SEGS], lat_sum = 0, lat_max = 0;
+	double mhz_s = 0, cube = 0;
+	struct tis before, after;
+	int i, j, steps = 0, missed = 0;
+	pthread_t thr;
+	cpu_set_t set;
+
+	if (write_str(fs_path, val)) {
+		fprintf(stderr, "cannot set %s\n", fs_path);
+		return -1;
+	}
+
+	/* settle at low load first */
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set)) {
+		perror("sched_setaffinity");
+		return -1;
+	}
+	usleep(500000);
+
+	if (read_time_in_state(&before))
+		before.n = 0;
+
+	nr_samples = 0;
+	sampling = 1;
+	if (pthread_create(&thr, NULL, sampler, NULL)) {
+		perror("pthread_create");
+		return -1;
+	}
+
+	for (i = 0; i < nr_segs; i++) {
+		seg_start[i] = now();
+		replay_seg(&segs[i]);
+	}
+
+	sampling = 0;
+	pthread_join(thr, NULL);
+
+	if (!read_time_in_state(&after) && after.n == before.n) {
+		for (i = 0; i < after.n; i++) {
+			/* time_in_state is in 10ms units */
+			double secs = (after.ticks[i] - before.ticks[i]) / 100.0;
+			double rel = (double)after.freq[i] / max_freq;
+
+			mhz_s += after.freq[i] / 1000.0 * secs;
+			cube += rel * rel * rel * secs;
+		}
+	}
+
+	for (i = 1; i < nr_segs; i++) {
+		unsigned int base = 0;
+		double lat = -1;
+
+		if (segs[i].busy < STEP_UP_PCT || segs[i - 1].busy >= STEP_UP_PCT)
+			continue;
+		steps++;
+
+		for (j = 0; j < nr_samples; j++) {
+			if (samples[j].t < seg_start[i]) {
+				base = samples[j].freq;
+				continue;
+			}
+			if (samples[j].t >= seg_start[i] + segs[i].ms / 1000.0)
+				break;
+			if (samples[j].freq > base) {
+				lat = samples[j].t - seg_start[i];
+				break;
+			}
+		}
+
+		if (lat < 0) {
+			missed++;
+			continue;
+		}
+		lat_sum += lat;
+		if (lat > lat_max)
+			lat_max = lat;
+	}
+
+	printf("%-6s: %d step-ups, %d without ramp, latency avg %.2f ms max %.2f ms, "
+	       "energy %.1f MHz*s, f^3 %.3f s\n", name, steps, missed,
+	       steps > missed ? lat_sum * 1000 / (steps - missed) : 0,
+	       lat_max * 1000, mhz_s, cube);
+	return 0;
+}
+
+static int load_trace(const char *file)
+{
+	unsigned int ms, busy;
+	FILE *f;
+
+	if (!file) {
+		nr_segs = sizeof(default_trace) / sizeof(default_trace[0]);
+		memcpy(segs, default_trace, sizeof(default_trace));
+		return 0;
+	}
+
+	f = fopen(file, "r");
+	if (!f) {
+		perror(file);
+		return -1;
+	}
+	while (nr_segs < MAX_SEGS && fscanf(f, "%u %u", &ms, &busy) == 2) {
+		segs[nr_segs].ms = ms;
+		segs[nr_segs].busy = busy > 100 ? 100 : busy;
+		nr_segs++;
+	}
+	fclose(f);
+	return nr_segs ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+	char gov[32], orig[16], buf[32];
+	const char *fs_path;
+	unsigned int max_freq;
+	int ret;
+
+	if (argc > 2)
+		cpu = atoi(argv[2]);
+
+	if (geteuid()) {
+		fprintf(stderr, "interactive_replay must be run as root, skipping\n");
+		return 0;
+	}
+
+	if (read_str(cpufreq_path("scaling_governor"), gov, sizeof(gov)) ||
+	    strcmp(gov, "interactive")) {
+		fprintf(stderr, "cpu%d not using the interactive governor, skipping\n",
+			cpu);
+		return 0;
+	}
+
+	fs_path = fast_switch_path();
+	if (!fs_path || read_str(fs_path, orig, sizeof(orig))) {
+		fprintf(stderr, "no fast_switch tunable, skipping\n");
+		return 0;
+	}
+
+	if (read_str(cpufreq_path("cpuinfo_max_freq"), buf, sizeof(buf)))
+		return 1;
+	max_freq = strtoul(buf, NULL, 10);
+
+	if (load_trace(argc > 1 ? argv[1] : NULL))
+		return 1;
+
+	ret = run_mode("timer", fs_path, "0", max_freq) ||
+	      run_mode("fast", fs_path, "1", max_freq);
+
+	write_str(fs_path, orig);
+
+	return ret ? 1 : 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * Workload classifier replay for msm_performance
+ *
+ * Feeds a recorded load trace through the classifier's test mode
+ * (/sys/module/msm_performance/parameters/wl_replay) and prints every
+ * mode change with the trace time it happened at. The trace has one
+ * cpu_mode_detect line per sample, as recorded from
+ * /sys/kernel/debug/tracing/trace; the CPU selects the cluster and the
+ * recorded mode is ignored. Lines without "cpu_mode_detect:" are
+ * skipped.
+ *
+ * The trace is replayed twice and both runs must give the same modes.
+ * With the built-in trace, sustained full load must also enter single
+ * mode and idle must leave it again.
+ *
+ * Needs root and msm_performance with clusters configured; skips
+ * otherwise.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define REPLAY_PATH	"/sys/module/msm_performance/parameters/wl_replay"
+#define MAX_SAMPLES	(1 << 16)
+#define MAX_LINE	256
+#define MODE_SINGLE	1
+
+static char samples[MAX_SAMPLES][MAX_LINE];
+static char *modes[2][MAX_SAMPLES];
+static int nr_samples;
+
+#define TP_FMT(max, avg, io)						\
+	"kworker/0:1-42 [000] .... 1.000000: cpu_mode_detect: cpu=0 "	\
+	"dt_us=20000 max_load=" #max " avg_load=" #avg " nr_cpus=4 "	\
+	"iowait=" #io " hi_freq=0 input=0 mode=0 io_busy=0"
+
+/* cpu0's cluster, 20ms windows: idle, one busy thread, idle, IO wait */
+static void default_trace(void)
+{
+	static const struct {
+		int windows;
+		const char *fmt;
+	} segs[] = {
+		{ 10, TP_FMT(5, 3, 0) },
+		{ 25, TP_FMT(100, 30, 0) },
+		{ 25, TP_FMT(4, 2, 0) },
+		{ 25, TP_FMT(10, 5, 60) },
+		{ 25, TP_FMT(5, 3, 0) },
+	};
+	unsigned int i;
+	int j;
+
+	for (i = 0; i < sizeof(segs) / sizeof(segs[0]); i++)
+		for (j = 0; j < segs[i].windows; j++)
+			snprintf(samples[nr_samples++], MAX_LINE, "%s",
+				 segs[i].fmt);
+}
+
+static int load_trace(const char *file)
+{
+	char line[MAX_LINE];
+	FILE *f;
+
+	if (!file) {
+		default_trace();
+		return 0;
+	}
+
+	f = fopen(file, "r");
+	if (!f) {
+		perror(file);
+		return -1;
+	}
+	while (nr_samples < MAX_SAMPLES && fgets(line, sizeof(line), f)) {
+		line[strcspn(line, "\n")] = 0;
+		if (!strstr(line, "cpu_mode_detect:"))
+			continue;
+		snprintf(samples[nr_samples++], MAX_LINE, "%s", line);
+	}
+	fclose(f);
+	return nr_samples ? 0 : -1;
+}
+
+static int write_replay(const char *val)
+{
+	FILE *f = fopen(REPLAY_PATH, "w");
+	int ret;
+
+	if (!f)
+		return -1;
+	ret = fputs(val, f) < 0 ? -1 : 0;
+	if (fclose(f))
+		ret = -1;
+	return ret;
+}
+
+static char *read_replay(void)
+{
+	char buf[256];
+	FILE *f = fopen(REPLAY_PATH, "r");
+	int ok;
+
+	if (!f)
+		return NULL;
+	ok = fgets(buf, sizeof(buf), f) != NULL;
+	fclose(f);
+	if (!ok)
+		return NULL;
+	buf[strcspn(buf, "\n")] = 0;
+	return strdup(buf);
+}
+
+static int replay(int run)
+{
+	unsigned long long t = 0, dt;
+	const char *p;
+	int i;
+
+	if (write_replay("reset")) {
+		fprintf(stderr, "cannot reset classifier\n");
+		return -1;
+	}
+
+	for (i = 0; i < nr_samples; i++) {
+		p = strstr(samples[i], "dt_us=");
+		if (!p || sscanf(p, "dt_us=%llu", &dt) != 1 ||
+		    write_replay(samples[i])) {
+			fprintf(stderr, "bad sample %d: '%s'\n", i, samples[i]);
+			return -1;
+		}
+		t += dt;
+
+		modes[run][i] = read_replay();
+		if (!modes[run][i])
+			return -1;
+		if (!run && (!i || strcmp(modes[run][i], modes[run][i - 1])))
+			printf("%8.1f ms: %s\n", t / 1000.0, modes[run][i]);
+	}
+	return 0;
+}
+
+/* single mode bit of cluster 0 after sample @i */
+static int single(int i)
+{
+	return atoi(modes[0][i]) & MODE_SINGLE;
+}
+
+int main(int argc, char **argv)
+{
+	int i, ret = 0;
+
+	if (geteuid()) {
+		fprintf(stderr, "msm_perf_replay must be run as root, skipping\n");
+		return 0;
+	}
+
+	if (access(REPLAY_PATH, W_OK) || write_replay("reset")) {
+		fprintf(stderr, "no msm_performance classifier, skipping\n");
+		return 0;
+	}
+
+	if (load_trace(argc > 1 ? argv[1] : NULL))
+		return 1;
+
+	if (replay(0) || replay(1))
+		return 1;
+
+	for (i = 0; i < nr_samples; i++) {
+		if (strcmp(modes[0][i], modes[1][i])) {
+			printf("sample %d: %s on first run, %s on second\n",
+			       i, modes[0][i], modes[1][i]);
+			ret = 1;
+			break;
+		}
+	}
+
+	if (argc < 2 && (!single(34) || single(59))) {
+		printf("single mode not detected on full load\n");
+		ret = 1;
+	}
+
+	printf("%s\n", ret ? "[FAIL]" : "[PASS]");
+	return ret;
+}
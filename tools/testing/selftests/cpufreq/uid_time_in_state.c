@@ -0,0 +1,170 @@
+/*
+ * Per-uid time in state check for cpufreq_stats
+ *
+ * Reads the binary /proc/uid_cpupower/time_in_state, spins on every
+ * online cpu for a second and reads it again. The file is a u32 array,
+ * [n, uid0, time0[0..n-1], uid1, time1[0..n-1], ...], with times in
+ * clock ticks. The number of frequencies must match the header of
+ * /proc/uid_time_in_state, no uid may lose time and our own uid must
+ * have gained most of the time spent spinning.
+ *
+ * Needs cpufreq_stats with task accounting; skips otherwise.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BIN_PATH	"/proc/uid_cpupower/time_in_state"
+#define TEXT_PATH	"/proc/uid_time_in_state"
+#define MAX_WORDS	(1 << 20)
+#define SPIN_SEC	1
+
+struct snapshot {
+	unsigned int words[MAX_WORDS];
+	size_t nr_words;
+};
+
+static struct snapshot before, after;
+
+static int read_snapshot(struct snapshot *s)
+{
+	FILE *f = fopen(BIN_PATH, "rb");
+
+	if (!f)
+		return -1;
+	s->nr_words = fread(s->words, sizeof(s->words[0]), MAX_WORDS, f);
+	fclose(f);
+	return s->nr_words ? 0 : -1;
+}
+
+/* number of frequencies in the "uid: f0 f1 ..." header line */
+static int text_nr_freqs(void)
+{
+	char line[4096], *tok;
+	int n = -1;
+	FILE *f = fopen(TEXT_PATH, "r");
+
+	if (!f)
+		return -1;
+	if (fgets(line, sizeof(line), f)) {
+		n = 0;
+		for (tok = strtok(line, " \n"); tok; tok = strtok(NULL, " \n"))
+			if (strcmp(tok, "uid:"))
+				n++;
+	}
+	fclose(f);
+	return n;
+}
+
+/* total time of @uid, or -1 if it has no record */
+static long long uid_total(const struct snapshot *s, unsigned int uid)
+{
+	unsigned int n = s->words[0];
+	long long total;
+	size_t i, j;
+
+	for (i = 1; i + n < s->nr_words; i += n + 1) {
+		if (s->words[i] != uid)
+			continue;
+		for (total = 0, j = 1; j <= n; j++)
+			total += s->words[i + j];
+		return total;
+	}
+	return -1;
+}
+
+static void *spin(void *arg)
+{
+	struct timespec start, now;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while (now.tv_sec - start.tv_sec < SPIN_SEC);
+	return arg;
+}
+
+static int check_records(void)
+{
+	unsigned int n = before.words[0];
+	long long t;
+	size_t i;
+	int ret = 0;
+
+	if (after.words[0] != n || (before.nr_words - 1) % (n + 1) ||
+	    (after.nr_words - 1) % (n + 1)) {
+		printf("bad record layout, %u and %u frequencies\n",
+		       n, after.words[0]);
+		return 1;
+	}
+
+	for (i = 1; i + n < before.nr_words; i += n + 1) {
+		t = uid_total(&after, before.words[i]);
+		if (t >= 0 && t < uid_total(&before, before.words[i])) {
+			printf("uid %u lost time: %lld -> %lld\n",
+			       before.words[i],
+			       uid_total(&before, before.words[i]), t);
+			ret = 1;
+		}
+	}
+	return ret;
+}
+
+int main(void)
+{
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	long hz = sysconf(_SC_CLK_TCK);
+	unsigned int uid = getuid();
+	pthread_t *threads;
+	long long gained;
+	int n, ret = 0;
+	long i;
+
+	if (read_snapshot(&before)) {
+		fprintf(stderr, "no %s, skipping\n", BIN_PATH);
+		return 0;
+	}
+
+	n = text_nr_freqs();
+	if (n >= 0 && (unsigned int)n != before.words[0]) {
+		printf("%u frequencies in %s, %d in %s\n",
+		       before.words[0], BIN_PATH, n, TEXT_PATH);
+		ret = 1;
+	}
+
+	threads = calloc(ncpus, sizeof(*threads));
+	if (!threads)
+		return 1;
+	for (i = 0; i < ncpus; i++)
+		pthread_create(&threads[i], NULL, spin, NULL);
+	for (i = 0; i < ncpus; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	if (read_snapshot(&after)) {
+		printf("cannot read %s again\n", BIN_PATH);
+		return 1;
+	}
+
+	ret |= check_records();
+
+	gained = uid_total(&after, uid) - (uid_total(&before, uid) > 0 ?
+					   uid_total(&before, uid) : 0);
+	printf("uid %u: %lld of %ld ticks spun\n", uid, gained,
+	       ncpus * SPIN_SEC * hz);
+	if (gained < ncpus * SPIN_SEC * hz / 2) {
+		printf("spinning time not charged to uid %u\n", uid);
+		ret = 1;
+	}
+
+	printf("%s\n", ret ? "[FAIL]" : "[PASS]");
+	return ret;
+}
@@ -0,0 +1,475 @@
+/*
+ * Per-UID traffic accounting with a cls_bpf eBPF program and per-CPU maps
+ *
+ * Checks the map semantics the accounting program relies on, then sends
+ * UDP datagrams over loopback and compares the per-packet cost of:
+ *  - no accounting,
+ *  - an iptables owner match chain with one rule per UID,
+ *  - a cls_bpf program counting bytes per UID in a per-CPU hash map.
+ *
+ * Needs root, a prio qdisc and cls_bpf, and the tc and iptables tools for
+ * the comparison. Missing tools skip the corresponding pass.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/netlink.h>
+#include <linux/pkt_cls.h>
+#include <linux/rtnetlink.h>
+
+#define NR_PACKETS	200000
+#define PAYLOAD_LEN	64
+#define NR_UID_RULES	32
+#define UDP_PORT	9123
+
+#define BPF_INSN(CODE, DST, SRC, OFF, IMM)			\
+	((struct bpf_insn) {					\
+		.code = CODE, .dst_reg = DST, .src_reg = SRC,	\
+		.off = OFF, .imm = IMM })
+
+#define BPF_MOV64_REG(DST, SRC)	BPF_INSN(BPF_ALU64 | BPF_MOV | BPF_X, DST, SRC, 0, 0)
+#define BPF_MOV64_IMM(DST, IMM)	BPF_INSN(BPF_ALU64 | BPF_MOV | BPF_K, DST, 0, 0, IMM)
+#define BPF_ADD64_REG(DST, SRC)	BPF_INSN(BPF_ALU64 | BPF_ADD | BPF_X, DST, SRC, 0, 0)
+#define BPF_ADD64_IMM(DST, IMM)	BPF_INSN(BPF_ALU64 | BPF_ADD | BPF_K, DST, 0, 0, IMM)
+#define BPF_LDX_MEM(SZ, DST, SRC, OFF)	BPF_INSN(BPF_LDX | BPF_SIZE(SZ) | BPF_MEM, DST, SRC, OFF, 0)
+#define BPF_STX_MEM(SZ, DST, SRC, OFF)	BPF_INSN(BPF_STX | BPF_SIZE(SZ) | BPF_MEM, DST, SRC, OFF, 0)
+#define BPF_JEQ_IMM(DST, IMM, OFF)	BPF_INSN(BPF_JMP | BPF_JEQ | BPF_K, DST, 0, OFF, IMM)
+#define BPF_JMP_A(OFF)		BPF_INSN(BPF_JMP | BPF_JA, 0, 0, OFF, 0)
+#define BPF_CALL_FUNC(FUNC)	BPF_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, FUNC)
+#define BPF_EXIT_INSN()		BPF_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)
+/* pseudo ld_imm64 referring to a map fd of this process */
+#define BPF_LD_MAP_FD(DST, FD)					\
+	BPF_INSN(BPF_LD | BPF_DW | BPF_IMM, DST, 1, 0, FD),	\
+	BPF_INSN(0, 0, 0, 0, 0)
+
+static int nr_cpus;
+
+static __u64 ptr_to_u64(const void *ptr)
+{
+	return (__u64) (unsigned long) ptr;
+}
+
+static int bpf(int cmd, union bpf_attr *attr)
+{
+	return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+static int map_create(int type, int key_size, int value_size, int max)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_type = type;
+	attr.key_size = key_size;
+	attr.value_size = value_size;
+	attr.max_entries = max;
+	return bpf(BPF_MAP_CREATE, &attr);
+}
+
+static int map_update(int fd, void *key, void *value, __u64 flags)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_fd = fd;
+	attr.key = ptr_to_u64(key);
+	attr.value = ptr_to_u64(value);
+	attr.flags = flags;
+	return bpf(BPF_MAP_UPDATE_ELEM, &attr);
+}
+
+static int map_lookup(int fd, void *key, void *value)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_fd = fd;
+	attr.key = ptr_to_u64(key);
+	attr.value = ptr_to_u64(value);
+	return bpf(BPF_MAP_LOOKUP_ELEM, &attr);
+}
+
+static int possible_cpus(void)
+{
+	unsigned int start, end;
+	int n = 0, c;
+	FILE *f;
+
+	f = fopen("/sys/devices/system/cpu/possible", "r");
+	if (!f)
+		return sysconf(_SC_NPROCESSORS_CONF);
+	while (fscanf(f, "%u", &start) == 1) {
+		end = start;
+		c = fgetc(f);
+		if (c == '-') {
+			if (fscanf(f, "%u", &end) != 1)
+				break;
+			c = fgetc(f);
+		}
+		n += end - start + 1;
+		if (c != ',')
+			break;
+	}
+	fclose(f);
+	return n;
+}
+
+#define CHECK(cond, fmt, ...)						\
+	do {								\
+		if (!(cond)) {						\
+			fprintf(stderr, "FAIL %s:%d: " fmt "\n",	\
+				__func__, __LINE__, ##__VA_ARGS__);	\
+			return -1;					\
+		}							\
+	} while (0)
+
+static int test_hash_flags(void)
+{
+	__u32 key = 1;
+	__u64 value = 10;
+	int fd;
+
+	fd = map_create(BPF_MAP_TYPE_HASH, sizeof(key), sizeof(value), 2);
+	CHECK(fd >= 0, "hash map create: %s", strerror(errno));
+
+	CHECK(map_update(fd, &key, &value, BPF_EXIST) < 0 && errno == ENOENT,
+	      "BPF_EXIST on a missing key");
+	CHECK(map_update(fd, &key, &value, BPF_NOEXIST) == 0,
+	      "BPF_NOEXIST insert: %s", strerror(errno));
+	CHECK(map_update(fd, &key, &value, BPF_NOEXIST) < 0 && errno == EEXIST,
+	      "BPF_NOEXIST on an existing key");
+	key = 2;
+	CHECK(map_update(fd, &key, &value, BPF_ANY) == 0, "second insert");
+	key = 3;
+	CHECK(map_update(fd, &key, &value, BPF_ANY) < 0 && errno == E2BIG,
+	      "max_entries not enforced");
+	key = 1;
+	value = 0;
+	CHECK(map_lookup(fd, &key, &value) == 0 && value == 10, "lookup");
+
+	close(fd);
+	return 0;
+}
+
+static int test_percpu(int type)
+{
+	__u64 *values;
+	__u32 key = 0;
+	int fd, cpu;
+
+	values = calloc(nr_cpus, sizeof(*values));
+	CHECK(values, "out of memory");
+
+	fd = map_create(type, sizeof(key), sizeof(*values), 4);
+	CHECK(fd >= 0, "map type %d create: %s", type, strerror(errno));
+
+	/* the syscall sets and reads back the slots of all possible CPUs */
+	for (cpu = 0; cpu < nr_cpus; cpu++)
+		values[cpu] = 100 + cpu;
+	CHECK(map_update(fd, &key, values, BPF_ANY) == 0,
+	      "per-cpu update: %s", strerror(errno));
+	memset(values, 0, nr_cpus * sizeof(*values));
+	CHECK(map_lookup(fd, &key, values) == 0,
+	      "per-cpu lookup: %s", strerror(errno));
+	for (cpu = 0; cpu < nr_cpus; cpu++)
+		CHECK(values[cpu] == 100 + cpu, "cpu %d value %llu", cpu,
+		      (unsigned long long) values[cpu]);
+
+	close(fd);
+	free(values);
+	return 0;
+}
+
+/* r0 = -1, skb->len is added to the per-CPU counter of the socket UID */
+static int load_uid_acct_prog(int map_fd)
+{
+	struct bpf_insn insns[] = {
+		BPF_MOV64_REG(BPF_REG_6, BPF_REG_1),
+		BPF_CALL_FUNC(BPF_FUNC_get_socket_uid),
+		BPF_STX_MEM(BPF_W, BPF_REG_10, BPF_REG_0, -4),
+		BPF_LDX_MEM(BPF_W, BPF_REG_7, BPF_REG_6,
+			    offsetof(struct __sk_buff, len)),
+		BPF_LD_MAP_FD(BPF_REG_1, map_fd),
+		BPF_MOV64_REG(BPF_REG_2, BPF_REG_10),
+		BPF_ADD64_IMM(BPF_REG_2, -4),
+		BPF_CALL_FUNC(BPF_FUNC_map_lookup_elem),
+		BPF_JEQ_IMM(BPF_REG_0, 0, 4),
+		/* existing UID, only this CPU's slot is touched */
+		BPF_LDX_MEM(BPF_DW, BPF_REG_1, BPF_REG_0, 0),
+		BPF_ADD64_REG(BPF_REG_1, BPF_REG_7),
+		BPF_STX_MEM(BPF_DW, BPF_REG_0, BPF_REG_1, 0),
+		BPF_JMP_A(9),
+		/* first packet of this UID */
+		BPF_STX_MEM(BPF_DW, BPF_REG_10, BPF_REG_7, -16),
+		BPF_LD_MAP_FD(BPF_REG_1, map_fd),
+		BPF_MOV64_REG(BPF_REG_2, BPF_REG_10),
+		BPF_ADD64_IMM(BPF_REG_2, -4),
+		BPF_MOV64_REG(BPF_REG_3, BPF_REG_10),
+		BPF_ADD64_IMM(BPF_REG_3, -16),
+		BPF_MOV64_IMM(BPF_REG_4, BPF_ANY),
+		BPF_CALL_FUNC(BPF_FUNC_map_update_elem),
+		BPF_MOV64_IMM(BPF_REG_0, -1),
+		BPF_EXIT_INSN(),
+	};
+	static char log[65536];
+	union bpf_attr attr;
+	int fd;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.prog_type = BPF_PROG_TYPE_SCHED_CLS;
+	attr.insns = ptr_to_u64(insns);
+	attr.insn_cnt = sizeof(insns) / sizeof(insns[0]);
+	attr.license = ptr_to_u64("GPL");
+	attr.log_buf = ptr_to_u64(log);
+	attr.log_size = sizeof(log);
+	attr.log_level = 1;
+
+	fd = bpf(BPF_PROG_LOAD, &attr);
+	if (fd < 0)
+		fprintf(stderr, "prog load: %s\n%s\n", strerror(errno), log);
+	return fd;
+}
+
+static int nl_add_attr(struct nlmsghdr *n, int type, const void *data,
+		       int len)
+{
+	struct rtattr *rta = (void *) n + NLMSG_ALIGN(n->nlmsg_len);
+
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(len);
+	if (len)
+		memcpy(RTA_DATA(rta), data, len);
+	n->nlmsg_len = NLMSG_ALIGN(n->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+	return 0;
+}
+
+/* tc filter add dev lo parent 1: bpf fd <prog_fd> classid 1:1 */
+static int attach_cls_bpf(int prog_fd)
+{
+	struct {
+		struct nlmsghdr n;
+		struct tcmsg t;
+		char buf[512];
+	} req;
+	struct {
+		struct nlmsghdr n;
+		struct nlmsgerr e;
+		char buf[512];
+	} ack;
+	struct sockaddr_nl sa = { .nl_family = AF_NETLINK };
+	struct rtattr *opts;
+	__u32 classid = 0x10001, fd = prog_fd;
+	int sock, ret;
+
+	memset(&req, 0, sizeof(req));
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct tcmsg));
+	req.n.nlmsg_type = RTM_NEWTFILTER;
+	req.n.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | NLM_F_CREATE |
+			    NLM_F_EXCL;
+	req.t.tcm_family = AF_UNSPEC;
+	req.t.tcm_ifindex = if_nametoindex("lo");
+	req.t.tcm_parent = 0x10000;
+	req.t.tcm_info = TC_H_MAKE(1 << 16, htons(ETH_P_ALL));
+
+	nl_add_attr(&req.n, TCA_KIND, "bpf", 4);
+	opts = (void *) &req.n + NLMSG_ALIGN(req.n.nlmsg_len);
+	nl_add_attr(&req.n, TCA_OPTIONS, NULL, 0);
+	nl_add_attr(&req.n, TCA_BPF_CLASSID, &classid, sizeof(classid));
+	nl_add_attr(&req.n, TCA_BPF_FD, &fd, sizeof(fd));
+	nl_add_attr(&req.n, TCA_BPF_NAME, "uid_acct", 9);
+	opts->rta_len = (void *) &req.n + req.n.nlmsg_len - (void *) opts;
+
+	sock = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+	if (sock < 0)
+		return -1;
+	ret = sendto(sock, &req, req.n.nlmsg_len, 0, (struct sockaddr *) &sa,
+		     sizeof(sa));
+	if (ret >= 0)
+		ret = recv(sock, &ack, sizeof(ack), 0);
+	close(sock);
+	if (ret < 0)
+		return -1;
+	if (ack.n.nlmsg_type == NLMSG_ERROR && ack.e.error) {
+		errno = -ack.e.error;
+		return -1;
+	}
+	return 0;
+}
+
+static int run_cmd(const char *cmd)
+{
+	char buf[256];
+
+	snprintf(buf, sizeof(buf), "%s >/dev/null 2>&1", cmd);
+	return system(buf);
+}
+
+static double send_packets(void)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(UDP_PORT),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	char payload[PAYLOAD_LEN] = {};
+	struct timespec t0, t1;
+	int rx, tx, i, sent = 0;
+
+	rx = socket(AF_INET, SOCK_DGRAM, 0);
+	tx = socket(AF_INET, SOCK_DGRAM, 0);
+	if (rx < 0 || tx < 0 ||
+	    bind(rx, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+	    connect(tx, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		perror("socket");
+		exit(1);
+	}
+
+	/* the receiver never reads, datagrams are dropped once its buffer
+	 * is full, which costs the same for every pass
+	 */
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < NR_PACKETS; i++)
+		if (send(tx, payload, sizeof(payload), 0) == sizeof(payload))
+			sent++;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	close(tx);
+	close(rx);
+	if (!sent)
+		return 0;
+	return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) /
+	       sent;
+}
+
+static int setup_qdisc(void)
+{
+	if (run_cmd("tc qdisc replace dev lo root handle 1: prio"))
+		return -1;
+	/* loopback has no tx queue length, give the band a real queue */
+	return run_cmd("tc qdisc replace dev lo parent 1:1 handle 10: pfifo limit 1000");
+}
+
+static void cleanup(void)
+{
+	run_cmd("tc qdisc del dev lo root");
+	run_cmd("iptables -D OUTPUT -o lo -j bpf_uid_acct");
+	run_cmd("iptables -F bpf_uid_acct");
+	run_cmd("iptables -X bpf_uid_acct");
+}
+
+static void bench_iptables(double base)
+{
+	char cmd[128];
+	double ns;
+	int i;
+
+	if (run_cmd("iptables -N bpf_uid_acct") ||
+	    run_cmd("iptables -I OUTPUT -o lo -j bpf_uid_acct")) {
+		printf("iptables owner match: skipped\n");
+		return;
+	}
+	/* per-app accounting needs one counting rule per UID, the UID of
+	 * this process is matched last
+	 */
+	for (i = 0; i < NR_UID_RULES; i++) {
+		snprintf(cmd, sizeof(cmd),
+			 "iptables -A bpf_uid_acct -m owner --uid-owner %u",
+			 i == NR_UID_RULES - 1 ? getuid() : 20000 + i);
+		if (run_cmd(cmd)) {
+			printf("iptables owner match: skipped\n");
+			cleanup();
+			return;
+		}
+	}
+
+	ns = send_packets();
+	printf("iptables owner match, %d rules: %.1f ns/packet (+%.1f)\n",
+	       NR_UID_RULES, ns, ns - base);
+	cleanup();
+}
+
+static int bench_bpf(double base)
+{
+	__u32 uid = getuid();
+	__u64 *values, bytes = 0;
+	int map_fd, prog_fd, cpu;
+	double ns;
+
+	map_fd = map_create(BPF_MAP_TYPE_PERCPU_HASH, sizeof(__u32),
+			    sizeof(__u64), 1024);
+	CHECK(map_fd >= 0, "percpu hash create: %s", strerror(errno));
+	prog_fd = load_uid_acct_prog(map_fd);
+	CHECK(prog_fd >= 0, "uid accounting program rejected");
+
+	if (setup_qdisc()) {
+		printf("cls_bpf per-CPU map: skipped, no tc\n");
+		return 0;
+	}
+	if (attach_cls_bpf(prog_fd)) {
+		fprintf(stderr, "attach cls_bpf: %s\n", strerror(errno));
+		cleanup();
+		return -1;
+	}
+
+	ns = send_packets();
+	cleanup();
+	printf("cls_bpf per-CPU map: %.1f ns/packet (+%.1f)\n", ns, ns - base);
+
+	values = calloc(nr_cpus, sizeof(*values));
+	CHECK(values, "out of memory");
+	CHECK(map_lookup(map_fd, &uid, values) == 0,
+	      "no bytes accounted to uid %u", uid);
+	for (cpu = 0; cpu < nr_cpus; cpu++)
+		bytes += values[cpu];
+	free(values);
+	printf("uid %u: %llu bytes\n", uid, (unsigned long long) bytes);
+	CHECK(bytes >= (__u64) NR_PACKETS * PAYLOAD_LEN,
+	      "accounted bytes too low");
+
+	close(prog_fd);
+	close(map_fd);
+	return 0;
+}
+
+int main(void)
+{
+	double base;
+
+	if (geteuid()) {
+		fprintf(stderr, "bpf_uid_acct: needs root, skipped\n");
+		return 0;
+	}
+
+	nr_cpus = possible_cpus();
+
+	if (test_hash_flags() || test_percpu(BPF_MAP_TYPE_PERCPU_HASH) ||
+	    test_percpu(BPF_MAP_TYPE_PERCPU_ARRAY))
+		return 1;
+	printf("map tests: ok\n");
+
+	cleanup();
+	base = send_packets();
+	printf("no accounting: %.1f ns/packet\n", base);
+
+	bench_iptables(base);
+	if (bench_bpf(base))
+		return 1;
+
+	return 0;
+}
@@ -0,0 +1,39 @@
+#!/bin/sh
+# Runs the test_bpf module once through the interpreter and once through
+# the JIT, so both produce the same results and their timings can be
+# compared side by side.
+
+sysctl=/proc/sys/net/core/bpf_jit_enable
+rc=0
+
+run_test_bpf()
+{
+	echo "--------------------"
+	echo "running test_bpf, $1"
+	echo "--------------------"
+	dmesg -c > /dev/null
+	if /sbin/modprobe test_bpf ; then
+		/sbin/rmmod test_bpf
+		echo "[PASS]"
+	else
+		echo "[FAIL]"
+		rc=1
+	fi
+	dmesg | grep "test_bpf: " | sed 's/^.*test_bpf: //'
+}
+
+if [ ! -w $sysctl ]; then
+	run_test_bpf "default runtime"
+	exit $rc
+fi
+
+saved=$(cat $sysctl)
+
+echo 0 > $sysctl
+run_test_bpf "interpreter"
+
+echo 1 > $sysctl
+run_test_bpf "JIT"
+
+echo $saved > $sysctl
+exit $rc
@@ -0,0 +1,214 @@
+/*
+ * IPv6 output route lookup benchmark
+ *
+ * Several processes send UDP datagrams from unconnected sockets to many
+ * destinations behind one gateway route on a dummy device, so that every
+ * send does a full route lookup. Reports the aggregate send rate and the
+ * number of cached routes in the fib before and after the run: lookups
+ * of gateway routes are served from per-CPU copies and should not add
+ * any clones to the tree.
+ *
+ * Needs root and the ip tool; skips otherwise.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define DEV_NAME	"rt6bench0"
+#define NR_DESTS	4096
+#define PAYLOAD_LEN	64
+#define UDP_PORT	9124
+#define MAX_WORKERS	64
+
+static int nr_workers;
+static int duration = 2;
+
+static int run(const char *cmd)
+{
+	int ret = system(cmd);
+
+	if (ret)
+		fprintf(stderr, "'%s' failed\n", cmd);
+	return ret;
+}
+
+static void teardown(void)
+{
+	int ret = system("ip link del " DEV_NAME " 2>/dev/null");
+
+	(void)ret;
+}
+
+static int setup(void)
+{
+	teardown();
+
+	if (run("ip link add " DEV_NAME " type dummy") ||
+	    run("ip link set " DEV_NAME " up") ||
+	    run("ip -6 addr add 2001:db8:1::1/64 dev " DEV_NAME " nodad") ||
+	    run("ip -6 route add 2001:db8:100::/48 via 2001:db8:1::2 dev "
+		DEV_NAME)) {
+		teardown();
+		return -1;
+	}
+	return 0;
+}
+
+/* Number of cached routes, fifth field of /proc/net/rt6_stats */
+static long rt6_cache_entries(void)
+{
+	unsigned int val[7];
+	FILE *f;
+	int n;
+
+	f = fopen("/proc/net/rt6_stats", "r");
+	if (!f)
+		return -1;
+	n = fscanf(f, "%x %x %x %x %x %x %x", &val[0], &val[1], &val[2],
+		   &val[3], &val[4], &val[5], &val[6]);
+	fclose(f);
+
+	return n == 7 ? (long)val[4] : -1;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long worker(int id)
+{
+	char payload[PAYLOAD_LEN] = { 0 };
+	struct sockaddr_in6 dst = {
+		.sin6_family = AF_INET6,
+		.sin6_port = htons(UDP_PORT),
+	};
+	unsigned long sent = 0;
+	unsigned int i = id;
+	double end;
+	int fd;
+
+	fd = socket(AF_INET6, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		exit(1);
+	}
+
+	inet_pton(AF_INET6, "2001:db8:100::", &dst.sin6_addr);
+
+	end = now() + duration;
+	while (now() < end) {
+		int j;
+
+		for (j = 0; j < 256; j++, i++) {
+			unsigned int dest = i % NR_DESTS;
+
+			dst.sin6_addr.s6_addr[14] = dest >> 8;
+			dst.sin6_addr.s6_addr[15] = dest & 0xff;
+			if (sendto(fd, payload, sizeof(payload), 0,
+				   (struct sockaddr *)&dst,
+				   sizeof(dst)) == sizeof(payload))
+				sent++;
+		}
+	}
+
+	close(fd);
+	return sent;
+}
+
+static int bench(void)
+{
+	int pipefd[MAX_WORKERS][2];
+	unsigned long total = 0;
+	long before, after;
+	int i;
+
+	before = rt6_cache_entries();
+
+	for (i = 0; i < nr_workers; i++) {
+		pid_t pid;
+
+		if (pipe(pipefd[i])) {
+			perror("pipe");
+			return -1;
+		}
+
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			return -1;
+		}
+		if (!pid) {
+			unsigned long sent = worker(i);
+
+			if (write(pipefd[i][1], &sent, sizeof(sent)) !=
+			    sizeof(sent))
+				exit(1);
+			exit(0);
+		}
+		close(pipefd[i][1]);
+	}
+
+	for (i = 0; i < nr_workers; i++) {
+		unsigned long sent = 0;
+
+		if (read(pipefd[i][0], &sent, sizeof(sent)) != sizeof(sent))
+			fprintf(stderr, "worker %d failed\n", i);
+		close(pipefd[i][0]);
+		total += sent;
+	}
+	while (wait(NULL) > 0)
+		;
+
+	after = rt6_cache_entries();
+
+	printf("%d workers, %d destinations: %.0f packets/s\n",
+	       nr_workers, NR_DESTS, (double)total / duration);
+	printf("cached routes: %ld before, %ld after\n", before, after);
+
+	return total ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+	int ret;
+
+	if (argc > 1)
+		nr_workers = atoi(argv[1]);
+	if (argc > 2)
+		duration = atoi(argv[2]);
+	if (nr_workers <= 0)
+		nr_workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_workers > MAX_WORKERS)
+		nr_workers = MAX_WORKERS;
+	if (duration <= 0)
+		duration = 2;
+
+	if (geteuid()) {
+		fprintf(stderr, "udp6_route_bench must be run as root, skipping\n");
+		return 0;
+	}
+
+	if (setup()) {
+		fprintf(stderr, "cannot set up " DEV_NAME ", skipping\n");
+		return 0;
+	}
+
+	ret = bench();
+	teardown();
+
+	return ret ? 1 : 0;
+}